@@ -2,6 +2,7 @@ import os
 import time
 import numpy as np
 import asyncio
+import hashlib
 from typing import Any, final
 import json
 
@@ -129,28 +130,18 @@ class LightFaissVectorDBStorage(BaseVectorStorage):
         # TODO: embeddings的形状到底是什么样子的？运行时确认一下
         lf.normalize_L2_cpu(embeddings, embeddings.shape[0], embeddings.shape[1])
 
-        # 插入逻辑
-        # 1. 检查哪些向量已经存在
-        # 2. 移除已经存在的向量
-        existing_ids_to_remove = []
-        for meta, emb in zip(list_data, embeddings):
-            lightfaiss_internal_id = self._find_lightfaiss_id_by_custom_id(meta["__id__"])
-            if lightfaiss_internal_id is not None:
-                existing_ids_to_remove.append(lightfaiss_internal_id)
-
-        if existing_ids_to_remove:
-            await self._remove_lightfaiss_ids(existing_ids_to_remove)
-        
-        # 3. 插入新的向量
+        # 插入逻辑：以custom id的哈希作为索引中的编号，已经存在的编号由索引删除旧的向量
+        labels = [self._custom_id_to_label(meta["__id__"]) for meta in list_data]
         index = await self._get_index()
-        start_idx = index.get_num()
-        index.add_vectors(embeddings)
+        index.add_with_ids(embeddings, np.array(labels, dtype=np.uint64))
+        # 覆盖已有的编号会把旧的向量标记为删除，与删除路径一样，墓碑超过阈值后压缩
+        if index.needs_compaction():
+            index.compact()
 
-        # 4. 重新储存现有的向量和meta数据
-        for i, meta in enumerate(list_data):
-            fid = start_idx + i
+        # 储存向量和meta数据
+        for i, (fid, meta) in enumerate(zip(labels, list_data)):
             meta["__vector__"] = embeddings[i].tolist()  # 转换为列表以便JSON序列化
-            self._id_to_meta.update({fid: meta})
+            self._id_to_meta[fid] = meta
 
         logger.info(f"Upserted {len(list_data)} vectors to LightFaiss index {self.namespace}")
 
@@ -174,22 +165,30 @@ class LightFaissVectorDBStorage(BaseVectorStorage):
         # 执行查询
         index = await self._get_index()
         # TODO: 返回值的形状怎么样？
-        indices, distances = index.search(embedding, top_k)
-
-        distances = distances[0]
-        indices = indices[0]
+        if ids is not None:
+            # 只在指定的向量中查询，过滤在索引内部完成
+            labels = np.array([self._custom_id_to_label(cid) for cid in ids], dtype=np.uint64)
+            indices, distances = index.search_filtered(embedding, top_k, ids=labels)
+            distances = distances[0]
+            indices = indices[0]
+        else:
+            # 阈值在索引内部判断，只对超过阈值的结果排序取前top_k个
+            _, indices, distances = index.range_search(embedding, self.cosine_better_than_threshold)
+            order = np.argsort(-distances, kind="stable")[:top_k]
+            indices = indices[order]
+            distances = distances[order]
 
         results = []
         for dist, idx in zip(distances, indices):
-            if idx == -1:
-                # TODO: search的返回结果如果是空，应该表达成-1
+            # 结果不足top_k个时填充的编号不在meta中
+            meta = self._id_to_meta.get(int(idx))
+            if meta is None:
                 continue
 
             if dist < self.cosine_better_than_threshold:
                 # 如果距离小于阈值，则认为没有足够相似的向量
                 continue
 
-            meta = self._id_to_meta.get(idx, {})
             results.append(
                 {
                     **meta,
@@ -207,7 +206,7 @@ class LightFaissVectorDBStorage(BaseVectorStorage):
 
     async def delete(self, ids: list[str]):
         """
-        因为FlatIndex不提供删除方法，所以删除时新建一个FlatIndex
+        按custom id删除向量
         """
         logger.info(f"Deleting {len(ids)} from LightFaiss index {self.namespace}")
         to_remove = []
@@ -252,38 +251,42 @@ class LightFaissVectorDBStorage(BaseVectorStorage):
     # Internal methods for LightFaiss
     # ---------------------------------------------------------
 
+    @staticmethod
+    def _custom_id_to_label(custom_id: str) -> int:
+        """
+        custom id 在索引中的64位编号，UINT64_MAX 被索引保留
+        """
+        digest = hashlib.md5(custom_id.encode("utf-8")).digest()
+        return int.from_bytes(digest[:8], "little") % (2**64 - 1)
+
     def _find_lightfaiss_id_by_custom_id(self, custom_id: str):
-        for fid, meta in self._id_to_meta.items():
-            if meta.get("__id__") == custom_id:
-                return fid
-        return None
+        fid = self._custom_id_to_label(custom_id)
+        return fid if fid in self._id_to_meta else None
     
     async def _remove_lightfaiss_ids(self, fid_list):
         """
-        因为FlatIndex不支持remove方法，此处新建一个Index
+        在FlatIndex中把向量标记为删除，查询会直接跳过它们；
+        删除的比例超过阈值后再压缩索引，压缩不改变编号
         """
-        keep_fids = [fid for fid in self._id_to_meta if fid not in fid_list]
-
-        # 重建
-        vectors_to_keep = []
-        new_id_to_meta = {}
-        for new_fid, old_fid in enumerate(keep_fids):
-            vec_meta = self._id_to_meta[old_fid]
-            vectors_to_keep.append(vec_meta["__vector__"])
-            new_id_to_meta[new_fid] = vec_meta
-        
+        to_remove = [fid for fid in fid_list if fid in self._id_to_meta]
+        if not to_remove:
+            return
+
         async with self._storage_lock:
-            self._index = lf.FlatIndex(self._dim, None, lf.MetricType.METRIC_INNER_PRODUCT)
-            if vectors_to_keep:
-                array = np.array(vectors_to_keep, dtype=np.float32)
-                self._index.add_vectors(array)
-            
-            self._id_to_meta = new_id_to_meta
+            self._index.remove_ids(np.array(to_remove, dtype=np.uint64))
+            for fid in to_remove:
+                self._id_to_meta.pop(fid, None)
+
+            if self._index.needs_compaction():
+                self._index.compact()
 
     def _save_lightfaiss_index(self):
         """
         保存当前的lightFaiss和meta data到磁盘
         """
+        # WAL 模式下 save 只提交这一批修改的日志，不再重写全部向量
+        if not self._index.is_wal_enabled():
+            self._index.enable_wal(self._lightfaiss_index_file)
         self._index.save(self._lightfaiss_index_file)
 
         # Save metadata dict to JSON. Convert all keys to strings for JSON storage.
@@ -303,7 +306,8 @@ class LightFaissVectorDBStorage(BaseVectorStorage):
             return
 
         try:
-            self._index.load(self._lightfaiss_index_file)
+            # 映射索引文件，多个进程共享同一份页缓存，追加只为新的向量分配内存，压缩时才复制映射的数据
+            self._index.load_mmap(self._lightfaiss_index_file)
             with open(self._meta_file, "r", encoding="utf-8") as f:
                 stored_dict = json.load(f)
             
@@ -311,6 +315,11 @@ class LightFaissVectorDBStorage(BaseVectorStorage):
             for fid_str, meta in stored_dict.items():
                 fid = int(fid_str)  # Convert string key back to int
                 self._id_to_meta[fid] = meta
+
+            if self._index.get_num() > 0 and not self._index.has_ids():
+                self._migrate_to_labels()
+            # 加载时已经重放了日志，在同一个日志上继续追加
+            self._index.enable_wal(self._lightfaiss_index_file)
             
             logger.info(
                 f"Faiss index loaded with {self._index.ntotal} vectors from {self._faiss_index_file}"
@@ -321,6 +330,21 @@ class LightFaissVectorDBStorage(BaseVectorStorage):
             self._index = lf.FlatIndex(self._dim, None, lf.MetricType.METRIC_INNER_PRODUCT)
             self._id_to_meta = {}
 
+    def _migrate_to_labels(self):
+        """
+        旧版本的索引按行号保存meta，用meta中的向量重建一个使用custom id编号的索引
+        """
+        metas = list(self._id_to_meta.values())
+        self._index = lf.FlatIndex(self._dim, None, lf.MetricType.METRIC_INNER_PRODUCT)
+        self._id_to_meta = {}
+        if not metas:
+            return
+        labels = [self._custom_id_to_label(meta["__id__"]) for meta in metas]
+        vectors = np.array([meta["__vector__"] for meta in metas], dtype=np.float32)
+        self._index.add_with_ids(vectors, np.array(labels, dtype=np.uint64))
+        self._id_to_meta = dict(zip(labels, metas))
+        logger.info(f"Migrated LightFaiss index {self.namespace} to custom id labels")
+
     async def index_done_callback(self):
         async with self._storage_lock:
             if self.storage_updated.value:
@@ -386,6 +410,8 @@ class LightFaissVectorDBStorage(BaseVectorStorage):
 
                 if os.path.exists(self._lightfaiss_index_file):
                     os.remove(self._lightfaiss_index_file)
+                if os.path.exists(self._lightfaiss_index_file + ".wal"):
+                    os.remove(self._lightfaiss_index_file + ".wal")
                 if os.path.exists(self._meta_file):
                     os.remove(self._meta_file)
 
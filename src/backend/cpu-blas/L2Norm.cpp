@@ -1,5 +1,6 @@
 #include "backend/cpu-blas/L2Norm.hpp"
 #include "backend/cpu-blas/distance.hpp"
+#include "backend/cpu-blas/kernels.hpp"
 
 #include <cmath>
 
@@ -31,14 +32,12 @@ void fvec_renorm_L2_noomp (
     size_t nx,
     float* x
 ) {
+    const DistanceKernels& kernels = getKernels();
     for (size_t i = 0; i < nx; ++i) {
         float* xi = x + i * dim;
-        float norm = fvec_norm_L2sqr(xi, dim);
+        float norm = kernels.norm_L2sqr(xi, dim);
         if (norm > 0) {
-            norm = 1.0f / sqrtf(norm);
-            for (size_t j = 0; j < dim; ++j) {
-                xi[j] *= norm;
-            }
+            kernels.scale(xi, 1.0f / sqrtf(norm), dim);
         }
     }
 }
@@ -48,15 +47,13 @@ void fvec_renorm_L2_omp (
     size_t nx,
     float* x
 ) {
+    const DistanceKernels& kernels = getKernels();
 #pragma omp parallel for if (nx > 10000)
     for (size_t i = 0; i < nx; ++i) {
         float* xi = x + i * dim;
-        float norm = fvec_norm_L2sqr(xi, dim);
+        float norm = kernels.norm_L2sqr(xi, dim);
         if (norm > 0) {
-            norm = 1.0f / sqrtf(norm);
-            for (size_t j = 0; j < dim; ++j) {
-                xi[j] *= norm;
-            }
+            kernels.scale(xi, 1.0f / sqrtf(norm), dim);
         }
     }
 }
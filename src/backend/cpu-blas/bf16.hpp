@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint> // For uint16_t, uint32_t
+#include <cstring> // std::memcpy
+
+/*
+    bfloat16 与单精度之间的软件转换
+    bf16 就是单精度的高16位，指数范围与单精度相同，转换只需要移位和舍入
+    与 fp16.hpp 一样使用static inline，保证各指令集的编译单元使用自己的副本
+*/
+
+namespace cpu_blas {
+
+static inline float bf16ToFp32(uint16_t h) {
+    uint32_t bits = (uint32_t)h << 16;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// 就近舍入（偶数优先），nan保持为nan
+static inline uint16_t fp32ToBf16(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    if ((x & 0x7fffffff) > 0x7f800000) {
+        return (uint16_t)((x >> 16) | 0x40);
+    }
+    return (uint16_t)((x + 0x7fff + ((x >> 16) & 1)) >> 16);
+}
+
+}
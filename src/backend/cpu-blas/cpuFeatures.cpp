@@ -0,0 +1,85 @@
+#include "backend/cpu-blas/cpuFeatures.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#elif defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+namespace cpu_blas {
+
+namespace {
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// 读取XCR0，判断操作系统是否保存了AVX/AVX-512的寄存器状态
+unsigned long long readXcr0() {
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+}
+
+CpuFeatures detect() {
+    CpuFeatures f;
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return f;
+    }
+    f.sse4_2 = ecx & (1u << 20);
+    f.popcnt = ecx & (1u << 23);
+    bool osxsave = ecx & (1u << 27);
+    bool cpuAvx = ecx & (1u << 28);
+    bool cpuFma = ecx & (1u << 12);
+    bool cpuF16c = ecx & (1u << 29);
+
+    unsigned long long xcr0 = osxsave ? readXcr0() : 0;
+    bool osAvx = (xcr0 & 0x6) == 0x6;        // XMM + YMM
+    bool osAvx512 = (xcr0 & 0xe6) == 0xe6;   // XMM + YMM + opmask + ZMM
+
+    f.avx = cpuAvx && osAvx;
+    f.fma = f.avx && cpuFma;
+    f.f16c = f.avx && cpuF16c;
+
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        f.avx2 = f.avx && (ebx & (1u << 5));
+        f.avx512f = osAvx512 && (ebx & (1u << 16));
+        f.avx512bw = f.avx512f && (ebx & (1u << 30));
+        unsigned int maxSubleaf = eax;
+        if (maxSubleaf >= 1 && __get_cpuid_count(7, 1, &eax, &ebx, &ecx, &edx)) {
+            f.avx512bf16 = f.avx512bw && (eax & (1u << 5));
+        }
+    }
+    return f;
+}
+
+#elif defined(__aarch64__)
+
+CpuFeatures detect() {
+    CpuFeatures f;
+    // aarch64 上 NEON (ASIMD) 是基础指令集
+    f.neon = true;
+#if defined(__linux__)
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    f.sve = hwcap & (1ul << 22);   // HWCAP_SVE
+    unsigned long hwcap2 = getauxval(AT_HWCAP2);
+    f.bf16 = hwcap2 & (1ul << 14); // HWCAP2_BF16
+#endif
+    return f;
+}
+
+#else
+
+CpuFeatures detect() {
+    return CpuFeatures();
+}
+
+#endif
+
+} // namespace
+
+const CpuFeatures& getCpuFeatures() {
+    static const CpuFeatures features = detect();
+    return features;
+}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+namespace cpu_blas {
+
+/*
+    运行时检测到的CPU指令集特性
+    同一个二进制会被分发到不同的x86/ARM机器上，内核的选择只依赖这里的检测结果
+*/
+struct CpuFeatures {
+    // x86
+    bool sse4_2 = false;
+    bool popcnt = false;
+    bool avx = false;
+    bool avx2 = false;
+    bool fma = false;
+    bool f16c = false;
+    bool avx512f = false;
+    bool avx512bw = false;
+    bool avx512bf16 = false;
+
+    // ARM
+    bool neon = false;
+    bool sve = false;
+    bool bf16 = false;      // BFDOT 等bf16指令 (FEAT_BF16)
+};
+
+// 第一次调用时检测，之后直接返回缓存的结果
+const CpuFeatures& getCpuFeatures();
+
+}
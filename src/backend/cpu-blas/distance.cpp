@@ -1,4 +1,6 @@
 #include "backend/cpu-blas/distance.hpp"
+#include "backend/cpu-blas/heap.hpp"
+#include "backend/cpu-blas/kernels.hpp"
 
 #include <memory>          // std::unique_ptr
 #include <cstddef>         // size_t
@@ -46,61 +48,145 @@ void query(
     float* distances,
     uint64_t* results,
     MetricType metricType,
-    float* metricArg
+    float* metricArg,
+    const RowFilter* filter
 ) {
     if (nQuery == 0 || k == 0 || dim == 0 || nData == 0)
         return;
+    // 查询数量很少时 sgemm_ 退化为 GEMV，直接使用SIMD内核扫描数据库
+    if (nQuery <= kScanQueryThreshold) {
+        if (metricType == MetricType::METRIC_INNER_PRODUCT) {
+            cpu_blas::calIPScan(query, data, nQuery, nData, dim, k, distances, results, filter);
+        } else {
+            cpu_blas::calL2Scan(query, data, nQuery, nData, dim, k, distances, results, filter);
+        }
+        return;
+    }
     // 选择合适的计算内积的函数
     if (metricType == MetricType::METRIC_INNER_PRODUCT) {
-        cpu_blas::calIPBLAS(query, data, nQuery, nData, dim, k, distances, results, dataNorm);
+        cpu_blas::calIPBLAS(query, data, nQuery, nData, dim, k, distances, results, dataNorm, filter);
     } else {
-        cpu_blas::calL2BLAS(query, data, nQuery, nData, dim, k, distances, results, dataNorm);
+        cpu_blas::calL2BLAS(query, data, nQuery, nData, dim, k, distances, results, dataNorm, filter);
     }
 }
 
-void calL2BLAS(
+namespace {
+
+// 计算量小于该阈值时不开启多线程，避免线程调度的开销超过计算本身
+const size_t kMinParallelWork = 1 << 18;
+
+// 单精度数据库直接返回原始数据
+struct Fp32Rows {
+    const float* y;
+    size_t dim;
+    const float* operator()(size_t j0, size_t, std::vector<float>&) const {
+        return y + j0 * dim;
+    }
+};
+
+/*
+    16位存储（fp16 / bf16）的数据库需要的内核：
+    toFp32 用于分块转换后交给 sgemm_，ipNy / L2Ny 用于少量查询时边读取边计算
+*/
+struct HalfFormat {
+    void (*toFp32)(float* dst, const uint16_t* src, size_t n);
+    void (*ipNy)(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny);
+    void (*L2Ny)(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny);
+};
+
+// 16位数据库按分块转换为单精度后再交给 sgemm_，转换后的分块只在当前任务内使用
+struct HalfRows {
+    const uint16_t* y;
+    size_t dim;
+    void (*toFp32)(float* dst, const uint16_t* src, size_t n);
+    const float* operator()(size_t j0, size_t n, std::vector<float>& buf) const {
+        buf.resize(n * dim);
+        toFp32(buf.data(), y + j0 * dim, n * dim);
+        return buf.data();
+    }
+};
+
+// SQ8编码的数据库按分块解码为单精度后再交给 sgemm_
+struct SQ8Rows {
+    const uint8_t* codes;
+    size_t dim;
+    const float* vmin;
+    const float* scale;
+    const DistanceKernels* kernels;
+    const float* operator()(size_t j0, size_t n, std::vector<float>& buf) const {
+        buf.resize(n * dim);
+        kernels->decode_u8(buf.data(), codes + j0 * dim, vmin, scale, dim, n);
+        return buf.data();
+    }
+};
+
+// 分块并行的任务划分，一个任务为 (查询块, 数据库区间)
+struct BlockPlan {
+    static constexpr size_t bs_x = 4096;
+    static constexpr size_t bs_y = 1024;
+    size_t nSplitY;             // 每个查询块对应的数据库区间数
+    size_t blocksPerSplit;      // 每个区间包含的数据库分块数
+    size_t nTasks;
+    bool parallel;
+
+    BlockPlan(size_t nx, size_t ny, size_t dim) {
+        size_t nThreads = omp_get_max_threads();
+        size_t nBlockX = (nx + bs_x - 1) / bs_x;
+        size_t nBlockY = (ny + bs_y - 1) / bs_y;
+
+        // 查询块不足以喂饱所有线程时，把数据库切成多个区间
+        nSplitY = 1;
+        if (nBlockX < nThreads) {
+            nSplitY = std::min(nBlockY, (nThreads + nBlockX - 1) / nBlockX);
+        }
+        blocksPerSplit = (nBlockY + nSplitY - 1) / nSplitY;
+        nSplitY = (nBlockY + blocksPerSplit - 1) / blocksPerSplit;
+
+        nTasks = nBlockX * nSplitY;
+        parallel = nTasks > 1 && nx * ny * dim > kMinParallelWork;
+    }
+};
+
+/*
+    分块并行的 sgemm_ 驱动
+    按 plan 把任务交给OpenMP线程池，查询数量很少（比如 nQuery=1..16）时只有一个查询块，
+    此时依靠切分数据库来并行，不再依赖OpenBLAS在 sgemm_ 内部的并行
+    rows(j0, n, buf) 返回数据库第 [j0, j0+n) 行的单精度数据，需要转换时写入任务自己的缓冲区buf
+    epilogue(line, i, j0, n) 负责把一行内积 line[0..n) 原地转换成最终的距离
+    consume(t, i, line, j0, n) 在任务t中处理第i个查询与第 [j0, j0+n) 行的距离
+*/
+template <class Rows, class Epilogue, class Consume>
+void blockedGemm(
     const float* x,
-    const float* y,
+    Rows rows,
     size_t nx,
     size_t ny,
     size_t dim,
-    uint64_t k,
-    float* outDistances,
-    uint64_t* outIndices,
-    const float* yNorm
+    const BlockPlan& plan,
+    Epilogue epilogue,
+    Consume consume
 ) {
-    if (nx == 0 || ny == 0)
-        return;
-
-    // block size
-    const size_t bs_x = 4096;
-    const size_t bs_y = 1024;
-    std::unique_ptr<float[]> ip_block(new float[bs_x * bs_y]);
-    std::unique_ptr<float[]> x_norms(new float[nx]);
-    std::unique_ptr<float[]> del2;
-
-    // 临时储存中间结果
-    std::vector<std::pair<float, uint64_t>> tmpSort(nx * ny, std::make_pair(HUGE_VALF, 1));
+    const size_t bs_x = BlockPlan::bs_x;
+    const size_t bs_y = BlockPlan::bs_y;
 
-    // 计算x的范数
-    fvec_norms_L2sqr(x_norms.get(), x, dim, nx);
+#pragma omp parallel for schedule(dynamic) if (plan.parallel)
+    for (int64_t t = 0; t < (int64_t)plan.nTasks; ++t) {
+        size_t bx = t / plan.nSplitY;
+        size_t sy = t % plan.nSplitY;
+        size_t i0 = bx * bs_x;
+        size_t i1 = std::min(nx, i0 + bs_x);
+        size_t jBegin = sy * plan.blocksPerSplit * bs_y;
+        size_t jEnd = std::min(ny, jBegin + plan.blocksPerSplit * bs_y);
 
-    if (!yNorm) {
-        float* y_norms2 = new float[ny];
-        del2.reset(y_norms2);
-        fvec_norms_L2sqr(y_norms2, y, dim, ny);
-        yNorm = y_norms2;
-    }
+        std::unique_ptr<float[]> ip_block(new float[(i1 - i0) * bs_y]);
+        std::vector<float> rowBuf;
 
-    // 计算最终距离，外循环每次移动bs_x个元素，内循环每次移动bs_y个元素
-    for (size_t i0 = 0; i0 < nx; i0 += bs_x) {
-        size_t i1 = std::min(nx, i0 + bs_x);
-        
         // 数据库分块
-        for (size_t j0 = 0; j0 < ny; j0 += bs_y) {
-            size_t j1 = std::min(ny, j0 + bs_y);
+        for (size_t j0 = jBegin; j0 < jEnd; j0 += bs_y) {
+            size_t j1 = std::min(jEnd, j0 + bs_y);
+            const float* yBlock = rows(j0, j1 - j0, rowBuf);
 
-            // 计算实际的内积大小
+            // 计算内积，在OpenMP并行区内OpenBLAS会退化为单线程执行
             float one = 1, zero = 0;
             FINTEGER nyi = j1 - j0, nxi = i1 - i0, di = dim;
             sgemm_(
@@ -110,7 +196,7 @@ void calL2BLAS(
                 &nxi,
                 &di,
                 &one,
-                y + j0 * dim,  // y的起始地址
+                yBlock,        // y的起始地址
                 &di,
                 x + i0 * dim,  // x的起始地址
                 &di,
@@ -119,121 +205,737 @@ void calL2BLAS(
                 &nyi
             );
 
-            // 最终处理
-            for (int64_t i = i0; i < i1; ++i) {
+            // 将当前分块的距离交给调用方
+            for (size_t i = i0; i < i1; ++i) {
                 float* ip_line = ip_block.get() + (i - i0) * (j1 - j0);
-                
-                for (size_t j = j0; j < j1; ++j) {
-                    float ip = ip_line[j - j0];
-                    float d = x_norms[i] + yNorm[j] - 2 * ip;
-                    
-                    if (d < 0) {
-                        d = 0; // 确保距离非负
-                    }
-                    tmpSort[i * ny + j] = std::make_pair(d, j);
-                }
-                // 对每个i的结果进行排序
-                // std::sort(
-                //     tmpSort.begin() + i * (k + bs_y),
-                //     tmpSort.begin() + (i + 1) * (k + bs_y),
-                //     [](const std::pair<float, uint64_t>& a, const std::pair<float, uint64_t>& b) {
-                //         return a.first < b.first; // 注意这里是 <，升序
-                //     }
-                // );
+                epilogue(ip_line, i, j0, j1 - j0);
+                consume(t, i, ip_line, j0, j1 - j0);
+            }
+        }
+    }
+}
+
+/*
+    分块并行的检索引擎
+    每个任务维护自己的top-k堆，所有任务完成后再把同一个查询在不同数据库区间上的堆合并
+    filter 不为空时跳过其中置位的行
+*/
+template <class Heap, class Rows, class Epilogue>
+void blockedSearch(
+    const float* x,
+    Rows rows,
+    size_t nx,
+    size_t ny,
+    size_t dim,
+    uint64_t k,
+    float emptyDistance,
+    float* outDistances,
+    uint64_t* outIndices,
+    const RowFilter* filter,
+    Epilogue epilogue
+) {
+    const size_t bs_x = BlockPlan::bs_x;
+    BlockPlan plan(nx, ny, dim);
+
+    // 每个任务独立的top-k状态，taskHeaps[bx * nSplitY + sy][i - bx * bs_x]
+    std::vector<std::vector<Heap>> taskHeaps(plan.nTasks);
+    for (size_t t = 0; t < plan.nTasks; ++t) {
+        size_t i0 = t / plan.nSplitY * bs_x;
+        taskHeaps[t].resize(std::min(nx, i0 + bs_x) - i0);
+    }
 
+    blockedGemm(x, rows, nx, ny, dim, plan, epilogue,
+        [&](size_t t, size_t i, const float* line, size_t j0, size_t n) {
+            heapPushLine(taskHeaps[t][i % bs_x], k, line, n, j0, filter);
+        }
+    );
+
+    // 合并同一个查询在不同数据库区间上的结果，并写入输出
+#pragma omp parallel for if (plan.parallel)
+    for (int64_t i = 0; i < (int64_t)nx; ++i) {
+        size_t bx = i / bs_x;
+        size_t local = i - bx * bs_x;
+        Heap& heap = taskHeaps[bx * plan.nSplitY][local];
+        for (size_t sy = 1; sy < plan.nSplitY; ++sy) {
+            heapMerge(heap, taskHeaps[bx * plan.nSplitY + sy][local], k);
+        }
+        heapToOutput(heap, k, emptyDistance, outDistances + i * k, outIndices + i * k);
+    }
+}
+
+/*
+    小批量查询的扫描引擎，不调用 sgemm_
+    数据库按行切成若干区间交给OpenMP线程，每个区间再按缓存大小分块，
+    同一个分块被批内所有查询复用；距离算完立即合并进该线程自己的堆
+    distNyFn(dis, x, y, d, ny) 计算一个查询与ny个连续数据向量的距离，T为数据库的存储类型
+    filter 不为空时跳过其中置位的行
+*/
+template <class Heap, class T, class DistNyFn>
+void scanSearch(
+    const float* x,
+    const T* y,
+    size_t nx,
+    size_t ny,
+    size_t dim,
+    uint64_t k,
+    float emptyDistance,
+    float* outDistances,
+    uint64_t* outIndices,
+    const RowFilter* filter,
+    DistNyFn distNyFn
+) {
+    // 每个分块大约256KB，保证在批内的多个查询之间留在L2缓存中
+    const size_t bs_y = std::max<size_t>(64, (256 * 1024) / (dim * sizeof(T)));
+
+    size_t nBlockY = (ny + bs_y - 1) / bs_y;
+    size_t nSplit = std::min<size_t>(omp_get_max_threads(), nBlockY);
+    bool parallel = nSplit > 1 && nx * ny * dim > kMinParallelWork;
+    if (!parallel) {
+        nSplit = 1;
+    }
+
+    std::vector<std::vector<Heap>> splitHeaps(nSplit, std::vector<Heap>(nx));
+
+#pragma omp parallel for if (parallel)
+    for (int64_t s = 0; s < (int64_t)nSplit; ++s) {
+        size_t jBegin = s * ny / nSplit;
+        size_t jEnd = (s + 1) * ny / nSplit;
+        std::vector<Heap>& heaps = splitHeaps[s];
+        std::unique_ptr<float[]> dis(new float[bs_y]);
+
+        for (size_t j0 = jBegin; j0 < jEnd; j0 += bs_y) {
+            size_t j1 = std::min(jEnd, j0 + bs_y);
+            for (size_t i = 0; i < nx; ++i) {
+                distNyFn(dis.get(), x + i * dim, y + j0 * dim, dim, j1 - j0);
+                heapPushLine(heaps[i], k, dis.get(), j1 - j0, j0, filter);
             }
         }
     }
 
-    // 将结果写入输出
     for (size_t i = 0; i < nx; ++i) {
-        // 对每个i的结果进行排序
-        std::sort(
-            tmpSort.begin() + i * ny,
-            tmpSort.begin() + (i + 1) * ny,
-            [](const std::pair<float, uint64_t>& a, const std::pair<float, uint64_t>& b) {
-                return a.first < b.first; // 注意这里是 <，升序
+        Heap& heap = splitHeaps[0][i];
+        for (size_t s = 1; s < nSplit; ++s) {
+            heapMerge(heap, splitHeaps[s][i], k);
+        }
+        heapToOutput(heap, k, emptyDistance, outDistances + i * k, outIndices + i * k);
+    }
+}
+
+// 一个任务（或数据库区间）中一个查询的范围查询结果
+struct RangeHits {
+    std::vector<uint64_t> labels;
+    std::vector<float> distances;
+};
+
+// 距离满足阈值（L2 为 dis < radius，IP 为 dis > radius）且未被 filter 跳过的行追加到 hits
+inline void collectRange(
+    RangeHits& hits,
+    const float* dis,
+    size_t n,
+    uint64_t j0,
+    float radius,
+    bool isIP,
+    const RowFilter* filter
+) {
+    for (size_t j = 0; j < n; ++j) {
+        bool hit = isIP ? dis[j] > radius : dis[j] < radius;
+        if (hit && (filter == nullptr || !filter->skip(j0 + j))) {
+            hits.labels.push_back(j0 + j);
+            hits.distances.push_back(dis[j]);
+        }
+    }
+}
+
+/*
+    把每个查询在 nParts 个数据库区间上的结果按区间顺序拼接成CSR格式
+    partHits(i, p) 返回第i个查询在第p个区间上的结果，拼接后释放
+*/
+template <class PartHits>
+void buildRangeResult(size_t nx, size_t nParts, PartHits partHits, RangeSearchResult& result) {
+    result.lims.assign(nx + 1, 0);
+    for (size_t i = 0; i < nx; ++i) {
+        result.lims[i + 1] = result.lims[i];
+        for (size_t p = 0; p < nParts; ++p) {
+            result.lims[i + 1] += partHits(i, p).labels.size();
+        }
+    }
+    result.labels.resize(result.lims[nx]);
+    result.distances.resize(result.lims[nx]);
+
+#pragma omp parallel for if (result.lims[nx] > 100000)
+    for (int64_t i = 0; i < (int64_t)nx; ++i) {
+        uint64_t offset = result.lims[i];
+        for (size_t p = 0; p < nParts; ++p) {
+            RangeHits& hits = partHits(i, p);
+            std::copy(hits.labels.begin(), hits.labels.end(), result.labels.begin() + offset);
+            std::copy(hits.distances.begin(), hits.distances.end(), result.distances.begin() + offset);
+            offset += hits.labels.size();
+            hits = RangeHits();
+        }
+    }
+}
+
+/*
+    分块并行的范围查询引擎，任务划分与 blockedSearch 相同
+    阈值在每一行的距离算出后立即判断，不需要堆和排序
+*/
+template <class Rows, class Epilogue>
+void blockedRangeSearch(
+    const float* x,
+    Rows rows,
+    size_t nx,
+    size_t ny,
+    size_t dim,
+    float radius,
+    bool isIP,
+    const RowFilter* filter,
+    Epilogue epilogue,
+    RangeSearchResult& result
+) {
+    const size_t bs_x = BlockPlan::bs_x;
+    BlockPlan plan(nx, ny, dim);
+
+    std::vector<std::vector<RangeHits>> taskHits(plan.nTasks);
+    for (size_t t = 0; t < plan.nTasks; ++t) {
+        size_t i0 = t / plan.nSplitY * bs_x;
+        taskHits[t].resize(std::min(nx, i0 + bs_x) - i0);
+    }
+
+    blockedGemm(x, rows, nx, ny, dim, plan, epilogue,
+        [&](size_t t, size_t i, const float* line, size_t j0, size_t n) {
+            collectRange(taskHits[t][i % bs_x], line, n, j0, radius, isIP, filter);
+        }
+    );
+
+    buildRangeResult(nx, plan.nSplitY,
+        [&](size_t i, size_t p) -> RangeHits& {
+            return taskHits[i / bs_x * plan.nSplitY + p][i % bs_x];
+        },
+        result
+    );
+}
+
+// 小批量查询的范围查询引擎，数据库的切分与 scanSearch 相同
+template <class T, class DistNyFn>
+void scanRangeSearch(
+    const float* x,
+    const T* y,
+    size_t nx,
+    size_t ny,
+    size_t dim,
+    float radius,
+    bool isIP,
+    const RowFilter* filter,
+    DistNyFn distNyFn,
+    RangeSearchResult& result
+) {
+    const size_t bs_y = std::max<size_t>(64, (256 * 1024) / (dim * sizeof(T)));
+
+    size_t nBlockY = (ny + bs_y - 1) / bs_y;
+    size_t nSplit = std::min<size_t>(omp_get_max_threads(), nBlockY);
+    bool parallel = nSplit > 1 && nx * ny * dim > kMinParallelWork;
+    if (!parallel) {
+        nSplit = 1;
+    }
+
+    std::vector<std::vector<RangeHits>> splitHits(nSplit, std::vector<RangeHits>(nx));
+
+#pragma omp parallel for if (parallel)
+    for (int64_t s = 0; s < (int64_t)nSplit; ++s) {
+        size_t jBegin = s * ny / nSplit;
+        size_t jEnd = (s + 1) * ny / nSplit;
+        std::unique_ptr<float[]> dis(new float[bs_y]);
+
+        for (size_t j0 = jBegin; j0 < jEnd; j0 += bs_y) {
+            size_t j1 = std::min(jEnd, j0 + bs_y);
+            for (size_t i = 0; i < nx; ++i) {
+                distNyFn(dis.get(), x + i * dim, y + j0 * dim, dim, j1 - j0);
+                collectRange(splitHits[s][i], dis.get(), j1 - j0, j0, radius, isIP, filter);
             }
-        );
+        }
+    }
+
+    buildRangeResult(nx, nSplit,
+        [&](size_t i, size_t p) -> RangeHits& {
+            return splitHits[p][i];
+        },
+        result
+    );
+}
+
+/*
+    范围查询的调度，与 query 相同：少量查询扫描数据库，批量查询使用 sgemm_
+    rows 为 sgemm_ 路径读取数据库的方式，ipNy / L2Ny 为扫描路径的内核
+    dataNorm 为空时用 norms(out) 计算数据库的范数
+*/
+template <class T, class Rows, class DistNyFn, class NormsFn>
+void rangeQueryImpl(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t dim,
+    const float* query,
+    const T* data,
+    Rows rows,
+    const float* dataNorm,
+    float radius,
+    MetricType metricType,
+    DistNyFn ipNy,
+    DistNyFn L2Ny,
+    NormsFn norms,
+    const RowFilter* filter,
+    RangeSearchResult& result
+) {
+    const bool isIP = metricType == MetricType::METRIC_INNER_PRODUCT;
+    if (nQuery == 0 || nData == 0 || dim == 0) {
+        result.lims.assign(nQuery + 1, 0);
+        result.labels.clear();
+        result.distances.clear();
+        return;
+    }
+    if (nQuery <= kScanQueryThreshold) {
+        scanRangeSearch(query, data, nQuery, nData, dim, radius, isIP, filter, isIP ? ipNy : L2Ny, result);
+        return;
+    }
+    if (isIP) {
+        blockedRangeSearch(query, rows, nQuery, nData, dim, radius, isIP, filter,
+            [](float*, size_t, size_t, size_t) {}, result);
+        return;
+    }
+
+    std::unique_ptr<float[]> x_norms(new float[nQuery]);
+    std::unique_ptr<float[]> del2;
+    fvec_norms_L2sqr(x_norms.get(), query, dim, nQuery);
+    if (!dataNorm) {
+        float* y_norms2 = new float[nData];
+        del2.reset(y_norms2);
+        norms(y_norms2);
+        dataNorm = y_norms2;
+    }
+
+    const float* xNorm = x_norms.get();
+    const DistanceKernels& kernels = getKernels();
+    blockedRangeSearch(query, rows, nQuery, nData, dim, radius, isIP, filter,
+        [xNorm, dataNorm, &kernels](float* line, size_t i, size_t j0, size_t n) {
+            kernels.L2_from_ip(line, line, xNorm[i], dataNorm + j0, n);
+        },
+        result
+    );
+}
 
-        for (size_t j = 0; j < k; ++j) {
-            outDistances[i * k + j] = tmpSort[i * ny + j].first;
-            outIndices[i * k + j] = tmpSort[i * ny + j].second;
+// 16位数据库按转换后的数据计算每一行的平方范数
+void halfNorms(float* norms, const uint16_t* y, size_t ny, size_t dim, const HalfFormat& fmt) {
+    const DistanceKernels& kernels = getKernels();
+#pragma omp parallel if (ny > 10000)
+    {
+        std::vector<float> row(dim);
+#pragma omp for
+        for (int64_t j = 0; j < (int64_t)ny; ++j) {
+            fmt.toFp32(row.data(), y + j * dim, dim);
+            norms[j] = kernels.norm_L2sqr(row.data(), dim);
         }
     }
-} 
+}
 
-void calIPBLAS(
+// 16位数据库的L2检索，范数为空时按转换后的数据计算
+void calL2Half(
     const float* x,
-    const float* y,
+    const uint16_t* y,
     size_t nx,
     size_t ny,
     size_t dim,
     uint64_t k,
     float* outDistances,
     uint64_t* outIndices,
-    const float* yNorm
+    const float* yNorm,
+    const HalfFormat& fmt,
+    const RowFilter* filter
 ) {
-    if (nx == 0 || ny == 0)
+    // 少量查询时边读取边转换，数据库只需要以16位读一遍
+    if (nx <= kScanQueryThreshold) {
+        scanSearch<L2Heap>(x, y, nx, ny, dim, k, HUGE_VALF, outDistances, outIndices, filter, fmt.L2Ny);
         return;
+    }
 
-    const size_t bs_x = 4096;
-    const size_t bs_y = 1024;
-    std::unique_ptr<float[]> ip_block(new float[bs_x * bs_y]);
+    const DistanceKernels& kernels = getKernels();
+    std::unique_ptr<float[]> x_norms(new float[nx]);
+    std::unique_ptr<float[]> del2;
+    fvec_norms_L2sqr(x_norms.get(), x, dim, nx);
 
-    // 临时储存中间结果
-    std::vector<std::pair<float, uint>> tmpSort(nx * (k + bs_y), std::make_pair(0.0, 1));
+    if (!yNorm) {
+        float* y_norms2 = new float[ny];
+        del2.reset(y_norms2);
+        halfNorms(y_norms2, y, ny, dim, fmt);
+        yNorm = y_norms2;
+    }
 
-    for (size_t i0 = 0; i0 < nx; i0 += bs_x) {
-        size_t i1 = std::min(nx, i0 + bs_x);
+    const float* xNorm = x_norms.get();
+    blockedSearch<L2Heap>(
+        x, HalfRows{y, dim, fmt.toFp32}, nx, ny, dim, k, HUGE_VALF, outDistances, outIndices, filter,
+        [xNorm, yNorm, &kernels](float* line, size_t i, size_t j0, size_t n) {
+            kernels.L2_from_ip(line, line, xNorm[i], yNorm + j0, n);
+        }
+    );
+}
 
-        for (size_t j0 = 0; j0 < ny; j0 += bs_y) {
-            size_t j1 = std::min(ny, j0 + bs_y);
+void calIPHalf(
+    const float* x,
+    const uint16_t* y,
+    size_t nx,
+    size_t ny,
+    size_t dim,
+    uint64_t k,
+    float* outDistances,
+    uint64_t* outIndices,
+    const HalfFormat& fmt,
+    const RowFilter* filter
+) {
+    if (nx <= kScanQueryThreshold) {
+        scanSearch<IPHeap>(x, y, nx, ny, dim, k, -HUGE_VALF, outDistances, outIndices, filter, fmt.ipNy);
+        return;
+    }
 
-            // 计算内积
-            float one = 1, zero = 0;
-            FINTEGER nyi = j1 - j0, nxi = i1 - i0, di = dim;
-            sgemm_(
-                "Transpose",
-                "Not transpose",
-                &nyi,
-                &nxi,
-                &di,
-                &one,
-                y + j0 * dim,  // y的起始地址
-                &di,
-                x + i0 * dim,  // x的起始地址
-                &di,
-                &zero,
-                ip_block.get(), // 存储结果的内存
-                &nyi
+    blockedSearch<IPHeap>(
+        x, HalfRows{y, dim, fmt.toFp32}, nx, ny, dim, k, -HUGE_VALF, outDistances, outIndices, filter,
+        [](float*, size_t, size_t, size_t) {
+            // 内积即为最终结果
+        }
+    );
+}
+
+void queryHalf(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t k,
+    uint64_t dim,
+    const float* query,
+    const uint16_t* data,
+    const float* dataNorm,
+    float* distances,
+    uint64_t* results,
+    MetricType metricType,
+    const HalfFormat& fmt,
+    const RowFilter* filter
+) {
+    if (nQuery == 0 || k == 0 || dim == 0 || nData == 0)
+        return;
+    if (metricType == MetricType::METRIC_INNER_PRODUCT) {
+        calIPHalf(query, data, nQuery, nData, dim, k, distances, results, fmt, filter);
+    } else {
+        calL2Half(query, data, nQuery, nData, dim, k, distances, results, dataNorm, fmt, filter);
+    }
+}
+
+} // namespace
+
+void queryFP16(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t k,
+    uint64_t dim,
+    const float* query,
+    const uint16_t* data,
+    const float* dataNorm,
+    float* distances,
+    uint64_t* results,
+    MetricType metricType,
+    float* metricArg,
+    const RowFilter* filter
+) {
+    const DistanceKernels& kernels = getKernels();
+    HalfFormat fmt{kernels.fp16_to_fp32, kernels.inner_products_ny_fp16, kernels.L2sqr_ny_fp16};
+    queryHalf(nQuery, nData, k, dim, query, data, dataNorm, distances, results, metricType, fmt, filter);
+}
+
+void queryBF16(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t k,
+    uint64_t dim,
+    const float* query,
+    const uint16_t* data,
+    const float* dataNorm,
+    float* distances,
+    uint64_t* results,
+    MetricType metricType,
+    float* metricArg,
+    const RowFilter* filter
+) {
+    const DistanceKernels& kernels = getKernels();
+    HalfFormat fmt{kernels.bf16_to_fp32, kernels.inner_products_ny_bf16, kernels.L2sqr_ny_bf16};
+    queryHalf(nQuery, nData, k, dim, query, data, dataNorm, distances, results, metricType, fmt, filter);
+}
+
+void rangeQuery(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t dim,
+    const float* query,
+    const float* data,
+    const float* dataNorm,
+    float radius,
+    MetricType metricType,
+    RangeSearchResult& result,
+    const RowFilter* filter
+) {
+    rangeQueryImpl(nQuery, nData, dim, query, data, Fp32Rows{data, dim}, dataNorm, radius, metricType,
+        fvec_inner_products_ny, fvec_L2sqr_ny,
+        [&](float* norms) {
+            fvec_norms_L2sqr(norms, data, dim, nData);
+        },
+        filter, result);
+}
+
+namespace {
+
+void rangeQueryHalf(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t dim,
+    const float* query,
+    const uint16_t* data,
+    const float* dataNorm,
+    float radius,
+    MetricType metricType,
+    RangeSearchResult& result,
+    const HalfFormat& fmt,
+    const RowFilter* filter
+) {
+    rangeQueryImpl(nQuery, nData, dim, query, data, HalfRows{data, dim, fmt.toFp32}, dataNorm, radius, metricType,
+        fmt.ipNy, fmt.L2Ny,
+        [&](float* norms) {
+            halfNorms(norms, data, nData, dim, fmt);
+        },
+        filter, result);
+}
+
+} // namespace
+
+void rangeQueryFP16(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t dim,
+    const float* query,
+    const uint16_t* data,
+    const float* dataNorm,
+    float radius,
+    MetricType metricType,
+    RangeSearchResult& result,
+    const RowFilter* filter
+) {
+    const DistanceKernels& kernels = getKernels();
+    HalfFormat fmt{kernels.fp16_to_fp32, kernels.inner_products_ny_fp16, kernels.L2sqr_ny_fp16};
+    rangeQueryHalf(nQuery, nData, dim, query, data, dataNorm, radius, metricType, result, fmt, filter);
+}
+
+void rangeQueryBF16(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t dim,
+    const float* query,
+    const uint16_t* data,
+    const float* dataNorm,
+    float radius,
+    MetricType metricType,
+    RangeSearchResult& result,
+    const RowFilter* filter
+) {
+    const DistanceKernels& kernels = getKernels();
+    HalfFormat fmt{kernels.bf16_to_fp32, kernels.inner_products_ny_bf16, kernels.L2sqr_ny_bf16};
+    rangeQueryHalf(nQuery, nData, dim, query, data, dataNorm, radius, metricType, result, fmt, filter);
+}
+
+void querySQ8(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t k,
+    uint64_t dim,
+    const float* query,
+    const uint8_t* codes,
+    const float* vmin,
+    const float* scale,
+    const float* codeNorm,
+    float* distances,
+    uint64_t* results,
+    MetricType metricType
+) {
+    if (nQuery == 0 || k == 0 || dim == 0 || nData == 0)
+        return;
+
+    const DistanceKernels& kernels = getKernels();
+    bool isIP = metricType == MetricType::METRIC_INNER_PRODUCT;
+
+    // 批量查询：按分块解码后使用 sgemm_，与单精度数据库的路径相同
+    if (nQuery > kScanQueryThreshold) {
+        SQ8Rows rows{codes, dim, vmin, scale, &kernels};
+        if (isIP) {
+            blockedSearch<IPHeap>(
+                query, rows, nQuery, nData, dim, k, -HUGE_VALF, distances, results, nullptr,
+                [](float*, size_t, size_t, size_t) {}
             );
-            for (int64_t i = i0; i < i1; ++i) {
-                float* ip_line = ip_block.get() + (i - i0) * (j1 - j0);
+            return;
+        }
 
-                for (size_t j = j0; j < j1; ++j) {
-                    tmpSort[i * (k + bs_y) + k + j - j0] = std::make_pair(ip_line[j - j0], j);
+        std::unique_ptr<float[]> x_norms(new float[nQuery]);
+        std::unique_ptr<float[]> del2;
+        fvec_norms_L2sqr(x_norms.get(), query, dim, nQuery);
+        if (!codeNorm) {
+            float* norms = new float[nData];
+            del2.reset(norms);
+#pragma omp parallel if (nData > 10000)
+            {
+                std::vector<float> row(dim);
+#pragma omp for
+                for (int64_t j = 0; j < (int64_t)nData; ++j) {
+                    kernels.decode_u8(row.data(), codes + j * dim, vmin, scale, dim, 1);
+                    norms[j] = kernels.norm_L2sqr(row.data(), dim);
                 }
-                // 对每个i的结果进行排序
-                std::partial_sort(
-                    tmpSort.begin() + i * (k + bs_y),
-                    tmpSort.begin() + i * (k + bs_y) + k,
-                    tmpSort.begin() + (i + 1) * (k + bs_y),
-                    [](const std::pair<float, uint64_t>& a, const std::pair<float, uint64_t>& b) {
-                        return a.first > b.first; // 注意这里是 >，降序
-                    }
-                );
             }
+            codeNorm = norms;
         }
+
+        const float* xNorm = x_norms.get();
+        blockedSearch<L2Heap>(
+            query, rows, nQuery, nData, dim, k, HUGE_VALF, distances, results, nullptr,
+            [xNorm, codeNorm, &kernels](float* line, size_t i, size_t j0, size_t n) {
+                kernels.L2_from_ip(line, line, xNorm[i], codeNorm + j0, n);
+            }
+        );
+        return;
     }
-    // 将结果写入输出
-    for (size_t i = 0; i < nx; ++i) {
-        for (size_t j = 0; j < k; ++j) {
-            outDistances[i * k + j] = tmpSort[i * (k + bs_y) + j].first;
-            outIndices[i * k + j] = tmpSort[i * (k + bs_y) + j].second;
+
+    /*
+        少量查询：直接扫描8位编码，数据库只读一遍
+        解码公式 y = vmin + scale * c，把与编码无关的部分提前合并进查询：
+        IP: <x, y> = <x, vmin> + sum_i (x[i] * scale[i]) * c[i]，前一项对同一个查询是常数，最后再加回
+        L2: ||x - y||^2 = sum_i ((x[i] - vmin[i]) - scale[i] * c[i])^2
+    */
+    std::vector<float> xt(nQuery * dim);
+    std::vector<float> bias(nQuery, 0.0f);
+    for (uint64_t i = 0; i < nQuery; ++i) {
+        const float* x = query + i * dim;
+        float* t = xt.data() + i * dim;
+        for (uint64_t j = 0; j < dim; ++j) {
+            if (isIP) {
+                t[j] = x[j] * scale[j];
+                bias[i] += x[j] * vmin[j];
+            } else {
+                t[j] = x[j] - vmin[j];
+            }
         }
     }
 
+    if (isIP) {
+        scanSearch<IPHeap>(xt.data(), codes, nQuery, nData, dim, k, -HUGE_VALF, distances, results, nullptr,
+            kernels.inner_products_ny_u8);
+        for (uint64_t i = 0; i < nQuery; ++i) {
+            for (uint64_t j = 0; j < k; ++j) {
+                if (results[i * k + j] != kInvalidIndex) {
+                    distances[i * k + j] += bias[i];
+                }
+            }
+        }
+    } else {
+        scanSearch<L2Heap>(xt.data(), codes, nQuery, nData, dim, k, HUGE_VALF, distances, results, nullptr,
+            [&kernels, scale](float* dis, const float* x, const uint8_t* y, size_t d, size_t ny) {
+                kernels.L2sqr_ny_u8(dis, x, scale, y, d, ny);
+            });
+    }
+}
+
+void calL2Scan(
+    const float* x,
+    const float* y,
+    size_t nx,
+    size_t ny,
+    size_t dim,
+    uint64_t k,
+    float* outDistances,
+    uint64_t* outIndices,
+    const RowFilter* filter
+) {
+    if (nx == 0 || ny == 0 || k == 0)
+        return;
+
+    scanSearch<L2Heap>(x, y, nx, ny, dim, k, HUGE_VALF, outDistances, outIndices, filter, fvec_L2sqr_ny);
+}
+
+void calIPScan(
+    const float* x,
+    const float* y,
+    size_t nx,
+    size_t ny,
+    size_t dim,
+    uint64_t k,
+    float* outDistances,
+    uint64_t* outIndices,
+    const RowFilter* filter
+) {
+    if (nx == 0 || ny == 0 || k == 0)
+        return;
+
+    scanSearch<IPHeap>(x, y, nx, ny, dim, k, -HUGE_VALF, outDistances, outIndices, filter, fvec_inner_products_ny);
+}
+
+void calL2BLAS(
+    const float* x,
+    const float* y,
+    size_t nx,
+    size_t ny,
+    size_t dim,
+    uint64_t k,
+    float* outDistances,
+    uint64_t* outIndices,
+    const float* yNorm,
+    const RowFilter* filter
+) {
+    if (nx == 0 || ny == 0 || k == 0)
+        return;
+
+    std::unique_ptr<float[]> x_norms(new float[nx]);
+    std::unique_ptr<float[]> del2;
+
+    // 计算x的范数
+    fvec_norms_L2sqr(x_norms.get(), x, dim, nx);
+
+    if (!yNorm) {
+        float* y_norms2 = new float[ny];
+        del2.reset(y_norms2);
+        fvec_norms_L2sqr(y_norms2, y, dim, ny);
+        yNorm = y_norms2;
+    }
+
+    const float* xNorm = x_norms.get();
+    const DistanceKernels& kernels = getKernels();
+    blockedSearch<L2Heap>(
+        x, Fp32Rows{y, dim}, nx, ny, dim, k, HUGE_VALF, outDistances, outIndices, filter,
+        [xNorm, yNorm, &kernels](float* line, size_t i, size_t j0, size_t n) {
+            // d = ||x||^2 + ||y||^2 - 2<x, y>，并确保距离非负
+            kernels.L2_from_ip(line, line, xNorm[i], yNorm + j0, n);
+        }
+    );
+}
+
+void calIPBLAS(
+    const float* x,
+    const float* y,
+    size_t nx,
+    size_t ny,
+    size_t dim,
+    uint64_t k,
+    float* outDistances,
+    uint64_t* outIndices,
+    const float* yNorm,
+    const RowFilter* filter
+) {
+    if (nx == 0 || ny == 0 || k == 0)
+        return;
+
+    blockedSearch<IPHeap>(
+        x, Fp32Rows{y, dim}, nx, ny, dim, k, -HUGE_VALF, outDistances, outIndices, filter,
+        [](float*, size_t, size_t, size_t) {
+            // 内积即为最终结果
+        }
+    );
 }
 
 void fvec_norms_L2sqr (
@@ -247,14 +949,7 @@ void fvec_norms_L2sqr (
 }
 
 float fvec_norm_L2sqr(const float* x, size_t d) {
-    // the double in the _ref is suspected to be a typo. Some of the manual
-    // implementations this replaces used float.
-    float res = 0;
-    for (size_t i = 0; i != d; ++i) {
-        res += x[i] * x[i];
-    }
-
-    return res;
+    return getKernels().norm_L2sqr(x, d);
 }
 
 } // namespace cpu_blas
\ No newline at end of file
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "index/MetricType.hpp"
+#include "index/RangeSearchResult.hpp"
 
 #include <cstdint> // For uint, uint64_t, etc.
 #include <cstddef> // For size_t
@@ -10,8 +11,18 @@
 #include <vector>
 #include <algorithm>
 
+struct RowFilter;
+
 namespace cpu_blas {
 
+// 查询数量不超过该值时使用SIMD扫描内核，而不是 sgemm_
+constexpr uint64_t kScanQueryThreshold = 8;
+
+/*
+    以下查询接口的 filter 不为空时，filter 中置位的数据行不会进入 top-k 结果（例如已删除的行）
+    结果不足k个时按 heapToOutput 的约定填充
+*/
+
 void query(
     uint64_t nQuery,
     uint64_t nData,
@@ -23,7 +34,110 @@ void query(
     float* distances,
     uint64_t* results,
     MetricType metricType,
-    float* metricArg = nullptr
+    float* metricArg = nullptr,
+    const RowFilter* filter = nullptr
+);
+
+/*
+    数据库以IEEE半精度（fp16）存储时的查询接口，查询向量和输出仍为单精度
+    少量查询时边读取边转换，批量查询时按分块转换为单精度后调用 sgemm_
+*/
+void queryFP16(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t k,
+    uint64_t dim,
+    const float* query,
+    const uint16_t* data,
+    const float* dataNorm,
+    float* distances,
+    uint64_t* results,
+    MetricType metricType,
+    float* metricArg = nullptr,
+    const RowFilter* filter = nullptr
+);
+
+/*
+    数据库以bfloat16存储时的查询接口，用法与 queryFP16 相同
+*/
+void queryBF16(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t k,
+    uint64_t dim,
+    const float* query,
+    const uint16_t* data,
+    const float* dataNorm,
+    float* distances,
+    uint64_t* results,
+    MetricType metricType,
+    float* metricArg = nullptr,
+    const RowFilter* filter = nullptr
+);
+
+/*
+    范围查询：返回每个查询距离在 radius 以内的所有数据行，L2 为 dis < radius，IP 为 dis > radius
+    阈值在 sgemm_ 分块的距离算出后立即判断，结果按行号升序写入CSR格式的 result
+*/
+void rangeQuery(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t dim,
+    const float* query,
+    const float* data,
+    const float* dataNorm,
+    float radius,
+    MetricType metricType,
+    RangeSearchResult& result,
+    const RowFilter* filter = nullptr
+);
+
+// 数据库以fp16存储时的范围查询
+void rangeQueryFP16(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t dim,
+    const float* query,
+    const uint16_t* data,
+    const float* dataNorm,
+    float radius,
+    MetricType metricType,
+    RangeSearchResult& result,
+    const RowFilter* filter = nullptr
+);
+
+// 数据库以bf16存储时的范围查询
+void rangeQueryBF16(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t dim,
+    const float* query,
+    const uint16_t* data,
+    const float* dataNorm,
+    float radius,
+    MetricType metricType,
+    RangeSearchResult& result,
+    const RowFilter* filter = nullptr
+);
+
+/*
+    数据库为8位标量量化（SQ8）编码时的查询接口，第i维的解码值为 vmin[i] + scale[i] * code[i]
+    codeNorm 为解码后向量的平方范数，可以为空（L2时现场计算）
+    IP 返回的距离包含 <x, vmin> 项，与对解码后的向量直接计算一致
+*/
+void querySQ8(
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t k,
+    uint64_t dim,
+    const float* query,
+    const uint8_t* codes,
+    const float* vmin,
+    const float* scale,
+    const float* codeNorm,
+    float* distances,
+    uint64_t* results,
+    MetricType metricType
 );
 
 /*
@@ -38,7 +152,38 @@ void calL2BLAS(
     uint64_t k,
     float* outDistances,
     uint64_t* outIndices,
-    const float* yNorm = nullptr
+    const float* yNorm = nullptr,
+    const RowFilter* filter = nullptr
+);
+
+/*
+    使用SIMD内核直接扫描计算L2距离，适用于单个/少量查询
+*/
+void calL2Scan(
+    const float* x,
+    const float* y,
+    size_t nx,
+    size_t ny,
+    size_t dim,
+    uint64_t k,
+    float* outDistances,
+    uint64_t* outIndices,
+    const RowFilter* filter = nullptr
+);
+
+/*
+    使用SIMD内核直接扫描计算IP距离，适用于单个/少量查询
+*/
+void calIPScan(
+    const float* x,
+    const float* y,
+    size_t nx,
+    size_t ny,
+    size_t dim,
+    uint64_t k,
+    float* outDistances,
+    uint64_t* outIndices,
+    const RowFilter* filter = nullptr
 );
 
 void fvec_norms_L2sqr (
@@ -63,7 +208,8 @@ void calIPBLAS(
     uint64_t k,
     float* outDistances,
     uint64_t* outIndices,
-    const float* yNorm = nullptr
+    const float* yNorm = nullptr,
+    const RowFilter* filter = nullptr
 );
 
 }
\ No newline at end of file
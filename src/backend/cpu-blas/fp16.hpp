@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint> // For uint16_t, uint32_t
+#include <cstring> // std::memcpy
+
+/*
+    IEEE 754 半精度浮点与单精度之间的软件转换，用于没有F16C等硬件转换指令的平台以及向量化循环的尾部
+    这里使用static inline而不是inline：各指令集的编译单元都会包含本文件，
+    必须保证每个编译单元使用自己的副本
+*/
+
+namespace cpu_blas {
+
+static inline float fp16ToFp32(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t bits;
+    if (exp == 0) {
+        if (mant == 0) {
+            bits = sign;
+        } else {
+            // 非规格化数，规格化后转换
+            exp = 127 - 15 + 1;
+            while ((mant & 0x400) == 0) {
+                mant <<= 1;
+                --exp;
+            }
+            mant &= 0x3ff;
+            bits = sign | (exp << 23) | (mant << 13);
+        }
+    } else if (exp == 0x1f) {
+        // inf / nan
+        bits = sign | 0x7f800000 | (mant << 13);
+    } else {
+        bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// 舍入方式为就近舍入（偶数优先），与F16C的 _MM_FROUND_TO_NEAREST_INT 一致
+static inline uint16_t fp32ToFp16(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t absx = x & 0x7fffffff;
+
+    if (absx >= 0x7f800000) {
+        // inf / nan
+        return (uint16_t)(sign | 0x7c00 | (absx > 0x7f800000 ? 0x200 : 0));
+    }
+    if (absx >= 0x477ff000) {
+        // 超出半精度的表示范围
+        return (uint16_t)(sign | 0x7c00);
+    }
+    if (absx < 0x38800000) {
+        // 结果为非规格化数或0
+        if (absx < 0x33000000) {
+            return (uint16_t)sign;
+        }
+        uint32_t e = absx >> 23;
+        uint32_t m = (absx & 0x7fffff) | 0x800000;
+        uint32_t shift = 126 - e;
+        uint32_t h = m >> shift;
+        uint32_t rem = m & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (h & 1))) {
+            ++h;
+        }
+        return (uint16_t)(sign | h);
+    }
+    uint32_t h = (absx - ((127 - 15) << 23) + 0xfff + ((absx >> 13) & 1)) >> 13;
+    return (uint16_t)(sign | h);
+}
+
+}
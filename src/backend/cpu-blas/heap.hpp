@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint> // For uint64_t
+#include <cstddef> // For size_t
+#include <queue>   // std::priority_queue
+#include <vector>
+#include <utility> // std::pair
+#include <functional>
+
+#include "index/Bitmap.hpp"
+
+namespace cpu_blas {
+
+/*
+    分块计算时用来维护每个查询前k个结果的堆
+    堆顶永远是当前保留结果中最差的一个，新结果只需要和堆顶比较
+*/
+using HeapElement = std::pair<float, uint64_t>;
+
+// L2: 距离越小越好，使用最大堆
+using L2Heap = std::priority_queue<HeapElement>;
+
+// IP: 内积越大越好，使用最小堆
+using IPHeap = std::priority_queue<HeapElement, std::vector<HeapElement>, std::greater<HeapElement>>;
+
+// 结果不足k个时填充的下标
+constexpr uint64_t kInvalidIndex = UINT64_MAX;
+
+// 尝试将 (d, idx) 放入容量为k的堆中
+template <class Heap>
+inline void heapPush(Heap& heap, uint64_t k, float d, uint64_t idx) {
+    if (heap.size() < k) {
+        heap.emplace(d, idx);
+    } else if (typename Heap::value_compare()(HeapElement(d, idx), heap.top())) {
+        heap.pop();
+        heap.emplace(d, idx);
+    }
+}
+
+/*
+    把一段连续的距离 dis[0..n)（下标从idx0开始）放入堆中
+    堆满之后只和当前最差的距离比较，绝大多数元素在这一步就被跳过，比逐个调用 heapPush 快得多
+*/
+template <class Heap>
+inline void heapPushLine(Heap& heap, uint64_t k, const float* dis, size_t n, uint64_t idx0) {
+    size_t j = 0;
+    for (; j < n && heap.size() < k; ++j) {
+        heap.emplace(dis[j], idx0 + j);
+    }
+    if (j == n) {
+        return;
+    }
+    typename Heap::value_compare cmp;
+    float worst = heap.top().first;
+    for (; j < n; ++j) {
+        // 距离相同时保留先出现的结果，与 heapPush 一致
+        if (cmp(HeapElement(dis[j], 0), HeapElement(worst, 0))) {
+            heap.pop();
+            heap.emplace(dis[j], idx0 + j);
+            worst = heap.top().first;
+        }
+    }
+}
+
+/*
+    与 heapPushLine 相同，但跳过 filter 中置位的行；filter 为空时等同于 heapPushLine
+    dis[j] 对应后端看到的第 idx0 + j 行
+*/
+template <class Heap>
+inline void heapPushLine(Heap& heap, uint64_t k, const float* dis, size_t n, uint64_t idx0, const RowFilter* filter) {
+    if (filter == nullptr) {
+        heapPushLine(heap, k, dis, n, idx0);
+        return;
+    }
+    for (size_t j = 0; j < n; ++j) {
+        if (!filter->skip(idx0 + j)) {
+            heapPush(heap, k, dis[j], idx0 + j);
+        }
+    }
+}
+
+// 将src中的结果合并进dst，合并后src为空
+template <class Heap>
+inline void heapMerge(Heap& dst, Heap& src, uint64_t k) {
+    while (!src.empty()) {
+        const HeapElement& top = src.top();
+        heapPush(dst, k, top.first, top.second);
+        src.pop();
+    }
+}
+
+/*
+    将堆中的结果按从好到坏的顺序写入输出，并清空堆
+    结果不足k个时，剩余位置填充 emptyDistance 和 kInvalidIndex
+*/
+template <class Heap>
+inline void heapToOutput(
+    Heap& heap,
+    uint64_t k,
+    float emptyDistance,
+    float* outDistances,
+    uint64_t* outIndices
+) {
+    size_t n = heap.size();
+    for (size_t j = n; j < k; ++j) {
+        outDistances[j] = emptyDistance;
+        outIndices[j] = kInvalidIndex;
+    }
+    for (size_t j = 0; j < n; ++j) {
+        const HeapElement& top = heap.top();
+        outDistances[n - 1 - j] = top.first;
+        outIndices[n - 1 - j] = top.second;
+        heap.pop();
+    }
+}
+
+} // namespace cpu_blas
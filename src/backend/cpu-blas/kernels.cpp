@@ -0,0 +1,118 @@
+#include "backend/cpu-blas/kernels.hpp"
+#include "backend/cpu-blas/cpuFeatures.hpp"
+
+#include <cstdlib>  // std::getenv
+#include <cstring>  // std::strcmp
+
+namespace cpu_blas {
+
+namespace {
+
+#if defined(EDGEVECDB_HAVE_SVE) && defined(EDGEVECDB_HAVE_ARM_BF16)
+// 同时支持SVE和BF16的CPU（如Neoverse V1/N2）：在SVE内核的基础上，bf16内积改用 bfdot，不再展开为float
+const DistanceKernels& getKernelsSVEBF16() {
+    static const DistanceKernels kernels = [] {
+        DistanceKernels k = getKernelsSVE();
+        k.name = "sve+bf16";
+        k.inner_products_ny_bf16 = getKernelsNEONBF16().inner_products_ny_bf16;
+        return k;
+    }();
+    return kernels;
+}
+#endif
+
+// 指令集按性能从低到高排列
+enum SimdLevel {
+    SIMD_SCALAR = 0,
+    SIMD_SSE4,
+    SIMD_AVX2,
+    SIMD_AVX512,
+    SIMD_AVX512BF16,
+    SIMD_NEON,
+    SIMD_NEONBF16,
+    SIMD_SVE,
+};
+
+// 读取环境变量 EDGEVECDB_SIMD，用于调试或规避某台机器上的问题
+SimdLevel requestedLevel() {
+    const char* env = std::getenv("EDGEVECDB_SIMD");
+    if (env == nullptr) {
+        return SIMD_SVE;
+    }
+    if (std::strcmp(env, "scalar") == 0) return SIMD_SCALAR;
+    if (std::strcmp(env, "sse4") == 0) return SIMD_SSE4;
+    if (std::strcmp(env, "avx2") == 0) return SIMD_AVX2;
+    if (std::strcmp(env, "avx512") == 0) return SIMD_AVX512;
+    if (std::strcmp(env, "avx512bf16") == 0) return SIMD_AVX512BF16;
+    if (std::strcmp(env, "neon") == 0) return SIMD_NEON;
+    if (std::strcmp(env, "neonbf16") == 0) return SIMD_NEONBF16;
+    return SIMD_SVE;
+}
+
+const DistanceKernels& selectKernels() {
+    const CpuFeatures& f = getCpuFeatures();
+    SimdLevel limit = requestedLevel();
+    (void)f;
+    (void)limit;
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(EDGEVECDB_HAVE_AVX512BF16)
+    if (limit >= SIMD_AVX512BF16 && f.avx512bf16 && f.avx2 && f.fma && f.f16c && f.popcnt) {
+        return getKernelsAVX512BF16();
+    }
+#endif
+    if (limit >= SIMD_AVX512 && f.avx512f && f.avx2 && f.fma && f.f16c && f.popcnt) {
+        return getKernelsAVX512();
+    }
+    if (limit >= SIMD_AVX2 && f.avx2 && f.fma && f.f16c && f.popcnt) {
+        return getKernelsAVX2();
+    }
+    if (limit >= SIMD_SSE4 && f.sse4_2 && f.popcnt) {
+        return getKernelsSSE4();
+    }
+#elif defined(__aarch64__)
+#if defined(EDGEVECDB_HAVE_SVE)
+    if (limit >= SIMD_SVE && f.sve) {
+#if defined(EDGEVECDB_HAVE_ARM_BF16)
+        if (f.bf16) {
+            return getKernelsSVEBF16();
+        }
+#endif
+        return getKernelsSVE();
+    }
+#endif
+#if defined(EDGEVECDB_HAVE_ARM_BF16)
+    if (limit >= SIMD_NEONBF16 && f.neon && f.bf16) {
+        return getKernelsNEONBF16();
+    }
+#endif
+    if (limit >= SIMD_NEON && f.neon) {
+        return getKernelsNEON();
+    }
+#endif
+    return getKernelsScalar();
+}
+
+} // namespace
+
+const DistanceKernels& getKernels() {
+    static const DistanceKernels& kernels = selectKernels();
+    return kernels;
+}
+
+float fvec_inner_product(const float* x, const float* y, size_t d) {
+    return getKernels().inner_product(x, y, d);
+}
+
+float fvec_L2sqr(const float* x, const float* y, size_t d) {
+    return getKernels().L2sqr(x, y, d);
+}
+
+void fvec_inner_products_ny(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    getKernels().inner_products_ny(dis, x, y, d, ny);
+}
+
+void fvec_L2sqr_ny(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    getKernels().L2sqr_ny(dis, x, y, d, ny);
+}
+
+} // namespace cpu_blas
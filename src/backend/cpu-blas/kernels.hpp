@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint> // For uint64_t
+#include <cstddef> // For size_t
+
+namespace cpu_blas {
+
+/*
+    手写向量化的距离/范数计算内核
+    每种指令集（SSE4 / AVX2 / AVX-512 / NEON / SVE / 标量）编译为独立的编译单元，
+    启动时根据 getCpuFeatures() 的检测结果选择最优的一组函数指针
+*/
+struct DistanceKernels {
+    const char* name;
+
+    // 内积 <x, y>
+    float (*inner_product)(const float* x, const float* y, size_t d);
+    // 平方L2距离 ||x - y||^2
+    float (*L2sqr)(const float* x, const float* y, size_t d);
+    // 平方范数 ||x||^2
+    float (*norm_L2sqr)(const float* x, size_t d);
+
+    // 一个查询向量x与连续存放的ny个向量y的距离，结果写入dis[0..ny)
+    void (*inner_products_ny)(float* dis, const float* x, const float* y, size_t d, size_t ny);
+    void (*L2sqr_ny)(float* dis, const float* x, const float* y, size_t d, size_t ny);
+
+    // GEMM之后的收尾: dis[j] = max(0, xNorm + yNorm[j] - 2 * ip[j])，dis 可以与 ip 相同
+    void (*L2_from_ip)(float* dis, const float* ip, float xNorm, const float* yNorm, size_t n);
+    // x[i] *= s
+    void (*scale)(float* x, float s, size_t d);
+
+    // 半精度（IEEE fp16）数据与单精度之间的批量转换
+    void (*fp16_to_fp32)(float* dst, const uint16_t* src, size_t n);
+    void (*fp32_to_fp16)(uint16_t* dst, const float* src, size_t n);
+    // 单精度查询向量x与连续存放的ny个半精度向量y的距离，边读取边转换
+    void (*inner_products_ny_fp16)(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny);
+    void (*L2sqr_ny_fp16)(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny);
+
+    // bfloat16 数据的转换与距离，含义同上
+    void (*bf16_to_fp32)(float* dst, const uint16_t* src, size_t n);
+    void (*fp32_to_bf16)(uint16_t* dst, const float* src, size_t n);
+    void (*inner_products_ny_bf16)(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny);
+    void (*L2sqr_ny_bf16)(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny);
+
+    /*
+        8位标量量化（SQ8）数据的非对称距离，查询保持float，编码c展开为float后参与计算
+        inner_products_ny_u8: dis[j] = sum_i x[i] * c_j[i]
+        L2sqr_ny_u8:          dis[j] = sum_i (x[i] - scale[i] * c_j[i])^2
+        decode_u8:            dst[j * d + i] = vmin[i] + scale[i] * c_j[i]，共n个向量
+    */
+    void (*inner_products_ny_u8)(float* dis, const float* x, const uint8_t* codes, size_t d, size_t ny);
+    void (*L2sqr_ny_u8)(float* dis, const float* x, const float* scale, const uint8_t* codes, size_t d, size_t ny);
+    void (*decode_u8)(float* dst, const uint8_t* codes, const float* vmin, const float* scale, size_t d, size_t n);
+
+    /*
+        4位PQ快速扫描（fast-scan）的查表累加
+        codes 按32个向量一组交错存放，每组 M * 16 字节：第m段的16个字节中，
+        第i个字节的低4位是组内第i个向量的编码，高4位是第i+16个向量的编码
+        lut 为 M * 16 个8位量化后的距离，out[b * 32 + i] = sum_m lut[m * 16 + code_{b,i,m}]
+        累加使用uint16，M <= 256 时不会溢出
+    */
+    void (*pq4_accumulate)(uint16_t* out, const uint8_t* codes, const uint8_t* lut, size_t M, size_t nBlocks);
+
+    // 二值编码的汉明距离：x 与连续存放的ny个编码（每个 nwords 个uint64）逐位异或后统计1的个数
+    void (*hamming_ny)(uint32_t* dis, const uint64_t* x, const uint64_t* codes, size_t nwords, size_t ny);
+
+    // CRC32C（Castagnoli）校验和，crc 为前一段的结果（第一段传0），可以分段连续计算
+    uint32_t (*crc32c)(uint32_t crc, const void* data, size_t n);
+};
+
+// 当前机器上最优的内核，第一次调用时完成选择
+// 设置环境变量 EDGEVECDB_SIMD=scalar|sse4|avx2|avx512|avx512bf16|neon|neonbf16|sve 可以强制使用较低的指令集
+const DistanceKernels& getKernels();
+
+// 各指令集的内核表，只有在对应平台上编译时才存在
+const DistanceKernels& getKernelsScalar();
+#if defined(__x86_64__) || defined(__i386__)
+const DistanceKernels& getKernelsSSE4();
+const DistanceKernels& getKernelsAVX2();
+const DistanceKernels& getKernelsAVX512();
+#if defined(EDGEVECDB_HAVE_AVX512BF16)
+// 在AVX-512内核的基础上，bf16内积改用 vdpbf16ps
+const DistanceKernels& getKernelsAVX512BF16();
+#endif
+#elif defined(__aarch64__)
+const DistanceKernels& getKernelsNEON();
+#if defined(EDGEVECDB_HAVE_ARM_BF16)
+// 在NEON内核的基础上，bf16内积改用 bfdot
+const DistanceKernels& getKernelsNEONBF16();
+#endif
+#if defined(EDGEVECDB_HAVE_SVE)
+const DistanceKernels& getKernelsSVE();
+#endif
+#endif
+
+/*
+    对外的便捷接口，内部转发到 getKernels()
+    注意不要在头文件中写成inline：各指令集的编译单元也包含本头文件，
+    inline函数可能被链接器选中带有高级指令的版本
+*/
+float fvec_inner_product(const float* x, const float* y, size_t d);
+
+float fvec_L2sqr(const float* x, const float* y, size_t d);
+
+void fvec_inner_products_ny(float* dis, const float* x, const float* y, size_t d, size_t ny);
+
+void fvec_L2sqr_ny(float* dis, const float* x, const float* y, size_t d, size_t ny);
+
+}
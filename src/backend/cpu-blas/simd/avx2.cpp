@@ -0,0 +1,104 @@
+// 使用 -mavx2 -mfma -mf16c -mpopcnt 编译
+#include "backend/cpu-blas/simd/simdImpl.hpp"
+
+#include <immintrin.h>
+
+namespace cpu_blas {
+
+namespace {
+
+struct AVX2 {
+    using Reg = __m256;
+    static constexpr size_t kWidth = 8;
+    static Reg zero() { return _mm256_setzero_ps(); }
+    static Reg set1(float a) { return _mm256_set1_ps(a); }
+    static Reg load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, Reg r) { _mm256_storeu_ps(p, r); }
+    static Reg loadHalf(const uint16_t* p) {
+        return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+    static void storeHalf(uint16_t* p, Reg r) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_cvtps_ph(r, _MM_FROUND_TO_NEAREST_INT));
+    }
+    static Reg loadBf16(const uint16_t* p) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+    }
+    static Reg loadU8(const uint8_t* p) {
+        __m128i c = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+        return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(c));
+    }
+    static Reg add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+    static Reg max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+    static Reg fmadd(Reg a, Reg b, Reg c) { return _mm256_fmadd_ps(a, b, c); }
+    static float reduce(Reg r) {
+        __m128 lo = _mm256_castps256_ps128(r);
+        __m128 hi = _mm256_extractf128_ps(r, 1);
+        lo = _mm_add_ps(lo, hi);
+        lo = _mm_hadd_ps(lo, lo);
+        lo = _mm_hadd_ps(lo, lo);
+        return _mm_cvtss_f32(lo);
+    }
+};
+
+/*
+    fast-scan 查表累加：每次处理相邻的两段
+    两段的编码和距离表正好各占256位寄存器的一个128位通道，vpshufb 在通道内查表，
+    最后把两个通道的部分和相加。M为奇数时最后一段用128位指令处理
+*/
+void avx2Pq4Accumulate(uint16_t* out, const uint8_t* codes, const uint8_t* lut, size_t M, size_t nBlocks) {
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    for (size_t b = 0; b < nBlocks; ++b) {
+        const uint8_t* block = codes + b * M * 16;
+        __m256i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+        size_t m = 0;
+        for (; m + 2 <= M; m += 2) {
+            __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + m * 16));
+            __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lut + m * 16));
+            __m256i lo = _mm256_shuffle_epi8(t, _mm256_and_si256(c, mask));
+            __m256i hi = _mm256_shuffle_epi8(t, _mm256_and_si256(_mm256_srli_epi16(c, 4), mask));
+            acc0 = _mm256_add_epi16(acc0, _mm256_unpacklo_epi8(lo, zero));
+            acc1 = _mm256_add_epi16(acc1, _mm256_unpackhi_epi8(lo, zero));
+            acc2 = _mm256_add_epi16(acc2, _mm256_unpacklo_epi8(hi, zero));
+            acc3 = _mm256_add_epi16(acc3, _mm256_unpackhi_epi8(hi, zero));
+        }
+        __m128i r0 = _mm_add_epi16(_mm256_castsi256_si128(acc0), _mm256_extracti128_si256(acc0, 1));
+        __m128i r1 = _mm_add_epi16(_mm256_castsi256_si128(acc1), _mm256_extracti128_si256(acc1, 1));
+        __m128i r2 = _mm_add_epi16(_mm256_castsi256_si128(acc2), _mm256_extracti128_si256(acc2, 1));
+        __m128i r3 = _mm_add_epi16(_mm256_castsi256_si128(acc3), _mm256_extracti128_si256(acc3, 1));
+        if (m < M) {
+            const __m128i mask128 = _mm_set1_epi8(0x0f);
+            const __m128i zero128 = _mm_setzero_si128();
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + m * 16));
+            __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lut + m * 16));
+            __m128i lo = _mm_shuffle_epi8(t, _mm_and_si128(c, mask128));
+            __m128i hi = _mm_shuffle_epi8(t, _mm_and_si128(_mm_srli_epi16(c, 4), mask128));
+            r0 = _mm_add_epi16(r0, _mm_unpacklo_epi8(lo, zero128));
+            r1 = _mm_add_epi16(r1, _mm_unpackhi_epi8(lo, zero128));
+            r2 = _mm_add_epi16(r2, _mm_unpacklo_epi8(hi, zero128));
+            r3 = _mm_add_epi16(r3, _mm_unpackhi_epi8(hi, zero128));
+        }
+        __m128i* o = reinterpret_cast<__m128i*>(out + b * 32);
+        _mm_storeu_si128(o + 0, r0);
+        _mm_storeu_si128(o + 1, r1);
+        _mm_storeu_si128(o + 2, r2);
+        _mm_storeu_si128(o + 3, r3);
+    }
+}
+
+} // namespace
+
+const DistanceKernels& getKernelsAVX2() {
+    static const DistanceKernels kernels = [] {
+        DistanceKernels k = makeKernels<AVX2>("avx2");
+        k.pq4_accumulate = avx2Pq4Accumulate;
+        k.crc32c = getKernelsSSE4().crc32c;
+        return k;
+    }();
+    return kernels;
+}
+
+}
@@ -0,0 +1,61 @@
+// 使用 -mavx512f -mavx2 -mfma -mf16c -mpopcnt 编译
+#include "backend/cpu-blas/simd/simdImpl.hpp"
+
+#include <immintrin.h>
+
+namespace cpu_blas {
+
+namespace {
+
+struct AVX512 {
+    using Reg = __m512;
+    static constexpr size_t kWidth = 16;
+    static Reg zero() { return _mm512_setzero_ps(); }
+    static Reg set1(float a) { return _mm512_set1_ps(a); }
+    static Reg load(const float* p) { return _mm512_loadu_ps(p); }
+    static void store(float* p, Reg r) { _mm512_storeu_ps(p, r); }
+    static Reg loadHalf(const uint16_t* p) {
+        return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    }
+    static void storeHalf(uint16_t* p, Reg r) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtps_ph(r, _MM_FROUND_TO_NEAREST_INT));
+    }
+    static Reg loadBf16(const uint16_t* p) {
+        __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(h), 16));
+    }
+    static Reg loadU8(const uint8_t* p) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(c));
+    }
+    static Reg add(Reg a, Reg b) { return _mm512_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm512_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm512_mul_ps(a, b); }
+    static Reg max(Reg a, Reg b) { return _mm512_max_ps(a, b); }
+    static Reg fmadd(Reg a, Reg b, Reg c) { return _mm512_fmadd_ps(a, b, c); }
+    static float reduce(Reg r) {
+        // 先折叠成256位再求和，避免 _mm512_reduce_add_ps 在部分编译器上的告警
+        __m256 lo = _mm512_castps512_ps256(r);
+        __m256 hi = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(r), 1));
+        __m256 s = _mm256_add_ps(lo, hi);
+        __m128 t = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+        t = _mm_hadd_ps(t, t);
+        t = _mm_hadd_ps(t, t);
+        return _mm_cvtss_f32(t);
+    }
+};
+
+} // namespace
+
+const DistanceKernels& getKernelsAVX512() {
+    static const DistanceKernels kernels = [] {
+        DistanceKernels k = makeKernels<AVX512>("avx512");
+        // 512位的字节查表需要AVX-512BW，这里沿用AVX2的版本（选择AVX-512内核时AVX2一定可用）
+        k.pq4_accumulate = getKernelsAVX2().pq4_accumulate;
+        k.crc32c = getKernelsSSE4().crc32c;
+        return k;
+    }();
+    return kernels;
+}
+
+}
@@ -0,0 +1,86 @@
+// 使用 -mavx512bf16 -mavx512bw -mavx512f -mavx2 -mfma -mf16c -mpopcnt 编译
+// 只替换 bf16 内积，其余内核沿用 avx512.cpp 中的实现
+#include "backend/cpu-blas/kernels.hpp"
+#include "backend/cpu-blas/bf16.hpp"
+
+#include <immintrin.h>
+
+namespace cpu_blas {
+
+namespace {
+
+// 每段的维数，是每次点积处理的元素数（32）的整数倍，只有最后一段有尾部
+const size_t kSplitBlock = 512;
+
+/*
+    vdpbf16ps 要求两个操作数都是bf16，直接把查询舍入为bf16会损失查询向量的精度
+    这里把查询拆成 hi + lo 两个bf16向量（hi = bf16(x)，lo = bf16(x - hi)），
+    <x, y> ≈ <hi, y> + <lo, y>，查询侧保留约16位有效数字，数据侧本来就是bf16
+    每32个元素两条 vdpbf16ps，不需要把数据展开为float
+*/
+void splitQuery(const float* x, size_t d, uint16_t* hi, uint16_t* lo) {
+    for (size_t i = 0; i < d; ++i) {
+        hi[i] = fp32ToBf16(x[i]);
+        lo[i] = fp32ToBf16(x[i] - bf16ToFp32(hi[i]));
+    }
+}
+
+inline __m512bh loadBh(const uint16_t* p) {
+    return (__m512bh)_mm512_loadu_si512(p);
+}
+
+inline __m512bh maskLoadBh(__mmask32 m, const uint16_t* p) {
+    return (__m512bh)_mm512_maskz_loadu_epi16(m, p);
+}
+
+float innerProductBf16(const uint16_t* hi, const uint16_t* lo, const uint16_t* y, size_t d) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= d; i += 32) {
+        __m512bh yv = loadBh(y + i);
+        acc0 = _mm512_dpbf16_ps(acc0, loadBh(hi + i), yv);
+        acc1 = _mm512_dpbf16_ps(acc1, loadBh(lo + i), yv);
+    }
+    if (i < d) {
+        // 尾部用掩码读取，多出的通道为0，不影响结果
+        __mmask32 m = (__mmask32)((1ull << (d - i)) - 1);
+        __m512bh yv = maskLoadBh(m, y + i);
+        acc0 = _mm512_dpbf16_ps(acc0, maskLoadBh(m, hi + i), yv);
+        acc1 = _mm512_dpbf16_ps(acc1, maskLoadBh(m, lo + i), yv);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+/*
+    查询按 kSplitBlock 维一段拆分到栈上的缓冲区，每段对所有数据向量累加一次，热路径上不分配堆内存
+    本文件使用高级指令编译，不使用 std 中的模板，避免链接器为其他编译单元选中这里生成的弱符号
+*/
+void avx512bf16InnerProductsNy(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    uint16_t hi[kSplitBlock];
+    uint16_t lo[kSplitBlock];
+    for (size_t j = 0; j < ny; ++j) {
+        dis[j] = 0.0f;
+    }
+    for (size_t b = 0; b < d; b += kSplitBlock) {
+        const size_t len = d - b < kSplitBlock ? d - b : kSplitBlock;
+        splitQuery(x + b, len, hi, lo);
+        for (size_t j = 0; j < ny; ++j) {
+            dis[j] += innerProductBf16(hi, lo, y + j * d + b, len);
+        }
+    }
+}
+
+} // namespace
+
+const DistanceKernels& getKernelsAVX512BF16() {
+    static const DistanceKernels kernels = [] {
+        DistanceKernels k = getKernelsAVX512();
+        k.name = "avx512bf16";
+        k.inner_products_ny_bf16 = avx512bf16InnerProductsNy;
+        return k;
+    }();
+    return kernels;
+}
+
+}
@@ -0,0 +1,96 @@
+#include "backend/cpu-blas/simd/simdImpl.hpp"
+
+#include <arm_neon.h>
+#include <cstring>  // std::memcpy
+
+namespace cpu_blas {
+
+namespace {
+
+struct NEON {
+    using Reg = float32x4_t;
+    static constexpr size_t kWidth = 4;
+    static Reg zero() { return vdupq_n_f32(0.0f); }
+    static Reg set1(float a) { return vdupq_n_f32(a); }
+    static Reg load(const float* p) { return vld1q_f32(p); }
+    static void store(float* p, Reg r) { vst1q_f32(p, r); }
+    // fp16与fp32之间的转换属于ARMv8基础指令，ARMv8.2的fp16算术在这里不使用，累加保持fp32精度
+    static Reg loadHalf(const uint16_t* p) { return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(p))); }
+    static void storeHalf(uint16_t* p, Reg r) { vst1_u16(p, vreinterpret_u16_f16(vcvt_f16_f32(r))); }
+    static Reg loadBf16(const uint16_t* p) { return vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(p), 16)); }
+    // 只读取4个字节，避免在数据末尾越界
+    static Reg loadU8(const uint8_t* p) {
+        uint32_t w;
+        std::memcpy(&w, p, sizeof(w));
+        uint16x8_t c = vmovl_u8(vcreate_u8(w));
+        return vcvtq_f32_u32(vmovl_u16(vget_low_u16(c)));
+    }
+    static Reg add(Reg a, Reg b) { return vaddq_f32(a, b); }
+    static Reg sub(Reg a, Reg b) { return vsubq_f32(a, b); }
+    static Reg mul(Reg a, Reg b) { return vmulq_f32(a, b); }
+    static Reg max(Reg a, Reg b) { return vmaxq_f32(a, b); }
+    static Reg fmadd(Reg a, Reg b, Reg c) { return vfmaq_f32(c, a, b); }
+    static float reduce(Reg r) { return vaddvq_f32(r); }
+};
+
+/*
+    fast-scan 查表累加：vqtbl1q_u8 一次完成16个4位编码的查表
+    vaddw_u8 / vaddw_high_u8 把8位距离直接加到uint16累加器上
+*/
+void neonPq4Accumulate(uint16_t* out, const uint8_t* codes, const uint8_t* lut, size_t M, size_t nBlocks) {
+    const uint8x16_t mask = vdupq_n_u8(0x0f);
+    for (size_t b = 0; b < nBlocks; ++b) {
+        const uint8_t* block = codes + b * M * 16;
+        uint16x8_t acc0 = vdupq_n_u16(0), acc1 = vdupq_n_u16(0), acc2 = vdupq_n_u16(0), acc3 = vdupq_n_u16(0);
+        for (size_t m = 0; m < M; ++m) {
+            uint8x16_t c = vld1q_u8(block + m * 16);
+            uint8x16_t t = vld1q_u8(lut + m * 16);
+            uint8x16_t lo = vqtbl1q_u8(t, vandq_u8(c, mask));
+            uint8x16_t hi = vqtbl1q_u8(t, vshrq_n_u8(c, 4));
+            acc0 = vaddw_u8(acc0, vget_low_u8(lo));
+            acc1 = vaddw_high_u8(acc1, lo);
+            acc2 = vaddw_u8(acc2, vget_low_u8(hi));
+            acc3 = vaddw_high_u8(acc3, hi);
+        }
+        uint16_t* o = out + b * 32;
+        vst1q_u16(o + 0, acc0);
+        vst1q_u16(o + 8, acc1);
+        vst1q_u16(o + 16, acc2);
+        vst1q_u16(o + 24, acc3);
+    }
+}
+
+/*
+    汉明距离：vcntq_u8 统计每个字节中1的个数，vpadalq_u8 两两相加累积到uint16
+    每次处理两个uint64，最后一个奇数位置的字单独处理
+*/
+void neonHammingNy(uint32_t* dis, const uint64_t* x, const uint64_t* codes, size_t nwords, size_t ny) {
+    for (size_t j = 0; j < ny; ++j) {
+        const uint64_t* c = codes + j * nwords;
+        uint16x8_t acc = vdupq_n_u16(0);
+        size_t i = 0;
+        for (; i + 2 <= nwords; i += 2) {
+            uint64x2_t v = veorq_u64(vld1q_u64(x + i), vld1q_u64(c + i));
+            acc = vpadalq_u8(acc, vcntq_u8(vreinterpretq_u8_u64(v)));
+        }
+        uint32_t d = vaddlvq_u16(acc);
+        if (i < nwords) {
+            d += __builtin_popcountll(x[i] ^ c[i]);
+        }
+        dis[j] = d;
+    }
+}
+
+} // namespace
+
+const DistanceKernels& getKernelsNEON() {
+    static const DistanceKernels kernels = [] {
+        DistanceKernels k = makeKernels<NEON>("neon");
+        k.pq4_accumulate = neonPq4Accumulate;
+        k.hamming_ny = neonHammingNy;
+        return k;
+    }();
+    return kernels;
+}
+
+}
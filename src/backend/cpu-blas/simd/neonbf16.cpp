@@ -0,0 +1,77 @@
+// 使用 -march=armv8.2-a+bf16 编译
+// 只替换 bf16 内积，其余内核沿用 neon.cpp 中的实现
+#include "backend/cpu-blas/kernels.hpp"
+#include "backend/cpu-blas/bf16.hpp"
+
+#include <arm_neon.h>
+
+namespace cpu_blas {
+
+namespace {
+
+// 每段的维数，是每次点积处理的元素数（8）的整数倍，只有最后一段有尾部
+const size_t kSplitBlock = 512;
+
+/*
+    bfdot 要求两个操作数都是bf16，与 avx512bf16.cpp 相同，
+    把查询拆成 hi + lo 两个bf16向量分别做点积，查询侧保留约16位有效数字
+*/
+void splitQuery(const float* x, size_t d, uint16_t* hi, uint16_t* lo) {
+    for (size_t i = 0; i < d; ++i) {
+        hi[i] = fp32ToBf16(x[i]);
+        lo[i] = fp32ToBf16(x[i] - bf16ToFp32(hi[i]));
+    }
+}
+
+inline bfloat16x8_t loadBh(const uint16_t* p) {
+    return vreinterpretq_bf16_u16(vld1q_u16(p));
+}
+
+float innerProductBf16(const uint16_t* hi, const uint16_t* lo, const uint16_t* y, size_t d) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; i + 8 <= d; i += 8) {
+        bfloat16x8_t yv = loadBh(y + i);
+        acc0 = vbfdotq_f32(acc0, loadBh(hi + i), yv);
+        acc1 = vbfdotq_f32(acc1, loadBh(lo + i), yv);
+    }
+    float res = vaddvq_f32(vaddq_f32(acc0, acc1));
+    for (; i < d; ++i) {
+        res += (bf16ToFp32(hi[i]) + bf16ToFp32(lo[i])) * bf16ToFp32(y[i]);
+    }
+    return res;
+}
+
+/*
+    查询按 kSplitBlock 维一段拆分到栈上的缓冲区，每段对所有数据向量累加一次，热路径上不分配堆内存
+    本文件使用高级指令编译，不使用 std 中的模板，避免链接器为其他编译单元选中这里生成的弱符号
+*/
+void neonBf16InnerProductsNy(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    uint16_t hi[kSplitBlock];
+    uint16_t lo[kSplitBlock];
+    for (size_t j = 0; j < ny; ++j) {
+        dis[j] = 0.0f;
+    }
+    for (size_t b = 0; b < d; b += kSplitBlock) {
+        const size_t len = d - b < kSplitBlock ? d - b : kSplitBlock;
+        splitQuery(x + b, len, hi, lo);
+        for (size_t j = 0; j < ny; ++j) {
+            dis[j] += innerProductBf16(hi, lo, y + j * d + b, len);
+        }
+    }
+}
+
+} // namespace
+
+const DistanceKernels& getKernelsNEONBF16() {
+    static const DistanceKernels kernels = [] {
+        DistanceKernels k = getKernelsNEON();
+        k.name = "neonbf16";
+        k.inner_products_ny_bf16 = neonBf16InnerProductsNy;
+        return k;
+    }();
+    return kernels;
+}
+
+}
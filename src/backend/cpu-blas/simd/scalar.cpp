@@ -0,0 +1,34 @@
+#include "backend/cpu-blas/simd/simdImpl.hpp"
+
+namespace cpu_blas {
+
+namespace {
+
+// 标量实现，作为所有平台的兜底
+struct Scalar {
+    using Reg = float;
+    static constexpr size_t kWidth = 1;
+    static Reg zero() { return 0.0f; }
+    static Reg set1(float a) { return a; }
+    static Reg load(const float* p) { return *p; }
+    static void store(float* p, Reg r) { *p = r; }
+    static Reg loadHalf(const uint16_t* p) { return fp16ToFp32(*p); }
+    static void storeHalf(uint16_t* p, Reg r) { *p = fp32ToFp16(r); }
+    static Reg loadBf16(const uint16_t* p) { return bf16ToFp32(*p); }
+    static Reg loadU8(const uint8_t* p) { return *p; }
+    static Reg add(Reg a, Reg b) { return a + b; }
+    static Reg sub(Reg a, Reg b) { return a - b; }
+    static Reg mul(Reg a, Reg b) { return a * b; }
+    static Reg max(Reg a, Reg b) { return a > b ? a : b; }
+    static Reg fmadd(Reg a, Reg b, Reg c) { return a * b + c; }
+    static float reduce(Reg r) { return r; }
+};
+
+} // namespace
+
+const DistanceKernels& getKernelsScalar() {
+    static const DistanceKernels kernels = makeKernels<Scalar>("scalar");
+    return kernels;
+}
+
+}
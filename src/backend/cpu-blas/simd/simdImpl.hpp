@@ -0,0 +1,509 @@
+#pragma once
+
+#include "backend/cpu-blas/kernels.hpp"
+#include "backend/cpu-blas/fp16.hpp"
+#include "backend/cpu-blas/bf16.hpp"
+
+#include <cstddef> // For size_t
+#include <cstring> // std::memcpy
+
+/*
+    与指令集无关的内核模板
+    每个指令集的编译单元（使用各自的编译选项）包含本文件，并提供一个描述SIMD寄存器的结构 V：
+        V::Reg                  寄存器类型
+        V::kWidth               每个寄存器的float数量
+        V::zero() / V::set1(a)
+        V::load(p) / V::store(p, r)
+        V::loadHalf(p) / V::storeHalf(p, r)   读取/写入kWidth个fp16并与float互相转换
+        V::loadBf16(p)          读取kWidth个bf16并展开为float
+        V::loadU8(p)            读取kWidth个uint8并展开为float
+        V::add(a, b) / V::sub(a, b) / V::mul(a, b) / V::max(a, b)
+        V::fmadd(a, b, c)       a * b + c
+        V::reduce(r)            水平求和
+    注意：这里的所有代码都放在匿名命名空间中，保证不同编译选项生成的代码不会在链接时被互相替换
+*/
+
+namespace cpu_blas {
+namespace {
+
+template <class V>
+float simdInnerProduct(const float* x, const float* y, size_t d) {
+    constexpr size_t W = V::kWidth;
+    typename V::Reg acc0 = V::zero();
+    typename V::Reg acc1 = V::zero();
+    size_t i = 0;
+    for (; i + 2 * W <= d; i += 2 * W) {
+        acc0 = V::fmadd(V::load(x + i), V::load(y + i), acc0);
+        acc1 = V::fmadd(V::load(x + i + W), V::load(y + i + W), acc1);
+    }
+    for (; i + W <= d; i += W) {
+        acc0 = V::fmadd(V::load(x + i), V::load(y + i), acc0);
+    }
+    float res = V::reduce(V::add(acc0, acc1));
+    for (; i < d; ++i) {
+        res += x[i] * y[i];
+    }
+    return res;
+}
+
+template <class V>
+float simdL2sqr(const float* x, const float* y, size_t d) {
+    constexpr size_t W = V::kWidth;
+    typename V::Reg acc0 = V::zero();
+    typename V::Reg acc1 = V::zero();
+    size_t i = 0;
+    for (; i + 2 * W <= d; i += 2 * W) {
+        typename V::Reg diff0 = V::sub(V::load(x + i), V::load(y + i));
+        typename V::Reg diff1 = V::sub(V::load(x + i + W), V::load(y + i + W));
+        acc0 = V::fmadd(diff0, diff0, acc0);
+        acc1 = V::fmadd(diff1, diff1, acc1);
+    }
+    for (; i + W <= d; i += W) {
+        typename V::Reg diff = V::sub(V::load(x + i), V::load(y + i));
+        acc0 = V::fmadd(diff, diff, acc0);
+    }
+    float res = V::reduce(V::add(acc0, acc1));
+    for (; i < d; ++i) {
+        float diff = x[i] - y[i];
+        res += diff * diff;
+    }
+    return res;
+}
+
+template <class V>
+float simdNormL2sqr(const float* x, size_t d) {
+    constexpr size_t W = V::kWidth;
+    typename V::Reg acc0 = V::zero();
+    typename V::Reg acc1 = V::zero();
+    size_t i = 0;
+    for (; i + 2 * W <= d; i += 2 * W) {
+        typename V::Reg x0 = V::load(x + i);
+        typename V::Reg x1 = V::load(x + i + W);
+        acc0 = V::fmadd(x0, x0, acc0);
+        acc1 = V::fmadd(x1, x1, acc1);
+    }
+    for (; i + W <= d; i += W) {
+        typename V::Reg x0 = V::load(x + i);
+        acc0 = V::fmadd(x0, x0, acc0);
+    }
+    float res = V::reduce(V::add(acc0, acc1));
+    for (; i < d; ++i) {
+        res += x[i] * x[i];
+    }
+    return res;
+}
+
+// 一次处理4个数据向量，查询向量x每次只需要加载一次
+template <class V>
+void simdInnerProductsNy(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    constexpr size_t W = V::kWidth;
+    size_t j = 0;
+    for (; j + 4 <= ny; j += 4) {
+        const float* y0 = y + j * d;
+        const float* y1 = y0 + d;
+        const float* y2 = y1 + d;
+        const float* y3 = y2 + d;
+        typename V::Reg acc0 = V::zero();
+        typename V::Reg acc1 = V::zero();
+        typename V::Reg acc2 = V::zero();
+        typename V::Reg acc3 = V::zero();
+        size_t i = 0;
+        for (; i + W <= d; i += W) {
+            typename V::Reg xi = V::load(x + i);
+            acc0 = V::fmadd(xi, V::load(y0 + i), acc0);
+            acc1 = V::fmadd(xi, V::load(y1 + i), acc1);
+            acc2 = V::fmadd(xi, V::load(y2 + i), acc2);
+            acc3 = V::fmadd(xi, V::load(y3 + i), acc3);
+        }
+        float r0 = V::reduce(acc0);
+        float r1 = V::reduce(acc1);
+        float r2 = V::reduce(acc2);
+        float r3 = V::reduce(acc3);
+        for (; i < d; ++i) {
+            r0 += x[i] * y0[i];
+            r1 += x[i] * y1[i];
+            r2 += x[i] * y2[i];
+            r3 += x[i] * y3[i];
+        }
+        dis[j] = r0;
+        dis[j + 1] = r1;
+        dis[j + 2] = r2;
+        dis[j + 3] = r3;
+    }
+    for (; j < ny; ++j) {
+        dis[j] = simdInnerProduct<V>(x, y + j * d, d);
+    }
+}
+
+template <class V>
+void simdL2sqrNy(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    constexpr size_t W = V::kWidth;
+    size_t j = 0;
+    for (; j + 4 <= ny; j += 4) {
+        const float* y0 = y + j * d;
+        const float* y1 = y0 + d;
+        const float* y2 = y1 + d;
+        const float* y3 = y2 + d;
+        typename V::Reg acc0 = V::zero();
+        typename V::Reg acc1 = V::zero();
+        typename V::Reg acc2 = V::zero();
+        typename V::Reg acc3 = V::zero();
+        size_t i = 0;
+        for (; i + W <= d; i += W) {
+            typename V::Reg xi = V::load(x + i);
+            typename V::Reg d0 = V::sub(xi, V::load(y0 + i));
+            typename V::Reg d1 = V::sub(xi, V::load(y1 + i));
+            typename V::Reg d2 = V::sub(xi, V::load(y2 + i));
+            typename V::Reg d3 = V::sub(xi, V::load(y3 + i));
+            acc0 = V::fmadd(d0, d0, acc0);
+            acc1 = V::fmadd(d1, d1, acc1);
+            acc2 = V::fmadd(d2, d2, acc2);
+            acc3 = V::fmadd(d3, d3, acc3);
+        }
+        float r0 = V::reduce(acc0);
+        float r1 = V::reduce(acc1);
+        float r2 = V::reduce(acc2);
+        float r3 = V::reduce(acc3);
+        for (; i < d; ++i) {
+            float t0 = x[i] - y0[i];
+            float t1 = x[i] - y1[i];
+            float t2 = x[i] - y2[i];
+            float t3 = x[i] - y3[i];
+            r0 += t0 * t0;
+            r1 += t1 * t1;
+            r2 += t2 * t2;
+            r3 += t3 * t3;
+        }
+        dis[j] = r0;
+        dis[j + 1] = r1;
+        dis[j + 2] = r2;
+        dis[j + 3] = r3;
+    }
+    for (; j < ny; ++j) {
+        dis[j] = simdL2sqr<V>(x, y + j * d, d);
+    }
+}
+
+template <class V>
+void simdL2FromIp(float* dis, const float* ip, float xNorm, const float* yNorm, size_t n) {
+    constexpr size_t W = V::kWidth;
+    typename V::Reg xn = V::set1(xNorm);
+    typename V::Reg minus2 = V::set1(-2.0f);
+    typename V::Reg zero = V::zero();
+    size_t j = 0;
+    for (; j + W <= n; j += W) {
+        typename V::Reg d = V::fmadd(minus2, V::load(ip + j), V::add(xn, V::load(yNorm + j)));
+        V::store(dis + j, V::max(d, zero));
+    }
+    for (; j < n; ++j) {
+        float d = xNorm + yNorm[j] - 2 * ip[j];
+        dis[j] = d < 0 ? 0 : d;
+    }
+}
+
+template <class V>
+void simdScale(float* x, float s, size_t d) {
+    constexpr size_t W = V::kWidth;
+    typename V::Reg sv = V::set1(s);
+    size_t i = 0;
+    for (; i + W <= d; i += W) {
+        V::store(x + i, V::mul(V::load(x + i), sv));
+    }
+    for (; i < d; ++i) {
+        x[i] *= s;
+    }
+}
+
+/*
+    16位存储格式的描述，E 提供：
+        E::load(p)              读取kWidth个元素并转换为float寄存器
+        E::toFloat(h)           单个元素的转换，用于循环尾部
+*/
+template <class V>
+struct Fp16Elem {
+    static typename V::Reg load(const uint16_t* p) { return V::loadHalf(p); }
+    static float toFloat(uint16_t h) { return fp16ToFp32(h); }
+};
+
+template <class V>
+struct Bf16Elem {
+    static typename V::Reg load(const uint16_t* p) { return V::loadBf16(p); }
+    static float toFloat(uint16_t h) { return bf16ToFp32(h); }
+};
+
+template <class V, class E>
+void simdHalfToFp32(float* dst, const uint16_t* src, size_t n) {
+    constexpr size_t W = V::kWidth;
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        V::store(dst + i, E::load(src + i));
+    }
+    for (; i < n; ++i) {
+        dst[i] = E::toFloat(src[i]);
+    }
+}
+
+template <class V>
+void simdFp32ToFp16(uint16_t* dst, const float* src, size_t n) {
+    constexpr size_t W = V::kWidth;
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        V::storeHalf(dst + i, V::load(src + i));
+    }
+    for (; i < n; ++i) {
+        dst[i] = fp32ToFp16(src[i]);
+    }
+}
+
+// 只在写入数据时使用，不是热点，直接用标量实现
+inline void fp32ToBf16Array(uint16_t* dst, const float* src, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = fp32ToBf16(src[i]);
+    }
+}
+
+template <class V, class E>
+float simdInnerProductHalf(const float* x, const uint16_t* y, size_t d) {
+    constexpr size_t W = V::kWidth;
+    typename V::Reg acc0 = V::zero();
+    typename V::Reg acc1 = V::zero();
+    size_t i = 0;
+    for (; i + 2 * W <= d; i += 2 * W) {
+        acc0 = V::fmadd(V::load(x + i), E::load(y + i), acc0);
+        acc1 = V::fmadd(V::load(x + i + W), E::load(y + i + W), acc1);
+    }
+    for (; i + W <= d; i += W) {
+        acc0 = V::fmadd(V::load(x + i), E::load(y + i), acc0);
+    }
+    float res = V::reduce(V::add(acc0, acc1));
+    for (; i < d; ++i) {
+        res += x[i] * E::toFloat(y[i]);
+    }
+    return res;
+}
+
+template <class V, class E>
+float simdL2sqrHalf(const float* x, const uint16_t* y, size_t d) {
+    constexpr size_t W = V::kWidth;
+    typename V::Reg acc0 = V::zero();
+    typename V::Reg acc1 = V::zero();
+    size_t i = 0;
+    for (; i + 2 * W <= d; i += 2 * W) {
+        typename V::Reg diff0 = V::sub(V::load(x + i), E::load(y + i));
+        typename V::Reg diff1 = V::sub(V::load(x + i + W), E::load(y + i + W));
+        acc0 = V::fmadd(diff0, diff0, acc0);
+        acc1 = V::fmadd(diff1, diff1, acc1);
+    }
+    for (; i + W <= d; i += W) {
+        typename V::Reg diff = V::sub(V::load(x + i), E::load(y + i));
+        acc0 = V::fmadd(diff, diff, acc0);
+    }
+    float res = V::reduce(V::add(acc0, acc1));
+    for (; i < d; ++i) {
+        float diff = x[i] - E::toFloat(y[i]);
+        res += diff * diff;
+    }
+    return res;
+}
+
+template <class V, class E>
+void simdInnerProductsNyHalf(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    for (size_t j = 0; j < ny; ++j) {
+        dis[j] = simdInnerProductHalf<V, E>(x, y + j * d, d);
+    }
+}
+
+template <class V, class E>
+void simdL2sqrNyHalf(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    for (size_t j = 0; j < ny; ++j) {
+        dis[j] = simdL2sqrHalf<V, E>(x, y + j * d, d);
+    }
+}
+
+template <class V>
+float simdInnerProductU8(const float* x, const uint8_t* c, size_t d) {
+    constexpr size_t W = V::kWidth;
+    typename V::Reg acc0 = V::zero();
+    typename V::Reg acc1 = V::zero();
+    size_t i = 0;
+    for (; i + 2 * W <= d; i += 2 * W) {
+        acc0 = V::fmadd(V::load(x + i), V::loadU8(c + i), acc0);
+        acc1 = V::fmadd(V::load(x + i + W), V::loadU8(c + i + W), acc1);
+    }
+    for (; i + W <= d; i += W) {
+        acc0 = V::fmadd(V::load(x + i), V::loadU8(c + i), acc0);
+    }
+    float res = V::reduce(V::add(acc0, acc1));
+    for (; i < d; ++i) {
+        res += x[i] * c[i];
+    }
+    return res;
+}
+
+template <class V>
+float simdL2sqrU8(const float* x, const float* scale, const uint8_t* c, size_t d) {
+    constexpr size_t W = V::kWidth;
+    typename V::Reg acc0 = V::zero();
+    typename V::Reg acc1 = V::zero();
+    size_t i = 0;
+    for (; i + 2 * W <= d; i += 2 * W) {
+        typename V::Reg diff0 = V::sub(V::load(x + i), V::mul(V::load(scale + i), V::loadU8(c + i)));
+        typename V::Reg diff1 = V::sub(V::load(x + i + W), V::mul(V::load(scale + i + W), V::loadU8(c + i + W)));
+        acc0 = V::fmadd(diff0, diff0, acc0);
+        acc1 = V::fmadd(diff1, diff1, acc1);
+    }
+    for (; i + W <= d; i += W) {
+        typename V::Reg diff = V::sub(V::load(x + i), V::mul(V::load(scale + i), V::loadU8(c + i)));
+        acc0 = V::fmadd(diff, diff, acc0);
+    }
+    float res = V::reduce(V::add(acc0, acc1));
+    for (; i < d; ++i) {
+        float diff = x[i] - scale[i] * c[i];
+        res += diff * diff;
+    }
+    return res;
+}
+
+template <class V>
+void simdInnerProductsNyU8(float* dis, const float* x, const uint8_t* codes, size_t d, size_t ny) {
+    for (size_t j = 0; j < ny; ++j) {
+        dis[j] = simdInnerProductU8<V>(x, codes + j * d, d);
+    }
+}
+
+template <class V>
+void simdL2sqrNyU8(float* dis, const float* x, const float* scale, const uint8_t* codes, size_t d, size_t ny) {
+    for (size_t j = 0; j < ny; ++j) {
+        dis[j] = simdL2sqrU8<V>(x, scale, codes + j * d, d);
+    }
+}
+
+template <class V>
+void simdDecodeU8(float* dst, const uint8_t* codes, const float* vmin, const float* scale, size_t d, size_t n) {
+    constexpr size_t W = V::kWidth;
+    for (size_t j = 0; j < n; ++j) {
+        const uint8_t* c = codes + j * d;
+        float* out = dst + j * d;
+        size_t i = 0;
+        for (; i + W <= d; i += W) {
+            V::store(out + i, V::fmadd(V::load(scale + i), V::loadU8(c + i), V::load(vmin + i)));
+        }
+        for (; i < d; ++i) {
+            out[i] = vmin[i] + scale[i] * c[i];
+        }
+    }
+}
+
+/*
+    fast-scan 查表累加的标量版本，没有字节查表指令的平台使用
+    按组内向量的顺序逐个查表，各指令集的版本必须与它的结果完全一致
+*/
+inline void pq4AccumulateScalar(uint16_t* out, const uint8_t* codes, const uint8_t* lut, size_t M, size_t nBlocks) {
+    for (size_t b = 0; b < nBlocks; ++b) {
+        const uint8_t* block = codes + b * M * 16;
+        uint16_t* o = out + b * 32;
+        for (size_t i = 0; i < 32; ++i) {
+            o[i] = 0;
+        }
+        for (size_t m = 0; m < M; ++m) {
+            const uint8_t* c = block + m * 16;
+            const uint8_t* t = lut + m * 16;
+            for (size_t i = 0; i < 16; ++i) {
+                o[i] += t[c[i] & 15];
+                o[i + 16] += t[c[i] >> 4];
+            }
+        }
+    }
+}
+
+/*
+    汉明距离的通用版本，x86的各个编译单元带 -mpopcnt 编译，__builtin_popcountll 直接生成 popcnt 指令
+    两路累加打断依赖链
+*/
+inline void hammingNy(uint32_t* dis, const uint64_t* x, const uint64_t* codes, size_t nwords, size_t ny) {
+    for (size_t j = 0; j < ny; ++j) {
+        const uint64_t* c = codes + j * nwords;
+        uint32_t d0 = 0, d1 = 0;
+        size_t i = 0;
+        for (; i + 2 <= nwords; i += 2) {
+            d0 += __builtin_popcountll(x[i] ^ c[i]);
+            d1 += __builtin_popcountll(x[i + 1] ^ c[i + 1]);
+        }
+        if (i < nwords) {
+            d0 += __builtin_popcountll(x[i] ^ c[i]);
+        }
+        dis[j] = d0 + d1;
+    }
+}
+
+/*
+    CRC32C 的查表版本（slicing-by-8），每次处理8个字节
+    表在第一次调用时生成，x86 上有 SSE4.2 的 crc32 指令时不会使用
+*/
+struct Crc32cTable {
+    uint32_t t[8][256];
+    Crc32cTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? (c >> 1) ^ 0x82f63b78u : c >> 1;
+            }
+            t[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int s = 1; s < 8; ++s) {
+                t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+            }
+        }
+    }
+};
+
+inline uint32_t crc32cTable(uint32_t crc, const void* data, size_t n) {
+    static const Crc32cTable table;
+    const uint32_t (*t)[256] = table.t;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (; n >= 8; n -= 8, p += 8) {
+        uint32_t lo, hi;
+        std::memcpy(&lo, p, sizeof(lo));
+        std::memcpy(&hi, p + 4, sizeof(hi));
+        lo ^= crc;
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+    for (; n > 0; --n, ++p) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xff];
+    }
+    return ~crc;
+}
+
+template <class V>
+DistanceKernels makeKernels(const char* name) {
+    DistanceKernels k;
+    k.name = name;
+    k.inner_product = simdInnerProduct<V>;
+    k.L2sqr = simdL2sqr<V>;
+    k.norm_L2sqr = simdNormL2sqr<V>;
+    k.inner_products_ny = simdInnerProductsNy<V>;
+    k.L2sqr_ny = simdL2sqrNy<V>;
+    k.L2_from_ip = simdL2FromIp<V>;
+    k.scale = simdScale<V>;
+    k.fp16_to_fp32 = simdHalfToFp32<V, Fp16Elem<V>>;
+    k.fp32_to_fp16 = simdFp32ToFp16<V>;
+    k.inner_products_ny_fp16 = simdInnerProductsNyHalf<V, Fp16Elem<V>>;
+    k.L2sqr_ny_fp16 = simdL2sqrNyHalf<V, Fp16Elem<V>>;
+    k.bf16_to_fp32 = simdHalfToFp32<V, Bf16Elem<V>>;
+    k.fp32_to_bf16 = fp32ToBf16Array;
+    k.inner_products_ny_bf16 = simdInnerProductsNyHalf<V, Bf16Elem<V>>;
+    k.L2sqr_ny_bf16 = simdL2sqrNyHalf<V, Bf16Elem<V>>;
+    k.inner_products_ny_u8 = simdInnerProductsNyU8<V>;
+    k.L2sqr_ny_u8 = simdL2sqrNyU8<V>;
+    k.decode_u8 = simdDecodeU8<V>;
+    k.pq4_accumulate = pq4AccumulateScalar;
+    k.hamming_ny = hammingNy;
+    k.crc32c = crc32cTable;
+    return k;
+}
+
+} // namespace
+} // namespace cpu_blas
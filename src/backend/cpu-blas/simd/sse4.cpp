@@ -0,0 +1,107 @@
+// 使用 -msse4.2 -mpopcnt 编译
+#include "backend/cpu-blas/simd/simdImpl.hpp"
+
+#include <immintrin.h>
+#include <cstring>  // std::memcpy
+
+namespace cpu_blas {
+
+namespace {
+
+struct SSE4 {
+    using Reg = __m128;
+    static constexpr size_t kWidth = 4;
+    static Reg zero() { return _mm_setzero_ps(); }
+    static Reg set1(float a) { return _mm_set1_ps(a); }
+    static Reg load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, Reg r) { _mm_storeu_ps(p, r); }
+    // SSE4 没有F16C，使用软件转换
+    static Reg loadHalf(const uint16_t* p) {
+        return _mm_setr_ps(fp16ToFp32(p[0]), fp16ToFp32(p[1]), fp16ToFp32(p[2]), fp16ToFp32(p[3]));
+    }
+    static void storeHalf(uint16_t* p, Reg r) {
+        alignas(16) float tmp[4];
+        _mm_store_ps(tmp, r);
+        for (int i = 0; i < 4; ++i) {
+            p[i] = fp32ToFp16(tmp[i]);
+        }
+    }
+    // bf16 零扩展到32位后左移16位即为对应的float
+    static Reg loadBf16(const uint16_t* p) {
+        __m128i h = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+        return _mm_castsi128_ps(_mm_slli_epi32(_mm_cvtepu16_epi32(h), 16));
+    }
+    static Reg loadU8(const uint8_t* p) {
+        int32_t w;
+        std::memcpy(&w, p, sizeof(w));
+        return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(w)));
+    }
+    static Reg add(Reg a, Reg b) { return _mm_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm_mul_ps(a, b); }
+    static Reg max(Reg a, Reg b) { return _mm_max_ps(a, b); }
+    static Reg fmadd(Reg a, Reg b, Reg c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static float reduce(Reg r) {
+        r = _mm_hadd_ps(r, r);
+        r = _mm_hadd_ps(r, r);
+        return _mm_cvtss_f32(r);
+    }
+};
+
+/*
+    fast-scan 查表累加：pshufb 一次完成16个4位编码的查表
+    查到的8位距离展开为uint16后累加，每组32个向量使用4个累加寄存器
+*/
+void sse4Pq4Accumulate(uint16_t* out, const uint8_t* codes, const uint8_t* lut, size_t M, size_t nBlocks) {
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i zero = _mm_setzero_si128();
+    for (size_t b = 0; b < nBlocks; ++b) {
+        const uint8_t* block = codes + b * M * 16;
+        __m128i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+        for (size_t m = 0; m < M; ++m) {
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + m * 16));
+            __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lut + m * 16));
+            __m128i lo = _mm_shuffle_epi8(t, _mm_and_si128(c, mask));
+            __m128i hi = _mm_shuffle_epi8(t, _mm_and_si128(_mm_srli_epi16(c, 4), mask));
+            acc0 = _mm_add_epi16(acc0, _mm_unpacklo_epi8(lo, zero));
+            acc1 = _mm_add_epi16(acc1, _mm_unpackhi_epi8(lo, zero));
+            acc2 = _mm_add_epi16(acc2, _mm_unpacklo_epi8(hi, zero));
+            acc3 = _mm_add_epi16(acc3, _mm_unpackhi_epi8(hi, zero));
+        }
+        __m128i* o = reinterpret_cast<__m128i*>(out + b * 32);
+        _mm_storeu_si128(o + 0, acc0);
+        _mm_storeu_si128(o + 1, acc1);
+        _mm_storeu_si128(o + 2, acc2);
+        _mm_storeu_si128(o + 3, acc3);
+    }
+}
+
+// SSE4.2 的 crc32 指令直接计算CRC32C，每条指令处理8个字节
+uint32_t sse4Crc32c(uint32_t crc, const void* data, size_t n) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t c = ~crc;
+    for (; n >= 8; n -= 8, p += 8) {
+        uint64_t w;
+        std::memcpy(&w, p, sizeof(w));
+        c = _mm_crc32_u64(c, w);
+    }
+    uint32_t c32 = static_cast<uint32_t>(c);
+    for (; n > 0; --n, ++p) {
+        c32 = _mm_crc32_u8(c32, *p);
+    }
+    return ~c32;
+}
+
+} // namespace
+
+const DistanceKernels& getKernelsSSE4() {
+    static const DistanceKernels kernels = [] {
+        DistanceKernels k = makeKernels<SSE4>("sse4");
+        k.pq4_accumulate = sse4Pq4Accumulate;
+        k.crc32c = sse4Crc32c;
+        return k;
+    }();
+    return kernels;
+}
+
+}
@@ -0,0 +1,231 @@
+// 使用 -march=armv8.2-a+sve 编译
+// SVE的寄存器长度在编译期未知，无法套用 simdImpl.hpp 中的模板，这里单独用谓词循环实现
+#include "backend/cpu-blas/kernels.hpp"
+#include "backend/cpu-blas/fp16.hpp"
+#include "backend/cpu-blas/bf16.hpp"
+
+#include <arm_sve.h>
+
+namespace cpu_blas {
+
+namespace {
+
+float sveInnerProduct(const float* x, const float* y, size_t d) {
+    svfloat32_t acc = svdup_n_f32(0.0f);
+    for (size_t i = 0; i < d; i += svcntw()) {
+        svbool_t pg = svwhilelt_b32_u64(i, d);
+        acc = svmla_f32_m(pg, acc, svld1_f32(pg, x + i), svld1_f32(pg, y + i));
+    }
+    return svaddv_f32(svptrue_b32(), acc);
+}
+
+float sveL2sqr(const float* x, const float* y, size_t d) {
+    svfloat32_t acc = svdup_n_f32(0.0f);
+    for (size_t i = 0; i < d; i += svcntw()) {
+        svbool_t pg = svwhilelt_b32_u64(i, d);
+        svfloat32_t diff = svsub_f32_m(pg, svld1_f32(pg, x + i), svld1_f32(pg, y + i));
+        acc = svmla_f32_m(pg, acc, diff, diff);
+    }
+    return svaddv_f32(svptrue_b32(), acc);
+}
+
+float sveNormL2sqr(const float* x, size_t d) {
+    svfloat32_t acc = svdup_n_f32(0.0f);
+    for (size_t i = 0; i < d; i += svcntw()) {
+        svbool_t pg = svwhilelt_b32_u64(i, d);
+        svfloat32_t xi = svld1_f32(pg, x + i);
+        acc = svmla_f32_m(pg, acc, xi, xi);
+    }
+    return svaddv_f32(svptrue_b32(), acc);
+}
+
+void sveInnerProductsNy(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    for (size_t j = 0; j < ny; ++j) {
+        dis[j] = sveInnerProduct(x, y + j * d, d);
+    }
+}
+
+void sveL2sqrNy(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    for (size_t j = 0; j < ny; ++j) {
+        dis[j] = sveL2sqr(x, y + j * d, d);
+    }
+}
+
+void sveL2FromIp(float* dis, const float* ip, float xNorm, const float* yNorm, size_t n) {
+    for (size_t j = 0; j < n; j += svcntw()) {
+        svbool_t pg = svwhilelt_b32_u64(j, n);
+        svfloat32_t d = svadd_n_f32_x(pg, svld1_f32(pg, yNorm + j), xNorm);
+        d = svmls_n_f32_x(pg, d, svld1_f32(pg, ip + j), 2.0f);
+        svst1_f32(pg, dis + j, svmax_n_f32_x(pg, d, 0.0f));
+    }
+}
+
+void sveScale(float* x, float s, size_t d) {
+    for (size_t i = 0; i < d; i += svcntw()) {
+        svbool_t pg = svwhilelt_b32_u64(i, d);
+        svst1_f32(pg, x + i, svmul_n_f32_x(pg, svld1_f32(pg, x + i), s));
+    }
+}
+
+// 半精度以32位为单位加载，svld1uh把每个fp16零扩展到一个32位通道中，再就地转换为fp32
+inline svfloat32_t sveLoadHalf(svbool_t pg, const uint16_t* p) {
+    svfloat16_t h = svreinterpret_f16_u32(svld1uh_u32(pg, p));
+    return svcvt_f32_f16_x(pg, h);
+}
+
+void sveFp16ToFp32(float* dst, const uint16_t* src, size_t n) {
+    for (size_t i = 0; i < n; i += svcntw()) {
+        svbool_t pg = svwhilelt_b32_u64(i, n);
+        svst1_f32(pg, dst + i, sveLoadHalf(pg, src + i));
+    }
+}
+
+void sveFp32ToFp16(uint16_t* dst, const float* src, size_t n) {
+    for (size_t i = 0; i < n; i += svcntw()) {
+        svbool_t pg = svwhilelt_b32_u64(i, n);
+        svfloat16_t h = svcvt_f16_f32_x(pg, svld1_f32(pg, src + i));
+        svst1h_u32(pg, dst + i, svreinterpret_u32_f16(h));
+    }
+}
+
+void sveInnerProductsNyFp16(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    for (size_t j = 0; j < ny; ++j) {
+        const uint16_t* yj = y + j * d;
+        svfloat32_t acc = svdup_n_f32(0.0f);
+        for (size_t i = 0; i < d; i += svcntw()) {
+            svbool_t pg = svwhilelt_b32_u64(i, d);
+            acc = svmla_f32_m(pg, acc, svld1_f32(pg, x + i), sveLoadHalf(pg, yj + i));
+        }
+        dis[j] = svaddv_f32(svptrue_b32(), acc);
+    }
+}
+
+void sveL2sqrNyFp16(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    for (size_t j = 0; j < ny; ++j) {
+        const uint16_t* yj = y + j * d;
+        svfloat32_t acc = svdup_n_f32(0.0f);
+        for (size_t i = 0; i < d; i += svcntw()) {
+            svbool_t pg = svwhilelt_b32_u64(i, d);
+            svfloat32_t diff = svsub_f32_m(pg, svld1_f32(pg, x + i), sveLoadHalf(pg, yj + i));
+            acc = svmla_f32_m(pg, acc, diff, diff);
+        }
+        dis[j] = svaddv_f32(svptrue_b32(), acc);
+    }
+}
+
+// bf16 零扩展到32位通道后左移16位即为对应的float
+inline svfloat32_t sveLoadBf16(svbool_t pg, const uint16_t* p) {
+    return svreinterpret_f32_u32(svlsl_n_u32_x(pg, svld1uh_u32(pg, p), 16));
+}
+
+void sveBf16ToFp32(float* dst, const uint16_t* src, size_t n) {
+    for (size_t i = 0; i < n; i += svcntw()) {
+        svbool_t pg = svwhilelt_b32_u64(i, n);
+        svst1_f32(pg, dst + i, sveLoadBf16(pg, src + i));
+    }
+}
+
+void sveFp32ToBf16(uint16_t* dst, const float* src, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = fp32ToBf16(src[i]);
+    }
+}
+
+void sveInnerProductsNyBf16(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    for (size_t j = 0; j < ny; ++j) {
+        const uint16_t* yj = y + j * d;
+        svfloat32_t acc = svdup_n_f32(0.0f);
+        for (size_t i = 0; i < d; i += svcntw()) {
+            svbool_t pg = svwhilelt_b32_u64(i, d);
+            acc = svmla_f32_m(pg, acc, svld1_f32(pg, x + i), sveLoadBf16(pg, yj + i));
+        }
+        dis[j] = svaddv_f32(svptrue_b32(), acc);
+    }
+}
+
+void sveL2sqrNyBf16(float* dis, const float* x, const uint16_t* y, size_t d, size_t ny) {
+    for (size_t j = 0; j < ny; ++j) {
+        const uint16_t* yj = y + j * d;
+        svfloat32_t acc = svdup_n_f32(0.0f);
+        for (size_t i = 0; i < d; i += svcntw()) {
+            svbool_t pg = svwhilelt_b32_u64(i, d);
+            svfloat32_t diff = svsub_f32_m(pg, svld1_f32(pg, x + i), sveLoadBf16(pg, yj + i));
+            acc = svmla_f32_m(pg, acc, diff, diff);
+        }
+        dis[j] = svaddv_f32(svptrue_b32(), acc);
+    }
+}
+
+inline svfloat32_t sveLoadU8(svbool_t pg, const uint8_t* p) {
+    return svcvt_f32_u32_x(pg, svld1ub_u32(pg, p));
+}
+
+void sveInnerProductsNyU8(float* dis, const float* x, const uint8_t* codes, size_t d, size_t ny) {
+    for (size_t j = 0; j < ny; ++j) {
+        const uint8_t* c = codes + j * d;
+        svfloat32_t acc = svdup_n_f32(0.0f);
+        for (size_t i = 0; i < d; i += svcntw()) {
+            svbool_t pg = svwhilelt_b32_u64(i, d);
+            acc = svmla_f32_m(pg, acc, svld1_f32(pg, x + i), sveLoadU8(pg, c + i));
+        }
+        dis[j] = svaddv_f32(svptrue_b32(), acc);
+    }
+}
+
+void sveL2sqrNyU8(float* dis, const float* x, const float* scale, const uint8_t* codes, size_t d, size_t ny) {
+    for (size_t j = 0; j < ny; ++j) {
+        const uint8_t* c = codes + j * d;
+        svfloat32_t acc = svdup_n_f32(0.0f);
+        for (size_t i = 0; i < d; i += svcntw()) {
+            svbool_t pg = svwhilelt_b32_u64(i, d);
+            svfloat32_t diff = svmls_f32_m(pg, svld1_f32(pg, x + i), svld1_f32(pg, scale + i), sveLoadU8(pg, c + i));
+            acc = svmla_f32_m(pg, acc, diff, diff);
+        }
+        dis[j] = svaddv_f32(svptrue_b32(), acc);
+    }
+}
+
+void sveDecodeU8(float* dst, const uint8_t* codes, const float* vmin, const float* scale, size_t d, size_t n) {
+    for (size_t j = 0; j < n; ++j) {
+        const uint8_t* c = codes + j * d;
+        float* out = dst + j * d;
+        for (size_t i = 0; i < d; i += svcntw()) {
+            svbool_t pg = svwhilelt_b32_u64(i, d);
+            svfloat32_t v = svmla_f32_x(pg, svld1_f32(pg, vmin + i), svld1_f32(pg, scale + i), sveLoadU8(pg, c + i));
+            svst1_f32(pg, out + i, v);
+        }
+    }
+}
+
+} // namespace
+
+const DistanceKernels& getKernelsSVE() {
+    static const DistanceKernels kernels = {
+        "sve",
+        sveInnerProduct,
+        sveL2sqr,
+        sveNormL2sqr,
+        sveInnerProductsNy,
+        sveL2sqrNy,
+        sveL2FromIp,
+        sveScale,
+        sveFp16ToFp32,
+        sveFp32ToFp16,
+        sveInnerProductsNyFp16,
+        sveL2sqrNyFp16,
+        sveBf16ToFp32,
+        sveFp32ToBf16,
+        sveInnerProductsNyBf16,
+        sveL2sqrNyBf16,
+        sveInnerProductsNyU8,
+        sveL2sqrNyU8,
+        sveDecodeU8,
+        // 16字节的查表正好是一个NEON寄存器，与向量长度无关，直接使用NEON版本
+        getKernelsNEON().pq4_accumulate,
+        getKernelsNEON().hamming_ny,
+        getKernelsNEON().crc32c,
+    };
+    return kernels;
+}
+
+}
@@ -4,6 +4,7 @@
 #include "backend/gpu-kompute/readShader.hpp"
 #include "backend/gpu-kompute/shader.hpp"
 #include "index/FlatIndex.hpp"
+#include "index/Bitmap.hpp"
 
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
@@ -13,6 +14,7 @@
 #include <sstream>
 #include <algorithm>
 #include <numeric>
+#include <cmath>
 
 namespace gpu_kompute {
 
@@ -28,12 +30,13 @@ void query(
     float* distances,
     uint64_t* results,
     MetricType metricType,
-    float* metricArg
+    float* metricArg,
+    const RowFilter* filter
 ) {
     if (metricType == METRIC_L2) {
-        calL2(mgr, query, data, nQuery, nData, dim, k, distances, results, dataNorm);
+        calL2(mgr, query, data, nQuery, nData, dim, k, distances, results, dataNorm, filter);
     } else if (metricType == METRIC_INNER_PRODUCT) {
-        calIP(mgr, query, data, nQuery, nData, dim, k, distances, results, dataNorm);
+        calIP(mgr, query, data, nQuery, nData, dim, k, distances, results, dataNorm, filter);
     } else {
         // 其他距离计算方式可以在这里添加
         // throw std::invalid_argument("Unsupported metric type");
@@ -50,7 +53,8 @@ void calL2(
     uint64_t k,
     float* outDistances,
     uint64_t* outIndices,
-    const float* yNorm
+    const float* yNorm,
+    const RowFilter* filter
 ) {
     // xNorm yNorm IP
     std::shared_ptr<kp::TensorT<float>> X = mgr->tensorT<float>(std::vector<float>(x, x + nx * dim));
@@ -78,20 +82,25 @@ void calL2(
     calL2Add(mgr, XNorm, YNorm, IP, L2, nx, ny);
 
     // 从L2中排序并赋值结果
-    std::vector<std::pair<float, uint64_t>> results(ny);
+    std::vector<std::pair<float, uint64_t>> results;
+    results.reserve(ny);
     for (uint64_t i = 0; i < nx; ++i) {
+        results.clear();
         for (uint64_t j = 0; j < ny; ++j) {
+            if (filter != nullptr && filter->skip(j)) {
+                continue;   // 被过滤的行不参与排序
+            }
             float value = L2->data()[i * ny + j];
-            results[j] = std::make_pair(value, j); // 存储距离和索引
+            results.emplace_back(value, j); // 存储距离和索引
         }
         std::sort(results.begin(), results.end(),
                           [](const std::pair<float, uint64_t>& a, const std::pair<float, uint64_t>& b) {
                               return a.first < b.first; // 升序排序
                           });
-        // 将前k个结果写入输出
-        for (uint64_t j = 0; j < std::min(k, ny); ++j) {
-            outDistances[i * k + j] = results[j].first;
-            outIndices[i * k + j] = results[j].second;
+        // 将前k个结果写入输出，不足k个时填充
+        for (uint64_t j = 0; j < k; ++j) {
+            outDistances[i * k + j] = j < results.size() ? results[j].first : HUGE_VALF;
+            outIndices[i * k + j] = j < results.size() ? results[j].second : UINT64_MAX;
         }
     }
 
@@ -107,7 +116,8 @@ void calIP(
     size_t k,
     float* outDistances,
     uint64_t* outIndices,
-    const float* yNorm
+    const float* yNorm,
+    const RowFilter* filter
 ) {
     // 计算内积距离，使用kompute接口
     std::shared_ptr<kp::TensorT<float>> IP = mgr->tensorT<float>(std::vector<float>(nx * ny, 0.0f));
@@ -117,12 +127,16 @@ void calIP(
     matmul(mgr, Tx, Ty, IP, nx, ny, dim, false, true);
 
     // 从IP中复制结果
-    std::vector<std::pair<float, uint64_t>> results(ny);
+    std::vector<std::pair<float, uint64_t>> results;
+    results.reserve(ny);
     for (uint64_t i = 0; i < nx; ++i) {
-        
+        results.clear();
         for (uint64_t j = 0; j < ny; ++j) {
+            if (filter != nullptr && filter->skip(j)) {
+                continue;   // 被过滤的行不参与排序
+            }
             float value = IP->data()[i * ny + j];
-            results[j] = std::make_pair(value, j); // 存储距离和索引
+            results.emplace_back(value, j); // 存储距离和索引
         }
 
         std::sort(results.begin(), results.end(),
@@ -130,10 +144,10 @@ void calIP(
                               return a.first > b.first; // 降序排序
                           });
 
-        // 将前k个结果写入输出
-        for (uint64_t j = 0; j < std::min(k, ny); ++j) {
-            outDistances[i * k + j] = results[j].first;
-            outIndices[i * k + j] = results[j].second;
+        // 将前k个结果写入输出，不足k个时填充
+        for (uint64_t j = 0; j < k; ++j) {
+            outDistances[i * k + j] = j < results.size() ? results[j].first : -HUGE_VALF;
+            outIndices[i * k + j] = j < results.size() ? results[j].second : UINT64_MAX;
         }
     }
 
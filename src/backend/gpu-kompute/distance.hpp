@@ -12,8 +12,12 @@
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
 
+struct RowFilter;
+
 namespace gpu_kompute {
 
+// filter 不为空时，其中置位的数据行不会进入 top-k 结果；结果不足k个时距离填充为最差值，下标填充为 UINT64_MAX
+
 void query(
     kp::Manager* mgr,           // Kompute管理器
     uint64_t nQuery,
@@ -26,7 +30,8 @@ void query(
     float* distances,
     uint64_t* results,
     MetricType metricType,
-    float* metricArg = nullptr
+    float* metricArg = nullptr,
+    const RowFilter* filter = nullptr
 );
 
 /*
@@ -42,7 +47,8 @@ void calL2(
     uint64_t k,
     float* outDistances,
     uint64_t* outIndices,
-    const float* yNorm = nullptr
+    const float* yNorm = nullptr,
+    const RowFilter* filter = nullptr
 );
 
 /*
@@ -59,7 +65,8 @@ void calIP(
     size_t k,
     float* outDistances,
     uint64_t* outIndices,
-    const float* yNorm = nullptr
+    const float* yNorm = nullptr,
+    const RowFilter* filter = nullptr
 );
 
 void matmul (
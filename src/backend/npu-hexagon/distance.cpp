@@ -1,4 +1,5 @@
 #include "backend/npu-hexagon/distance.hpp"
+#include "index/Bitmap.hpp"
 
 #include <memory>          // std::unique_ptr
 #include <cstddef>         // size_t
@@ -33,7 +34,8 @@ void query(
     float* distances,
     uint64_t* results,
     MetricType metricType,
-    float* metricArg
+    float* metricArg,
+    const RowFilter* filter
 ) {
     struct timespec ts_start, ts_end;
     clock_gettime(CLOCK_MONOTONIC, &ts_start);
@@ -43,9 +45,9 @@ void query(
         return;
     // 选择合适的计算内积的函数
     if (metricType == MetricType::METRIC_INNER_PRODUCT) {
-        npu_hexagon::calIPHexagon(query, data, nQuery, nData, dim, k, distances, results, dataNorm);
+        npu_hexagon::calIPHexagon(query, data, nQuery, nData, dim, k, distances, results, dataNorm, filter);
     } else {
-        npu_hexagon::calL2Hexagon(query, data, nQuery, nData, dim, k, distances, results, dataNorm);
+        npu_hexagon::calL2Hexagon(query, data, nQuery, nData, dim, k, distances, results, dataNorm, filter);
     }
            // 记录结束时间
     clock_gettime(CLOCK_MONOTONIC, &ts_end);
@@ -147,7 +149,8 @@ void calL2Hexagon(
     uint64_t k,
     float* outDistances,
     uint64_t* outIndices,
-    const float* yNorm
+    const float* yNorm,
+    const RowFilter* filter
 ) {
     if (nx == 0 || ny == 0 || k == 0) {
         return;
@@ -213,6 +216,9 @@ void calL2Hexagon(
 
                 for (size_t j_local = 0; j_local < nyi; ++j_local) {
                     size_t j_global = j0 + j_local;
+                    if (filter != nullptr && filter->skip(j_global)) {
+                        continue;
+                    }
                     float ip = ip_row[j_local];
 
                     float d = x_norms[i_global] + yNorm[j_global] - 2 * ip;
@@ -233,6 +239,10 @@ void calL2Hexagon(
             auto& heap = query_heaps[i_local];
             
             size_t current_k = heap.size();
+            for (size_t j = current_k; j < k; ++j) {
+                outDistances[i_global * k + j] = HUGE_VALF;
+                outIndices[i_global * k + j] = UINT64_MAX;
+            }
             for (size_t j = 0; j < current_k; ++j) {
                 const auto& [distance, index] = heap.top();
                 size_t out_idx = i_global * k + (current_k - 1 - j);
@@ -253,7 +263,8 @@ void calIPHexagon(
     uint64_t k,
     float* outDistances,
     uint64_t* outIndices,
-    const float* yNorm
+    const float* yNorm,
+    const RowFilter* filter
 ) {
     if (nx == 0 || ny == 0 || k == 0) {
         return;
@@ -308,6 +319,9 @@ void calIPHexagon(
                 for (size_t j_local = 0; j_local < nyi; ++j_local) {
                     float ip = ip_row[j_local];
                     size_t j_global = j0 + j_local;
+                    if (filter != nullptr && filter->skip(j_global)) {
+                        continue;
+                    }
 
                     if (query_heaps[i_local].size() < k) {
                         query_heaps[i_local].push({ip, j_global});
@@ -324,6 +338,10 @@ void calIPHexagon(
             MinHeap& heap = query_heaps[i_local];
             
             size_t current_k = heap.size();
+            for (size_t j = current_k; j < k; ++j) {
+                outDistances[i_global * k + j] = -HUGE_VALF;
+                outIndices[i_global * k + j] = UINT64_MAX;
+            }
             for (size_t j = 0; j < current_k; ++j) {
                 const auto& [ip_value, index] = heap.top();
 
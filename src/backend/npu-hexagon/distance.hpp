@@ -10,8 +10,12 @@
 #include <vector>
 #include <algorithm>
 
+struct RowFilter;
+
 namespace npu_hexagon {
 
+// filter 不为空时，其中置位的数据行不会进入 top-k 结果；结果不足k个时距离填充为最差值，下标填充为 UINT64_MAX
+
 void query(
     uint64_t nQuery,
     uint64_t nData,
@@ -23,7 +27,8 @@ void query(
     float* distances,
     uint64_t* results,
     MetricType metricType,
-    float* metricArg = nullptr
+    float* metricArg = nullptr,
+    const RowFilter* filter = nullptr
 );
 
 void calL2Hexagon(
@@ -35,7 +40,8 @@ void calL2Hexagon(
     uint64_t k,
     float* outDistances,
     uint64_t* outIndices,
-    const float* yNorm = nullptr
+    const float* yNorm = nullptr,
+    const RowFilter* filter = nullptr
 );
 
 void fvec_norms_L2sqr (
@@ -55,7 +61,8 @@ void calIPHexagon(
     uint64_t k,
     float* outDistances,
     uint64_t* outIndices,
-    const float* yNorm = nullptr
+    const float* yNorm = nullptr,
+    const RowFilter* filter = nullptr
 );
 
 }
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include "index/BinaryIndex.hpp"
+#include "index/FlatIndex.hpp"
+#include "index/Refine.hpp"
+#include "backend/cpu-blas/heap.hpp"
+#include "backend/cpu-blas/kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <omp.h>
+#include <random>
+
+namespace {
+
+constexpr uint64_t kChunkSize = 1024;   // 每次调用汉明距离内核处理的向量数量
+
+/*
+    扫描 [begin, end) 的编码，把汉明距离放入堆中
+*/
+void scanCodes(
+    const uint64_t* x,
+    const uint64_t* codes,
+    uint64_t nwords,
+    uint64_t begin,
+    uint64_t end,
+    uint64_t k,
+    cpu_blas::L2Heap& heap
+) {
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+    std::vector<uint32_t> hamming(kChunkSize);
+    std::vector<float> dis(kChunkSize);
+    for (uint64_t i0 = begin; i0 < end; i0 += kChunkSize) {
+        const uint64_t n = std::min(kChunkSize, end - i0);
+        kernels.hamming_ny(hamming.data(), x, codes + i0 * nwords, nwords, n);
+        for (uint64_t j = 0; j < n; ++j) {
+            dis[j] = (float)hamming[j];
+        }
+        cpu_blas::heapPushLine(heap, k, dis.data(), n, i0);
+    }
+}
+
+} // namespace
+
+BinaryIndex::BinaryIndex(uint64_t dim, MetricType metricType, bool rotate, uint64_t seed)
+        : dim_(dim), nwords_((dim + 63) / 64), num_(0), metricType_(metricType), rotate_(rotate),
+          refineIndex_(nullptr), kFactor_(1) {
+    if (rotate_) {
+        initRotation(seed);
+    }
+}
+
+void BinaryIndex::initRotation(uint64_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    rotation_.resize(dim_ * dim_);
+    for (auto& v : rotation_) {
+        v = dist(rng);
+    }
+    // 逐行减去在前面各行上的投影后归一化
+    for (uint64_t i = 0; i < dim_; ++i) {
+        float* row = rotation_.data() + i * dim_;
+        for (uint64_t j = 0; j < i; ++j) {
+            const float* prev = rotation_.data() + j * dim_;
+            const float p = cpu_blas::fvec_inner_product(row, prev, dim_);
+            for (uint64_t d = 0; d < dim_; ++d) {
+                row[d] -= p * prev[d];
+            }
+        }
+        const float norm = std::sqrt(cpu_blas::fvec_inner_product(row, row, dim_));
+        for (uint64_t d = 0; d < dim_; ++d) {
+            row[d] /= norm;
+        }
+    }
+}
+
+void BinaryIndex::encode(const float* vecs, uint64_t n, uint64_t* codes) const {
+#pragma omp parallel for if (n > 1000)
+    for (int64_t i = 0; i < (int64_t)n; ++i) {
+        const float* x = vecs + i * dim_;
+        std::vector<float> rotated;
+        if (rotate_) {
+            rotated.resize(dim_);
+            cpu_blas::fvec_inner_products_ny(rotated.data(), x, rotation_.data(), dim_, dim_);
+            x = rotated.data();
+        }
+        uint64_t* code = codes + i * nwords_;
+        std::fill(code, code + nwords_, 0);
+        for (uint64_t d = 0; d < dim_; ++d) {
+            if (x[d] > 0) {
+                code[d / 64] |= 1ull << (d % 64);
+            }
+        }
+    }
+}
+
+void BinaryIndex::addVector(const float* vecs, uint64_t n) {
+    codes_.resize((num_ + n) * nwords_);
+    encode(vecs, n, codes_.data() + num_ * nwords_);
+    num_ += n;
+}
+
+uint64_t BinaryIndex::getNum() const {
+    return num_;
+}
+
+uint64_t BinaryIndex::getDim() const {
+    return dim_;
+}
+
+uint64_t BinaryIndex::getCodeWords() const {
+    return nwords_;
+}
+
+void BinaryIndex::setRefine(FlatIndex* refineIndex, uint64_t kFactor) {
+    refineIndex_ = refineIndex;
+    kFactor_ = std::max<uint64_t>(kFactor, 1);
+}
+
+void BinaryIndex::searchCodes(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances
+) {
+    std::vector<uint64_t> queryCodes(nQuery * nwords_);
+    encode(query, nQuery, queryCodes.data());
+
+    const uint64_t nThreads = omp_get_max_threads();
+    // 与 PQIndex 相同：查询足够多时按查询并行，否则把数据库切成多段并行扫描后再合并
+    if (nQuery >= nThreads || num_ < 10000) {
+#pragma omp parallel for if (nQuery > 1)
+        for (int64_t q = 0; q < (int64_t)nQuery; ++q) {
+            cpu_blas::L2Heap heap;
+            scanCodes(queryCodes.data() + q * nwords_, codes_.data(), nwords_, 0, num_, k, heap);
+            cpu_blas::heapToOutput(heap, k, HUGE_VALF, distances + q * k, results + q * k);
+        }
+        return;
+    }
+
+    uint64_t nSplit = nThreads;
+    for (uint64_t q = 0; q < nQuery; ++q) {
+        std::vector<cpu_blas::L2Heap> heaps(nSplit);
+#pragma omp parallel for
+        for (int64_t s = 0; s < (int64_t)nSplit; ++s) {
+            scanCodes(queryCodes.data() + q * nwords_, codes_.data(), nwords_,
+                      s * num_ / nSplit, (s + 1) * num_ / nSplit, k, heaps[s]);
+        }
+        for (uint64_t s = 1; s < nSplit; ++s) {
+            cpu_blas::heapMerge(heaps[0], heaps[s], k);
+        }
+        cpu_blas::heapToOutput(heaps[0], k, HUGE_VALF, distances + q * k, results + q * k);
+    }
+}
+
+void BinaryIndex::search(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances
+) {
+    if (nQuery == 0 || k == 0) {
+        return;
+    }
+    if (refineIndex_ == nullptr) {
+        searchCodes(k, nQuery, query, results, distances);
+        return;
+    }
+
+    const uint64_t nCandidate = k * kFactor_;
+    std::vector<uint64_t> candidates(nQuery * nCandidate);
+    std::vector<float> candidateDistances(nQuery * nCandidate);
+    searchCodes(nCandidate, nQuery, query, candidates.data(), candidateDistances.data());
+
+    if (metricType_ == MetricType::METRIC_INNER_PRODUCT) {
+        refineResults<cpu_blas::IPHeap>(*refineIndex_, metricType_, query, nQuery, dim_, k,
+                                        nCandidate, candidates.data(), -HUGE_VALF, results, distances);
+    } else {
+        refineResults<cpu_blas::L2Heap>(*refineIndex_, metricType_, query, nQuery, dim_, k,
+                                        nCandidate, candidates.data(), HUGE_VALF, results, distances);
+    }
+}
+
+void BinaryIndex::getCode(uint64_t idx, uint64_t* code) const {
+    if (idx >= num_) {
+        // 索引超出范围
+        return;
+    }
+    std::copy(codes_.begin() + idx * nwords_, codes_.begin() + (idx + 1) * nwords_, code);
+}
+
+int BinaryIndex::save(const std::string filename) {
+    try {
+        std::filesystem::path dir_path = std::filesystem::path(filename).parent_path();
+        if (!dir_path.empty()) {
+            std::filesystem::create_directories(dir_path);
+        }
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Filesystem error while creating directory: " << e.what() << std::endl;
+        return -1;
+    }
+
+    std::ofstream ofs(filename, std::ios::binary);
+    if (!ofs) {
+        return -1; // 打开文件失败
+    }
+
+    // header
+    /*
+        magicNumber + num + dim + metricType + rotate + 旋转矩阵（rotate 为真时） + 编码
+        精排使用的 FlatIndex 不保存，加载后需要重新调用 setRefine
+    */
+    uint64_t magicNumber = 1154;
+    uint8_t rotate = rotate_ ? 1 : 0;
+    ofs.write(reinterpret_cast<const char*>(&magicNumber), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&num_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&dim_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&metricType_), sizeof(MetricType));
+    ofs.write(reinterpret_cast<const char*>(&rotate), sizeof(uint8_t));
+    if (rotate_) {
+        ofs.write(reinterpret_cast<const char*>(rotation_.data()), rotation_.size() * sizeof(float));
+    }
+    ofs.write(reinterpret_cast<const char*>(codes_.data()), codes_.size() * sizeof(uint64_t));
+
+    ofs.close();
+    return 0; // 成功
+}
+
+int BinaryIndex::load(const std::string filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) {
+        return -1; // 打开文件失败
+    }
+
+    uint64_t magicNumber;
+    ifs.read(reinterpret_cast<char*>(&magicNumber), sizeof(uint64_t));
+    if (magicNumber != 1154) {
+        return -2; // 魔数不匹配
+    }
+    uint8_t rotate = 0;
+    ifs.read(reinterpret_cast<char*>(&num_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&dim_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&metricType_), sizeof(MetricType));
+    ifs.read(reinterpret_cast<char*>(&rotate), sizeof(uint8_t));
+    rotate_ = rotate != 0;
+    nwords_ = (dim_ + 63) / 64;
+    rotation_.clear();
+    if (rotate_) {
+        rotation_.resize(dim_ * dim_);
+        ifs.read(reinterpret_cast<char*>(rotation_.data()), rotation_.size() * sizeof(float));
+    }
+    codes_.resize(num_ * nwords_);
+    ifs.read(reinterpret_cast<char*>(codes_.data()), codes_.size() * sizeof(uint64_t));
+    if (!ifs) {
+        return -3; // 文件损坏
+    }
+
+    ifs.close();
+    return 0; // 成功
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "MetricType.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class FlatIndex;
+
+/*
+    二值量化索引
+    每个向量只保存各维的符号位（1位/维，相比float32压缩32倍），用异或 + popcount 计算汉明距离快速筛选候选，
+    再用 FlatIndex 中的原始向量对候选做精确距离的精排
+    对归一化的嵌入向量，汉明距离近似反映向量夹角；各维方差差别较大时可以开启随机正交旋转，
+    把信息均匀分散到各维，提高符号位的区分度
+*/
+class BinaryIndex
+{
+    public:
+        BinaryIndex(uint64_t dim, MetricType metricType = MetricType::METRIC_INNER_PRODUCT,
+                    bool rotate = false, uint64_t seed = 1234);
+        ~BinaryIndex() {};
+
+        // 添加向量，不需要训练；向量的编号按添加顺序从0开始
+        void addVector(const float* vecs, uint64_t n);
+        // 获取向量数量
+        uint64_t getNum() const;
+        // 获取向量维度
+        uint64_t getDim() const;
+        // 每个向量编码占用的uint64个数
+        uint64_t getCodeWords() const;
+
+        /*
+            设置精排使用的原始向量，refineIndex 中第i个向量必须与本索引的第i个向量对应
+            先按汉明距离取出 k * kFactor 个候选，再用 refineIndex 中的向量按 metricType 计算精确距离取前k个
+            refineIndex 为 nullptr 时不精排，返回汉明距离
+        */
+        void setRefine(FlatIndex* refineIndex, uint64_t kFactor = 10);
+
+        // 查询nQuery个向量并返回前k个匹配的向量
+        void search(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances
+        );
+
+        // 取回第 idx 个向量的二值编码，code 需要 getCodeWords() 个uint64
+        void getCode(uint64_t idx, uint64_t* code) const;
+
+        int save(const std::string filename);
+        int load(const std::string filename);
+
+    private:
+        // 生成随机正交矩阵（对高斯随机矩阵做 Gram-Schmidt 正交化）
+        void initRotation(uint64_t seed);
+        // 把n个向量（可选旋转后）编码为符号位
+        void encode(const float* vecs, uint64_t n, uint64_t* codes) const;
+        // 按汉明距离查询，结果为汉明距离
+        void searchCodes(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances
+        );
+
+        uint64_t dim_;                      // 向量维度
+        uint64_t nwords_;                   // 每个编码的uint64个数，ceil(dim / 64)
+        uint64_t num_;                      // 向量数量
+        MetricType metricType_;             // 精排时的距离计算方式
+        bool rotate_;                       // 编码前是否旋转
+        std::vector<float> rotation_;       // dim_ * dim_ 的正交矩阵，按行存放
+        std::vector<uint64_t> codes_;       // num_ * nwords_ 个uint64，第 j 维对应第 j / 64 个字的第 j % 64 位
+        FlatIndex* refineIndex_;            // 精排使用的原始向量，不归本索引所有
+        uint64_t kFactor_;                  // 精排时候选数量的倍数
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/*
+    按行号存放的位图，FlatIndex 用它标记已删除的行（墓碑）
+*/
+class Bitmap
+{
+    public:
+        // 调整位数，新增的位为0
+        void resize(uint64_t n) {
+            if (n < size_) {
+                // 缩小时去掉被截断部分的计数
+                for (uint64_t i = n; i < size_; ++i) {
+                    count_ -= test(i) ? 1 : 0;
+                }
+            }
+            words_.resize((n + 63) / 64, 0);
+            if (n % 64 != 0) {
+                words_.back() &= (1ull << (n % 64)) - 1;
+            }
+            size_ = n;
+        }
+
+        uint64_t size() const {
+            return size_;
+        }
+
+        // 置位的数量
+        uint64_t count() const {
+            return count_;
+        }
+
+        bool test(uint64_t i) const {
+            return (words_[i >> 6] >> (i & 63)) & 1;
+        }
+
+        // 置位，返回该位之前是否为0
+        bool set(uint64_t i) {
+            if (test(i)) {
+                return false;
+            }
+            words_[i >> 6] |= 1ull << (i & 63);
+            ++count_;
+            return true;
+        }
+
+        // 清空所有位，位数不变
+        void reset() {
+            std::fill(words_.begin(), words_.end(), 0);
+            count_ = 0;
+        }
+
+        const uint64_t* data() const {
+            return words_.data();
+        }
+
+        uint64_t* data() {
+            return words_.data();
+        }
+
+        uint64_t numWords() const {
+            return words_.size();
+        }
+
+        // 直接修改 data() 之后重新统计置位数量
+        void recount() {
+            count_ = 0;
+            for (uint64_t w : words_) {
+                count_ += __builtin_popcountll(w);
+            }
+        }
+
+    private:
+        std::vector<uint64_t> words_;
+        uint64_t size_ = 0;
+        uint64_t count_ = 0;
+};
+
+/*
+    传给各个后端 top-k 阶段的行过滤条件
+    后端看到的第 j 行对应位图中的第 offset + j 位，置位的行不会进入结果
+*/
+struct RowFilter {
+    const uint64_t* bits = nullptr;
+    uint64_t offset = 0;
+
+    bool skip(uint64_t j) const {
+        const uint64_t pos = offset + j;
+        return (bits[pos >> 6] >> (pos & 63)) & 1;
+    }
+};
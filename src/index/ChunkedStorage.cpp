@@ -0,0 +1,125 @@
+#include "index/ChunkedStorage.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace {
+
+const uint64_t kCacheLine = 64;
+
+uint64_t alignUp(uint64_t bytes) {
+    return (bytes + kCacheLine - 1) / kCacheLine * kCacheLine;
+}
+
+} // namespace
+
+void ChunkedStorage::init(uint64_t rowBytes, uint64_t chunkBytes) {
+    rowBytes_ = rowBytes;
+    chunkBytes_ = chunkBytes;
+    chunkRows_ = rowBytes > 0 ? std::max<uint64_t>(1, chunkBytes / rowBytes) : 1;
+    this->clear();
+}
+
+void ChunkedStorage::clear() {
+    chunks_.clear();
+    external_ = nullptr;
+    externalNorms_ = nullptr;
+    externalRows_ = 0;
+}
+
+uint64_t ChunkedStorage::getRowBytes() const {
+    return rowBytes_;
+}
+
+uint64_t ChunkedStorage::getChunkBytes() const {
+    return chunkBytes_;
+}
+
+uint64_t ChunkedStorage::getChunkRows() const {
+    return chunkRows_;
+}
+
+uint64_t ChunkedStorage::capacity() const {
+    return externalRows_ + (chunks_.empty() ? 0 : (chunks_.size() - 1) * chunkRows_ + chunks_.back().capacity);
+}
+
+ChunkedStorage::Chunk ChunkedStorage::allocate(uint64_t rows) const {
+    const uint64_t dataBytes = alignUp(rows * rowBytes_);
+    void* p = nullptr;
+    if (posix_memalign(&p, kCacheLine, dataBytes + alignUp(rows * sizeof(float))) != 0) {
+        throw std::bad_alloc();
+    }
+    Chunk chunk;
+    chunk.buffer.reset(static_cast<char*>(p));
+    chunk.data = chunk.buffer.get();
+    chunk.norms = reinterpret_cast<float*>(chunk.data + dataBytes);
+    chunk.capacity = rows;
+    return chunk;
+}
+
+void ChunkedStorage::reserve(uint64_t n) {
+    while (capacity() < n) {
+        const uint64_t missing = n - capacity();
+        if (!chunks_.empty() && chunks_.back().capacity < chunkRows_) {
+            // 最后一个块未满：按倍数增长，最多到 chunkRows 行，只复制这一个块
+            Chunk& last = chunks_.back();
+            Chunk grown = allocate(std::min(chunkRows_, std::max(last.capacity * 2, last.capacity + missing)));
+            std::memcpy(grown.data, last.data, last.capacity * rowBytes_);
+            std::memcpy(grown.norms, last.norms, last.capacity * sizeof(float));
+            last = std::move(grown);
+        } else {
+            // 新的块按需要的行数分配，之后再按倍数增长
+            chunks_.push_back(allocate(std::min(chunkRows_, missing)));
+        }
+    }
+}
+
+void ChunkedStorage::shrink(uint64_t n) {
+    const uint64_t owned = n > externalRows_ ? n - externalRows_ : 0;
+    const uint64_t used = (owned + chunkRows_ - 1) / chunkRows_;
+    if (chunks_.size() > used) {
+        chunks_.erase(chunks_.begin() + used, chunks_.end());
+    }
+}
+
+void ChunkedStorage::setExternal(const void* data, const float* norms, uint64_t n) {
+    this->clear();
+    external_ = static_cast<const char*>(data);
+    externalNorms_ = norms;
+    externalRows_ = n;
+}
+
+bool ChunkedStorage::isExternal() const {
+    return external_ != nullptr;
+}
+
+void ChunkedStorage::copyExternal(uint64_t n) {
+    if (!external_) {
+        return;
+    }
+    ChunkedStorage copy;
+    copy.init(rowBytes_, chunkBytes_);
+    copy.reserve(n);
+    for (uint64_t i = 0; i < n;) {
+        const uint64_t len = std::min({n - i, this->contiguous(i), copy.contiguous(i)});
+        std::memcpy(copy.mutableRow(i), this->row(i), len * rowBytes_);
+        std::memcpy(copy.mutableNorm(i), this->norm(i), len * sizeof(float));
+        i += len;
+    }
+    *this = std::move(copy);
+}
+
+void ChunkedStorage::assign(const void* data, const float* norms, uint64_t n) {
+    const char* src = static_cast<const char*>(data);
+    this->clear();
+    this->reserve(n);
+    for (uint64_t i = 0; i < n;) {
+        const uint64_t len = std::min(n - i, this->contiguous(i));
+        std::memcpy(this->mutableRow(i), src + i * rowBytes_, len * rowBytes_);
+        if (norms) {
+            std::memcpy(this->mutableNorm(i), norms + i, len * sizeof(float));
+        }
+        i += len;
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+/*
+    分块存储的向量和范数，FlatIndex 用它存放数据库
+    | 块0：chunkRows 行向量 + chunkRows 个范数 | 块1 | ... | 最后一个块（可能未满） |
+
+    每块的起始地址和块内范数的起始地址都按缓存行（64字节）对齐，块内的行连续存放，可以直接交给各个后端
+    扩容时只分配新的块，已有块中的行不会移动；只有最后一个块在达到 chunkRows 之前按倍数增长，
+    增长时最多复制一个块，不会像整体翻倍那样复制整个数据库、短时间内占用三倍的内存
+    除最后一个块外每块都是 chunkRows 行，第 i 行位于第 i / chunkRows 块
+
+    也可以直接使用外部的一段连续数据（mmap 映射的文件）作为只读的第一个块：
+    | 外部数据：externalRows 行 | 块0 | 块1 | ... |
+    之后追加的行放在自己的块中，第 i 行（i >= externalRows）位于第 (i - externalRows) / chunkRows 块，
+    追加时映射的数据既不复制也不移动；只有需要原地修改已有的行时（例如压缩）才用 copyExternal 复制出来
+*/
+class ChunkedStorage
+{
+    public:
+        /*
+            设置每行向量的字节数和每块向量数据的目标字节数（每块至少1行），释放已有的数据
+        */
+        void init(uint64_t rowBytes, uint64_t chunkBytes);
+        // 释放所有数据，行的字节数和块大小不变
+        void clear();
+
+        uint64_t getRowBytes() const;
+        uint64_t getChunkBytes() const;
+        // 每块的行数
+        uint64_t getChunkRows() const;
+        // 可以容纳的行数，包括外部数据的行数
+        uint64_t capacity() const;
+
+        // 保证可以容纳 n 行，只会在外部数据之后分配自己的块
+        void reserve(uint64_t n);
+        // 释放前 n 行之后完全空闲的块
+        void shrink(uint64_t n);
+
+        // 改为以外部的 n 行连续数据开头，释放已有的块；外部数据只读，需要在使用期间保持有效
+        void setExternal(const void* data, const float* norms, uint64_t n);
+        bool isExternal() const;
+        // 把外部数据和之后的共 n 行复制到自己的块中，不再使用外部数据，之后所有的行都可以修改
+        void copyExternal(uint64_t n);
+        // 用 n 行连续数据替换现有内容，norms 为空时范数由调用者填写
+        void assign(const void* data, const float* norms, uint64_t n);
+
+        // 第 i 行的向量和范数
+        const char* row(uint64_t i) const {
+            if (i < externalRows_) {
+                return external_ + i * rowBytes_;
+            }
+            i -= externalRows_;
+            return chunks_[i / chunkRows_].data + (i % chunkRows_) * rowBytes_;
+        }
+
+        const float* norm(uint64_t i) const {
+            if (i < externalRows_) {
+                return externalNorms_ + i;
+            }
+            i -= externalRows_;
+            return chunks_[i / chunkRows_].norms + i % chunkRows_;
+        }
+
+        // 可写的版本，只能用于自己的块（i >= 外部数据的行数）
+        char* mutableRow(uint64_t i) {
+            i -= externalRows_;
+            return chunks_[i / chunkRows_].data + (i % chunkRows_) * rowBytes_;
+        }
+
+        float* mutableNorm(uint64_t i) {
+            i -= externalRows_;
+            return chunks_[i / chunkRows_].norms + i % chunkRows_;
+        }
+
+        // 从第 i 行开始在同一块中连续存放的行数，调用者再按需要的行数截断
+        uint64_t contiguous(uint64_t i) const {
+            if (i < externalRows_) {
+                return externalRows_ - i;
+            }
+            i -= externalRows_;
+            return chunks_[i / chunkRows_].capacity - i % chunkRows_;
+        }
+
+    private:
+        struct Free {
+            void operator()(char* p) const { std::free(p); }
+        };
+        struct Chunk {
+            std::unique_ptr<char, Free> buffer;     // 向量和范数在同一次分配中
+            char* data;
+            float* norms;
+            uint64_t capacity;                      // 块中可以容纳的行数
+        };
+        // 分配可以容纳 rows 行的块
+        Chunk allocate(uint64_t rows) const;
+
+        uint64_t rowBytes_ = 0;
+        uint64_t chunkBytes_ = 0;
+        uint64_t chunkRows_ = 1;
+        std::vector<Chunk> chunks_;
+        const char* external_ = nullptr;        // 外部数据，为空时所有的行都在 chunks_ 中
+        const float* externalNorms_ = nullptr;
+        uint64_t externalRows_ = 0;
+};
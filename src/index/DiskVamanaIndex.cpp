@@ -0,0 +1,494 @@
+#include "index/DiskVamanaIndex.hpp"
+#include "index/VisitedTable.hpp"
+#include "backend/cpu-blas/distance.hpp"
+#include "backend/cpu-blas/heap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t kSectorSize = 4096;      // 节点记录按扇区对齐，一条记录不会跨越两个扇区
+constexpr uint64_t kMagicNumber = 1153;
+
+// 没有指定PQ段数时，取不超过 dim / 4 的最大约数，每段约4维
+uint64_t defaultPqM(uint64_t dim, uint64_t pqM) {
+    if (pqM != 0) {
+        return pqM;
+    }
+    for (uint64_t m = std::max<uint64_t>(dim / 4, 1); m > 1; --m) {
+        if (dim % m == 0) {
+            return m;
+        }
+    }
+    return 1;
+}
+
+// 候选列表中的一项，按距离从小到大排列
+struct ListEntry {
+    float distance;
+    uint32_t id;
+    bool expanded;
+    bool operator<(const ListEntry& other) const { return distance < other.distance; }
+};
+
+// 把 (d, id) 插入有序的候选列表，列表最多保留 capacity 项
+void insertEntry(std::vector<ListEntry>& list, uint64_t capacity, float d, uint32_t id) {
+    if (list.size() >= capacity && d >= list.back().distance) {
+        return;
+    }
+    ListEntry entry{d, id, false};
+    list.insert(std::upper_bound(list.begin(), list.end(), entry), entry);
+    if (list.size() > capacity) {
+        list.pop_back();
+    }
+}
+
+} // namespace
+
+struct DiskVamanaIndex::Graph {
+    std::vector<std::vector<uint32_t>> adj;     // 每个节点的邻居
+    mutable std::deque<std::mutex> locks;       // 每个节点一把锁
+};
+
+DiskVamanaIndex::DiskVamanaIndex(uint64_t dim, uint64_t R, uint64_t L, float alpha, uint64_t pqM)
+        : dim_(dim), R_(R), L_(L), alpha_(alpha), searchL_(L), beamWidth_(4), num_(0), medoid_(0),
+          recordSize_(0), nodesPerSector_(0), sectorsPerNode_(0), pq_(dim, defaultPqM(dim, pqM), 8),
+          fd_(-1), kernels_(&cpu_blas::getKernels()), diskReads_(0) {
+    if (R == 0 || L == 0 || alpha < 1.0f) {
+        throw std::invalid_argument("DiskVamanaIndex: R and L must be positive and alpha >= 1");
+    }
+}
+
+DiskVamanaIndex::~DiskVamanaIndex() {
+    closeFile();
+}
+
+void DiskVamanaIndex::closeFile() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+uint32_t DiskVamanaIndex::findMedoid(const float* vecs, uint64_t n) const {
+    std::vector<float> mean(dim_, 0.0f);
+    for (uint64_t i = 0; i < n; ++i) {
+        for (uint64_t d = 0; d < dim_; ++d) {
+            mean[d] += vecs[i * dim_ + d];
+        }
+    }
+    for (auto& v : mean) {
+        v /= n;
+    }
+    float distance;
+    uint64_t medoid;
+    cpu_blas::calL2BLAS(mean.data(), vecs, 1, n, dim_, 1, &distance, &medoid);
+    return (uint32_t)medoid;
+}
+
+void DiskVamanaIndex::greedySearch(const float* vecs, const Graph& graph, const float* x, std::vector<Candidate>& expanded) const {
+    VisitedTable& visited = threadVisitedTable(num_);
+    std::vector<ListEntry> list;
+    list.reserve(L_ + 1);
+    visited.visit(medoid_);
+    list.push_back({kernels_->L2sqr(x, vecs + (uint64_t)medoid_ * dim_, dim_), medoid_, false});
+
+    expanded.clear();
+    std::vector<uint32_t> neighbors;
+    while (true) {
+        auto it = std::find_if(list.begin(), list.end(), [](const ListEntry& e) { return !e.expanded; });
+        if (it == list.end()) {
+            break;
+        }
+        it->expanded = true;
+        const uint32_t node = it->id;
+        expanded.emplace_back(it->distance, node);
+        {
+            std::lock_guard<std::mutex> guard(graph.locks[node]);
+            neighbors = graph.adj[node];
+        }
+        for (uint32_t nb : neighbors) {
+            if (visited.visit(nb)) {
+                continue;
+            }
+            insertEntry(list, L_, kernels_->L2sqr(x, vecs + (uint64_t)nb * dim_, dim_), nb);
+        }
+    }
+}
+
+void DiskVamanaIndex::robustPrune(const float* vecs, uint32_t p, std::vector<Candidate>& candidates, float alpha, std::vector<uint32_t>& out) const {
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end(),
+        [](const Candidate& a, const Candidate& b) { return a.second == b.second; }), candidates.end());
+
+    out.clear();
+    std::vector<bool> pruned(candidates.size(), false);
+    for (uint64_t i = 0; i < candidates.size() && out.size() < R_; ++i) {
+        if (pruned[i] || candidates[i].second == p) {
+            continue;
+        }
+        const uint32_t chosen = candidates[i].second;
+        out.push_back(chosen);
+        const float* v = vecs + (uint64_t)chosen * dim_;
+        // 能从 chosen 以更短的（放宽 alpha 倍的）距离到达的候选不再需要直接相连
+        for (uint64_t j = i + 1; j < candidates.size(); ++j) {
+            if (!pruned[j] && alpha * kernels_->L2sqr(v, vecs + (uint64_t)candidates[j].second * dim_, dim_) <= candidates[j].first) {
+                pruned[j] = true;
+            }
+        }
+    }
+}
+
+void DiskVamanaIndex::buildGraph(const float* vecs, uint64_t n, Graph& graph) const {
+    graph.adj.assign(n, {});
+    graph.locks.clear();
+    for (uint64_t i = 0; i < n; ++i) {
+        graph.locks.emplace_back();
+    }
+
+    // 随机初始图
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<uint32_t> pick(0, n - 1);
+    const uint64_t initDegree = std::min<uint64_t>(R_, n - 1);
+    for (uint64_t i = 0; i < n; ++i) {
+        while (graph.adj[i].size() < initDegree) {
+            uint32_t j = pick(rng);
+            if (j != i && std::find(graph.adj[i].begin(), graph.adj[i].end(), j) == graph.adj[i].end()) {
+                graph.adj[i].push_back(j);
+            }
+        }
+    }
+
+    std::vector<uint32_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    // 先用 alpha = 1 得到稀疏的图，再用 alpha 加入长边
+    std::vector<float> passes = {1.0f};
+    if (alpha_ > 1.0f) {
+        passes.push_back(alpha_);
+    }
+    for (float alpha : passes) {
+#pragma omp parallel for schedule(dynamic, 64)
+        for (int64_t i = 0; i < (int64_t)n; ++i) {
+            const uint32_t p = order[i];
+            const float* x = vecs + (uint64_t)p * dim_;
+            std::vector<Candidate> candidates;
+            greedySearch(vecs, graph, x, candidates);
+            {
+                std::lock_guard<std::mutex> guard(graph.locks[p]);
+                for (uint32_t nb : graph.adj[p]) {
+                    candidates.emplace_back(kernels_->L2sqr(x, vecs + (uint64_t)nb * dim_, dim_), nb);
+                }
+            }
+            std::vector<uint32_t> neighbors;
+            robustPrune(vecs, p, candidates, alpha, neighbors);
+            {
+                std::lock_guard<std::mutex> guard(graph.locks[p]);
+                graph.adj[p] = neighbors;
+            }
+
+            // 加入反向边，邻居的邻接表满了就重新剪边
+            std::vector<uint32_t> pruned;
+            for (uint32_t j : neighbors) {
+                std::lock_guard<std::mutex> guard(graph.locks[j]);
+                std::vector<uint32_t>& adj = graph.adj[j];
+                if (std::find(adj.begin(), adj.end(), p) != adj.end()) {
+                    continue;
+                }
+                if (adj.size() < R_) {
+                    adj.push_back(p);
+                    continue;
+                }
+                const float* y = vecs + (uint64_t)j * dim_;
+                std::vector<Candidate> jCandidates;
+                jCandidates.reserve(adj.size() + 1);
+                for (uint32_t nb : adj) {
+                    jCandidates.emplace_back(kernels_->L2sqr(y, vecs + (uint64_t)nb * dim_, dim_), nb);
+                }
+                jCandidates.emplace_back(kernels_->L2sqr(y, x, dim_), p);
+                robustPrune(vecs, j, jCandidates, alpha, pruned);
+                adj = pruned;
+            }
+        }
+    }
+}
+
+uint64_t DiskVamanaIndex::recordOffset(uint32_t node) const {
+    return kSectorSize + node / nodesPerSector_ * sectorsPerNode_ * kSectorSize + node % nodesPerSector_ * recordSize_;
+}
+
+int DiskVamanaIndex::writeFile(const float* vecs, const Graph& graph, const std::string& filename) const {
+    try {
+        std::filesystem::path dir_path = std::filesystem::path(filename).parent_path();
+        if (!dir_path.empty()) {
+            std::filesystem::create_directories(dir_path);
+        }
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Filesystem error while creating directory: " << e.what() << std::endl;
+        return -1;
+    }
+
+    std::ofstream ofs(filename, std::ios::binary);
+    if (!ofs) {
+        return -1; // 打开文件失败
+    }
+
+    const uint64_t nGroups = (num_ + nodesPerSector_ - 1) / nodesPerSector_;
+    const uint64_t pqOffset = kSectorSize + nGroups * sectorsPerNode_ * kSectorSize;
+
+    // header，单独占一个扇区
+    /*
+        magicNumber + dim + num + R + L + alpha + medoid + recordSize + nodesPerSector + sectorsPerNode + pqOffset
+        之后是节点记录区：每条记录为 dim 个float + 邻居数量(uint32) + R 个邻居(uint32)
+        文件末尾是常驻内存的部分：PQ参数与子中心 + 编码
+    */
+    std::vector<char> sector(kSectorSize, 0);
+    char* h = sector.data();
+    auto put = [&h](const void* p, size_t size) {
+        std::memcpy(h, p, size);
+        h += size;
+    };
+    put(&kMagicNumber, sizeof(uint64_t));
+    put(&dim_, sizeof(uint64_t));
+    put(&num_, sizeof(uint64_t));
+    put(&R_, sizeof(uint64_t));
+    put(&L_, sizeof(uint64_t));
+    put(&alpha_, sizeof(float));
+    put(&medoid_, sizeof(uint32_t));
+    put(&recordSize_, sizeof(uint64_t));
+    put(&nodesPerSector_, sizeof(uint64_t));
+    put(&sectorsPerNode_, sizeof(uint64_t));
+    put(&pqOffset, sizeof(uint64_t));
+    ofs.write(sector.data(), kSectorSize);
+
+    std::vector<char> group(sectorsPerNode_ * kSectorSize);
+    for (uint64_t g = 0; g < nGroups; ++g) {
+        std::fill(group.begin(), group.end(), 0);
+        for (uint64_t r = 0; r < nodesPerSector_; ++r) {
+            const uint64_t node = g * nodesPerSector_ + r;
+            if (node >= num_) {
+                break;
+            }
+            char* rec = group.data() + r * recordSize_;
+            std::memcpy(rec, vecs + node * dim_, dim_ * sizeof(float));
+            const uint32_t degree = graph.adj[node].size();
+            std::memcpy(rec + dim_ * sizeof(float), &degree, sizeof(uint32_t));
+            std::memcpy(rec + dim_ * sizeof(float) + sizeof(uint32_t), graph.adj[node].data(), degree * sizeof(uint32_t));
+        }
+        ofs.write(group.data(), group.size());
+    }
+
+    pq_.write(ofs);
+    ofs.write(reinterpret_cast<const char*>(codes_.data()), codes_.size());
+    if (!ofs) {
+        return -1; // 写入失败
+    }
+    ofs.close();
+    return 0; // 成功
+}
+
+int DiskVamanaIndex::build(const float* vecs, uint64_t n, const std::string filename) {
+    if (n == 0 || n > UINT32_MAX) {
+        throw std::invalid_argument("DiskVamanaIndex: number of vectors must be in [1, 2^32 - 1]");
+    }
+    closeFile();
+    num_ = n;
+    recordSize_ = dim_ * sizeof(float) + (R_ + 1) * sizeof(uint32_t);
+    nodesPerSector_ = std::max<uint64_t>(kSectorSize / recordSize_, 1);
+    sectorsPerNode_ = (recordSize_ + kSectorSize - 1) / kSectorSize;
+
+    // 常驻内存的PQ编码
+    pq_.train(vecs, n);
+    codes_.resize(n * pq_.getCodeSize());
+    pq_.encode(vecs, n, codes_.data());
+
+    medoid_ = findMedoid(vecs, n);
+    Graph graph;
+    buildGraph(vecs, n, graph);
+
+    int ret = writeFile(vecs, graph, filename);
+    if (ret != 0) {
+        return ret;
+    }
+    fd_ = ::open(filename.c_str(), O_RDONLY);
+    return fd_ >= 0 ? 0 : -1;
+}
+
+int DiskVamanaIndex::load(const std::string filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) {
+        return -1; // 打开文件失败
+    }
+
+    uint64_t magicNumber;
+    ifs.read(reinterpret_cast<char*>(&magicNumber), sizeof(uint64_t));
+    if (magicNumber != kMagicNumber) {
+        return -2; // 魔数不匹配
+    }
+    uint64_t pqOffset;
+    ifs.read(reinterpret_cast<char*>(&dim_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&num_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&R_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&L_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&alpha_), sizeof(float));
+    ifs.read(reinterpret_cast<char*>(&medoid_), sizeof(uint32_t));
+    ifs.read(reinterpret_cast<char*>(&recordSize_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&nodesPerSector_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&sectorsPerNode_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&pqOffset), sizeof(uint64_t));
+    if (!ifs || num_ == 0 || num_ > UINT32_MAX || medoid_ >= num_ || nodesPerSector_ == 0 ||
+        recordSize_ != dim_ * sizeof(float) + (R_ + 1) * sizeof(uint32_t)) {
+        return -3; // 文件头损坏
+    }
+
+    ifs.seekg(pqOffset);
+    if (!pq_.read(ifs) || pq_.getDim() != dim_) {
+        return -3; // PQ参数损坏
+    }
+    codes_.resize(num_ * pq_.getCodeSize());
+    ifs.read(reinterpret_cast<char*>(codes_.data()), codes_.size());
+    if (!ifs) {
+        return -3; // 文件不完整
+    }
+    ifs.close();
+
+    closeFile();
+    fd_ = ::open(filename.c_str(), O_RDONLY);
+    return fd_ >= 0 ? 0 : -1;
+}
+
+uint64_t DiskVamanaIndex::getNum() const {
+    return num_;
+}
+
+uint64_t DiskVamanaIndex::getDim() const {
+    return dim_;
+}
+
+void DiskVamanaIndex::setSearchListSize(uint64_t searchL) {
+    searchL_ = std::max<uint64_t>(searchL, 1);
+}
+
+void DiskVamanaIndex::setBeamWidth(uint64_t beamWidth) {
+    beamWidth_ = std::max<uint64_t>(beamWidth, 1);
+}
+
+uint64_t DiskVamanaIndex::getDiskReads() const {
+    return diskReads_.load();
+}
+
+bool DiskVamanaIndex::readNodes(const uint32_t* nodes, uint64_t count, char* buf) const {
+    // 同一批的读取彼此独立，可以替换为 io_uring 一次提交
+    for (uint64_t i = 0; i < count; ++i) {
+        char* dst = buf + i * recordSize_;
+        uint64_t done = 0;
+        while (done < recordSize_) {
+            ssize_t ret = ::pread(fd_, dst + done, recordSize_ - done, recordOffset(nodes[i]) + done);
+            if (ret <= 0) {
+                return false;
+            }
+            done += ret;
+        }
+    }
+    diskReads_ += count;
+    return true;
+}
+
+void DiskVamanaIndex::search(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances
+) {
+    if (nQuery == 0 || k == 0) {
+        return;
+    }
+    if (fd_ < 0) {
+        throw std::runtime_error("DiskVamanaIndex must be built or loaded before searching");
+    }
+    const uint64_t listSize = std::max(searchL_, k);
+    const uint64_t M = pq_.getM();
+    const uint64_t ksub = pq_.getKsub();
+
+#pragma omp parallel for if (nQuery > 1)
+    for (int64_t q = 0; q < (int64_t)nQuery; ++q) {
+        const float* x = query + q * dim_;
+        std::vector<float> table(M * ksub);
+        pq_.computeDistanceTables(x, 1, MetricType::METRIC_L2, table.data());
+
+        VisitedTable& visited = threadVisitedTable(num_);
+        std::vector<ListEntry> list;
+        list.reserve(listSize + 1);
+        visited.visit(medoid_);
+        list.push_back({pq_.adc(table.data(), codes_.data() + (uint64_t)medoid_ * M), medoid_, false});
+
+        cpu_blas::L2Heap exact;
+        std::vector<uint32_t> frontier;
+        std::vector<uint32_t> buf(beamWidth_ * recordSize_ / sizeof(uint32_t));
+        std::vector<float> vec(dim_);
+        while (true) {
+            // 取最近的 beamWidth 个未展开节点，一次读出
+            frontier.clear();
+            for (ListEntry& e : list) {
+                if (!e.expanded) {
+                    e.expanded = true;
+                    frontier.push_back(e.id);
+                    if (frontier.size() >= beamWidth_) {
+                        break;
+                    }
+                }
+            }
+            if (frontier.empty()) {
+                break;
+            }
+            if (!readNodes(frontier.data(), frontier.size(), reinterpret_cast<char*>(buf.data()))) {
+                break;
+            }
+            for (uint64_t i = 0; i < frontier.size(); ++i) {
+                const uint32_t* rec = buf.data() + i * recordSize_ / sizeof(uint32_t);
+                std::memcpy(vec.data(), rec, dim_ * sizeof(float));
+                cpu_blas::heapPush(exact, k, kernels_->L2sqr(x, vec.data(), dim_), frontier[i]);
+
+                const uint32_t degree = std::min<uint32_t>(rec[dim_], R_);
+                const uint32_t* neighbors = rec + dim_ + 1;
+                for (uint32_t j = 0; j < degree; ++j) {
+                    const uint32_t nb = neighbors[j];
+                    if (nb >= num_ || visited.visit(nb)) {
+                        continue;
+                    }
+                    insertEntry(list, listSize, pq_.adc(table.data(), codes_.data() + (uint64_t)nb * M), nb);
+                }
+            }
+        }
+        cpu_blas::heapToOutput(exact, k, HUGE_VALF, distances + q * k, results + q * k);
+    }
+}
+
+void DiskVamanaIndex::reconstruct(
+    uint64_t idx,
+    float* vec
+) {
+    if (idx >= num_ || fd_ < 0) {
+        // 索引超出范围
+        return;
+    }
+    std::vector<uint32_t> buf(recordSize_ / sizeof(uint32_t));
+    const uint32_t node = (uint32_t)idx;
+    if (readNodes(&node, 1, reinterpret_cast<char*>(buf.data()))) {
+        std::memcpy(vec, buf.data(), dim_ * sizeof(float));
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "MetricType.hpp"
+#include "ProductQuantizer.hpp"
+#include "backend/cpu-blas/kernels.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+    磁盘上的 Vamana 图索引（DiskANN 的做法）
+    每个节点的原始向量和邻接表放在一条定长记录中写入磁盘文件，记录按4KB扇区对齐，读一个节点只需要一次 pread；
+    内存中只保留每个向量的PQ编码，几GB内存就可以服务远大于内存的数据集
+
+    查询是 beam search：候选列表按PQ近似距离排序，每一步取最近的 beamWidth 个未展开节点，
+    一批读出它们的记录，用原始向量计算精确距离作为结果，再用邻居的PQ编码更新候选列表
+    最终结果按精确距离排序
+
+    目前只支持L2距离（Vamana 的剪边规则依赖三角不等式）；search 可以多线程同时调用
+*/
+class DiskVamanaIndex
+{
+    public:
+        DiskVamanaIndex(uint64_t dim, uint64_t R = 32, uint64_t L = 64, float alpha = 1.2f, uint64_t pqM = 0);
+        ~DiskVamanaIndex();
+
+        DiskVamanaIndex(const DiskVamanaIndex&) = delete;
+        DiskVamanaIndex& operator=(const DiskVamanaIndex&) = delete;
+
+        /*
+            在内存中构建图并写入 filename，之后以只读方式打开该文件用于查询
+            vecs 只在构建期间使用，构建完成后内存中只保留PQ编码
+        */
+        int build(const float* vecs, uint64_t n, const std::string filename);
+        // 打开已经构建好的索引文件
+        int load(const std::string filename);
+
+        // 获取向量数量
+        uint64_t getNum() const;
+        // 获取向量维度
+        uint64_t getDim() const;
+
+        // 查询时候选列表的大小，越大越准确，实际使用 max(searchL, k)
+        void setSearchListSize(uint64_t searchL);
+        // 每一步同时读取的节点数
+        void setBeamWidth(uint64_t beamWidth);
+        // 累计读取的节点记录数，用于观察每个查询的IO次数
+        uint64_t getDiskReads() const;
+
+        // 查询nQuery个向量并返回前k个匹配的向量
+        void search(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances
+        );
+
+        // 从磁盘读取原始向量
+        void reconstruct(
+            uint64_t idx,
+            float* vec
+        );
+
+    private:
+        using Candidate = std::pair<float, uint32_t>;   // (距离, 节点)
+
+        // 构建期间的内存中的图
+        struct Graph;
+        uint32_t findMedoid(const float* vecs, uint64_t n) const;
+        void buildGraph(const float* vecs, uint64_t n, Graph& graph) const;
+        // 在内存图上贪心搜索，返回展开过的节点
+        void greedySearch(const float* vecs, const Graph& graph, const float* x, std::vector<Candidate>& expanded) const;
+        // 剪边：保留离 p 近、且不能经由已选邻居以 alpha 倍距离到达的候选
+        void robustPrune(const float* vecs, uint32_t p, std::vector<Candidate>& candidates, float alpha, std::vector<uint32_t>& out) const;
+        int writeFile(const float* vecs, const Graph& graph, const std::string& filename) const;
+
+        // 节点记录在文件中的位置
+        uint64_t recordOffset(uint32_t node) const;
+        // 批量读取节点记录，buf 中每条记录占 recordSize_ 字节
+        bool readNodes(const uint32_t* nodes, uint64_t count, char* buf) const;
+        void closeFile();
+
+        uint64_t dim_;                      // 向量维度
+        uint64_t R_;                        // 每个节点的最大邻居数
+        uint64_t L_;                        // 构建时候选列表的大小
+        float alpha_;                       // 剪边的放宽系数
+        uint64_t searchL_;                  // 查询时候选列表的大小
+        uint64_t beamWidth_;                // 每一步读取的节点数
+        uint64_t num_;                      // 向量数量
+        uint32_t medoid_;                   // 搜索的起点，离全体向量中心最近的节点
+        uint64_t recordSize_;               // 每条节点记录的字节数：dim 个float + 邻居数量 + R 个邻居
+        uint64_t nodesPerSector_;           // 每个扇区放多少条记录
+        uint64_t sectorsPerNode_;           // 记录大于一个扇区时每条记录占用的扇区数
+        ProductQuantizer pq_;               // 内存中用于近似距离的编码器
+        std::vector<uint8_t> codes_;        // num_ * M 字节的PQ编码
+        int fd_;                            // 只读打开的索引文件
+        const cpu_blas::DistanceKernels* kernels_;      // 距离计算内核
+        mutable std::atomic<uint64_t> diskReads_;       // 累计读取的节点记录数
+};
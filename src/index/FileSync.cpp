@@ -0,0 +1,55 @@
+#include "index/FileSync.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool syncFd(int fd) {
+#if defined(__APPLE__)
+    return ::fsync(fd) == 0;
+#else
+    return ::fdatasync(fd) == 0;
+#endif
+}
+
+bool syncFile(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = syncFd(fd);
+    ::close(fd);
+    return ok;
+}
+
+namespace {
+
+// 目录项的修改（改名、删除）需要对所在的目录本身 fsync
+bool syncParentDir(const std::string& filename) {
+    std::string dir = std::filesystem::path(filename).parent_path().string();
+    int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+} // namespace
+
+bool renameDurable(const std::string& from, const std::string& to) {
+    if (std::rename(from.c_str(), to.c_str()) != 0) {
+        return false;
+    }
+    return syncParentDir(to);
+}
+
+bool removeDurable(const std::string& filename) {
+    if (std::remove(filename.c_str()) != 0) {
+        return errno == ENOENT;
+    }
+    return syncParentDir(filename);
+}
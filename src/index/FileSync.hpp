@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+/*
+    文件落盘的辅助函数，索引快照和预写日志共用
+    用改名替换文件时，新文件的数据要先落盘再改名，改名之后还要同步所在的目录，
+    否则崩溃后可能看到改过名但数据不完整的文件，或者改名本身丢失
+*/
+
+// 把 fd 的数据落盘，返回是否成功
+bool syncFd(int fd);
+// 打开 filename 并把它的数据落盘
+bool syncFile(const std::string& filename);
+// 把 from 改名为 to，并同步 to 所在的目录，使改名在崩溃后仍然有效
+bool renameDurable(const std::string& from, const std::string& to);
+// 删除 filename 并同步所在的目录，文件不存在时也算成功
+bool removeDurable(const std::string& filename);
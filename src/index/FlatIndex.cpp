@@ -2,6 +2,9 @@
 #include "backend/cpu-blas/distance.hpp"
 #include "backend/gpu-kompute/distance.hpp"
 #include "backend/npu-hexagon/distance.hpp"
+#include "backend/cpu-blas/kernels.hpp"
+#include "backend/cpu-blas/heap.hpp"
+#include "index/FileSync.hpp"
 
 #include <android/log.h>
 
@@ -18,17 +21,59 @@ kp::Manager AllMgr;
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
 
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
 #include <vector>
 #include <thread>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+namespace {
+
+const uint64_t kLegacyMagic = 1145;     // 旧格式：各部分紧挨着存放；同时作为 v2 格式中的索引类型
+const uint64_t kAlignedMagic = 1146;    // 数据和范数按页对齐，可以 mmap
+const uint64_t kSectionAlign = 4096;
+
+uint64_t alignUp(uint64_t offset) {
+    return (offset + kSectionAlign - 1) / kSectionAlign * kSectionAlign;
+}
+
+// 计算范数时超过该元素数才按向量并行
+const uint64_t kParallelNormElems = 1 << 16;
+
+// v2 格式 META 段的内容，以后增加的字段追加在末尾
+struct FlatIndexMeta {
+    uint64_t dim;
+    uint64_t num;
+    uint32_t storageType;
+    uint32_t metricType;
+    uint64_t walSequence;       // 快照包含的最后一条日志记录的序号，较早的文件没有该字段
+};
+// 较早的 META 段只有前面的字段
+const uint64_t kMinMetaSize = offsetof(FlatIndexMeta, walSequence);
+
+// 预写日志中的记录类型
+enum WalRecord : uint32_t {
+    WAL_ADD = 1,                // count 个向量
+    WAL_ADD_WITH_IDS = 2,       // count 个标签，之后是 count 个向量
+    WAL_REMOVE = 3,             // count 个编号，含义与 removeIds 相同
+    WAL_COMPACT = 4,
+};
+
+} // namespace
+
 FlatIndex::FlatIndex(uint64_t dim, uint64_t capacity, bool isFloat16, MetricType metricType, kp::Manager* mgr)
-        : dim_(dim), num_(0), capacity_(capacity), isFloat16_(isFloat16), metricType_(metricType), realMgr_() {
+        : FlatIndex(dim, capacity, isFloat16 ? StorageType::STORAGE_FP16 : StorageType::STORAGE_FP32, metricType, mgr) {
+}
+
+FlatIndex::FlatIndex(uint64_t dim, uint64_t capacity, StorageType storageType, MetricType metricType, kp::Manager* mgr)
+        : dim_(dim), num_(0), storageType_(storageType), metricType_(metricType), realMgr_() {
     // this->realMgr_ = kp::Manager();
     this->mgr_ = &this->realMgr_; // 使用实际的Kompute管理器实例
-    data_.resize(capacity * dim);
-    dataNorm_.resize(capacity * dim); // 初始化Norm数据
+    this->resetStorage();
+    storage_.reserve(capacity);
 }
 
 FlatIndex::FlatIndex(uint64_t dim, kp::Manager* mgr, MetricType metricType): realMgr_() {
@@ -37,30 +82,131 @@ FlatIndex::FlatIndex(uint64_t dim, kp::Manager* mgr, MetricType metricType): rea
     this->mgr_ = &this->realMgr_; // 使用实际的Kompute管理器实例
     dim_ = dim;
     num_ = 0;
-    capacity_ = 0;              // 默认容量
-    isFloat16_ = false;         // 默认不使用 float16 存储
+    storageType_ = StorageType::STORAGE_FP32; // 默认使用 float32 存储
     metricType_ = metricType; // 默认使用内积度量
     mgr_ = mgr;                 // 默认不使用Kompute管理器
-    data_.clear();              // 清空数据
-    dataNorm_.clear();          // 清空Norm数据
+    this->resetStorage();       // 空的存储，添加向量时再分配
+}
+
+void FlatIndex::resetStorage() {
+    const uint64_t elemSize = storageType_ != StorageType::STORAGE_FP32 ? sizeof(uint16_t) : sizeof(float);
+    storage_.init(dim_ * elemSize, chunkBytes);
+}
+
+void FlatIndex::encodeRows(uint16_t* dst, const float* src, uint64_t n) const {
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+    if (storageType_ == StorageType::STORAGE_BF16) {
+        kernels.fp32_to_bf16(dst, src, n);
+    } else {
+        kernels.fp32_to_fp16(dst, src, n);
+    }
+}
+
+void FlatIndex::decodeRows(float* dst, const uint16_t* src, uint64_t n) const {
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+    if (storageType_ == StorageType::STORAGE_BF16) {
+        kernels.bf16_to_fp32(dst, src, n);
+    } else {
+        kernels.fp16_to_fp32(dst, src, n);
+    }
 }
 
 void FlatIndex::addVector(const float* vecs, uint64_t n) {
-    while ((num_ + n) >= capacity_)
-        capacity_ = capacity_ == 0 ? 1 : capacity_ * 2; // 扩展容量，至少为1
-    
-    data_.resize(capacity_ * dim_);
-    dataNorm_.resize(capacity_ * dim_);
-    std::copy(vecs, vecs + n * dim_, data_.data() + num_ * dim_);
-    
-    // 预计算每个向量的Norm数据
+    if (!labels_.empty()) {
+        throw std::invalid_argument("Index uses external ids, use addVectorWithIds");
+    }
+    this->appendRows(vecs, n);
+    this->logWal(WAL_ADD, n, vecs, n * dim_ * sizeof(float));
+}
+
+void FlatIndex::addVectorWithIds(const float* vecs, const uint64_t* ids, uint64_t n) {
+    if (labels_.size() != num_) {
+        throw std::invalid_argument("Index already has vectors without external ids");
+    }
     for (uint64_t i = 0; i < n; ++i) {
-        for (uint64_t j = 0; j < dim_; ++j) {
-            dataNorm_[num_ + i] += vecs[i * dim_ + j] * vecs[i * dim_ + j]; // 计算平方和
+        if (ids[i] == UINT64_MAX) {
+            throw std::invalid_argument("External id UINT64_MAX is reserved");
         }
     }
-    
+    const uint64_t first = num_;
+    this->appendRows(vecs, n);
+
+    labels_.insert(labels_.end(), ids, ids + n);
+    labelToRow_.reserve(labelToRow_.size() + n);
+    for (uint64_t i = 0; i < n; ++i) {
+        auto [it, inserted] = labelToRow_.try_emplace(ids[i], first + i);
+        if (!inserted) {
+            // 已有的标签：删除旧的行，指向新的行
+            removed_.set(it->second);
+            it->second = first + i;
+        }
+    }
+    this->logWal(WAL_ADD_WITH_IDS, n, ids, n * sizeof(uint64_t), vecs, n * dim_ * sizeof(float));
+}
+
+bool FlatIndex::hasIds() const {
+    return num_ > 0 && !labels_.empty();
+}
+
+uint64_t FlatIndex::getRow(uint64_t id) const {
+    if (labels_.empty()) {
+        return id < num_ && !removed_.test(id) ? id : UINT64_MAX;
+    }
+    auto it = labelToRow_.find(id);
+    return it == labelToRow_.end() ? UINT64_MAX : it->second;
+}
+
+uint64_t FlatIndex::getId(uint64_t row) const {
+    if (row >= num_) {
+        return UINT64_MAX;
+    }
+    return labels_.empty() ? row : labels_[row];
+}
+
+void FlatIndex::appendRows(const float* vecs, uint64_t n) {
+    if (num_ == 0 && storage_.getChunkBytes() != chunkBytes) {
+        this->resetStorage();   // 空索引按新的块大小分配
+        mapping_.reset();
+    }
+    // 只分配新的块（或增长未满的最后一个块），已有的向量不会移动；映射的数据保持只读，不会被复制
+    storage_.reserve(num_ + n);
+    for (uint64_t i = 0; i < n;) {
+        const uint64_t row = num_ + i;
+        const uint64_t len = std::min(n - i, storage_.contiguous(row));
+        if (storageType_ != StorageType::STORAGE_FP32) {
+            // 16位存储：写入时完成转换
+            encodeRows(reinterpret_cast<uint16_t*>(storage_.mutableRow(row)), vecs + i * dim_, len * dim_);
+        } else {
+            std::copy(vecs + i * dim_, vecs + (i + len) * dim_, reinterpret_cast<float*>(storage_.mutableRow(row)));
+        }
+        i += len;
+    }
+    this->computeNorms(num_, n);
+
     num_ += n;
+    removed_.resize(num_);
+}
+
+void FlatIndex::computeNorms(uint64_t first, uint64_t n) {
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+    const int64_t count = static_cast<int64_t>(n);
+    if (storageType_ != StorageType::STORAGE_FP32) {
+        // 范数按转换后的值计算，保证与检索时读到的数据一致
+#pragma omp parallel if (n * dim_ > kParallelNormElems)
+        {
+            std::vector<float> row(dim_);
+#pragma omp for
+            for (int64_t i = 0; i < count; ++i) {
+                decodeRows(row.data(), rowData16(first + i), dim_);
+                *storage_.mutableNorm(first + i) = kernels.norm_L2sqr(row.data(), dim_);
+            }
+        }
+    } else {
+#pragma omp parallel for if (n * dim_ > kParallelNormElems)
+        for (int64_t i = 0; i < count; ++i) {
+            *storage_.mutableNorm(first + i) = kernels.norm_L2sqr(rowData(first + i), dim_);
+        }
+    }
 }
 
 uint64_t FlatIndex::getNum() const {
@@ -72,11 +218,58 @@ uint64_t FlatIndex::getDim() const {
 }
 
 uint64_t FlatIndex::getCapacity() const {
-    return capacity_;
+    return storage_.capacity();
 }
 
 bool FlatIndex::isFloat16() const {
-    return isFloat16_;
+    return storageType_ == StorageType::STORAGE_FP16;
+}
+
+StorageType FlatIndex::getStorageType() const {
+    return storageType_;
+}
+
+// 后端返回的是区间内的下标，加上区间起点得到全局下标；不足k个时的填充值保持不变
+static void offsetResults(uint64_t start, uint64_t n, uint64_t* results) {
+    if (start == 0) {
+        return;
+    }
+    for (uint64_t i = 0; i < n; ++i) {
+        if (results[i] != UINT64_MAX) {
+            results[i] += start;
+        }
+    }
+}
+
+// 把另一段数据的结果（chunkResults / chunkDistances）合并进每个查询的前k个结果，距离相同时保留先出现的
+static void mergeResults(
+    uint64_t k,
+    uint64_t nQuery,
+    bool isIP,
+    const uint64_t* chunkResults,
+    const float* chunkDistances,
+    uint64_t* results,
+    float* distances
+) {
+#pragma omp parallel for if (nQuery > 1)
+    for (int64_t q = 0; q < (int64_t)nQuery; ++q) {
+        auto merge = [&](auto& heap, float emptyDistance) {
+            for (uint64_t j = 0; j < k && results[q * k + j] != cpu_blas::kInvalidIndex; ++j) {
+                cpu_blas::heapPush(heap, k, distances[q * k + j], results[q * k + j]);
+            }
+            for (uint64_t j = 0; j < k && chunkResults[q * k + j] != cpu_blas::kInvalidIndex; ++j) {
+                cpu_blas::heapPush(heap, k, chunkDistances[q * k + j], chunkResults[q * k + j]);
+            }
+            cpu_blas::heapToOutput(heap, k, emptyDistance, distances + q * k, results + q * k);
+        };
+        if (isIP) {
+            cpu_blas::IPHeap heap;
+            merge(heap, -HUGE_VALF);
+        } else {
+            cpu_blas::L2Heap heap;
+            merge(heap, HUGE_VALF);
+        }
+    }
 }
 
 // 在指定设备上，对数据库的指定范围 [start,end) 进行查询
@@ -90,7 +283,87 @@ void FlatIndex::query(
     uint64_t* results,
     float* distances
 ) {
-    float* dataNorm = dataNorm_.empty() ? nullptr : dataNorm_.data();
+    this->queryRange(k, start, end, device, nQuery, query, results, distances, removed_);
+}
+
+void FlatIndex::queryRange(
+    uint64_t k,
+    uint64_t start,
+    uint64_t end,
+    DeviceType device,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances,
+    const Bitmap& skip
+) {
+    const bool isIP = metricType_ == MetricType::METRIC_INNER_PRODUCT;
+    if (start >= end) {
+        // 空区间：按 heapToOutput 的约定填充
+        std::fill(results, results + nQuery * k, cpu_blas::kInvalidIndex);
+        std::fill(distances, distances + nQuery * k, isIP ? -HUGE_VALF : HUGE_VALF);
+        return;
+    }
+    // 第一块直接写入输出，之后每块的结果再合并进来
+    uint64_t chunkEnd = std::min(end, start + storage_.contiguous(start));
+    this->queryChunk(k, start, chunkEnd, device, nQuery, query, results, distances, skip);
+    if (chunkEnd == end) {
+        return;
+    }
+    std::vector<uint64_t> chunkResults(nQuery * k);
+    std::vector<float> chunkDistances(nQuery * k);
+    for (uint64_t i = chunkEnd; i < end; i = chunkEnd) {
+        chunkEnd = std::min(end, i + storage_.contiguous(i));
+        this->queryChunk(k, i, chunkEnd, device, nQuery, query, chunkResults.data(), chunkDistances.data(), skip);
+        mergeResults(k, nQuery, isIP, chunkResults.data(), chunkDistances.data(), results, distances);
+    }
+}
+
+void FlatIndex::queryChunk(
+    uint64_t k,
+    uint64_t start,
+    uint64_t end,
+    DeviceType device,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances,
+    const Bitmap& skip
+) {
+    const float* dataNorm = normData(start);
+    // 有需要跳过的行时交给后端在 top-k 阶段跳过，位图按全局行号存放，偏移为区间起点
+    RowFilter skipFilter{skip.data(), start};
+    const RowFilter* filter = skip.count() > 0 ? &skipFilter : nullptr;
+    if (storageType_ != StorageType::STORAGE_FP32 && device == DeviceType::CPU_BLAS) {
+        // CPU直接读取16位数据，在内核中完成转换
+        auto queryFn = storageType_ == StorageType::STORAGE_BF16 ? cpu_blas::queryBF16 : cpu_blas::queryFP16;
+        queryFn(
+            nQuery,
+            end - start,
+            k,
+            this->dim_,
+            query,
+            rowData16(start),
+            dataNorm,
+            distances,
+            results,
+            metricType_,
+            nullptr,
+            filter
+        );
+        offsetResults(start, nQuery * k, results);
+        return;
+    }
+
+    // GPU/NPU 的内核只接受单精度数据，16位存储时先把这一段转换出来
+    std::vector<float> converted;
+    const float* data = rowData(start);
+    if (storageType_ != StorageType::STORAGE_FP32) {
+        converted.resize((end - start) * dim_);
+        decodeRows(converted.data(), rowData16(start), converted.size());
+        data = converted.data();
+    }
+
     if (device == DeviceType::CPU_BLAS) {
         cpu_blas::query(
             nQuery,
@@ -98,11 +371,13 @@ void FlatIndex::query(
             k,
             this->dim_,
             query,
-            this->data_.data() + start * dim_,
-            dataNorm + start * dim_,
+            data,
+            dataNorm,
             distances,
             results,
-            metricType_
+            metricType_,
+            nullptr,
+            filter
         );
     }
     else if (device == DeviceType::GPU_KOMPUTE) {
@@ -113,12 +388,13 @@ void FlatIndex::query(
             k,
             this->dim_,
             query,
-            this->data_.data() + start * dim_,
-            dataNorm + start * dim_,
+            data,
+            dataNorm,
             distances,
             results,
             metricType_,
-            nullptr
+            nullptr,
+            filter
         );
     } else if (device == DeviceType::NPU_HEXAGON) {
 		npu_hexagon::query(
@@ -127,15 +403,90 @@ void FlatIndex::query(
             k,
             this->dim_,
             query,
-            this->data_.data() + start * dim_,
-            dataNorm + start * dim_,
+            data,
+            dataNorm,
             distances,
             results,
-            metricType_
+            metricType_,
+            nullptr,
+            filter
         );
 	} else {
 		throw std::invalid_argument("Unsupported device type for query");
 	}
+    offsetResults(start, nQuery * k, results);
+}
+
+void FlatIndex::treeSearch(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances,
+    const Bitmap& skip
+) {
+    std::shared_ptr<const KDTreeIndex> tree;
+    {
+        std::lock_guard<std::mutex> lock(treeMutex_);
+        if (!tree_ || tree_->getNum() > num_ || num_ - tree_->getNum() > tree_->getNum() / 8) {
+            auto rebuilt = std::make_shared<KDTreeIndex>(dim_, metricType_);
+            if (num_ > 0 && storage_.contiguous(0) < num_) {
+                // 数据跨越多个块：KD树本身会复制一份数据，这里先临时拼接成连续的
+                std::vector<float> rows(num_ * dim_);
+                for (uint64_t i = 0; i < num_;) {
+                    const uint64_t len = std::min(num_ - i, storage_.contiguous(i));
+                    std::copy(rowData(i), rowData(i) + len * dim_, rows.data() + i * dim_);
+                    i += len;
+                }
+                rebuilt->build(rows.data(), num_);
+            } else {
+                rebuilt->build(num_ > 0 ? rowData(0) : nullptr, num_);
+            }
+            tree_ = rebuilt;
+        }
+        tree = tree_;
+    }
+    RowFilter skipFilter{skip.data(), 0};
+    const RowFilter* filter = skip.count() > 0 ? &skipFilter : nullptr;
+    tree->search(k, nQuery, query, results, distances, filter);
+
+    // 建树之后新增的向量直接扫描，与树的结果合并
+    const uint64_t treeNum = tree->getNum();
+    if (treeNum == num_) {
+        return;
+    }
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+    const bool isIP = metricType_ == MetricType::METRIC_INNER_PRODUCT;
+#pragma omp parallel for if (nQuery > 1)
+    for (int64_t q = 0; q < (int64_t)nQuery; ++q) {
+        const float* x = query + q * dim_;
+        std::vector<float> dis;
+        auto merge = [&](auto& heap, float emptyDistance) {
+            for (uint64_t j = 0; j < k && results[q * k + j] != cpu_blas::kInvalidIndex; ++j) {
+                heap.emplace(distances[q * k + j], results[q * k + j]);
+            }
+            // 按块扫描
+            for (uint64_t i = treeNum; i < num_;) {
+                const uint64_t len = std::min(num_ - i, storage_.contiguous(i));
+                dis.resize(len);
+                if (isIP) {
+                    kernels.inner_products_ny(dis.data(), x, rowData(i), dim_, len);
+                } else {
+                    kernels.L2sqr_ny(dis.data(), x, rowData(i), dim_, len);
+                }
+                cpu_blas::heapPushLine(heap, k, dis.data(), len, i, filter);
+                i += len;
+            }
+            cpu_blas::heapToOutput(heap, k, emptyDistance, distances + q * k, results + q * k);
+        };
+        if (isIP) {
+            cpu_blas::IPHeap heap;
+            merge(heap, -HUGE_VALF);
+        } else {
+            cpu_blas::L2Heap heap;
+            merge(heap, HUGE_VALF);
+        }
+    }
 }
 
 void FlatIndex::search(
@@ -145,6 +496,220 @@ void FlatIndex::search(
     uint64_t* results,
     float* distances
 ) {
+    this->searchRows(k, nQuery, query, results, distances, removed_);
+    this->rowsToLabels(results, nQuery * k);
+}
+
+void FlatIndex::rowsToLabels(uint64_t* results, uint64_t n) const {
+    if (labels_.empty()) {
+        return;
+    }
+    // 不足k个时的填充值保持不变
+    for (uint64_t i = 0; i < n; ++i) {
+        if (results[i] < num_) {
+            results[i] = labels_[results[i]];
+        }
+    }
+}
+
+void FlatIndex::search(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances,
+    const IDSelector& selector
+) {
+    Bitmap selected;
+    this->selectRows(selector, selected);
+
+    if (selected.count() <= filterGatherRatio * num_) {
+        // 选中的行很少：只计算这些行，不必扫描整个数据库
+        std::vector<uint64_t> rows;
+        rows.reserve(selected.count());
+        const uint64_t* words = selected.data();
+        for (uint64_t w = 0; w < selected.numWords(); ++w) {
+            for (uint64_t bits = words[w]; bits != 0; bits &= bits - 1) {
+                rows.push_back(w * 64 + __builtin_ctzll(bits));
+            }
+        }
+        this->gatherSearch(k, nQuery, query, rows, results, distances);
+    } else {
+        // 未选中的行（包括墓碑）和删除一样在 top-k 阶段跳过
+        uint64_t* words = selected.data();
+        for (uint64_t w = 0; w < selected.numWords(); ++w) {
+            words[w] = ~words[w];
+        }
+        if (num_ % 64 != 0) {
+            words[selected.numWords() - 1] &= (1ull << (num_ % 64)) - 1;
+        }
+        selected.recount();
+        this->searchRows(k, nQuery, query, results, distances, selected);
+    }
+    this->rowsToLabels(results, nQuery * k);
+}
+
+void FlatIndex::rangeSearch(
+    uint64_t nQuery,
+    const float* query,
+    float radius,
+    RangeSearchResult& result
+) {
+    // 在一块连续存放的行 [start, start + n) 上查询，结果中的编号是块内的下标
+    auto rangeChunk = [&](uint64_t start, uint64_t n, RangeSearchResult& out) {
+        RowFilter removedFilter{removed_.data(), start};
+        const RowFilter* filter = removed_.count() > 0 ? &removedFilter : nullptr;
+        if (storageType_ != StorageType::STORAGE_FP32) {
+            auto rangeFn = storageType_ == StorageType::STORAGE_BF16 ? cpu_blas::rangeQueryBF16 : cpu_blas::rangeQueryFP16;
+            rangeFn(nQuery, n, dim_, query, rowData16(start), normData(start), radius, metricType_, out, filter);
+        } else {
+            cpu_blas::rangeQuery(nQuery, n, dim_, query, rowData(start), normData(start), radius, metricType_, out, filter);
+        }
+    };
+
+    if (num_ == 0) {
+        result.lims.assign(nQuery + 1, 0);
+        result.labels.clear();
+        result.distances.clear();
+        return;
+    }
+    if (storage_.contiguous(0) >= num_) {
+        rangeChunk(0, num_, result);
+    } else {
+        // 跨越多个块：逐块查询，每个查询的结果按块的顺序连接起来，仍然按行号升序
+        std::vector<uint64_t> starts;
+        std::vector<RangeSearchResult> parts;
+        for (uint64_t i = 0; i < num_;) {
+            const uint64_t len = std::min(num_ - i, storage_.contiguous(i));
+            starts.push_back(i);
+            parts.emplace_back();
+            rangeChunk(i, len, parts.back());
+            i += len;
+        }
+        result.lims.assign(nQuery + 1, 0);
+        for (uint64_t q = 0; q < nQuery; ++q) {
+            result.lims[q + 1] = result.lims[q];
+            for (const RangeSearchResult& part : parts) {
+                result.lims[q + 1] += part.lims[q + 1] - part.lims[q];
+            }
+        }
+        result.labels.resize(result.lims[nQuery]);
+        result.distances.resize(result.lims[nQuery]);
+#pragma omp parallel for if (nQuery > 1)
+        for (int64_t q = 0; q < (int64_t)nQuery; ++q) {
+            uint64_t pos = result.lims[q];
+            for (size_t p = 0; p < parts.size(); ++p) {
+                for (uint64_t j = parts[p].lims[q]; j < parts[p].lims[q + 1]; ++j, ++pos) {
+                    result.labels[pos] = parts[p].labels[j] + starts[p];
+                    result.distances[pos] = parts[p].distances[j];
+                }
+            }
+        }
+    }
+    this->rowsToLabels(result.labels.data(), result.labels.size());
+}
+
+void FlatIndex::selectRows(const IDSelector& selector, Bitmap& selected) const {
+    selected.resize(0);
+    selected.resize(num_);
+    uint64_t* words = selected.data();
+
+    if (!labels_.empty()) {
+        // 标签是稀疏的：编号列表逐个查找行号，其余形式逐行判断标签
+        if (selector.getType() == IDSelector::Type::SORTED_LIST) {
+            for (uint64_t i = 0; i < selector.getSize(); ++i) {
+                uint64_t row = this->getRow(selector.getData()[i]);
+                if (row != UINT64_MAX) {
+                    selected.set(row);
+                }
+            }
+        } else {
+            for (uint64_t i = 0; i < num_; ++i) {
+                if (selector.contains(labels_[i])) {
+                    selected.set(i);
+                }
+            }
+        }
+    } else if (selector.getType() == IDSelector::Type::BITSET) {
+        // 行号与位号一致，按字复制
+        uint64_t nbits = std::min(selector.getSize(), num_);
+        std::copy(selector.getData(), selector.getData() + nbits / 64, words);
+        if (nbits % 64 != 0) {
+            words[nbits / 64] = selector.getData()[nbits / 64] & ((1ull << (nbits % 64)) - 1);
+        }
+    } else if (selector.getType() == IDSelector::Type::SORTED_LIST) {
+        for (uint64_t i = 0; i < selector.getSize() && selector.getData()[i] < num_; ++i) {
+            selected.set(selector.getData()[i]);
+        }
+    } else {
+        for (uint64_t i = selector.getBegin(); i < std::min(selector.getEnd(), num_); ++i) {
+            selected.set(i);
+        }
+    }
+
+    // 去掉已删除的行
+    const uint64_t* removedWords = removed_.data();
+    for (uint64_t w = 0; w < selected.numWords(); ++w) {
+        words[w] &= ~removedWords[w];
+    }
+    selected.recount();
+}
+
+void FlatIndex::gatherSearch(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    const std::vector<uint64_t>& rows,
+    uint64_t* results,
+    float* distances
+) const {
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+    const bool isIP = metricType_ == MetricType::METRIC_INNER_PRODUCT;
+    // 16位存储直接用读取16位数据的内核
+    auto distNy16 = storageType_ == StorageType::STORAGE_BF16
+        ? (isIP ? kernels.inner_products_ny_bf16 : kernels.L2sqr_ny_bf16)
+        : (isIP ? kernels.inner_products_ny_fp16 : kernels.L2sqr_ny_fp16);
+#pragma omp parallel for if (nQuery > 1)
+    for (int64_t q = 0; q < (int64_t)nQuery; ++q) {
+        const float* x = query + q * dim_;
+        auto scan = [&](auto& heap, float emptyDistance) {
+            for (uint64_t r : rows) {
+                float dis;
+                if (storageType_ != StorageType::STORAGE_FP32) {
+                    distNy16(&dis, x, rowData16(r), dim_, 1);
+                } else if (isIP) {
+                    dis = kernels.inner_product(x, rowData(r), dim_);
+                } else {
+                    dis = kernels.L2sqr(x, rowData(r), dim_);
+                }
+                cpu_blas::heapPush(heap, k, dis, r);
+            }
+            cpu_blas::heapToOutput(heap, k, emptyDistance, distances + q * k, results + q * k);
+        };
+        if (isIP) {
+            cpu_blas::IPHeap heap;
+            scan(heap, -HUGE_VALF);
+        } else {
+            cpu_blas::L2Heap heap;
+            scan(heap, HUGE_VALF);
+        }
+    }
+}
+
+void FlatIndex::searchRows(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances,
+    const Bitmap& skip
+) {
+    // 低维数据不适合矩阵乘法，改用KD树
+    if (dim_ <= treeMaxDim && storageType_ == StorageType::STORAGE_FP32) {
+        this->treeSearch(k, nQuery, query, results, distances, skip);
+        return;
+    }
+
     // 在这一层进行调度
     // 如果nQ * nY > 10000，则使用GPU，否则使用CPU
     uint64_t nData = num_;
@@ -152,7 +717,7 @@ void FlatIndex::search(
 
     if (nQuery * nData <= threshold) {
         // 计算量小的情况下，直接调用CPU完成计算并返回结果
-        this->query(
+        this->queryRange(
             k,
             0,
             nData,
@@ -160,24 +725,26 @@ void FlatIndex::search(
             nQuery,
             query,
             results,
-            distances
+            distances,
+            skip
         );
 
         return;
     }
 
     /**
-     * 进行调度计算，保证每个后端的data的数量均满足>=k，这样为每个计算后端
-     * 预先分配的中间结果临时空间会直接填满，不会有空闲空间，方便后续汇总
-     * 处理
+     * 每个计算后端的中间结果按 heapToOutput 的约定预先填充为空结果（kInvalidIndex、最差的距离），
+     * 数据量很小时某些后端分到的范围为空、不会运行，删除或过滤之后运行的后端也可能不足k个结果，
+     * 这些空位在汇总排序时排在最后，不会被当成第0行、距离为0的结果
      */
-    std::vector<uint64_t> resultsTmpCPU(nQuery * k, 0);
-    std::vector<uint64_t> resultsTmpGPU(nQuery * k, 0);
-    std::vector<uint64_t> resultsTmpNPU(nQuery * k, 0);
-    
-    std::vector<float> distancesTmpCPU(nQuery * k, 0.0f);
-    std::vector<float> distancesTmpGPU(nQuery * k, 0.0f);
-    std::vector<float> distancesTmpNPU(nQuery * k, 0.0f);
+    const float emptyDistance = metricType_ == MetricType::METRIC_INNER_PRODUCT ? -HUGE_VALF : HUGE_VALF;
+    std::vector<uint64_t> resultsTmpCPU(nQuery * k, cpu_blas::kInvalidIndex);
+    std::vector<uint64_t> resultsTmpGPU(nQuery * k, cpu_blas::kInvalidIndex);
+    std::vector<uint64_t> resultsTmpNPU(nQuery * k, cpu_blas::kInvalidIndex);
+
+    std::vector<float> distancesTmpCPU(nQuery * k, emptyDistance);
+    std::vector<float> distancesTmpGPU(nQuery * k, emptyDistance);
+    std::vector<float> distancesTmpNPU(nQuery * k, emptyDistance);
 
 	uint64_t cpu_start;
     uint64_t cpu_end;
@@ -226,7 +793,7 @@ void FlatIndex::search(
     if (gpu_start != UINT64_MAX && gpu_end > gpu_start) {
         gpu_thread = std::thread(
             [&](){
-                this->query(k, gpu_start, gpu_end, DeviceType::GPU_KOMPUTE, nQuery, query, resultsTmpGPU.data(), distancesTmpGPU.data());
+                this->queryRange(k, gpu_start, gpu_end, DeviceType::GPU_KOMPUTE, nQuery, query, resultsTmpGPU.data(), distancesTmpGPU.data(), skip);
             }
         );
     }
@@ -235,7 +802,7 @@ void FlatIndex::search(
     if (cpu_start != UINT64_MAX && cpu_end > cpu_start) {
         cpu_thread = std::thread(
             [&](){
-                this->query(k, cpu_start, cpu_end, DeviceType::CPU_BLAS, nQuery, query, resultsTmpCPU.data(), distancesTmpCPU.data());
+                this->queryRange(k, cpu_start, cpu_end, DeviceType::CPU_BLAS, nQuery, query, resultsTmpCPU.data(), distancesTmpCPU.data(), skip);
             }
         );
     }
@@ -243,7 +810,7 @@ void FlatIndex::search(
     if (npu_start != UINT64_MAX && npu_end > npu_start) {
         npu_thread = std::thread(
             [&](){
-                this->query(k, npu_start, npu_end, DeviceType::NPU_HEXAGON, nQuery, query, resultsTmpNPU.data(), distancesTmpNPU.data());
+                this->queryRange(k, npu_start, npu_end, DeviceType::NPU_HEXAGON, nQuery, query, resultsTmpNPU.data(), distancesTmpNPU.data(), skip);
             }
         );
     }
@@ -318,10 +885,35 @@ void FlatIndex::reconstruct(
         // 索引超出范围
         return;
     }
-    std::copy(data_.data() + idx * dim_, data_.data() + (idx + 1) * dim_, vec);
+    if (storageType_ != StorageType::STORAGE_FP32) {
+        decodeRows(vec, rowData16(idx), dim_);
+        return;
+    }
+    std::copy(rowData(idx), rowData(idx) + dim_, vec);
 }
 
 int FlatIndex::save(const std::string filename) {
+    if (wal_ && filename == walFilename_) {
+        // WAL 模式：提交日志即可，日志超过快照的 walCheckpointRatio 倍时重写快照
+        if (wal_->commit() != 0) {
+            return -1;
+        }
+        const uint64_t elemSize = storageType_ != StorageType::STORAGE_FP32 ? sizeof(uint16_t) : sizeof(float);
+        const uint64_t snapshotBytes = num_ * (dim_ * elemSize + sizeof(float));
+        if (wal_->size() > walCheckpointRatio * snapshotBytes) {
+            return this->checkpoint();
+        }
+        return 0;
+    }
+    int ret = this->writeSnapshot(filename);
+    if (ret != 0) {
+        return ret;
+    }
+    // 普通保存的快照不对应任何日志：快照落盘之后删除同名的旧日志，否则加载时会把它重放到无关的快照上
+    return removeDurable(filename + ".wal") ? 0 : -1;
+}
+
+int FlatIndex::writeSnapshot(const std::string& filename) {
     try {
         // 1. 将字符串转换为 filesystem::path 对象
         std::filesystem::path file_path(filename);
@@ -344,58 +936,532 @@ int FlatIndex::save(const std::string filename) {
         return -1;
     }
     
-    std::ofstream ofs(filename, std::ios::binary);
-    if (!ofs) {
-        return -1; // 打开文件失败
-    }
-
-    // header
     /*
-        magicNumber + dim + num + isFloat16 + metricType
+        v2 格式，索引类型为 kLegacyMagic：
+        META（dim + num + storageType + metricType + walSequence）| VECTORS | NORMS（num 个）| TOMBSTONES | IDS
+        16位存储时直接写入16位数据；没有删除的行时不写 TOMBSTONES，不使用外部编号时不写 IDS
+        向量和范数按块依次写入，不需要先拼接
     */
-    uint64_t magicNumber = 1145; 
-    ofs.write(reinterpret_cast<const char*>(&magicNumber), sizeof(uint64_t));
-    ofs.write(reinterpret_cast<const char*>(&dim_), sizeof(uint64_t));
-    ofs.write(reinterpret_cast<const char*>(&num_), sizeof(uint64_t));
-    ofs.write(reinterpret_cast<const char*>(&isFloat16_), sizeof(bool));
-    ofs.write(reinterpret_cast<const char*>(&metricType_), sizeof(MetricType));
-    // true data
-    ofs.write(reinterpret_cast<const char*>(data_.data()), num_ * dim_ * sizeof(float));
-    ofs.write(reinterpret_cast<const char*>(dataNorm_.data()), num_ * dim_ * sizeof(float));
+    FlatIndexMeta meta = {dim_, num_, static_cast<uint32_t>(storageType_), static_cast<uint32_t>(metricType_), walSequence_};
+    std::vector<IndexFileWriter::Part> vecParts, normParts;
+    for (uint64_t i = 0; i < num_;) {
+        const uint64_t len = std::min(num_ - i, storage_.contiguous(i));
+        vecParts.emplace_back(storage_.row(i), len * storage_.getRowBytes());
+        normParts.emplace_back(normData(i), len * sizeof(float));
+        i += len;
+    }
+    IndexFileWriter writer(kLegacyMagic);
+    writer.addSection(SECTION_META, &meta, sizeof(meta));
+    writer.addSection(SECTION_VECTORS, vecParts);
+    writer.addSection(SECTION_NORMS, normParts);
+    if (removed_.count() > 0) {
+        writer.addSection(SECTION_TOMBSTONES, removed_.data(), removed_.numWords() * sizeof(uint64_t));
+    }
+    if (!labels_.empty()) {
+        writer.addSection(SECTION_IDS, labels_.data(), labels_.size() * sizeof(uint64_t));
+    }
+    return writer.write(filename);
+}
+
+int FlatIndex::readHeader(std::istream& is, uint64_t& magicNumber) {
+    // 读取魔数
+    is.read(reinterpret_cast<char*>(&magicNumber), sizeof(uint64_t));
+    if (!is || (magicNumber != kLegacyMagic && magicNumber != kAlignedMagic)) {
+        return -2; // 魔数不匹配
+    }
+    // 读取向量维度和数量
+    is.read(reinterpret_cast<char*>(&dim_), sizeof(uint64_t));
+    is.read(reinterpret_cast<char*>(&num_), sizeof(uint64_t));
+    uint8_t storageType = 0;
+    is.read(reinterpret_cast<char*>(&storageType), sizeof(uint8_t));
+    if (!is || storageType > StorageType::STORAGE_BF16) {
+        return -3; // 未知的存储格式
+    }
+    storageType_ = static_cast<StorageType>(storageType);
+    is.read(reinterpret_cast<char*>(&metricType_), sizeof(MetricType));
+    this->walSequence_ = 0;
+    this->resetLoaded();
+    return is ? 0 : -3;
+}
+
+void FlatIndex::resetLoaded() {
+    // 数据已被替换，之前的存储、映射和KD树都不再使用
+    this->resetStorage();
+    mapping_.reset();
+    std::lock_guard<std::mutex> lock(treeMutex_);
+    tree_.reset();
+}
+
+void FlatIndex::rebuildLabelMap() {
+    labelToRow_.clear();
+    labelToRow_.reserve(num_ - removed_.count());
+    for (uint64_t i = 0; i < num_; ++i) {
+        if (!removed_.test(i)) {
+            labelToRow_[labels_[i]] = i;
+        }
+    }
+}
+
+int FlatIndex::readTail(std::istream& is) {
+    // 墓碑和外部编号：旧文件没有这两段，读取失败时视为没有删除的行、不使用外部编号
+    removed_.resize(0);
+    removed_.resize(num_);
+    labels_.clear();
+    labelToRow_.clear();
+    uint64_t numRemoved = 0;
+    if (!is.read(reinterpret_cast<char*>(&numRemoved), sizeof(uint64_t))) {
+        return 0;
+    }
+    if (numRemoved > 0) {
+        is.read(reinterpret_cast<char*>(removed_.data()), removed_.numWords() * sizeof(uint64_t));
+        removed_.recount();
+        if (!is || removed_.count() != numRemoved) {
+            return -3; // 墓碑数据损坏
+        }
+    }
+    uint64_t numLabels = 0;
+    if (is.read(reinterpret_cast<char*>(&numLabels), sizeof(uint64_t)) && numLabels > 0) {
+        if (numLabels != num_) {
+            return -3; // 外部编号数据损坏
+        }
+        labels_.resize(num_);
+        if (!is.read(reinterpret_cast<char*>(labels_.data()), num_ * sizeof(uint64_t))) {
+            labels_.clear();
+            return -3;
+        }
+        this->rebuildLabelMap();
+    }
+    return 0;
+}
+
+int FlatIndex::readSections(const IndexFileReader& reader) {
+    if (reader.getIndexType() != kLegacyMagic) {
+        return -2; // 不是 FlatIndex 的文件
+    }
+    FlatIndexMeta meta = {};
+    uint64_t metaSize = 0;
+    const char* metaData = reader.section(SECTION_META, &metaSize);
+    if (!metaData || metaSize < kMinMetaSize) {
+        return -3;
+    }
+    std::memcpy(&meta, metaData, std::min<uint64_t>(metaSize, sizeof(meta)));
+    if (meta.storageType > StorageType::STORAGE_BF16) {
+        return -3; // 未知的存储格式
+    }
 
-    ofs.close();
-    return 0; // 成功
+    // 先检查各段的长度，全部有效后再修改索引
+    const uint64_t elemSize = meta.storageType != StorageType::STORAGE_FP32 ? sizeof(uint16_t) : sizeof(float);
+    uint64_t vecSize = 0, normSize = 0, removedSize = 0, idsSize = 0;
+    const char* vecs = reader.section(SECTION_VECTORS, &vecSize);
+    const char* norms = reader.section(SECTION_NORMS, &normSize);
+    const char* removed = reader.section(SECTION_TOMBSTONES, &removedSize);
+    const char* ids = reader.section(SECTION_IDS, &idsSize);
+    if (!vecs || vecSize != meta.num * meta.dim * elemSize || !norms || normSize != meta.num * sizeof(float) ||
+        (removed && removedSize != (meta.num + 63) / 64 * sizeof(uint64_t)) ||
+        (ids && idsSize != meta.num * sizeof(uint64_t))) {
+        return -3;
+    }
+
+    dim_ = meta.dim;
+    num_ = meta.num;
+    storageType_ = static_cast<StorageType>(meta.storageType);
+    metricType_ = static_cast<MetricType>(meta.metricType);
+    walSequence_ = meta.walSequence;
+    this->resetLoaded();
+
+    removed_.resize(0);
+    removed_.resize(num_);
+    if (removed) {
+        std::memcpy(removed_.data(), removed, removedSize);
+        removed_.resize(num_);  // 清掉最后一个字中超出 num 的位
+        removed_.recount();
+    }
+    labels_.clear();
+    labelToRow_.clear();
+    if (ids) {
+        labels_.resize(num_);
+        std::memcpy(labels_.data(), ids, idsSize);
+        this->rebuildLabelMap();
+    }
+    return 0;
 }
 
 int FlatIndex::load(const std::string filename) {
+    this->disableWal();
+    int ret = this->loadFile(filename);
+    return ret == 0 ? this->replayWal(filename) : ret;
+}
+
+int FlatIndex::loadFile(const std::string& filename) {
     if (filename.find("data.") == std::string::npos) {
         std::string newFilename = "data/" + filename;
     }
 
+    // v2 格式：校验所有段之后从映射中复制
+    IndexFileReader reader;
+    int ret = reader.open(filename, true);
+    if (ret == 0) {
+        ret = this->readSections(reader);
+        if (ret != 0) {
+            return ret;
+        }
+        storage_.assign(reader.section(SECTION_VECTORS), reinterpret_cast<const float*>(reader.section(SECTION_NORMS)), num_);
+        return 0;
+    }
+    if (ret != -2) {
+        return ret;
+    }
+
+    // 旧格式
     std::ifstream ifs(filename, std::ios::binary);
     if (!ifs) {
         return -1; // 打开文件失败
     }
 
-    // 读取魔数
-    uint64_t magicNumber;
-    ifs.read(reinterpret_cast<char*>(&magicNumber), sizeof(uint64_t));
-    if (magicNumber != 1145) {
-        return -2; // 魔数不匹配
+    uint64_t magicNumber = 0;
+    ret = this->readHeader(ifs, magicNumber);
+    if (ret != 0) {
+        return ret;
     }
-    // 读取向量维度和数量
-    ifs.read(reinterpret_cast<char*>(&dim_), sizeof(uint64_t));
-    ifs.read(reinterpret_cast<char*>(&num_), sizeof(uint64_t));
-    ifs.read(reinterpret_cast<char*>(&isFloat16_), sizeof(bool));
-    ifs.read(reinterpret_cast<char*>(&metricType_), sizeof(MetricType));
-    this->capacity_ = num_; // 设置容量为当前数量
-
-    // 读取向量数据
-    data_.resize(capacity_ * dim_);
-    dataNorm_.resize(capacity_ * dim_);
-    ifs.read(reinterpret_cast<char*>(data_.data()), num_ * dim_ * sizeof(float));
-    ifs.read(reinterpret_cast<char*>(dataNorm_.data()), num_ * dim_ * sizeof(float));
 
+    // 按块读取向量数据（isNorm 为真时读取范数）
+    storage_.reserve(num_);
+    auto readChunks = [&](bool isNorm) {
+        for (uint64_t i = 0; i < num_;) {
+            const uint64_t len = std::min(num_ - i, storage_.contiguous(i));
+            if (isNorm) {
+                ifs.read(reinterpret_cast<char*>(storage_.mutableNorm(i)), len * sizeof(float));
+            } else {
+                ifs.read(storage_.mutableRow(i), len * storage_.getRowBytes());
+            }
+            i += len;
+        }
+    };
+    if (magicNumber == kAlignedMagic) {
+        ifs.seekg(kSectionAlign);
+        readChunks(false);
+        ifs.seekg(alignUp(kSectionAlign + num_ * storage_.getRowBytes()));
+        readChunks(true);
+    } else if (storageType_ != StorageType::STORAGE_FP32) {
+        // 旧版本即使 isFloat16 为真也按单精度写入，根据剩余的文件长度区分
+        std::streampos pos = ifs.tellg();
+        ifs.seekg(0, std::ios::end);
+        uint64_t remaining = static_cast<uint64_t>(ifs.tellg() - pos);
+        ifs.seekg(pos);
+
+        if (remaining >= 2 * num_ * dim_ * sizeof(float)) {
+            std::vector<float> legacy(num_ * dim_);
+            ifs.read(reinterpret_cast<char*>(legacy.data()), num_ * dim_ * sizeof(float));
+            for (uint64_t i = 0; i < num_;) {
+                const uint64_t len = std::min(num_ - i, storage_.contiguous(i));
+                encodeRows(reinterpret_cast<uint16_t*>(storage_.mutableRow(i)), legacy.data() + i * dim_, len * dim_);
+                i += len;
+            }
+        } else {
+            readChunks(false);
+        }
+    } else {
+        readChunks(false);
+    }
+    if (magicNumber == kLegacyMagic) {
+        // 旧格式的范数按 num * dim 个保存，跳过后按数据重新计算
+        ifs.seekg(num_ * dim_ * sizeof(float), std::ios::cur);
+        this->computeNorms(0, num_);
+    }
+    if (!ifs) {
+        return -3; // 文件被截断
+    }
+
+    ret = this->readTail(ifs);
     ifs.close();
-    return 0; // 成功
-}
\ No newline at end of file
+    return ret;
+}
+
+int FlatIndex::loadMmap(const std::string filename, bool populate, MappedFile::Advice advice, bool verify) {
+    this->disableWal();
+    int ret = this->mapFile(filename, populate, advice, verify);
+    return ret == 0 ? this->replayWal(filename) : ret;
+}
+
+int FlatIndex::mapFile(const std::string& filename, bool populate, MappedFile::Advice advice, bool verify) {
+    IndexFileReader reader;
+    int ret = reader.open(filename, verify, populate);
+    if (ret == 0) {
+        ret = this->readSections(reader);
+        if (ret != 0) {
+            return ret;
+        }
+        // 内存中的旧数据已经释放，之后的读取都直接访问映射
+        uint64_t vecSize = 0, normSize = 0;
+        const char* vecs = reader.section(SECTION_VECTORS, &vecSize);
+        const float* norms = reinterpret_cast<const float*>(reader.section(SECTION_NORMS, &normSize));
+        storage_.setExternal(vecs, norms, num_);
+        mapping_ = reader.getMapping();
+        mapping_->advise(reader.sectionOffset(SECTION_VECTORS), vecSize, advice);
+        mapping_->advise(reader.sectionOffset(SECTION_NORMS), normSize, advice);
+        return 0;
+    }
+    if (ret != -2) {
+        return ret;
+    }
+
+    // 旧格式
+    std::shared_ptr<MappedFile> mapping = MappedFile::open(filename, populate);
+    if (!mapping) {
+        return -1; // 打开或映射文件失败
+    }
+    uint64_t magicNumber = 0;
+    if (mapping->size() >= sizeof(uint64_t)) {
+        std::copy(mapping->data(), mapping->data() + sizeof(uint64_t), reinterpret_cast<char*>(&magicNumber));
+    }
+    if (magicNumber == kLegacyMagic) {
+        // 旧格式的数据没有对齐，只能复制
+        return this->loadFile(filename);
+    }
+
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) {
+        return -1;
+    }
+    ret = this->readHeader(ifs, magicNumber);
+    if (ret != 0) {
+        return ret;
+    }
+
+    const uint64_t elemSize = storageType_ != StorageType::STORAGE_FP32 ? sizeof(uint16_t) : sizeof(float);
+    const uint64_t dataOffset = kSectionAlign;
+    const uint64_t normOffset = alignUp(dataOffset + num_ * dim_ * elemSize);
+    const uint64_t tailOffset = normOffset + num_ * sizeof(float);
+    if (mapping->size() < tailOffset) {
+        return -3; // 文件被截断
+    }
+    ifs.seekg(tailOffset);
+    ret = this->readTail(ifs);
+    if (ret != 0) {
+        return ret;
+    }
+
+    // 内存中的旧数据已经释放，之后的读取都直接访问映射
+    mapping->advise(dataOffset, tailOffset - dataOffset, advice);
+    storage_.setExternal(mapping->data() + dataOffset, reinterpret_cast<const float*>(mapping->data() + normOffset), num_);
+    mapping_ = mapping;
+    return 0;
+}
+
+bool FlatIndex::isMapped() const {
+    return mapping_ != nullptr;
+}
+
+const float* FlatIndex::rowData(uint64_t row) const {
+    return reinterpret_cast<const float*>(storage_.row(row));
+}
+
+const uint16_t* FlatIndex::rowData16(uint64_t row) const {
+    return reinterpret_cast<const uint16_t*>(storage_.row(row));
+}
+
+const float* FlatIndex::normData(uint64_t row) const {
+    return storage_.norm(row);
+}
+
+void FlatIndex::unmap() {
+    if (!mapping_) {
+        return;
+    }
+    storage_.copyExternal(num_);
+    mapping_.reset();
+}
+
+uint64_t FlatIndex::removeIds(const uint64_t* ids, uint64_t n) {
+    uint64_t removed = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        if (labels_.empty()) {
+            if (ids[i] < num_ && removed_.set(ids[i])) {
+                ++removed;
+            }
+            continue;
+        }
+        auto it = labelToRow_.find(ids[i]);
+        if (it != labelToRow_.end()) {
+            removed_.set(it->second);
+            labelToRow_.erase(it);
+            ++removed;
+        }
+    }
+    this->logWal(WAL_REMOVE, n, ids, n * sizeof(uint64_t));
+    return removed;
+}
+
+bool FlatIndex::isRemoved(uint64_t idx) const {
+    return idx < num_ && removed_.test(idx);
+}
+
+uint64_t FlatIndex::getNumRemoved() const {
+    return removed_.count();
+}
+
+bool FlatIndex::needsCompaction() const {
+    return num_ > 0 && removed_.count() > compactThreshold * num_;
+}
+
+uint64_t FlatIndex::compact(std::vector<uint64_t>* newIds) {
+    this->unmap();
+    if (newIds != nullptr) {
+        newIds->assign(num_, UINT64_MAX);
+    }
+    uint64_t write = 0;
+    for (uint64_t i = 0; i < num_; ++i) {
+        if (removed_.test(i)) {
+            continue;
+        }
+        if (write != i) {
+            std::memcpy(storage_.mutableRow(write), storage_.row(i), storage_.getRowBytes());
+            *storage_.mutableNorm(write) = *storage_.norm(i);
+            if (!labels_.empty()) {
+                labels_[write] = labels_[i];
+                labelToRow_[labels_[i]] = write;
+            }
+        }
+        if (newIds != nullptr) {
+            (*newIds)[i] = write;
+        }
+        ++write;
+    }
+    num_ = write;
+    storage_.shrink(num_);      // 释放压缩后完全空闲的块
+    if (!labels_.empty()) {
+        labels_.resize(num_);
+    }
+    removed_.resize(0);
+    removed_.resize(num_);
+    {
+        std::lock_guard<std::mutex> lock(treeMutex_);
+        tree_.reset();      // 行号已经改变，KD树需要重建
+    }
+    this->logWal(WAL_COMPACT, 0, nullptr, 0);
+    return num_;
+}
+
+int FlatIndex::enableWal(const std::string filename) {
+    this->disableWal();
+    if (filename == walLoadedFrom_) {
+        // 刚从这个文件加载，之后没有修改过：快照不需要重写，在已有日志的末尾继续追加
+        wal_ = walLoadedEnd_ == 0 ? WriteAheadLog::create(filename + ".wal", dim_)
+                                  : WriteAheadLog::openAppend(filename + ".wal", walLoadedEnd_, walLoadedSize_);
+    }
+    if (!wal_) {
+        // 写一份完整的快照作为日志的起点，快照落盘之后才替换旧的日志
+        int ret = this->writeSnapshot(filename);
+        if (ret != 0) {
+            return ret;
+        }
+        wal_ = WriteAheadLog::create(filename + ".wal", dim_);
+        if (!wal_) {
+            return -1;
+        }
+    }
+    walFilename_ = filename;
+    walLoadedFrom_.clear();
+    return 0;
+}
+
+void FlatIndex::disableWal() {
+    wal_.reset();
+    walFilename_.clear();
+}
+
+bool FlatIndex::isWalEnabled() const {
+    return wal_ != nullptr;
+}
+
+int FlatIndex::checkpoint() {
+    if (!wal_) {
+        return -1;
+    }
+    /*
+        快照记录了当前的序号，writeSnapshot 返回时快照的数据和改名都已落盘，之后才清空日志：
+        两步之间崩溃时，日志中的记录在加载时都会被跳过；快照写入失败时日志保持不变
+    */
+    int ret = this->writeSnapshot(walFilename_);
+    if (ret != 0) {
+        return ret;
+    }
+    wal_.reset();
+    wal_ = WriteAheadLog::create(walFilename_ + ".wal", dim_);
+    if (!wal_) {
+        walFilename_.clear();
+        return -1;
+    }
+    return 0;
+}
+
+void FlatIndex::logWal(uint32_t type, uint64_t count, const void* data, uint64_t size, const void* extra, uint64_t extraSize) {
+    // 不在 WAL 模式时的修改不写日志，加载时记录的日志位置不再能直接续写
+    walLoadedFrom_.clear();
+    if (wal_) {
+        wal_->append(type, ++walSequence_, count, data, size, extra, extraSize);
+    }
+}
+
+int FlatIndex::replayWal(const std::string& filename) {
+    walLoadedFrom_.clear();
+    std::shared_ptr<MappedFile> mapping;
+    std::vector<WriteAheadLog::Record> records;
+    uint64_t end = 0;
+    int ret = WriteAheadLog::read(filename + ".wal", dim_, mapping, records, end);
+    if (ret == -1) {
+        // 没有日志
+        walLoadedFrom_ = filename;
+        walLoadedEnd_ = 0;
+        return 0;
+    }
+    if (ret != 0) {
+        return ret;
+    }
+
+    const uint64_t vecBytes = dim_ * sizeof(float);
+    try {
+        for (const WriteAheadLog::Record& rec : records) {
+            if (rec.sequence <= walSequence_) {
+                continue; // 已经包含在快照中
+            }
+            if (rec.sequence != walSequence_ + 1) {
+                return -3; // 日志与快照不连续
+            }
+            const uint64_t* ids = reinterpret_cast<const uint64_t*>(rec.data);
+            switch (rec.type) {
+                case WAL_ADD:
+                    if (rec.size != rec.count * vecBytes) {
+                        return -3;
+                    }
+                    this->addVector(reinterpret_cast<const float*>(rec.data), rec.count);
+                    break;
+                case WAL_ADD_WITH_IDS:
+                    if (rec.size != rec.count * (sizeof(uint64_t) + vecBytes)) {
+                        return -3;
+                    }
+                    this->addVectorWithIds(reinterpret_cast<const float*>(ids + rec.count), ids, rec.count);
+                    break;
+                case WAL_REMOVE:
+                    if (rec.size != rec.count * sizeof(uint64_t)) {
+                        return -3;
+                    }
+                    this->removeIds(ids, rec.count);
+                    break;
+                case WAL_COMPACT:
+                    this->compact();
+                    break;
+                default:
+                    return -3; // 未知的记录
+            }
+            walSequence_ = rec.sequence;
+        }
+    } catch (const std::invalid_argument&) {
+        // 记录与快照不匹配（例如向没有外部编号的索引添加带编号的向量），按日志损坏处理
+        return -3;
+    }
+    walLoadedFrom_ = filename;
+    walLoadedEnd_ = end;
+    walLoadedSize_ = mapping->size();
+    return 0;
+}
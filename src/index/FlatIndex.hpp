@@ -4,9 +4,21 @@
 
 #include "MetricType.hpp"
 #include "Device.hpp"
+#include "StorageType.hpp"
+#include "KDTreeIndex.hpp"
+#include "Bitmap.hpp"
+#include "IDSelector.hpp"
+#include "RangeSearchResult.hpp"
+#include "MappedFile.hpp"
+#include "ChunkedStorage.hpp"
+#include "IndexFile.hpp"
+#include "WriteAheadLog.hpp"
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
+#include <memory>
+#include <istream>
 #include <mutex>
+#include <unordered_map>
 
 #include <vector>
 
@@ -14,11 +26,24 @@ class FlatIndex
 {
     public:
         FlatIndex(uint64_t dim, uint64_t capacity, bool isFloat16 = false, MetricType metricType = MetricType::METRIC_INNER_PRODUCT, kp::Manager* mgr = nullptr);
+        FlatIndex(uint64_t dim, uint64_t capacity, StorageType storageType, MetricType metricType = MetricType::METRIC_INNER_PRODUCT, kp::Manager* mgr = nullptr);
         FlatIndex(uint64_t dim, kp::Manager* mgr = nullptr, MetricType metricType = MetricType::METRIC_INNER_PRODUCT);
         ~FlatIndex() {};
 
-        // 添加向量
+        // 添加向量，行号按添加顺序从0开始；已经使用外部编号的索引只能用 addVectorWithIds
         void addVector(const float* vecs, uint64_t n);
+        /*
+            添加向量并指定外部编号（标签），之后 search 返回标签而不是行号，removeIds 也按标签删除
+            标签已经存在时旧的行被删除，相当于更新；标签不能为 UINT64_MAX
+            只能用于空索引或者一直使用外部编号的索引
+        */
+        void addVectorWithIds(const float* vecs, const uint64_t* ids, uint64_t n);
+        // 是否使用外部编号
+        bool hasIds() const;
+        // 标签所在的行，不存在或已删除时返回 UINT64_MAX
+        uint64_t getRow(uint64_t id) const;
+        // 第 row 行的标签，没有使用外部编号时就是行号
+        uint64_t getId(uint64_t row) const;
         // 获取向量数量
         uint64_t getNum() const;
         // 获取向量维度
@@ -27,6 +52,8 @@ class FlatIndex
         uint64_t getCapacity() const;
         // 获取是否使用 float16 存储
         bool isFloat16() const;
+        // 获取数据库向量的存储格式
+        StorageType getStorageType() const;
 
         // 查询n个指定向量并返回前k个匹配的向量
         void query(
@@ -50,7 +77,7 @@ class FlatIndex
             float* distances
         );
 
-        // 真正的调度函数
+        // 真正的调度函数，使用外部编号时返回标签
         void search(
             uint64_t k,
             uint64_t nQuery,
@@ -59,6 +86,31 @@ class FlatIndex
             float* distances
         );
 
+        /*
+            只在 selector 选中的向量中查询，结果不足k个时用 UINT64_MAX 填充
+            选中的向量占比不超过 filterGatherRatio 时直接逐个计算选中的向量；
+            否则把未选中的行和墓碑合并成一个位图，交给KD树或各个后端在 top-k 阶段跳过
+        */
+        void search(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances,
+            const IDSelector& selector
+        );
+
+        /*
+            范围查询：返回每个查询距离在 radius 以内的所有向量，L2 为 dis < radius，IP 为 dis > radius
+            结果按CSR格式写入 result，编号与 search 相同；在CPU上计算，阈值在距离算出后立即判断
+        */
+        void rangeSearch(
+            uint64_t nQuery,
+            const float* query,
+            float radius,
+            RangeSearchResult& result
+        );
+
         // 根据索引重建向量
         void reconstruct(
             uint64_t idx,
@@ -68,17 +120,190 @@ class FlatIndex
         static std::mutex assetManagerMutex_;      // 互斥锁，用于保护资源管理器的访问
 
         // search方法
+        // 按 v2 格式（见 IndexFile.hpp）保存；WAL 模式下保存到同一个文件时只提交日志，否则删除同名的旧日志
         int save(const std::string filename);
+        /*
+            加载 v2 格式或旧格式的文件，v2 格式会先校验所有段；返回-3表示文件损坏
+            存在 filename.wal 时在快照上重放其中快照之后的记录，日志与快照不匹配时返回-3
+        */
         int load(const std::string filename);
+        /*
+            以 mmap 方式加载：向量和范数直接使用文件中按页对齐的区域，不复制也不预先读入，
+            多个进程加载同一个文件时共享页缓存中的同一份数据
+            advice 作用于向量和范数所在的区域；populate 为真时在返回前读入所有页
+            verify 为真时先并行校验 v2 格式的所有段，需要读一遍整个文件，默认只校验文件头
+            旧格式的文件没有对齐，退回到 load 的复制方式
+            映射的数据只读：addVector（以及重放日志中的新增）只为新的向量分配块，不复制映射的数据；
+            compact 需要原地移动已有的向量，会先把映射的数据复制到内存中
+        */
+        int loadMmap(const std::string filename, bool populate = false,
+                     MappedFile::Advice advice = MappedFile::Advice::NORMAL, bool verify = false);
+        // 数据是否来自 mmap
+        bool isMapped() const;
+
+        /*
+            WAL（预写日志）模式：之后的 addVector / addVectorWithIds / removeIds / compact 追加到 filename.wal，
+            save(filename) 只把日志提交并落盘（组提交），代价与修改量成正比，与索引大小无关；
+            日志超过快照的 walCheckpointRatio 倍时 save 改为重写快照并清空日志
+            刚从 filename 加载且没有修改过时沿用已有的快照和日志，否则先写一份完整的快照
+            同一时间只能有一个索引对象写同一个日志；load / loadMmap 会退出 WAL 模式
+        */
+        int enableWal(const std::string filename);
+        // 提交日志并退出 WAL 模式
+        void disableWal();
+        bool isWalEnabled() const;
+        // 立即重写快照并清空日志
+        int checkpoint();
+        // 日志与快照大小之比超过该值时 save 重写快照
+        float walCheckpointRatio = 0.5f;
+
+        /*
+            删除指定的行：只在位图中打上墓碑，所有后端的 top-k 都会跳过这些行，其余行的行号不变
+            使用外部编号时 ids 为标签；返回新删除的行数，不存在或已经删除的编号被忽略
+        */
+        uint64_t removeIds(const uint64_t* ids, uint64_t n);
+        // 第 idx 行是否已删除
+        bool isRemoved(uint64_t idx) const;
+        // 已删除但还没有压缩掉的行数，getNum() 包含这些行
+        uint64_t getNumRemoved() const;
+        // 已删除的行数占比是否超过 compactThreshold
+        bool needsCompaction() const;
+        /*
+            压缩：把未删除的行依次前移，原地重写数据和范数并清空墓碑，不重新分配内存，只释放压缩后完全空闲的块
+            压缩后行号会改变，newIds 不为空时写入旧行号到新行号的映射（已删除的行为 UINT64_MAX）
+            外部编号不受影响，使用外部编号时可以随时压缩
+            返回压缩后的向量数量
+        */
+        uint64_t compact(std::vector<uint64_t>* newIds = nullptr);
+        // 触发压缩的删除比例
+        float compactThreshold = 0.2f;
+
+        /*
+            维度不超过该值且按单精度存储时，search 改用KD树做精确搜索，设为0关闭
+            均匀分布的数据在8维以上剪枝效果明显变差；数据的内在维度较低时可以调大到16左右
+            KD树在第一次 search 时构建；之后新增的向量较少时直接暴力扫描，超过树中数量的 1/8 时重建
+        */
+        uint64_t treeMaxDim = 8;
+
+        // 过滤查询改为逐个计算选中向量的占比
+        float filterGatherRatio = 0.05f;
+
+        /*
+            分块存储中每块向量数据的字节数（见 ChunkedStorage.hpp），添加向量时只分配新的块，已有的向量不会移动
+            查询按块分段交给后端再合并结果：块太小时分段和合并的开销变大，太大时最后一个块增长时复制的数据变多
+            只在重新分配存储时生效：空索引第一次添加向量、加载文件
+        */
+        uint64_t chunkBytes = 16ull << 20;
 
     private:
+        // 第 row 行的向量和范数的只读地址，mmap 加载时指向映射的文件；同一块中的行连续存放
+        const float* rowData(uint64_t row) const;
+        const uint16_t* rowData16(uint64_t row) const;
+        const float* normData(uint64_t row) const;
+        // 按当前的维度、存储格式和 chunkBytes 重新初始化空的分块存储
+        void resetStorage();
+        // 把映射的数据和之后新增的向量复制到内存中并解除映射，之后可以原地修改
+        void unmap();
+        // 读取文件头，load 与 loadMmap 共用
+        int readHeader(std::istream& is, uint64_t& magicNumber);
+        // 读取文件末尾的墓碑和外部编号
+        int readTail(std::istream& is);
+        // load / loadMmap 中读取快照的部分，不处理日志
+        int loadFile(const std::string& filename);
+        int mapFile(const std::string& filename, bool populate, MappedFile::Advice advice, bool verify);
+        // 写完整的快照
+        int writeSnapshot(const std::string& filename);
+        // WAL 模式下把一次修改追加到日志
+        void logWal(uint32_t type, uint64_t count, const void* data, uint64_t size,
+                    const void* extra = nullptr, uint64_t extraSize = 0);
+        // 在刚加载的快照上重放 filename.wal 中快照之后的记录
+        int replayWal(const std::string& filename);
+        // 读取 v2 格式的 META、墓碑和外部编号，向量和范数由调用者复制或映射
+        int readSections(const IndexFileReader& reader);
+        // 加载新数据前丢弃之前的映射和KD树
+        void resetLoaded();
+        // 根据 labels_ 和墓碑重建标签到行号的映射
+        void rebuildLabelMap();
+        // 把n个向量写到末尾并计算范数
+        void appendRows(const float* vecs, uint64_t n);
+        // 计算 [first, first + n) 行的平方范数，16位存储时按转换后的值计算，向量较多时并行
+        void computeNorms(uint64_t first, uint64_t n);
+        // 16位存储与float之间的转换，按 storageType_ 选择 fp16 或 bf16
+        void encodeRows(uint16_t* dst, const float* src, uint64_t n) const;
+        void decodeRows(float* dst, const uint16_t* src, uint64_t n) const;
+        // query 的实现，skip 中置位的行不进入结果；区间跨越多个块时逐块查询再合并
+        void queryRange(
+            uint64_t k,
+            uint64_t start,
+            uint64_t end,
+            DeviceType device,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances,
+            const Bitmap& skip
+        );
+        // 在一段连续存放的行 [start,end) 上调用后端
+        void queryChunk(
+            uint64_t k,
+            uint64_t start,
+            uint64_t end,
+            DeviceType device,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances,
+            const Bitmap& skip
+        );
+        // 按行号返回结果的调度
+        void searchRows(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances,
+            const Bitmap& skip
+        );
+        // 低维数据用KD树搜索
+        void treeSearch(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances,
+            const Bitmap& skip
+        );
+        // 把 selector 选中的、未删除的行写入 selected（num_ 位）
+        void selectRows(const IDSelector& selector, Bitmap& selected) const;
+        // 逐个计算 rows 中的行
+        void gatherSearch(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            const std::vector<uint64_t>& rows,
+            uint64_t* results,
+            float* distances
+        ) const;
+        // 使用外部编号时把结果中的行号换成标签
+        void rowsToLabels(uint64_t* results, uint64_t n) const;
+
         kp::Manager* mgr_;             // Kompute管理器
         kp::Manager realMgr_;          // real Kompute管理器
         uint64_t dim_;                      // 向量维度
         uint64_t num_;                      // 向量数量    
-        uint64_t capacity_;                 // 向量容量
-        bool isFloat16_;                    // 是否使用 float16 存储
+        StorageType storageType_;           // 数据库向量的存储格式
         MetricType metricType_;             // 距离计算方式
-        std::vector<float> data_;           // 存储向量数据
-        std::vector<float> dataNorm_;       // 存储向量归一化后的数据
+        ChunkedStorage storage_;            // 向量（单精度或 fp16/bf16）和每个向量的平方范数，按块存放
+        std::shared_ptr<MappedFile> mapping_;   // mmap 加载时映射的文件，此时 storage_ 直接使用映射中的数据
+        Bitmap removed_;                    // 已删除的行（墓碑），位数与 num_ 相同
+        std::vector<uint64_t> labels_;      // 每一行的外部编号，不使用外部编号时为空
+        std::unordered_map<uint64_t, uint64_t> labelToRow_;     // 未删除的行的标签到行号
+        std::shared_ptr<const KDTreeIndex> tree_;   // 覆盖前 tree_->getNum() 个向量的KD树，查询时复制一份指针，重建不影响正在进行的查询
+        std::mutex treeMutex_;              // 保护 tree_ 的重建
+        std::unique_ptr<WriteAheadLog> wal_;    // WAL 模式下打开的日志，为空时不写日志
+        std::string walFilename_;           // WAL 模式的快照文件
+        uint64_t walSequence_ = 0;          // 最后一条已应用的日志记录的序号
+        std::string walLoadedFrom_;         // 最近一次加载的文件，加载之后有修改时清空
+        uint64_t walLoadedEnd_ = 0;         // 加载时日志中有效记录的末尾，0 表示没有日志
+        uint64_t walLoadedSize_ = 0;        // 加载时日志文件的长度
 };
\ No newline at end of file
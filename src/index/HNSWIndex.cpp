@@ -0,0 +1,419 @@
+#include "index/HNSWIndex.hpp"
+#include "index/VisitedTable.hpp"
+#include "backend/cpu-blas/heap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+
+HNSWIndex::HNSWIndex(uint64_t dim, uint64_t M, uint64_t efConstruction, MetricType metricType, uint64_t seed)
+        : dim_(dim), M_(M), efConstruction_(efConstruction), efSearch_(16), metricType_(metricType),
+          num_(0), maxLevel_(-1), entryPoint_(0), levelMult_(0), rng_(seed), kernels_(&cpu_blas::getKernels()) {
+    if (M < 2) {
+        throw std::invalid_argument("HNSWIndex: M must be at least 2");
+    }
+    levelMult_ = 1.0 / std::log((double)M);
+}
+
+float HNSWIndex::distance(const float* x, uint32_t id) const {
+    const float* y = data_.data() + (uint64_t)id * dim_;
+    if (metricType_ == MetricType::METRIC_INNER_PRODUCT) {
+        return -kernels_->inner_product(x, y, dim_);
+    }
+    return kernels_->L2sqr(x, y, dim_);
+}
+
+uint64_t HNSWIndex::maxLinks(int level) const {
+    return level == 0 ? 2 * M_ : M_;
+}
+
+uint32_t* HNSWIndex::linkList(uint32_t node, int level) {
+    if (level == 0) {
+        return links0_.data() + (uint64_t)node * (2 * M_ + 1);
+    }
+    return upperLinks_[node].data() + (uint64_t)(level - 1) * (M_ + 1);
+}
+
+const uint32_t* HNSWIndex::linkList(uint32_t node, int level) const {
+    return const_cast<HNSWIndex*>(this)->linkList(node, level);
+}
+
+void HNSWIndex::copyLinks(uint32_t node, int level, bool lock, std::vector<uint32_t>& out) const {
+    std::unique_lock<std::mutex> guard(nodeLocks_[node], std::defer_lock);
+    if (lock) {
+        guard.lock();
+    }
+    const uint32_t* list = linkList(node, level);
+    out.assign(list + 1, list + 1 + list[0]);
+}
+
+uint32_t HNSWIndex::greedySearch(const float* x, uint32_t entry, float& entryDistance, int level, bool lock) const {
+    std::vector<uint32_t> neighbors;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        copyLinks(entry, level, lock, neighbors);
+        for (uint32_t nb : neighbors) {
+            float d = distance(x, nb);
+            if (d < entryDistance) {
+                entryDistance = d;
+                entry = nb;
+                changed = true;
+            }
+        }
+    }
+    return entry;
+}
+
+HNSWIndex::MaxHeap HNSWIndex::searchLayer(const float* x, const MaxHeap& entries, uint64_t ef, int level, bool lock) const {
+    VisitedTable& visited = threadVisitedTable(num_);
+    MaxHeap top = entries;
+    // 待扩展的候选，距离越小越靠前
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+    MaxHeap copy = entries;
+    while (!copy.empty()) {
+        visited.visit(copy.top().second);
+        candidates.push(copy.top());
+        copy.pop();
+    }
+
+    std::vector<uint32_t> neighbors;
+    while (!candidates.empty()) {
+        Candidate c = candidates.top();
+        if (c.first > top.top().first && top.size() >= ef) {
+            break;
+        }
+        candidates.pop();
+        copyLinks(c.second, level, lock, neighbors);
+        for (uint32_t nb : neighbors) {
+            if (visited.visit(nb)) {
+                continue;
+            }
+            float d = distance(x, nb);
+            if (top.size() < ef || d < top.top().first) {
+                candidates.emplace(d, nb);
+                top.emplace(d, nb);
+                if (top.size() > ef) {
+                    top.pop();
+                }
+            }
+        }
+    }
+    return top;
+}
+
+void HNSWIndex::selectNeighbors(std::vector<Candidate>& candidates, uint64_t maxM) const {
+    std::sort(candidates.begin(), candidates.end());
+    if (candidates.size() <= maxM) {
+        return;
+    }
+    std::vector<Candidate> selected;
+    selected.reserve(maxM);
+    for (const Candidate& c : candidates) {
+        // 如果候选离某个已选邻居比离基准点更近，就可以经过那个邻居到达，不需要再连边
+        const float* v = data_.data() + (uint64_t)c.second * dim_;
+        bool good = true;
+        for (const Candidate& s : selected) {
+            if (distance(v, s.second) < c.first) {
+                good = false;
+                break;
+            }
+        }
+        if (good) {
+            selected.push_back(c);
+            if (selected.size() >= maxM) {
+                break;
+            }
+        }
+    }
+    candidates.swap(selected);
+}
+
+void HNSWIndex::addLink(uint32_t node, uint32_t target, int level) {
+    std::lock_guard<std::mutex> guard(nodeLocks_[node]);
+    uint32_t* list = linkList(node, level);
+    const uint64_t maxM = maxLinks(level);
+    if (list[0] < maxM) {
+        list[1 + list[0]] = target;
+        ++list[0];
+        return;
+    }
+    // 邻接表已满，在原有邻居和新节点中重新选边
+    const float* v = data_.data() + (uint64_t)node * dim_;
+    std::vector<Candidate> candidates;
+    candidates.reserve(maxM + 1);
+    for (uint32_t j = 0; j < list[0]; ++j) {
+        candidates.emplace_back(distance(v, list[1 + j]), list[1 + j]);
+    }
+    candidates.emplace_back(distance(v, target), target);
+    selectNeighbors(candidates, maxM);
+    list[0] = candidates.size();
+    for (uint64_t j = 0; j < candidates.size(); ++j) {
+        list[1 + j] = candidates[j].second;
+    }
+}
+
+void HNSWIndex::insert(uint32_t node) {
+    const float* x = data_.data() + (uint64_t)node * dim_;
+    const int level = levels_[node];
+
+    // 新节点比当前最高层还高时，整个插入过程都持有入口锁，结束时更新入口点
+    std::unique_lock<std::mutex> entryGuard(entryLock_);
+    const int maxLevel = maxLevel_;
+    uint32_t entry = entryPoint_;
+    if (level <= maxLevel) {
+        entryGuard.unlock();
+    }
+
+    float entryDistance = distance(x, entry);
+    for (int l = maxLevel; l > level; --l) {
+        entry = greedySearch(x, entry, entryDistance, l, true);
+    }
+
+    MaxHeap entries;
+    entries.emplace(entryDistance, entry);
+    for (int l = std::min(level, maxLevel); l >= 0; --l) {
+        MaxHeap found = searchLayer(x, entries, efConstruction_, l, true);
+        entries = found;
+        std::vector<Candidate> neighbors;
+        neighbors.reserve(found.size());
+        while (!found.empty()) {
+            neighbors.push_back(found.top());
+            found.pop();
+        }
+        selectNeighbors(neighbors, M_);
+        {
+            std::lock_guard<std::mutex> guard(nodeLocks_[node]);
+            uint32_t* list = linkList(node, l);
+            list[0] = neighbors.size();
+            for (uint64_t j = 0; j < neighbors.size(); ++j) {
+                list[1 + j] = neighbors[j].second;
+            }
+        }
+        for (const Candidate& nb : neighbors) {
+            addLink(nb.second, node, l);
+        }
+    }
+
+    if (level > maxLevel) {
+        maxLevel_ = level;
+        entryPoint_ = node;
+    }
+}
+
+void HNSWIndex::addVector(const float* vecs, uint64_t n) {
+    if (n == 0) {
+        return;
+    }
+    if (num_ + n > UINT32_MAX) {
+        throw std::runtime_error("HNSWIndex supports at most 2^32 - 1 vectors");
+    }
+    // 先分配好所有存储，并行插入期间不会发生扩容
+    const uint64_t start = num_;
+    data_.insert(data_.end(), vecs, vecs + n * dim_);
+    levels_.resize(start + n);
+    links0_.resize((start + n) * (2 * M_ + 1), 0);
+    upperLinks_.resize(start + n);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (uint64_t i = start; i < start + n; ++i) {
+        // 层数服从几何分布，P(level >= l) = M^-l
+        levels_[i] = (int)(-std::log(1.0 - uniform(rng_)) * levelMult_);
+        upperLinks_[i].assign(levels_[i] * (M_ + 1), 0);
+        nodeLocks_.emplace_back();
+    }
+    num_ = start + n;
+
+    uint64_t first = start;
+    if (maxLevel_ < 0) {
+        // 第一个节点直接作为入口
+        maxLevel_ = levels_[first];
+        entryPoint_ = first;
+        ++first;
+    }
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int64_t i = first; i < (int64_t)num_; ++i) {
+        insert((uint32_t)i);
+    }
+}
+
+uint64_t HNSWIndex::getNum() const {
+    return num_;
+}
+
+uint64_t HNSWIndex::getDim() const {
+    return dim_;
+}
+
+void HNSWIndex::setEfSearch(uint64_t efSearch) {
+    efSearch_ = std::max<uint64_t>(efSearch, 1);
+}
+
+uint64_t HNSWIndex::getEfSearch() const {
+    return efSearch_;
+}
+
+uint64_t HNSWIndex::getM() const {
+    return M_;
+}
+
+uint64_t HNSWIndex::getEfConstruction() const {
+    return efConstruction_;
+}
+
+int HNSWIndex::getMaxLevel() const {
+    return maxLevel_;
+}
+
+void HNSWIndex::search(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances
+) {
+    if (nQuery == 0 || k == 0) {
+        return;
+    }
+    const bool isIP = metricType_ == MetricType::METRIC_INNER_PRODUCT;
+    const float emptyDistance = isIP ? -HUGE_VALF : HUGE_VALF;
+    const uint64_t ef = std::max(efSearch_, k);
+
+#pragma omp parallel for if (nQuery > 1)
+    for (int64_t q = 0; q < (int64_t)nQuery; ++q) {
+        const float* x = query + q * dim_;
+        float* outDistances = distances + q * k;
+        uint64_t* outIndices = results + q * k;
+        for (uint64_t j = 0; j < k; ++j) {
+            outDistances[j] = emptyDistance;
+            outIndices[j] = cpu_blas::kInvalidIndex;
+        }
+        if (num_ == 0) {
+            continue;
+        }
+
+        uint32_t entry = entryPoint_;
+        float entryDistance = distance(x, entry);
+        for (int l = maxLevel_; l > 0; --l) {
+            entry = greedySearch(x, entry, entryDistance, l, false);
+        }
+        MaxHeap entries;
+        entries.emplace(entryDistance, entry);
+        MaxHeap found = searchLayer(x, entries, ef, 0, false);
+        while (found.size() > k) {
+            found.pop();
+        }
+        // 堆顶是最远的结果，从后往前写
+        for (int64_t j = (int64_t)found.size() - 1; j >= 0; --j) {
+            outDistances[j] = isIP ? -found.top().first : found.top().first;
+            outIndices[j] = found.top().second;
+            found.pop();
+        }
+    }
+}
+
+void HNSWIndex::reconstruct(
+    uint64_t idx,
+    float* vec
+) {
+    if (idx >= num_) {
+        // 索引超出范围
+        return;
+    }
+    std::copy(data_.data() + idx * dim_, data_.data() + (idx + 1) * dim_, vec);
+}
+
+int HNSWIndex::save(const std::string filename) {
+    try {
+        std::filesystem::path dir_path = std::filesystem::path(filename).parent_path();
+        if (!dir_path.empty()) {
+            std::filesystem::create_directories(dir_path);
+        }
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Filesystem error while creating directory: " << e.what() << std::endl;
+        return -1;
+    }
+
+    std::ofstream ofs(filename, std::ios::binary);
+    if (!ofs) {
+        return -1; // 打开文件失败
+    }
+
+    // header
+    /*
+        magicNumber + dim + M + efConstruction + efSearch + metricType + num + maxLevel + entryPoint
+        之后依次为: 向量 + 每个节点的层数 + 第0层邻接表 + 每个节点第1层及以上的邻接表
+    */
+    uint64_t magicNumber = 1152;
+    ofs.write(reinterpret_cast<const char*>(&magicNumber), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&dim_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&M_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&efConstruction_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&efSearch_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&metricType_), sizeof(MetricType));
+    ofs.write(reinterpret_cast<const char*>(&num_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&maxLevel_), sizeof(int));
+    ofs.write(reinterpret_cast<const char*>(&entryPoint_), sizeof(uint32_t));
+    ofs.write(reinterpret_cast<const char*>(data_.data()), data_.size() * sizeof(float));
+    ofs.write(reinterpret_cast<const char*>(levels_.data()), levels_.size() * sizeof(int));
+    ofs.write(reinterpret_cast<const char*>(links0_.data()), links0_.size() * sizeof(uint32_t));
+    for (uint64_t i = 0; i < num_; ++i) {
+        ofs.write(reinterpret_cast<const char*>(upperLinks_[i].data()), upperLinks_[i].size() * sizeof(uint32_t));
+    }
+
+    ofs.close();
+    return 0; // 成功
+}
+
+int HNSWIndex::load(const std::string filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) {
+        return -1; // 打开文件失败
+    }
+
+    uint64_t magicNumber;
+    ifs.read(reinterpret_cast<char*>(&magicNumber), sizeof(uint64_t));
+    if (magicNumber != 1152) {
+        return -2; // 魔数不匹配
+    }
+    ifs.read(reinterpret_cast<char*>(&dim_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&M_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&efConstruction_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&efSearch_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&metricType_), sizeof(MetricType));
+    ifs.read(reinterpret_cast<char*>(&num_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&maxLevel_), sizeof(int));
+    ifs.read(reinterpret_cast<char*>(&entryPoint_), sizeof(uint32_t));
+    if (!ifs || M_ < 2 || num_ > UINT32_MAX || (num_ > 0 && entryPoint_ >= num_)) {
+        return -3; // 文件头损坏
+    }
+    levelMult_ = 1.0 / std::log((double)M_);
+
+    data_.resize(num_ * dim_);
+    levels_.resize(num_);
+    links0_.resize(num_ * (2 * M_ + 1));
+    ifs.read(reinterpret_cast<char*>(data_.data()), data_.size() * sizeof(float));
+    ifs.read(reinterpret_cast<char*>(levels_.data()), levels_.size() * sizeof(int));
+    ifs.read(reinterpret_cast<char*>(links0_.data()), links0_.size() * sizeof(uint32_t));
+    upperLinks_.assign(num_, {});
+    for (uint64_t i = 0; i < num_; ++i) {
+        if (levels_[i] < 0 || levels_[i] > maxLevel_) {
+            return -3; // 层数损坏
+        }
+        upperLinks_[i].resize(levels_[i] * (M_ + 1));
+        ifs.read(reinterpret_cast<char*>(upperLinks_[i].data()), upperLinks_[i].size() * sizeof(uint32_t));
+    }
+    if (!ifs) {
+        return -3; // 文件不完整
+    }
+    nodeLocks_.clear();
+    for (uint64_t i = 0; i < num_; ++i) {
+        nodeLocks_.emplace_back();
+    }
+
+    ifs.close();
+    return 0; // 成功
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "MetricType.hpp"
+#include "backend/cpu-blas/kernels.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+    HNSW（分层可导航小世界图）索引
+    每个向量随机分配一个层数，第0层包含所有向量，每层中的节点与最多 M 个（第0层为 2M 个）近邻相连
+    查询时从最高层的入口点开始逐层贪心下降，在第0层用大小为 efSearch 的候选集做最佳优先搜索
+    单个查询只需要计算几百到几千次距离，适合逐条查询、对延迟敏感的场景
+
+    构建时用 OpenMP 并行插入，修改邻接表时对节点加锁；search 可以多线程同时调用，但不能与 addVector 并发
+*/
+class HNSWIndex
+{
+    public:
+        HNSWIndex(uint64_t dim, uint64_t M = 16, uint64_t efConstruction = 200,
+                  MetricType metricType = MetricType::METRIC_L2, uint64_t seed = 100);
+        ~HNSWIndex() {};
+
+        // 添加向量，向量的编号按添加顺序从0开始
+        void addVector(const float* vecs, uint64_t n);
+        // 获取向量数量
+        uint64_t getNum() const;
+        // 获取向量维度
+        uint64_t getDim() const;
+
+        // 查询时第0层候选集的大小，越大越准确，实际使用 max(efSearch, k)
+        void setEfSearch(uint64_t efSearch);
+        uint64_t getEfSearch() const;
+        uint64_t getM() const;
+        uint64_t getEfConstruction() const;
+        // 图的最高层数，空索引为-1
+        int getMaxLevel() const;
+
+        // 查询nQuery个向量并返回前k个匹配的向量
+        void search(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances
+        );
+
+        // 根据编号取回向量
+        void reconstruct(
+            uint64_t idx,
+            float* vec
+        );
+
+        int save(const std::string filename);
+        int load(const std::string filename);
+
+    private:
+        using Candidate = std::pair<float, uint32_t>;   // (距离, 节点)
+        // 距离越大越靠前，用来保存当前最好的 ef 个结果
+        using MaxHeap = std::priority_queue<Candidate>;
+
+        // 内部统一使用"越小越近"的距离，内积取相反数
+        float distance(const float* x, uint32_t id) const;
+        // 第 level 层的邻接表，[0] 为邻居数量，之后是邻居编号
+        uint32_t* linkList(uint32_t node, int level);
+        const uint32_t* linkList(uint32_t node, int level) const;
+        uint64_t maxLinks(int level) const;
+
+        // 复制 node 在 level 层的邻居，构建期间需要加锁
+        void copyLinks(uint32_t node, int level, bool lock, std::vector<uint32_t>& out) const;
+        // 从 entry 出发在 level 层贪心地走到离x最近的节点
+        uint32_t greedySearch(const float* x, uint32_t entry, float& entryDistance, int level, bool lock) const;
+        // 在 level 层做最佳优先搜索，返回最近的 ef 个节点
+        MaxHeap searchLayer(const float* x, const MaxHeap& entries, uint64_t ef, int level, bool lock) const;
+        // 启发式选边：候选按距离从近到远，只保留比已选邻居更靠近基准点的候选，最多 maxM 个
+        void selectNeighbors(std::vector<Candidate>& candidates, uint64_t maxM) const;
+        // 插入一个已经写入 data_ 的节点
+        void insert(uint32_t node);
+        // 给 node 的 level 层增加一条指向 target 的边，超过上限时重新选边
+        void addLink(uint32_t node, uint32_t target, int level);
+
+        uint64_t dim_;                      // 向量维度
+        uint64_t M_;                        // 每层的最大邻居数（第0层为 2M）
+        uint64_t efConstruction_;           // 构建时候选集的大小
+        uint64_t efSearch_;                 // 查询时候选集的大小
+        MetricType metricType_;             // 距离计算方式
+        uint64_t num_;                      // 向量数量
+        int maxLevel_;                      // 当前最高层
+        uint32_t entryPoint_;               // 最高层的入口节点
+        double levelMult_;                  // 随机层数的系数 1 / ln(M)
+        std::mt19937 rng_;                  // 生成随机层数
+        const cpu_blas::DistanceKernels* kernels_;      // 距离计算内核
+
+        std::vector<float> data_;           // num_ * dim_ 个原始向量
+        std::vector<int> levels_;           // 每个节点的层数
+        std::vector<uint32_t> links0_;      // 第0层的邻接表，每个节点 2M + 1 个位置
+        std::vector<std::vector<uint32_t>> upperLinks_;     // 第1层及以上的邻接表，每层 M + 1 个位置
+        mutable std::deque<std::mutex> nodeLocks_;  // 每个节点一把锁，deque 扩容时不移动已有元素
+        std::mutex entryLock_;              // 保护 maxLevel_ / entryPoint_
+};
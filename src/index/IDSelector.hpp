@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+/*
+    过滤查询时选择参与查询的向量，编号与 search 返回的编号相同（使用外部编号时为标签，否则为行号）
+    支持三种形式：位图、升序排列的编号列表、区间 [begin, end)
+    只保存指针，不复制数据，查询期间数据需要保持有效
+*/
+class IDSelector
+{
+    public:
+        enum class Type {
+            BITSET,         // 第 id 位置位表示选中，超过 nbits 的编号不选中
+            SORTED_LIST,    // 升序排列的编号
+            RANGE,          // begin <= id < end
+        };
+
+        static IDSelector bitset(const uint64_t* bits, uint64_t nbits) {
+            return IDSelector(Type::BITSET, bits, nbits, 0, 0);
+        }
+
+        static IDSelector sortedList(const uint64_t* ids, uint64_t n) {
+            return IDSelector(Type::SORTED_LIST, ids, n, 0, 0);
+        }
+
+        static IDSelector range(uint64_t begin, uint64_t end) {
+            return IDSelector(Type::RANGE, nullptr, 0, begin, end);
+        }
+
+        bool contains(uint64_t id) const {
+            switch (type_) {
+                case Type::BITSET:
+                    return id < size_ && ((data_[id >> 6] >> (id & 63)) & 1);
+                case Type::SORTED_LIST:
+                    return std::binary_search(data_, data_ + size_, id);
+                case Type::RANGE:
+                    return id >= begin_ && id < end_;
+            }
+            return false;
+        }
+
+        Type getType() const {
+            return type_;
+        }
+
+        // 位图的字或者编号列表
+        const uint64_t* getData() const {
+            return data_;
+        }
+
+        // 位图的位数或者编号列表的长度
+        uint64_t getSize() const {
+            return size_;
+        }
+
+        uint64_t getBegin() const {
+            return begin_;
+        }
+
+        uint64_t getEnd() const {
+            return end_;
+        }
+
+    private:
+        IDSelector(Type type, const uint64_t* data, uint64_t size, uint64_t begin, uint64_t end)
+            : type_(type), data_(data), size_(size), begin_(begin), end_(end) {}
+
+        Type type_;
+        const uint64_t* data_;
+        uint64_t size_;
+        uint64_t begin_;
+        uint64_t end_;
+};
@@ -0,0 +1,315 @@
+#include "index/IVFFlatIndex.hpp"
+#include "index/KMeans.hpp"
+#include "backend/cpu-blas/distance.hpp"
+#include "backend/cpu-blas/heap.hpp"
+#include "backend/cpu-blas/kernels.hpp"
+#include "backend/gpu-kompute/distance.hpp"
+#include "backend/npu-hexagon/distance.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+// 与 FlatIndex 共用同一个Kompute管理器
+extern kp::Manager AllMgr;
+
+IVFFlatIndex::IVFFlatIndex(uint64_t dim, uint64_t nlist, MetricType metricType)
+        : dim_(dim), nlist_(nlist), nprobe_(1), num_(0), trained_(false), metricType_(metricType),
+          listData_(nlist), listNorms_(nlist), listIds_(nlist) {
+    if (nlist == 0) {
+        throw std::invalid_argument("IVFFlatIndex: nlist must be positive");
+    }
+}
+
+void IVFFlatIndex::train(const float* vecs, uint64_t n) {
+    KMeans kmeans(dim_, nlist_);
+    kmeans.train(vecs, n);
+    centroids_ = kmeans.getCentroids();
+    centroidNorms_.resize(nlist_);
+    cpu_blas::fvec_norms_L2sqr(centroidNorms_.data(), centroids_.data(), dim_, nlist_);
+    trained_ = true;
+}
+
+bool IVFFlatIndex::isTrained() const {
+    return trained_;
+}
+
+void IVFFlatIndex::assign(const float* vecs, uint64_t n, uint64_t nprobe, uint64_t* lists, float* distances) const {
+    // 粗聚类中心很少，查找最近的 nprobe 个中心就是一次L2检索
+    cpu_blas::calL2BLAS(vecs, centroids_.data(), n, nlist_, dim_, nprobe, distances, lists, centroidNorms_.data());
+}
+
+void IVFFlatIndex::addVector(const float* vecs, uint64_t n) {
+    if (!trained_) {
+        throw std::runtime_error("IVFFlatIndex must be trained before adding vectors");
+    }
+    if (n == 0) {
+        return;
+    }
+    std::vector<uint64_t> lists(n);
+    std::vector<float> distances(n);
+    assign(vecs, n, 1, lists.data(), distances.data());
+
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+    idToList_.resize(num_ + n);
+    idToOffset_.resize(num_ + n);
+    for (uint64_t i = 0; i < n; ++i) {
+        const uint64_t l = lists[i];
+        const float* v = vecs + i * dim_;
+        idToList_[num_ + i] = l;
+        idToOffset_[num_ + i] = listIds_[l].size();
+        listData_[l].insert(listData_[l].end(), v, v + dim_);
+        listNorms_[l].push_back(kernels.norm_L2sqr(v, dim_));
+        listIds_[l].push_back(num_ + i);
+    }
+    num_ += n;
+}
+
+uint64_t IVFFlatIndex::getNum() const {
+    return num_;
+}
+
+uint64_t IVFFlatIndex::getDim() const {
+    return dim_;
+}
+
+void IVFFlatIndex::setNprobe(uint64_t nprobe) {
+    nprobe_ = std::max<uint64_t>(nprobe, 1);
+}
+
+uint64_t IVFFlatIndex::getNprobe() const {
+    return nprobe_;
+}
+
+uint64_t IVFFlatIndex::getNlist() const {
+    return nlist_;
+}
+
+uint64_t IVFFlatIndex::getListSize(uint64_t list) const {
+    return list < nlist_ ? listIds_[list].size() : 0;
+}
+
+void IVFFlatIndex::scanList(
+    uint64_t list,
+    uint64_t k,
+    DeviceType device,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances
+) {
+    const uint64_t nData = listIds_[list].size();
+    const float* data = listData_[list].data();
+    const float* dataNorm = listNorms_[list].data();
+    if (device == DeviceType::CPU_BLAS) {
+        cpu_blas::query(nQuery, nData, k, dim_, query, data, dataNorm, distances, results, metricType_);
+    } else if (device == DeviceType::GPU_KOMPUTE) {
+        gpu_kompute::query(&AllMgr, nQuery, nData, k, dim_, query, data, dataNorm, distances, results, metricType_, nullptr);
+    } else if (device == DeviceType::NPU_HEXAGON) {
+        npu_hexagon::query(nQuery, nData, k, dim_, query, data, dataNorm, distances, results, metricType_);
+    } else {
+        throw std::invalid_argument("Unsupported device type for query");
+    }
+}
+
+template <class Heap>
+void IVFFlatIndex::searchLists(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances,
+    DeviceType device,
+    float emptyDistance
+) {
+    const uint64_t nprobe = std::min(nprobe_, nlist_);
+    std::vector<uint64_t> probes(nQuery * nprobe);
+    std::vector<float> probeDistances(nQuery * nprobe);
+    assign(query, nQuery, nprobe, probes.data(), probeDistances.data());
+
+    // 按倒排表把查询分组，每个倒排表只调用一次后端，多个查询仍然可以走GEMM
+    std::vector<std::vector<uint64_t>> listQueries(nlist_);
+    for (uint64_t q = 0; q < nQuery; ++q) {
+        for (uint64_t p = 0; p < nprobe; ++p) {
+            const uint64_t l = probes[q * nprobe + p];
+            if (l < nlist_ && !listIds_[l].empty()) {
+                listQueries[l].push_back(q);
+            }
+        }
+    }
+
+    std::vector<Heap> heaps(nQuery);
+    std::vector<float> queryBuf;
+    std::vector<uint64_t> listResults;
+    std::vector<float> listDistances;
+    for (uint64_t l = 0; l < nlist_; ++l) {
+        const std::vector<uint64_t>& qs = listQueries[l];
+        if (qs.empty()) {
+            continue;
+        }
+        const uint64_t nq = qs.size();
+        const uint64_t kk = std::min<uint64_t>(k, listIds_[l].size());
+        queryBuf.resize(nq * dim_);
+        for (uint64_t i = 0; i < nq; ++i) {
+            std::copy(query + qs[i] * dim_, query + (qs[i] + 1) * dim_, queryBuf.data() + i * dim_);
+        }
+        listResults.resize(nq * kk);
+        listDistances.resize(nq * kk);
+        scanList(l, kk, device, nq, queryBuf.data(), listResults.data(), listDistances.data());
+
+        const std::vector<uint64_t>& ids = listIds_[l];
+        for (uint64_t i = 0; i < nq; ++i) {
+            for (uint64_t j = 0; j < kk; ++j) {
+                const uint64_t r = listResults[i * kk + j];
+                if (r < ids.size()) {
+                    cpu_blas::heapPush(heaps[qs[i]], k, listDistances[i * kk + j], ids[r]);
+                }
+            }
+        }
+    }
+
+    for (uint64_t q = 0; q < nQuery; ++q) {
+        cpu_blas::heapToOutput(heaps[q], k, emptyDistance, distances + q * k, results + q * k);
+    }
+}
+
+void IVFFlatIndex::search(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances,
+    DeviceType device
+) {
+    if (nQuery == 0 || k == 0) {
+        return;
+    }
+    if (!trained_) {
+        throw std::runtime_error("IVFFlatIndex must be trained before searching");
+    }
+    if (metricType_ == MetricType::METRIC_INNER_PRODUCT) {
+        searchLists<cpu_blas::IPHeap>(k, nQuery, query, results, distances, device, -HUGE_VALF);
+    } else {
+        searchLists<cpu_blas::L2Heap>(k, nQuery, query, results, distances, device, HUGE_VALF);
+    }
+}
+
+void IVFFlatIndex::reconstruct(
+    uint64_t idx,
+    float* vec
+) {
+    if (idx >= num_) {
+        // 索引超出范围
+        return;
+    }
+    const float* src = listData_[idToList_[idx]].data() + idToOffset_[idx] * dim_;
+    std::copy(src, src + dim_, vec);
+}
+
+const std::vector<float>& IVFFlatIndex::getCentroids() const {
+    return centroids_;
+}
+
+int IVFFlatIndex::save(const std::string filename) {
+    try {
+        std::filesystem::path dir_path = std::filesystem::path(filename).parent_path();
+        if (!dir_path.empty()) {
+            std::filesystem::create_directories(dir_path);
+        }
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Filesystem error while creating directory: " << e.what() << std::endl;
+        return -1;
+    }
+
+    std::ofstream ofs(filename, std::ios::binary);
+    if (!ofs) {
+        return -1; // 打开文件失败
+    }
+
+    // header
+    /*
+        magicNumber + dim + nlist + nprobe + num + metricType + trained + 粗聚类中心
+        之后每个倒排表依次为: 向量数量 + 全局编号 + 向量
+        范数和编号到倒排表的映射在加载时重新计算
+    */
+    uint64_t magicNumber = 1150;
+    ofs.write(reinterpret_cast<const char*>(&magicNumber), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&dim_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&nlist_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&nprobe_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&num_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&metricType_), sizeof(MetricType));
+    ofs.write(reinterpret_cast<const char*>(&trained_), sizeof(bool));
+    if (trained_) {
+        ofs.write(reinterpret_cast<const char*>(centroids_.data()), nlist_ * dim_ * sizeof(float));
+    }
+    for (uint64_t l = 0; l < nlist_; ++l) {
+        uint64_t size = listIds_[l].size();
+        ofs.write(reinterpret_cast<const char*>(&size), sizeof(uint64_t));
+        ofs.write(reinterpret_cast<const char*>(listIds_[l].data()), size * sizeof(uint64_t));
+        ofs.write(reinterpret_cast<const char*>(listData_[l].data()), size * dim_ * sizeof(float));
+    }
+
+    ofs.close();
+    return 0; // 成功
+}
+
+int IVFFlatIndex::load(const std::string filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) {
+        return -1; // 打开文件失败
+    }
+
+    uint64_t magicNumber;
+    ifs.read(reinterpret_cast<char*>(&magicNumber), sizeof(uint64_t));
+    if (magicNumber != 1150) {
+        return -2; // 魔数不匹配
+    }
+    ifs.read(reinterpret_cast<char*>(&dim_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&nlist_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&nprobe_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&num_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&metricType_), sizeof(MetricType));
+    ifs.read(reinterpret_cast<char*>(&trained_), sizeof(bool));
+    if (!ifs || nlist_ == 0) {
+        return -3; // 文件头损坏
+    }
+    centroids_.assign(trained_ ? nlist_ * dim_ : 0, 0.0f);
+    ifs.read(reinterpret_cast<char*>(centroids_.data()), centroids_.size() * sizeof(float));
+    centroidNorms_.resize(trained_ ? nlist_ : 0);
+    cpu_blas::fvec_norms_L2sqr(centroidNorms_.data(), centroids_.data(), dim_, centroidNorms_.size());
+
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+    listData_.assign(nlist_, {});
+    listNorms_.assign(nlist_, {});
+    listIds_.assign(nlist_, {});
+    idToList_.assign(num_, 0);
+    idToOffset_.assign(num_, 0);
+    for (uint64_t l = 0; l < nlist_; ++l) {
+        uint64_t size = 0;
+        ifs.read(reinterpret_cast<char*>(&size), sizeof(uint64_t));
+        if (!ifs || size > num_) {
+            return -3; // 倒排表损坏
+        }
+        listIds_[l].resize(size);
+        listData_[l].resize(size * dim_);
+        ifs.read(reinterpret_cast<char*>(listIds_[l].data()), size * sizeof(uint64_t));
+        ifs.read(reinterpret_cast<char*>(listData_[l].data()), size * dim_ * sizeof(float));
+        listNorms_[l].resize(size);
+        for (uint64_t i = 0; i < size; ++i) {
+            const uint64_t id = listIds_[l][i];
+            if (id >= num_) {
+                return -3; // 编号超出范围
+            }
+            idToList_[id] = l;
+            idToOffset_[id] = i;
+            listNorms_[l][i] = kernels.norm_L2sqr(listData_[l].data() + i * dim_, dim_);
+        }
+    }
+
+    ifs.close();
+    return 0; // 成功
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "MetricType.hpp"
+#include "Device.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+    倒排文件（IVF）索引
+    用 k-means 训练 nlist 个粗聚类中心，每个向量按L2距离放入最近中心对应的倒排表，
+    同一个倒排表中的向量连续存放；查询时只扫描距离查询最近的 nprobe 个倒排表
+    倒排表内的检索直接复用 FlatIndex 使用的 CPU/GPU/NPU 后端
+*/
+class IVFFlatIndex
+{
+    public:
+        IVFFlatIndex(uint64_t dim, uint64_t nlist, MetricType metricType = MetricType::METRIC_L2);
+        ~IVFFlatIndex() {};
+
+        // 训练粗聚类中心，需要至少 nlist 个样本
+        void train(const float* vecs, uint64_t n);
+        bool isTrained() const;
+
+        // 添加向量，需要先训练；向量的编号按添加顺序从0开始
+        void addVector(const float* vecs, uint64_t n);
+        // 获取向量数量
+        uint64_t getNum() const;
+        // 获取向量维度
+        uint64_t getDim() const;
+
+        // 查询时扫描的倒排表数量，默认为1，超过 nlist 时按 nlist 处理
+        void setNprobe(uint64_t nprobe);
+        uint64_t getNprobe() const;
+        uint64_t getNlist() const;
+        // 第 list 个倒排表中的向量数量
+        uint64_t getListSize(uint64_t list) const;
+
+        // 查询nQuery个向量并返回前k个匹配的向量，倒排表内的计算在device上完成
+        void search(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances,
+            DeviceType device = DeviceType::CPU_BLAS
+        );
+
+        // 根据编号取回向量
+        void reconstruct(
+            uint64_t idx,
+            float* vec
+        );
+
+        // nlist * dim 个粗聚类中心
+        const std::vector<float>& getCentroids() const;
+
+        int save(const std::string filename);
+        int load(const std::string filename);
+
+    private:
+        // 把n个向量分配到最近的粗聚类中心
+        void assign(const float* vecs, uint64_t n, uint64_t nprobe, uint64_t* lists, float* distances) const;
+
+        // 在device上检索一个倒排表，结果中的下标为表内下标
+        void scanList(
+            uint64_t list,
+            uint64_t k,
+            DeviceType device,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances
+        );
+
+        template <class Heap>
+        void searchLists(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances,
+            DeviceType device,
+            float emptyDistance
+        );
+
+        uint64_t dim_;                      // 向量维度
+        uint64_t nlist_;                    // 倒排表数量
+        uint64_t nprobe_;                   // 查询时扫描的倒排表数量
+        uint64_t num_;                      // 向量数量
+        bool trained_;                      // 是否已经训练
+        MetricType metricType_;             // 距离计算方式
+        std::vector<float> centroids_;      // nlist_ * dim_ 个粗聚类中心
+        std::vector<float> centroidNorms_;  // 粗聚类中心的平方范数，加速分配时的L2计算
+
+        std::vector<std::vector<float>> listData_;      // 每个倒排表连续存放的向量
+        std::vector<std::vector<float>> listNorms_;     // 每个向量的平方范数
+        std::vector<std::vector<uint64_t>> listIds_;    // 每个向量的全局编号
+        std::vector<uint64_t> idToList_;                // 全局编号所在的倒排表
+        std::vector<uint64_t> idToOffset_;              // 全局编号在倒排表中的位置
+};
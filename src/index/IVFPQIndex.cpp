@@ -0,0 +1,386 @@
+#include "index/IVFPQIndex.hpp"
+#include "index/KMeans.hpp"
+#include "backend/cpu-blas/distance.hpp"
+#include "backend/cpu-blas/heap.hpp"
+#include "backend/cpu-blas/kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <omp.h>
+#include <stdexcept>
+
+IVFPQIndex::IVFPQIndex(uint64_t dim, uint64_t nlist, uint64_t M, uint64_t nbits, MetricType metricType)
+        : dim_(dim), nlist_(nlist), nprobe_(1), num_(0), trained_(false), metricType_(metricType),
+          pq_(dim, M, nbits), listCodes_(nlist), listIds_(nlist) {
+    if (nlist == 0) {
+        throw std::invalid_argument("IVFPQIndex: nlist must be positive");
+    }
+}
+
+void IVFPQIndex::assign(const float* vecs, uint64_t n, uint64_t nprobe, uint64_t* lists, float* distances) const {
+    cpu_blas::calL2BLAS(vecs, centroids_.data(), n, nlist_, dim_, nprobe, distances, lists, centroidNorms_.data());
+}
+
+void IVFPQIndex::train(const float* vecs, uint64_t n) {
+    KMeans kmeans(dim_, nlist_);
+    kmeans.train(vecs, n);
+    centroids_ = kmeans.getCentroids();
+    centroidNorms_.resize(nlist_);
+    cpu_blas::fvec_norms_L2sqr(centroidNorms_.data(), centroids_.data(), dim_, nlist_);
+
+    // 子量化器在残差上训练
+    std::vector<uint64_t> lists(n);
+    std::vector<float> distances(n);
+    assign(vecs, n, 1, lists.data(), distances.data());
+    std::vector<float> residuals(n * dim_);
+    for (uint64_t i = 0; i < n; ++i) {
+        const float* c = centroids_.data() + lists[i] * dim_;
+        for (uint64_t d = 0; d < dim_; ++d) {
+            residuals[i * dim_ + d] = vecs[i * dim_ + d] - c[d];
+        }
+    }
+    pq_.train(residuals.data(), n);
+    trained_ = true;
+    precompute();
+}
+
+void IVFPQIndex::precompute() {
+    centroidNorms_.resize(nlist_);
+    cpu_blas::fvec_norms_L2sqr(centroidNorms_.data(), centroids_.data(), dim_, nlist_);
+
+    precomputedTable_.clear();
+    const uint64_t M = pq_.getM();
+    const uint64_t ksub = pq_.getKsub();
+    const uint64_t dsub = pq_.getDsub();
+    if (metricType_ != MetricType::METRIC_L2 || nlist_ * M * ksub * sizeof(float) > precomputedTableMaxBytes) {
+        return;
+    }
+
+    // table[l][m][j] = ||r_mj||^2 + 2 <c_l 的第m段, r_mj>
+    const std::vector<float>& subCentroids = pq_.getCentroids();
+    std::vector<float> subNorms(M * ksub);
+    cpu_blas::fvec_norms_L2sqr(subNorms.data(), subCentroids.data(), dsub, M * ksub);
+    precomputedTable_.resize(nlist_ * M * ksub);
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+#pragma omp parallel for if (nlist_ > 16)
+    for (int64_t l = 0; l < (int64_t)nlist_; ++l) {
+        for (uint64_t m = 0; m < M; ++m) {
+            float* t = precomputedTable_.data() + (l * M + m) * ksub;
+            kernels.inner_products_ny(t, centroids_.data() + l * dim_ + m * dsub,
+                                      subCentroids.data() + m * ksub * dsub, dsub, ksub);
+            for (uint64_t j = 0; j < ksub; ++j) {
+                t[j] = subNorms[m * ksub + j] + 2 * t[j];
+            }
+        }
+    }
+}
+
+bool IVFPQIndex::isTrained() const {
+    return trained_;
+}
+
+void IVFPQIndex::addVector(const float* vecs, uint64_t n) {
+    if (!trained_) {
+        throw std::runtime_error("IVFPQIndex must be trained before adding vectors");
+    }
+    if (n == 0) {
+        return;
+    }
+    std::vector<uint64_t> lists(n);
+    std::vector<float> distances(n);
+    assign(vecs, n, 1, lists.data(), distances.data());
+
+    std::vector<float> residuals(n * dim_);
+    for (uint64_t i = 0; i < n; ++i) {
+        const float* c = centroids_.data() + lists[i] * dim_;
+        for (uint64_t d = 0; d < dim_; ++d) {
+            residuals[i * dim_ + d] = vecs[i * dim_ + d] - c[d];
+        }
+    }
+    const uint64_t codeSize = pq_.getCodeSize();
+    std::vector<uint8_t> codes(n * codeSize);
+    pq_.encode(residuals.data(), n, codes.data());
+
+    idToList_.resize(num_ + n);
+    idToOffset_.resize(num_ + n);
+    for (uint64_t i = 0; i < n; ++i) {
+        const uint64_t l = lists[i];
+        idToList_[num_ + i] = l;
+        idToOffset_[num_ + i] = listIds_[l].size();
+        listCodes_[l].insert(listCodes_[l].end(), codes.data() + i * codeSize, codes.data() + (i + 1) * codeSize);
+        listIds_[l].push_back(num_ + i);
+    }
+    num_ += n;
+}
+
+uint64_t IVFPQIndex::getNum() const {
+    return num_;
+}
+
+uint64_t IVFPQIndex::getDim() const {
+    return dim_;
+}
+
+void IVFPQIndex::setNprobe(uint64_t nprobe) {
+    nprobe_ = std::max<uint64_t>(nprobe, 1);
+}
+
+uint64_t IVFPQIndex::getNprobe() const {
+    return nprobe_;
+}
+
+uint64_t IVFPQIndex::getNlist() const {
+    return nlist_;
+}
+
+uint64_t IVFPQIndex::getListSize(uint64_t list) const {
+    return list < nlist_ ? listIds_[list].size() : 0;
+}
+
+const float* IVFPQIndex::listTable(
+    const float* x,
+    const float* queryTable,
+    uint64_t list,
+    float coarseDistance,
+    float* buf,
+    float* residual,
+    float& bias
+) const {
+    const uint64_t tableSize = pq_.getM() * pq_.getKsub();
+    if (metricType_ == MetricType::METRIC_INNER_PRODUCT) {
+        // <x, c + r> = <x, c> + <x, r>
+        bias = cpu_blas::fvec_inner_product(x, centroids_.data() + list * dim_, dim_);
+        return queryTable;
+    }
+    if (!precomputedTable_.empty()) {
+        // ||x - c||^2 + (||r||^2 + 2<c, r>) - 2<x, r>
+        const float* pre = precomputedTable_.data() + list * tableSize;
+        for (uint64_t i = 0; i < tableSize; ++i) {
+            buf[i] = pre[i] - 2 * queryTable[i];
+        }
+        bias = coarseDistance;
+        return buf;
+    }
+    // 没有预计算表时直接用查询的残差计算
+    const float* c = centroids_.data() + list * dim_;
+    for (uint64_t d = 0; d < dim_; ++d) {
+        residual[d] = x[d] - c[d];
+    }
+    pq_.computeDistanceTables(residual, 1, MetricType::METRIC_L2, buf);
+    bias = 0;
+    return buf;
+}
+
+template <class Heap>
+void IVFPQIndex::searchLists(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances,
+    float emptyDistance
+) {
+    const uint64_t nprobe = std::min(nprobe_, nlist_);
+    std::vector<uint64_t> probes(nQuery * nprobe);
+    std::vector<float> probeDistances(nQuery * nprobe);
+    assign(query, nQuery, nprobe, probes.data(), probeDistances.data());
+
+    // 与倒排表无关的 <x, r> 表，每个查询只计算一次
+    const uint64_t tableSize = pq_.getM() * pq_.getKsub();
+    const bool useQueryTable = metricType_ == MetricType::METRIC_INNER_PRODUCT || !precomputedTable_.empty();
+    std::vector<float> queryTables(useQueryTable ? nQuery * tableSize : 0);
+    if (useQueryTable) {
+        pq_.computeDistanceTables(query, nQuery, MetricType::METRIC_INNER_PRODUCT, queryTables.data());
+    }
+
+    const uint64_t codeSize = pq_.getCodeSize();
+    auto scanProbe = [&](uint64_t q, uint64_t p, Heap& heap, std::vector<float>& table, std::vector<float>& residual) {
+        const uint64_t l = probes[q * nprobe + p];
+        if (l >= nlist_ || listIds_[l].empty()) {
+            return;
+        }
+        const float* x = query + q * dim_;
+        const float* qt = useQueryTable ? queryTables.data() + q * tableSize : nullptr;
+        float bias;
+        const float* t = listTable(x, qt, l, probeDistances[q * nprobe + p], table.data(), residual.data(), bias);
+        const uint8_t* codes = listCodes_[l].data();
+        const std::vector<uint64_t>& ids = listIds_[l];
+        for (uint64_t j = 0; j < ids.size(); ++j) {
+            cpu_blas::heapPush(heap, k, bias + pq_.adc(t, codes + j * codeSize), ids[j]);
+        }
+    };
+
+    // 查询足够多时按查询并行，否则把一个查询的各个倒排表分给不同线程后再合并
+    const uint64_t nThreads = omp_get_max_threads();
+    if (nQuery >= nThreads || nprobe == 1) {
+#pragma omp parallel for if (nQuery > 1)
+        for (int64_t q = 0; q < (int64_t)nQuery; ++q) {
+            std::vector<float> table(tableSize), residual(dim_);
+            Heap heap;
+            for (uint64_t p = 0; p < nprobe; ++p) {
+                scanProbe(q, p, heap, table, residual);
+            }
+            cpu_blas::heapToOutput(heap, k, emptyDistance, distances + q * k, results + q * k);
+        }
+        return;
+    }
+
+    for (uint64_t q = 0; q < nQuery; ++q) {
+        std::vector<Heap> heaps(nprobe);
+#pragma omp parallel for
+        for (int64_t p = 0; p < (int64_t)nprobe; ++p) {
+            std::vector<float> table(tableSize), residual(dim_);
+            scanProbe(q, p, heaps[p], table, residual);
+        }
+        for (uint64_t p = 1; p < nprobe; ++p) {
+            cpu_blas::heapMerge(heaps[0], heaps[p], k);
+        }
+        cpu_blas::heapToOutput(heaps[0], k, emptyDistance, distances + q * k, results + q * k);
+    }
+}
+
+void IVFPQIndex::search(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances
+) {
+    if (nQuery == 0 || k == 0) {
+        return;
+    }
+    if (!trained_) {
+        throw std::runtime_error("IVFPQIndex must be trained before searching");
+    }
+    if (metricType_ == MetricType::METRIC_INNER_PRODUCT) {
+        searchLists<cpu_blas::IPHeap>(k, nQuery, query, results, distances, -HUGE_VALF);
+    } else {
+        searchLists<cpu_blas::L2Heap>(k, nQuery, query, results, distances, HUGE_VALF);
+    }
+}
+
+void IVFPQIndex::reconstruct(
+    uint64_t idx,
+    float* vec
+) {
+    if (idx >= num_) {
+        // 索引超出范围
+        return;
+    }
+    const uint64_t l = idToList_[idx];
+    pq_.decode(listCodes_[l].data() + idToOffset_[idx] * pq_.getCodeSize(), 1, vec);
+    const float* c = centroids_.data() + l * dim_;
+    for (uint64_t d = 0; d < dim_; ++d) {
+        vec[d] += c[d];
+    }
+}
+
+const ProductQuantizer& IVFPQIndex::getQuantizer() const {
+    return pq_;
+}
+
+int IVFPQIndex::save(const std::string filename) {
+    try {
+        std::filesystem::path dir_path = std::filesystem::path(filename).parent_path();
+        if (!dir_path.empty()) {
+            std::filesystem::create_directories(dir_path);
+        }
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Filesystem error while creating directory: " << e.what() << std::endl;
+        return -1;
+    }
+
+    std::ofstream ofs(filename, std::ios::binary);
+    if (!ofs) {
+        return -1; // 打开文件失败
+    }
+
+    // header
+    /*
+        magicNumber + dim + nlist + nprobe + num + metricType + trained + 粗聚类中心 + PQ参数与子中心
+        之后每个倒排表依次为: 向量数量 + 全局编号 + 编码
+        预计算表在加载时重新计算
+    */
+    uint64_t magicNumber = 1151;
+    ofs.write(reinterpret_cast<const char*>(&magicNumber), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&dim_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&nlist_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&nprobe_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&num_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&metricType_), sizeof(MetricType));
+    ofs.write(reinterpret_cast<const char*>(&trained_), sizeof(bool));
+    if (trained_) {
+        ofs.write(reinterpret_cast<const char*>(centroids_.data()), nlist_ * dim_ * sizeof(float));
+    }
+    pq_.write(ofs);
+    for (uint64_t l = 0; l < nlist_; ++l) {
+        uint64_t size = listIds_[l].size();
+        ofs.write(reinterpret_cast<const char*>(&size), sizeof(uint64_t));
+        ofs.write(reinterpret_cast<const char*>(listIds_[l].data()), size * sizeof(uint64_t));
+        ofs.write(reinterpret_cast<const char*>(listCodes_[l].data()), size * pq_.getCodeSize());
+    }
+
+    ofs.close();
+    return 0; // 成功
+}
+
+int IVFPQIndex::load(const std::string filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) {
+        return -1; // 打开文件失败
+    }
+
+    uint64_t magicNumber;
+    ifs.read(reinterpret_cast<char*>(&magicNumber), sizeof(uint64_t));
+    if (magicNumber != 1151) {
+        return -2; // 魔数不匹配
+    }
+    ifs.read(reinterpret_cast<char*>(&dim_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&nlist_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&nprobe_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&num_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&metricType_), sizeof(MetricType));
+    ifs.read(reinterpret_cast<char*>(&trained_), sizeof(bool));
+    if (!ifs || nlist_ == 0) {
+        return -3; // 文件头损坏
+    }
+    centroids_.assign(trained_ ? nlist_ * dim_ : 0, 0.0f);
+    ifs.read(reinterpret_cast<char*>(centroids_.data()), centroids_.size() * sizeof(float));
+    if (!pq_.read(ifs) || pq_.getDim() != dim_) {
+        return -3; // PQ参数损坏
+    }
+
+    const uint64_t codeSize = pq_.getCodeSize();
+    listCodes_.assign(nlist_, {});
+    listIds_.assign(nlist_, {});
+    idToList_.assign(num_, 0);
+    idToOffset_.assign(num_, 0);
+    for (uint64_t l = 0; l < nlist_; ++l) {
+        uint64_t size = 0;
+        ifs.read(reinterpret_cast<char*>(&size), sizeof(uint64_t));
+        if (!ifs || size > num_) {
+            return -3; // 倒排表损坏
+        }
+        listIds_[l].resize(size);
+        listCodes_[l].resize(size * codeSize);
+        ifs.read(reinterpret_cast<char*>(listIds_[l].data()), size * sizeof(uint64_t));
+        ifs.read(reinterpret_cast<char*>(listCodes_[l].data()), size * codeSize);
+        for (uint64_t i = 0; i < size; ++i) {
+            const uint64_t id = listIds_[l][i];
+            if (id >= num_) {
+                return -3; // 编号超出范围
+            }
+            idToList_[id] = l;
+            idToOffset_[id] = i;
+        }
+    }
+    if (trained_) {
+        precompute();
+    }
+
+    ifs.close();
+    return 0; // 成功
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "MetricType.hpp"
+#include "ProductQuantizer.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+    倒排文件 + 残差乘积量化（IVF-PQ）索引
+    先用粗聚类中心把向量分到 nlist 个倒排表，再用PQ编码向量相对所属中心的残差 r = x - c，
+    每个向量只保存M字节的编码
+    L2距离按 ||x - c - r||^2 = ||x - c||^2 + (||r||^2 + 2<c, r>) - 2<x, r> 拆开：
+        第一项在选择倒排表时已经得到，第二项只与倒排表有关，训练后预先计算成表，
+        第三项只与查询有关，每个查询计算一次，扫描每个倒排表前把三者相加得到该表的距离表
+    内积 <x, c + r> = <x, c> + <x, r>，距离表与倒排表无关，只需要加上偏置
+*/
+class IVFPQIndex
+{
+    public:
+        IVFPQIndex(uint64_t dim, uint64_t nlist, uint64_t M, uint64_t nbits = 8, MetricType metricType = MetricType::METRIC_L2);
+        ~IVFPQIndex() {};
+
+        // 训练粗聚类中心和残差的子量化器
+        void train(const float* vecs, uint64_t n);
+        bool isTrained() const;
+
+        // 添加向量，需要先训练；向量的编号按添加顺序从0开始
+        void addVector(const float* vecs, uint64_t n);
+        // 获取向量数量
+        uint64_t getNum() const;
+        // 获取向量维度
+        uint64_t getDim() const;
+
+        // 查询时扫描的倒排表数量，默认为1，超过 nlist 时按 nlist 处理
+        void setNprobe(uint64_t nprobe);
+        uint64_t getNprobe() const;
+        uint64_t getNlist() const;
+        // 第 list 个倒排表中的向量数量
+        uint64_t getListSize(uint64_t list) const;
+
+        // 查询nQuery个向量并返回前k个匹配的向量
+        void search(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances
+        );
+
+        // 根据编号解码向量（粗聚类中心 + 解码后的残差）
+        void reconstruct(
+            uint64_t idx,
+            float* vec
+        );
+
+        const ProductQuantizer& getQuantizer() const;
+
+        int save(const std::string filename);
+        int load(const std::string filename);
+
+        /*
+            预计算表大小为 nlist * M * ksub 个float，超过该字节数时不预计算，
+            改为每个（查询，倒排表）直接用残差计算距离表
+        */
+        uint64_t precomputedTableMaxBytes = 1ull << 30;
+
+    private:
+        // 把n个向量分配到最近的 nprobe 个粗聚类中心
+        void assign(const float* vecs, uint64_t n, uint64_t nprobe, uint64_t* lists, float* distances) const;
+        // 训练或加载后计算中心的范数和预计算表
+        void precompute();
+        /*
+            得到查询x在第 list 个倒排表上的距离表，bias 为需要加到查表结果上的偏置
+            距离表与倒排表无关时直接返回 queryTable，否则写入 buf 并返回 buf
+        */
+        const float* listTable(
+            const float* x,
+            const float* queryTable,
+            uint64_t list,
+            float coarseDistance,
+            float* buf,
+            float* residual,
+            float& bias
+        ) const;
+
+        template <class Heap>
+        void searchLists(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances,
+            float emptyDistance
+        );
+
+        uint64_t dim_;                      // 向量维度
+        uint64_t nlist_;                    // 倒排表数量
+        uint64_t nprobe_;                   // 查询时扫描的倒排表数量
+        uint64_t num_;                      // 向量数量
+        bool trained_;                      // 是否已经训练
+        MetricType metricType_;             // 距离计算方式
+        ProductQuantizer pq_;               // 残差的编解码器
+        std::vector<float> centroids_;      // nlist_ * dim_ 个粗聚类中心
+        std::vector<float> centroidNorms_;  // 粗聚类中心的平方范数
+        std::vector<float> precomputedTable_;   // nlist * M * ksub，||r||^2 + 2<c, r>，为空时不使用
+
+        std::vector<std::vector<uint8_t>> listCodes_;   // 每个倒排表连续存放的编码
+        std::vector<std::vector<uint64_t>> listIds_;    // 每个向量的全局编号
+        std::vector<uint64_t> idToList_;                // 全局编号所在的倒排表
+        std::vector<uint64_t> idToOffset_;              // 全局编号在倒排表中的位置
+};
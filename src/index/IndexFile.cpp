@@ -0,0 +1,316 @@
+#include "index/IndexFile.hpp"
+#include "index/FileSync.hpp"
+#include "backend/cpu-blas/kernels.hpp"
+
+#include <algorithm>
+#include <cstddef>  // offsetof
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+const uint64_t kMagic = 0x58444e4942445645ull;     // "EVDBINDX"，按小端序读出
+const uint32_t kVersion = 2;
+const uint64_t kAlign = 4096;
+const uint64_t kChecksumBlock = 1ull << 20;
+
+// 文件头，位于文件开始处，之后紧接段表
+struct FileHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t indexType;
+    uint32_t headerSize;        // 文件头加段表并填充后的长度，第一个段从这里开始
+    uint32_t numSections;
+    uint64_t fileSize;
+    uint32_t checksumBlock;     // 段校验和的分块大小
+    uint32_t checksum;          // 文件头和段表的CRC32C，计算时该字段为0
+    uint8_t reserved[24];
+};
+static_assert(sizeof(FileHeader) == 64, "FileHeader must be 64 bytes");
+
+struct SectionEntry {
+    uint32_t id;
+    uint32_t checksum;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t reserved;
+};
+static_assert(sizeof(SectionEntry) == 32, "SectionEntry must be 32 bytes");
+
+// 一个4KB的文件头最多容纳的段数
+const uint64_t kMaxSections = (kAlign - sizeof(FileHeader)) / sizeof(SectionEntry);
+
+uint64_t alignUp(uint64_t offset) {
+    return (offset + kAlign - 1) / kAlign * kAlign;
+}
+
+// 一个段的数据，由一个或多个不连续的部分依次连接而成
+using Parts = std::vector<std::pair<const char*, uint64_t>>;
+
+uint64_t partsSize(const Parts& parts) {
+    uint64_t size = 0;
+    for (const auto& p : parts) {
+        size += p.second;
+    }
+    return size;
+}
+
+// parts 依次连接后 [begin, begin + length) 部分的CRC32C
+uint32_t partsCrc(const Parts& parts, uint64_t begin, uint64_t length) {
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+    uint32_t crc = 0;
+    for (const auto& p : parts) {
+        if (length == 0) {
+            break;
+        }
+        if (begin >= p.second) {
+            begin -= p.second;
+            continue;
+        }
+        const uint64_t n = std::min(length, p.second - begin);
+        crc = kernels.crc32c(crc, p.first + begin, n);
+        begin = 0;
+        length -= n;
+    }
+    return crc;
+}
+
+/*
+    计算各段的校验和：所有段的所有块放在一起并行计算，再把每段的块校验和连接起来算一次CRC32C
+    块的划分只与段的长度和 block 有关，与段由几部分组成、线程数都无关
+*/
+void sectionChecksums(
+    const std::vector<Parts>& sections,
+    uint64_t block,
+    std::vector<uint32_t>& checksums
+) {
+    std::vector<uint64_t> sizes(sections.size());
+    std::vector<uint64_t> firstBlock(sections.size() + 1, 0);
+    for (size_t i = 0; i < sections.size(); ++i) {
+        sizes[i] = partsSize(sections[i]);
+        firstBlock[i + 1] = firstBlock[i] + (sizes[i] + block - 1) / block;
+    }
+    const int64_t nBlocks = static_cast<int64_t>(firstBlock.back());
+    std::vector<uint32_t> blockCrc(nBlocks);
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+
+#pragma omp parallel for schedule(dynamic) if (nBlocks > 1)
+    for (int64_t b = 0; b < nBlocks; ++b) {
+        // 块所在的段：最后一个起始块号不超过 b 的段（空段的起始块号与下一段相同）
+        size_t s = std::upper_bound(firstBlock.begin(), firstBlock.end(), static_cast<uint64_t>(b)) - firstBlock.begin() - 1;
+        uint64_t begin = (b - firstBlock[s]) * block;
+        blockCrc[b] = partsCrc(sections[s], begin, std::min(block, sizes[s] - begin));
+    }
+
+    checksums.resize(sections.size());
+    for (size_t i = 0; i < sections.size(); ++i) {
+        checksums[i] = kernels.crc32c(0, blockCrc.data() + firstBlock[i], (firstBlock[i + 1] - firstBlock[i]) * sizeof(uint32_t));
+    }
+}
+
+// 文件头和段表的校验和，checksum 字段按0计算
+uint32_t headerChecksum(const char* header, uint64_t size) {
+    std::vector<char> buf(header, header + size);
+    std::memset(buf.data() + offsetof(FileHeader, checksum), 0, sizeof(uint32_t));
+    return cpu_blas::getKernels().crc32c(0, buf.data(), buf.size());
+}
+
+// 用0填充到文件的 offset 处
+void padTo(std::ostream& os, uint64_t offset) {
+    static const char zeros[kAlign] = {};
+    uint64_t pos = static_cast<uint64_t>(os.tellp());
+    if (pos < offset) {
+        os.write(zeros, offset - pos);
+    }
+}
+
+} // namespace
+
+IndexFileWriter::IndexFileWriter(uint32_t indexType) : indexType_(indexType) {
+}
+
+void IndexFileWriter::addSection(uint32_t id, const void* data, uint64_t size) {
+    this->addSection(id, std::vector<Part>{{data, size}});
+}
+
+void IndexFileWriter::addSection(uint32_t id, const std::vector<Part>& parts) {
+    for (const Section& s : sections_) {
+        if (s.id == id) {
+            throw std::invalid_argument("duplicate section id in index file");
+        }
+    }
+    if (sections_.size() >= kMaxSections) {
+        throw std::invalid_argument("too many sections in index file");
+    }
+    Section section = {id, {}, 0};
+    for (const Part& p : parts) {
+        section.parts.emplace_back(static_cast<const char*>(p.first), p.second);
+        section.size += p.second;
+    }
+    sections_.push_back(std::move(section));
+}
+
+int IndexFileWriter::write(const std::string& filename) const {
+    std::vector<Parts> ranges;
+    for (const Section& s : sections_) {
+        ranges.push_back(s.parts);
+    }
+    std::vector<uint32_t> checksums;
+    sectionChecksums(ranges, kChecksumBlock, checksums);
+
+    // 文件头和段表占用第一个4KB，之后每个段从4KB的整数倍开始
+    std::vector<char> header(kAlign, 0);
+    SectionEntry* entries = reinterpret_cast<SectionEntry*>(header.data() + sizeof(FileHeader));
+    uint64_t offset = kAlign;
+    uint64_t fileSize = kAlign;
+    for (size_t i = 0; i < sections_.size(); ++i) {
+        entries[i].id = sections_[i].id;
+        entries[i].checksum = checksums[i];
+        entries[i].offset = offset;
+        entries[i].size = sections_[i].size;
+        fileSize = offset + sections_[i].size;
+        offset = alignUp(fileSize);
+    }
+    FileHeader* h = reinterpret_cast<FileHeader*>(header.data());
+    h->magic = kMagic;
+    h->version = kVersion;
+    h->indexType = indexType_;
+    h->headerSize = static_cast<uint32_t>(kAlign);
+    h->numSections = static_cast<uint32_t>(sections_.size());
+    h->fileSize = fileSize;
+    h->checksumBlock = static_cast<uint32_t>(kChecksumBlock);
+    h->checksum = headerChecksum(header.data(), sizeof(FileHeader) + sections_.size() * sizeof(SectionEntry));
+
+    const std::string tmpFilename = filename + ".tmp";
+    std::ofstream ofs(tmpFilename, std::ios::binary);
+    if (!ofs) {
+        return -1; // 打开文件失败
+    }
+    ofs.write(header.data(), header.size());
+    for (size_t i = 0; i < sections_.size(); ++i) {
+        padTo(ofs, entries[i].offset);
+        for (const auto& p : sections_[i].parts) {
+            ofs.write(p.first, p.second);
+        }
+    }
+    ofs.close();
+    // 数据落盘之后再改名并同步目录：返回0时新文件已经持久化，调用者可以放心丢弃旧的数据（例如清空日志）
+    if (!ofs || !syncFile(tmpFilename) || !renameDurable(tmpFilename, filename)) {
+        return -1;
+    }
+    return 0;
+}
+
+int IndexFileReader::open(const std::string& filename, bool verify, bool populate) {
+    mapping_.reset();
+    sections_.clear();
+    std::shared_ptr<MappedFile> mapping = MappedFile::open(filename, populate);
+    if (!mapping) {
+        return -1; // 打开或映射文件失败
+    }
+    const char* data = mapping->data();
+    const uint64_t fileSize = mapping->size();
+
+    FileHeader header;
+    if (fileSize < sizeof(FileHeader)) {
+        return -2;
+    }
+    std::memcpy(&header, data, sizeof(FileHeader));
+    if (header.magic != kMagic || header.version < 2 || header.version > kVersion) {
+        return -2; // 不是 v2 格式，或者是更新的不兼容版本
+    }
+    const uint64_t tableEnd = sizeof(FileHeader) + static_cast<uint64_t>(header.numSections) * sizeof(SectionEntry);
+    if (header.headerSize % kAlign != 0 || header.headerSize < tableEnd || header.headerSize > fileSize ||
+        header.fileSize != fileSize || header.checksumBlock == 0) {
+        return -3; // 文件头损坏或文件被截断
+    }
+    if (headerChecksum(data, tableEnd) != header.checksum) {
+        return -3;
+    }
+
+    const SectionEntry* entries = reinterpret_cast<const SectionEntry*>(data + sizeof(FileHeader));
+    for (uint32_t i = 0; i < header.numSections; ++i) {
+        SectionEntry e;
+        std::memcpy(&e, entries + i, sizeof(SectionEntry));
+        if (e.offset % kAlign != 0 || e.offset < header.headerSize || e.offset > fileSize ||
+            e.size > fileSize - e.offset || find(e.id) != nullptr) {
+            sections_.clear();
+            return -3; // 段表损坏
+        }
+        sections_.push_back({e.id, e.checksum, e.offset, e.size});
+    }
+    version_ = header.version;
+    indexType_ = header.indexType;
+    checksumBlock_ = header.checksumBlock;
+    mapping_ = mapping;
+
+    if (verify && this->verify() != 0) {
+        mapping_.reset();
+        sections_.clear();
+        return -3;
+    }
+    return 0;
+}
+
+int IndexFileReader::verify() const {
+    std::vector<Parts> ranges;
+    for (const Section& s : sections_) {
+        ranges.push_back({{mapping_->data() + s.offset, s.size}});
+    }
+    std::vector<uint32_t> checksums;
+    sectionChecksums(ranges, checksumBlock_, checksums);
+    for (size_t i = 0; i < sections_.size(); ++i) {
+        if (checksums[i] != sections_[i].checksum) {
+            return -3; // 段的数据损坏
+        }
+    }
+    return 0;
+}
+
+uint32_t IndexFileReader::getVersion() const {
+    return version_;
+}
+
+uint32_t IndexFileReader::getIndexType() const {
+    return indexType_;
+}
+
+std::vector<uint32_t> IndexFileReader::getSectionIds() const {
+    std::vector<uint32_t> ids;
+    for (const Section& s : sections_) {
+        ids.push_back(s.id);
+    }
+    return ids;
+}
+
+bool IndexFileReader::hasSection(uint32_t id) const {
+    return find(id) != nullptr;
+}
+
+const char* IndexFileReader::section(uint32_t id, uint64_t* size) const {
+    const Section* s = find(id);
+    if (size) {
+        *size = s ? s->size : 0;
+    }
+    return s ? mapping_->data() + s->offset : nullptr;
+}
+
+uint64_t IndexFileReader::sectionOffset(uint32_t id) const {
+    const Section* s = find(id);
+    return s ? s->offset : 0;
+}
+
+const std::shared_ptr<MappedFile>& IndexFileReader::getMapping() const {
+    return mapping_;
+}
+
+const IndexFileReader::Section* IndexFileReader::find(uint32_t id) const {
+    for (const Section& s : sections_) {
+        if (s.id == id) {
+            return &s;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+    索引文件的 v2 格式，各种索引共用
+
+    | 文件头（64字节） | 段表（每段32字节） | 填充到4KB | 段 | 填充 | 段 | ...
+
+    文件头：魔数 "EVDBINDX"、版本号、索引类型、段数、文件长度和文件头自身的校验和
+    每个段从4KB的整数倍开始，可以直接 mmap 使用；段表记录段编号、位置、长度和校验和
+    校验和为CRC32C：段按1MB分块分别计算（块大小记录在文件头中），段的校验和是各块校验和依次连接后的CRC32C，
+    加载时所有段的所有块可以并行校验
+
+    兼容规则：
+    - indexType 区分索引类型（沿用各索引旧格式的魔数），段编号的含义由索引类型决定
+    - 读取时忽略不认识的段，以后增加新的段不需要修改版本号，旧程序仍然可以读取
+    - 只有不兼容的改动才增加版本号，读取时拒绝版本号比当前（2）更新的文件
+*/
+
+// 段编号，新增的编号只能追加
+enum IndexSection : uint32_t {
+    SECTION_META = 1,           // 维度、数量、度量方式等标量参数，内容由各索引定义
+    SECTION_VECTORS = 2,        // 向量数据或编码
+    SECTION_NORMS = 3,          // 每个向量的平方范数
+    SECTION_IDS = 4,            // 外部编号
+    SECTION_TOMBSTONES = 5,     // 已删除行的位图
+    SECTION_QUANTIZER = 6,      // 量化器参数
+};
+
+class IndexFileWriter
+{
+    public:
+        // 段的一部分：起始地址和长度
+        using Part = std::pair<const void*, uint64_t>;
+
+        explicit IndexFileWriter(uint32_t indexType);
+
+        /*
+            添加一个段，只保存指针，write 之前数据需要保持有效
+            同一个段编号只能添加一次
+        */
+        void addSection(uint32_t id, const void* data, uint64_t size);
+        // 添加由多个不连续的部分依次连接而成的段（例如分块存储的向量），写入时不需要先拼接
+        void addSection(uint32_t id, const std::vector<Part>& parts);
+
+        /*
+            计算校验和并写入 filename：先写 filename.tmp 并落盘，再改名并同步所在的目录，
+            返回0时新文件已经持久化；正在被 mmap 的旧文件在改名后仍然有效
+            返回0成功，-1写入失败
+        */
+        int write(const std::string& filename) const;
+
+    private:
+        struct Section {
+            uint32_t id;
+            std::vector<std::pair<const char*, uint64_t>> parts;
+            uint64_t size;
+        };
+
+        uint32_t indexType_;
+        std::vector<Section> sections_;
+};
+
+class IndexFileReader
+{
+    public:
+        /*
+            映射并解析 filename，文件头和段表总是校验；verify 为真时并行校验所有段
+            populate 为真时使用 MAP_POPULATE 在返回前读入所有页
+            返回0成功，-1打开失败，-2不是 v2 格式或版本太新，-3文件损坏
+        */
+        int open(const std::string& filename, bool verify = true, bool populate = false);
+        // 校验所有段的校验和，返回0或-3
+        int verify() const;
+
+        uint32_t getVersion() const;
+        uint32_t getIndexType() const;
+        // 文件中所有段的编号，按段表的顺序
+        std::vector<uint32_t> getSectionIds() const;
+        bool hasSection(uint32_t id) const;
+        // 段的起始地址（4KB对齐），段不存在时返回空指针；size 不为空时写入段的长度
+        const char* section(uint32_t id, uint64_t* size = nullptr) const;
+        // 段在文件中的偏移，段不存在时返回0
+        uint64_t sectionOffset(uint32_t id) const;
+        // 数据需要在读取结束后继续使用时，持有该映射
+        const std::shared_ptr<MappedFile>& getMapping() const;
+
+    private:
+        struct Section {
+            uint32_t id;
+            uint32_t checksum;
+            uint64_t offset;
+            uint64_t size;
+        };
+        const Section* find(uint32_t id) const;
+
+        std::shared_ptr<MappedFile> mapping_;
+        uint32_t version_ = 0;
+        uint32_t indexType_ = 0;
+        uint64_t checksumBlock_ = 0;
+        std::vector<Section> sections_;
+};
@@ -0,0 +1,288 @@
+#include "index/KDTreeIndex.hpp"
+#include "backend/cpu-blas/heap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+KDTreeIndex::KDTreeIndex(uint64_t dim, MetricType metricType, uint64_t leafSize)
+        : dim_(dim), leafSize_(std::max<uint64_t>(leafSize, 1)), metricType_(metricType), num_(0), depth_(0),
+          kernels_(&cpu_blas::getKernels()) {
+}
+
+const float* KDTreeIndex::lower(uint64_t node) const {
+    return boxes_.data() + node * 2 * dim_;
+}
+
+const float* KDTreeIndex::upper(uint64_t node) const {
+    return boxes_.data() + node * 2 * dim_ + dim_;
+}
+
+void KDTreeIndex::build(const float* vecs, uint64_t n) {
+    num_ = n;
+    depth_ = 0;
+    while ((n + (1ull << depth_) - 1) >> depth_ > leafSize_) {
+        ++depth_;
+    }
+    const uint64_t nNodes = (2ull << depth_) - 1;
+    begin_.assign(nNodes, 0);
+    end_.assign(nNodes, 0);
+    boxes_.assign(nNodes * 2 * dim_, 0.0f);
+    ids_.resize(n);
+    for (uint64_t i = 0; i < n; ++i) {
+        ids_[i] = i;
+    }
+    end_[0] = n;
+
+    // 按层构建，同一层的节点互不重叠，可以并行划分
+    for (uint64_t level = 0; level <= depth_; ++level) {
+        const uint64_t first = (1ull << level) - 1;
+        const uint64_t count = 1ull << level;
+#pragma omp parallel for if (count > 1)
+        for (int64_t j = 0; j < (int64_t)count; ++j) {
+            const uint64_t node = first + j;
+            const uint64_t b = begin_[node];
+            const uint64_t e = end_[node];
+            float* lo = boxes_.data() + node * 2 * dim_;
+            float* hi = lo + dim_;
+            if (b < e) {
+                std::copy(vecs + ids_[b] * dim_, vecs + (ids_[b] + 1) * dim_, lo);
+                std::copy(vecs + ids_[b] * dim_, vecs + (ids_[b] + 1) * dim_, hi);
+            }
+            for (uint64_t i = b + 1; i < e; ++i) {
+                const float* v = vecs + ids_[i] * dim_;
+                for (uint64_t d = 0; d < dim_; ++d) {
+                    lo[d] = std::min(lo[d], v[d]);
+                    hi[d] = std::max(hi[d], v[d]);
+                }
+            }
+            if (level == depth_) {
+                continue;
+            }
+
+            // 沿跨度最大的维度在中位数处切分
+            uint64_t splitDim = 0;
+            for (uint64_t d = 1; d < dim_; ++d) {
+                if (hi[d] - lo[d] > hi[splitDim] - lo[splitDim]) {
+                    splitDim = d;
+                }
+            }
+            const uint64_t mid = b + (e - b) / 2;
+            std::nth_element(ids_.begin() + b, ids_.begin() + mid, ids_.begin() + e,
+                             [vecs, splitDim, this](uint64_t a, uint64_t c) {
+                                 return vecs[a * dim_ + splitDim] < vecs[c * dim_ + splitDim];
+                             });
+            begin_[2 * node + 1] = b;
+            end_[2 * node + 1] = mid;
+            begin_[2 * node + 2] = mid;
+            end_[2 * node + 2] = e;
+        }
+    }
+
+    points_.resize(n * dim_);
+#pragma omp parallel for if (n > 10000)
+    for (int64_t i = 0; i < (int64_t)n; ++i) {
+        std::copy(vecs + ids_[i] * dim_, vecs + (ids_[i] + 1) * dim_, points_.data() + i * dim_);
+    }
+}
+
+uint64_t KDTreeIndex::getNum() const {
+    return num_;
+}
+
+uint64_t KDTreeIndex::getDim() const {
+    return dim_;
+}
+
+float KDTreeIndex::bound(const float* x, uint64_t node) const {
+    const float* lo = lower(node);
+    const float* hi = upper(node);
+    float b = 0;
+    if (metricType_ == MetricType::METRIC_INNER_PRODUCT) {
+        for (uint64_t d = 0; d < dim_; ++d) {
+            b += std::max(x[d] * lo[d], x[d] * hi[d]);
+        }
+        return -b;
+    }
+    for (uint64_t d = 0; d < dim_; ++d) {
+        float diff = std::max(std::max(lo[d] - x[d], x[d] - hi[d]), 0.0f);
+        b += diff * diff;
+    }
+    return b;
+}
+
+template <class Heap>
+void KDTreeIndex::searchNode(const float* x, uint64_t node, uint64_t k, const RowFilter* filter, float* buf, Heap& heap) const {
+    const uint64_t b = begin_[node];
+    const uint64_t n = end_[node] - b;
+    if (node >= (1ull << depth_) - 1) {
+        // 叶子：向量连续存放，直接调用批量距离内核
+        if (metricType_ == MetricType::METRIC_INNER_PRODUCT) {
+            kernels_->inner_products_ny(buf, x, points_.data() + b * dim_, dim_, n);
+        } else {
+            kernels_->L2sqr_ny(buf, x, points_.data() + b * dim_, dim_, n);
+        }
+        if (filter == nullptr) {
+            cpu_blas::heapPushLine(heap, k, buf, n, b);
+            return;
+        }
+        for (uint64_t j = 0; j < n; ++j) {
+            if (!filter->skip(ids_[b + j])) {
+                cpu_blas::heapPush(heap, k, buf[j], b + j);
+            }
+        }
+        return;
+    }
+
+    uint64_t children[2] = {2 * node + 1, 2 * node + 2};
+    float bounds[2] = {bound(x, children[0]), bound(x, children[1])};
+    if (bounds[1] < bounds[0]) {
+        std::swap(children[0], children[1]);
+        std::swap(bounds[0], bounds[1]);
+    }
+    for (int c = 0; c < 2; ++c) {
+        if (begin_[children[c]] == end_[children[c]]) {
+            continue;
+        }
+        // 堆已满且子树不可能有更好的结果时剪枝；距离相同的结果不会替换已有结果，也可以剪掉
+        if (heap.size() == k) {
+            const float worst = metricType_ == MetricType::METRIC_INNER_PRODUCT ? -heap.top().first : heap.top().first;
+            if (bounds[c] >= worst) {
+                continue;
+            }
+        }
+        searchNode(x, children[c], k, filter, buf, heap);
+    }
+}
+
+void KDTreeIndex::search(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances,
+    const RowFilter* filter
+) const {
+    if (nQuery == 0 || k == 0) {
+        return;
+    }
+    const bool isIP = metricType_ == MetricType::METRIC_INNER_PRODUCT;
+
+#pragma omp parallel for if (nQuery > 1)
+    for (int64_t q = 0; q < (int64_t)nQuery; ++q) {
+        const float* x = query + q * dim_;
+        float* outDistances = distances + q * k;
+        uint64_t* outIndices = results + q * k;
+        std::vector<float> buf(leafSize_);
+        if (isIP) {
+            cpu_blas::IPHeap heap;
+            if (num_ > 0) {
+                searchNode(x, 0, k, filter, buf.data(), heap);
+            }
+            cpu_blas::heapToOutput(heap, k, -HUGE_VALF, outDistances, outIndices);
+        } else {
+            cpu_blas::L2Heap heap;
+            if (num_ > 0) {
+                searchNode(x, 0, k, filter, buf.data(), heap);
+            }
+            cpu_blas::heapToOutput(heap, k, HUGE_VALF, outDistances, outIndices);
+        }
+        // 堆中是重新排列后的位置，换回原始编号
+        for (uint64_t j = 0; j < k; ++j) {
+            if (outIndices[j] != cpu_blas::kInvalidIndex) {
+                outIndices[j] = ids_[outIndices[j]];
+            }
+        }
+    }
+}
+
+void KDTreeIndex::reconstruct(
+    uint64_t idx,
+    float* vec
+) {
+    if (idx >= num_) {
+        // 索引超出范围
+        return;
+    }
+    // 与 build 的输入顺序相同的编号需要反查位置，只在取回单个向量时使用
+    const uint64_t pos = std::find(ids_.begin(), ids_.end(), idx) - ids_.begin();
+    std::copy(points_.begin() + pos * dim_, points_.begin() + (pos + 1) * dim_, vec);
+}
+
+int KDTreeIndex::save(const std::string filename) {
+    try {
+        std::filesystem::path dir_path = std::filesystem::path(filename).parent_path();
+        if (!dir_path.empty()) {
+            std::filesystem::create_directories(dir_path);
+        }
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Filesystem error while creating directory: " << e.what() << std::endl;
+        return -1;
+    }
+
+    std::ofstream ofs(filename, std::ios::binary);
+    if (!ofs) {
+        return -1; // 打开文件失败
+    }
+
+    // header
+    /*
+        magicNumber + dim + leafSize + metricType + num + depth
+        + 重新排列后的向量 + 原始编号 + 每个节点的范围和包围盒
+    */
+    uint64_t magicNumber = 1156;
+    ofs.write(reinterpret_cast<const char*>(&magicNumber), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&dim_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&leafSize_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&metricType_), sizeof(MetricType));
+    ofs.write(reinterpret_cast<const char*>(&num_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&depth_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(points_.data()), points_.size() * sizeof(float));
+    ofs.write(reinterpret_cast<const char*>(ids_.data()), ids_.size() * sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(begin_.data()), begin_.size() * sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(end_.data()), end_.size() * sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(boxes_.data()), boxes_.size() * sizeof(float));
+
+    ofs.close();
+    return 0; // 成功
+}
+
+int KDTreeIndex::load(const std::string filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) {
+        return -1; // 打开文件失败
+    }
+
+    uint64_t magicNumber;
+    ifs.read(reinterpret_cast<char*>(&magicNumber), sizeof(uint64_t));
+    if (magicNumber != 1156) {
+        return -2; // 魔数不匹配
+    }
+    ifs.read(reinterpret_cast<char*>(&dim_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&leafSize_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&metricType_), sizeof(MetricType));
+    ifs.read(reinterpret_cast<char*>(&num_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&depth_), sizeof(uint64_t));
+    if (!ifs || leafSize_ == 0 || depth_ >= 48 || (num_ + (1ull << depth_) - 1) >> depth_ > leafSize_) {
+        return -3; // 文件头损坏
+    }
+    const uint64_t nNodes = (2ull << depth_) - 1;
+    points_.resize(num_ * dim_);
+    ids_.resize(num_);
+    begin_.resize(nNodes);
+    end_.resize(nNodes);
+    boxes_.resize(nNodes * 2 * dim_);
+    ifs.read(reinterpret_cast<char*>(points_.data()), points_.size() * sizeof(float));
+    ifs.read(reinterpret_cast<char*>(ids_.data()), ids_.size() * sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(begin_.data()), begin_.size() * sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(end_.data()), end_.size() * sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(boxes_.data()), boxes_.size() * sizeof(float));
+    if (!ifs) {
+        return -3; // 文件不完整
+    }
+
+    ifs.close();
+    return 0; // 成功
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "MetricType.hpp"
+#include "Bitmap.hpp"
+#include "backend/cpu-blas/kernels.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+    低维数据（2~16维，例如地理坐标）的精确KD树索引
+    低维时矩阵乘法的计算量太小，分块GEMM的开销反而占了大头；KD树每次查询只需访问少数几个叶子
+    树按中位数二分，所有叶子在同一层，节点按完全二叉树的下标存放（i 的子节点为 2i+1 / 2i+2），
+    每个节点记录包围盒，查询时用包围盒给出子树距离的界做分支限界：
+        L2：查询到包围盒的最近距离
+        内积：每一维取 x * lo 与 x * hi 中较大者求和，是子树中任意向量内积的上界
+    结果是精确的，与暴力搜索一致
+    build 按层并行；search 可以多线程同时调用
+*/
+class KDTreeIndex
+{
+    public:
+        KDTreeIndex(uint64_t dim, MetricType metricType = MetricType::METRIC_INNER_PRODUCT, uint64_t leafSize = 32);
+        ~KDTreeIndex() {};
+
+        // 用n个向量批量构建，替换已有的数据；向量的编号为在 vecs 中的位置
+        void build(const float* vecs, uint64_t n);
+        // 获取向量数量
+        uint64_t getNum() const;
+        // 获取向量维度
+        uint64_t getDim() const;
+
+        // 查询nQuery个向量并返回前k个匹配的向量，filter 按原始编号跳过向量
+        void search(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances,
+            const RowFilter* filter = nullptr
+        ) const;
+
+        // 根据编号取回向量
+        void reconstruct(
+            uint64_t idx,
+            float* vec
+        );
+
+        int save(const std::string filename);
+        int load(const std::string filename);
+
+    private:
+        const float* lower(uint64_t node) const;
+        const float* upper(uint64_t node) const;
+        // 查询到节点包围盒的距离的界（内部统一为越小越近，内积取相反数）
+        float bound(const float* x, uint64_t node) const;
+        // 深度优先的分支限界搜索，heap 中保存的是点在 points_ 中的位置
+        template <class Heap>
+        void searchNode(const float* x, uint64_t node, uint64_t k, const RowFilter* filter, float* buf, Heap& heap) const;
+
+        uint64_t dim_;                      // 向量维度
+        uint64_t leafSize_;                 // 叶子中向量数量的上限
+        MetricType metricType_;             // 距离计算方式
+        uint64_t num_;                      // 向量数量
+        uint64_t depth_;                    // 叶子所在的层，根为第0层
+        const cpu_blas::DistanceKernels* kernels_;      // 距离计算内核
+
+        std::vector<float> points_;         // 按叶子顺序重新排列的向量，每个叶子的向量连续存放
+        std::vector<uint64_t> ids_;         // points_ 中每个位置对应的原始编号
+        std::vector<uint64_t> begin_;       // 每个节点在 points_ 中的起始位置
+        std::vector<uint64_t> end_;         // 每个节点在 points_ 中的结束位置
+        std::vector<float> boxes_;          // 每个节点的包围盒，dim_ 个下界后接 dim_ 个上界
+};
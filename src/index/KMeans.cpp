@@ -0,0 +1,123 @@
+#include "index/KMeans.hpp"
+#include "backend/cpu-blas/distance.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+KMeans::KMeans(uint64_t dim, uint64_t k, uint64_t nIter, uint64_t seed)
+        : dim_(dim), k_(k), nIter_(nIter), seed_(seed) {
+}
+
+void KMeans::train(const float* vecs, uint64_t n) {
+    if (n < k_) {
+        throw std::invalid_argument("KMeans needs at least k training vectors");
+    }
+
+    std::mt19937_64 rng(seed_);
+
+    // 样本过多时随机采样，聚类质量基本不变，训练时间与 k 成正比
+    std::vector<float> sampled;
+    const float* x = vecs;
+    uint64_t nx = n;
+    if (n > maxPointsPerCentroid * k_) {
+        nx = maxPointsPerCentroid * k_;
+        std::vector<uint64_t> perm(n);
+        std::iota(perm.begin(), perm.end(), 0);
+        std::shuffle(perm.begin(), perm.end(), rng);
+        sampled.resize(nx * dim_);
+        for (uint64_t i = 0; i < nx; ++i) {
+            std::copy(vecs + perm[i] * dim_, vecs + (perm[i] + 1) * dim_, sampled.data() + i * dim_);
+        }
+        x = sampled.data();
+    }
+
+    // 随机选择k个不同的样本作为初始中心
+    {
+        std::vector<uint64_t> perm(nx);
+        std::iota(perm.begin(), perm.end(), 0);
+        std::shuffle(perm.begin(), perm.end(), rng);
+        centroids_.resize(k_ * dim_);
+        for (uint64_t c = 0; c < k_; ++c) {
+            std::copy(x + perm[c] * dim_, x + (perm[c] + 1) * dim_, centroids_.data() + c * dim_);
+        }
+    }
+
+    std::vector<uint64_t> labels(nx);
+    std::vector<float> distances(nx);
+    std::vector<double> sums(k_ * dim_);
+    std::vector<uint64_t> counts(k_);
+
+    for (uint64_t iter = 0; iter < nIter_; ++iter) {
+        assign(x, nx, labels.data(), distances.data());
+
+        // 重新计算中心
+        std::fill(sums.begin(), sums.end(), 0.0);
+        std::fill(counts.begin(), counts.end(), 0);
+        for (uint64_t i = 0; i < nx; ++i) {
+            uint64_t c = labels[i];
+            counts[c]++;
+            const float* xi = x + i * dim_;
+            double* s = sums.data() + c * dim_;
+            for (uint64_t j = 0; j < dim_; ++j) {
+                s[j] += xi[j];
+            }
+        }
+        for (uint64_t c = 0; c < k_; ++c) {
+            if (counts[c] == 0) {
+                continue;
+            }
+            for (uint64_t j = 0; j < dim_; ++j) {
+                centroids_[c * dim_ + j] = (float)(sums[c * dim_ + j] / counts[c]);
+            }
+        }
+
+        // 空的中心：把最大的簇一分为二，两个中心沿相反方向做微小扰动
+        for (uint64_t c = 0; c < k_; ++c) {
+            if (counts[c] != 0) {
+                continue;
+            }
+            uint64_t big = std::max_element(counts.begin(), counts.end()) - counts.begin();
+            float* dst = centroids_.data() + c * dim_;
+            float* src = centroids_.data() + big * dim_;
+            std::copy(src, src + dim_, dst);
+            for (uint64_t j = 0; j < dim_; ++j) {
+                float eps = (j % 2 == 0 ? 1.0f : -1.0f) * (1.0f / 1024.0f);
+                dst[j] *= 1.0f + eps;
+                src[j] *= 1.0f - eps;
+            }
+            counts[c] = counts[big] / 2;
+            counts[big] -= counts[c];
+        }
+    }
+}
+
+void KMeans::assign(const float* vecs, uint64_t n, uint64_t* labels, float* distances) const {
+    if (n == 0) {
+        return;
+    }
+    std::vector<uint64_t> l;
+    std::vector<float> d;
+    if (labels == nullptr) {
+        l.resize(n);
+        labels = l.data();
+    }
+    if (distances == nullptr) {
+        d.resize(n);
+        distances = d.data();
+    }
+    cpu_blas::calL2BLAS(vecs, centroids_.data(), n, k_, dim_, 1, distances, labels);
+}
+
+const std::vector<float>& KMeans::getCentroids() const {
+    return centroids_;
+}
+
+uint64_t KMeans::getK() const {
+    return k_;
+}
+
+uint64_t KMeans::getDim() const {
+    return dim_;
+}
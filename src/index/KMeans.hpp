@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+    L2 k-means 聚类，供 PQ 的子量化器和 IVF 的粗量化器训练使用
+    每轮迭代的分配步骤调用 cpu_blas::calL2BLAS（k = 1），即 sgemm_ 加 top-1 堆
+*/
+class KMeans
+{
+    public:
+        KMeans(uint64_t dim, uint64_t k, uint64_t nIter = 25, uint64_t seed = 1234);
+        ~KMeans() {};
+
+        // 在n个向量上训练，样本数超过 maxPointsPerCentroid * k 时随机采样
+        void train(const float* vecs, uint64_t n);
+
+        // 把n个向量分配到最近的中心，labels / distances 可以为空
+        void assign(const float* vecs, uint64_t n, uint64_t* labels, float* distances = nullptr) const;
+
+        // 训练得到的 k * dim 个中心
+        const std::vector<float>& getCentroids() const;
+        uint64_t getK() const;
+        uint64_t getDim() const;
+
+        uint64_t maxPointsPerCentroid = 256;    // 每个中心最多使用的训练样本数
+
+    private:
+        uint64_t dim_;                      // 向量维度
+        uint64_t k_;                        // 中心数量
+        uint64_t nIter_;                    // 迭代次数
+        uint64_t seed_;                     // 随机种子
+        std::vector<float> centroids_;      // k_ * dim_
+};
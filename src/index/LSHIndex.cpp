@@ -0,0 +1,279 @@
+#include "index/LSHIndex.hpp"
+#include "index/VisitedTable.hpp"
+#include "backend/cpu-blas/heap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <stdexcept>
+
+LSHIndex::LSHIndex(uint64_t dim, uint64_t nTables, uint64_t nBits, MetricType metricType, uint64_t seed)
+        : dim_(dim), nTables_(nTables), nBits_(nBits), nprobe_(1), metricType_(metricType), num_(0),
+          kernels_(&cpu_blas::getKernels()), tables_(nTables) {
+    if (nTables == 0 || nBits == 0 || nBits > 32) {
+        throw std::invalid_argument("LSHIndex: nTables must be positive and nBits must be in [1, 32]");
+    }
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    planes_.resize(nTables_ * nBits_ * dim_);
+    for (auto& v : planes_) {
+        v = dist(rng);
+    }
+}
+
+void LSHIndex::project(const float* x, float* proj) const {
+    kernels_->inner_products_ny(proj, x, planes_.data(), dim_, nTables_ * nBits_);
+}
+
+uint32_t LSHIndex::signature(const float* proj, uint64_t table) const {
+    const float* p = proj + table * nBits_;
+    uint32_t sig = 0;
+    for (uint64_t b = 0; b < nBits_; ++b) {
+        if (p[b] > 0) {
+            sig |= 1u << b;
+        }
+    }
+    return sig;
+}
+
+void LSHIndex::probeMasks(const float* proj, uint64_t table, std::vector<uint32_t>& masks) const {
+    masks.clear();
+    masks.push_back(0);
+    if (nprobe_ <= 1) {
+        return;
+    }
+    const float* p = proj + table * nBits_;
+    std::vector<uint32_t> order(nBits_);
+    for (uint64_t b = 0; b < nBits_; ++b) {
+        order[b] = b;
+    }
+    std::sort(order.begin(), order.end(), [p](uint32_t a, uint32_t b) {
+        return std::abs(p[a]) < std::abs(p[b]);
+    });
+
+    /*
+        翻转集合用 order 中的下标表示，从 {0} 开始，每次取出得分最小的集合，
+        再生成两个后继：把最后一个下标加一（shift），或追加下一个下标（expand）
+        两种后继的得分都不小于原集合，因此按得分从小到大枚举所有集合且不重复
+    */
+    using Perturbation = std::pair<float, std::vector<uint32_t>>;
+    std::priority_queue<Perturbation, std::vector<Perturbation>, std::greater<Perturbation>> heap;
+    heap.emplace(std::abs(p[order[0]]), std::vector<uint32_t>{0});
+    while (masks.size() < nprobe_ && !heap.empty()) {
+        Perturbation top = heap.top();
+        heap.pop();
+        uint32_t mask = 0;
+        for (uint32_t i : top.second) {
+            mask |= 1u << order[i];
+        }
+        masks.push_back(mask);
+
+        const uint32_t last = top.second.back();
+        if (last + 1 < nBits_) {
+            Perturbation shifted = top;
+            shifted.second.back() = last + 1;
+            shifted.first += std::abs(p[order[last + 1]]) - std::abs(p[order[last]]);
+            heap.push(std::move(shifted));
+            top.second.push_back(last + 1);
+            top.first += std::abs(p[order[last + 1]]);
+            heap.push(std::move(top));
+        }
+    }
+}
+
+void LSHIndex::insert(uint64_t begin, uint64_t end, const std::vector<uint32_t>& signatures) {
+    // 每个表互不相关，按表并行
+#pragma omp parallel for if (end - begin > 1000)
+    for (int64_t t = 0; t < (int64_t)nTables_; ++t) {
+        for (uint64_t i = begin; i < end; ++i) {
+            tables_[t][signatures[(i - begin) * nTables_ + t]].push_back((uint32_t)i);
+        }
+    }
+}
+
+void LSHIndex::addVector(const float* vecs, uint64_t n) {
+    if (num_ + n > UINT32_MAX) {
+        throw std::length_error("LSHIndex: too many vectors");
+    }
+    std::vector<uint32_t> signatures(n * nTables_);
+#pragma omp parallel for if (n > 100)
+    for (int64_t i = 0; i < (int64_t)n; ++i) {
+        std::vector<float> proj(nTables_ * nBits_);
+        project(vecs + i * dim_, proj.data());
+        for (uint64_t t = 0; t < nTables_; ++t) {
+            signatures[i * nTables_ + t] = signature(proj.data(), t);
+        }
+    }
+    data_.insert(data_.end(), vecs, vecs + n * dim_);
+    insert(num_, num_ + n, signatures);
+    num_ += n;
+}
+
+uint64_t LSHIndex::getNum() const {
+    return num_;
+}
+
+uint64_t LSHIndex::getDim() const {
+    return dim_;
+}
+
+uint64_t LSHIndex::getNumTables() const {
+    return nTables_;
+}
+
+uint64_t LSHIndex::getNumBits() const {
+    return nBits_;
+}
+
+void LSHIndex::setNprobe(uint64_t nprobe) {
+    // 最多探测 2^nBits 个桶
+    const uint64_t maxProbe = nBits_ >= 32 ? UINT32_MAX : (1ull << nBits_);
+    nprobe_ = std::min(std::max<uint64_t>(nprobe, 1), maxProbe);
+}
+
+uint64_t LSHIndex::getNprobe() const {
+    return nprobe_;
+}
+
+void LSHIndex::search(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances
+) {
+    if (nQuery == 0 || k == 0) {
+        return;
+    }
+    const bool isIP = metricType_ == MetricType::METRIC_INNER_PRODUCT;
+
+#pragma omp parallel for if (nQuery > 1)
+    for (int64_t q = 0; q < (int64_t)nQuery; ++q) {
+        const float* x = query + q * dim_;
+        std::vector<float> proj(nTables_ * nBits_);
+        project(x, proj.data());
+
+        // 收集所有表中探测到的桶里的向量，去重后计算精确距离
+        VisitedTable& visited = threadVisitedTable(num_);
+        visited.reset(num_);
+        std::vector<uint32_t> masks;
+        cpu_blas::IPHeap ipHeap;
+        cpu_blas::L2Heap l2Heap;
+        for (uint64_t t = 0; t < nTables_; ++t) {
+            const uint32_t sig = signature(proj.data(), t);
+            probeMasks(proj.data(), t, masks);
+            for (uint32_t mask : masks) {
+                auto it = tables_[t].find(sig ^ mask);
+                if (it == tables_[t].end()) {
+                    continue;
+                }
+                for (uint32_t id : it->second) {
+                    if (visited.visit(id)) {
+                        continue;
+                    }
+                    const float* y = data_.data() + (uint64_t)id * dim_;
+                    if (isIP) {
+                        cpu_blas::heapPush(ipHeap, k, kernels_->inner_product(x, y, dim_), id);
+                    } else {
+                        cpu_blas::heapPush(l2Heap, k, kernels_->L2sqr(x, y, dim_), id);
+                    }
+                }
+            }
+        }
+        if (isIP) {
+            cpu_blas::heapToOutput(ipHeap, k, -HUGE_VALF, distances + q * k, results + q * k);
+        } else {
+            cpu_blas::heapToOutput(l2Heap, k, HUGE_VALF, distances + q * k, results + q * k);
+        }
+    }
+}
+
+void LSHIndex::reconstruct(
+    uint64_t idx,
+    float* vec
+) {
+    if (idx >= num_) {
+        // 索引超出范围
+        return;
+    }
+    std::copy(data_.begin() + idx * dim_, data_.begin() + (idx + 1) * dim_, vec);
+}
+
+int LSHIndex::save(const std::string filename) {
+    try {
+        std::filesystem::path dir_path = std::filesystem::path(filename).parent_path();
+        if (!dir_path.empty()) {
+            std::filesystem::create_directories(dir_path);
+        }
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Filesystem error while creating directory: " << e.what() << std::endl;
+        return -1;
+    }
+
+    std::ofstream ofs(filename, std::ios::binary);
+    if (!ofs) {
+        return -1; // 打开文件失败
+    }
+
+    // header
+    /*
+        magicNumber + dim + nTables + nBits + nprobe + metricType + num + 超平面 + 原始向量
+        哈希表在加载时根据原始向量重新计算
+    */
+    uint64_t magicNumber = 1155;
+    ofs.write(reinterpret_cast<const char*>(&magicNumber), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&dim_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&nTables_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&nBits_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&nprobe_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&metricType_), sizeof(MetricType));
+    ofs.write(reinterpret_cast<const char*>(&num_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(planes_.data()), planes_.size() * sizeof(float));
+    ofs.write(reinterpret_cast<const char*>(data_.data()), data_.size() * sizeof(float));
+
+    ofs.close();
+    return 0; // 成功
+}
+
+int LSHIndex::load(const std::string filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) {
+        return -1; // 打开文件失败
+    }
+
+    uint64_t magicNumber;
+    ifs.read(reinterpret_cast<char*>(&magicNumber), sizeof(uint64_t));
+    if (magicNumber != 1155) {
+        return -2; // 魔数不匹配
+    }
+    uint64_t num = 0;
+    ifs.read(reinterpret_cast<char*>(&dim_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&nTables_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&nBits_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&nprobe_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&metricType_), sizeof(MetricType));
+    ifs.read(reinterpret_cast<char*>(&num), sizeof(uint64_t));
+    if (!ifs || nTables_ == 0 || nBits_ == 0 || nBits_ > 32 || num > UINT32_MAX) {
+        return -3; // 文件头损坏
+    }
+    planes_.resize(nTables_ * nBits_ * dim_);
+    std::vector<float> data(num * dim_);
+    ifs.read(reinterpret_cast<char*>(planes_.data()), planes_.size() * sizeof(float));
+    ifs.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(float));
+    if (!ifs) {
+        return -3; // 文件不完整
+    }
+
+    data_.clear();
+    tables_.assign(nTables_, {});
+    num_ = 0;
+    addVector(data.data(), num);
+
+    ifs.close();
+    return 0; // 成功
+}
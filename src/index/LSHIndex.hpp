@@ -0,0 +1,84 @@
+#pragma once
+
+#include "MetricType.hpp"
+#include "backend/cpu-blas/kernels.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+    多表 SimHash 局部敏感哈希索引
+    每个哈希表使用 nBits 个随机超平面，向量在各超平面哪一侧组成 nBits 位的签名，作为桶的键；
+    夹角越小的两个向量签名相同的概率越高，L 个表各自独立，任一表中同桶即成为候选
+    查询时除了自身的桶，还按多探测（multi-probe）的顺序探测签名翻转了少数几位的相邻桶，
+    最后用原始向量和距离内核计算候选的精确距离
+    不需要训练，插入只需计算签名并追加到各表的桶中，适合数据持续写入的场景
+    search 可以多线程同时调用，但不能与 addVector 并发
+*/
+class LSHIndex
+{
+    public:
+        LSHIndex(uint64_t dim, uint64_t nTables = 8, uint64_t nBits = 16,
+                 MetricType metricType = MetricType::METRIC_INNER_PRODUCT, uint64_t seed = 1234);
+        ~LSHIndex() {};
+
+        // 添加向量，向量的编号按添加顺序从0开始
+        void addVector(const float* vecs, uint64_t n);
+        // 获取向量数量
+        uint64_t getNum() const;
+        // 获取向量维度
+        uint64_t getDim() const;
+        uint64_t getNumTables() const;
+        uint64_t getNumBits() const;
+
+        // 每个哈希表探测的桶数量（包括自身的桶），默认为1，越大召回率越高
+        void setNprobe(uint64_t nprobe);
+        uint64_t getNprobe() const;
+
+        // 查询nQuery个向量并返回前k个匹配的向量
+        void search(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances
+        );
+
+        // 根据编号取回向量
+        void reconstruct(
+            uint64_t idx,
+            float* vec
+        );
+
+        int save(const std::string filename);
+        int load(const std::string filename);
+
+    private:
+        using Bucket = std::vector<uint32_t>;
+
+        // 计算向量在全部 nTables * nBits 个超平面上的投影
+        void project(const float* x, float* proj) const;
+        // 第 table 个表的签名，proj 为 project 的结果
+        uint32_t signature(const float* proj, uint64_t table) const;
+        /*
+            按探测顺序生成第 table 个表需要翻转的位掩码，第一个总是0（自身的桶）
+            投影越接近0的位越容易与近邻不同，翻转位的投影绝对值之和越小越先探测
+        */
+        void probeMasks(const float* proj, uint64_t table, std::vector<uint32_t>& masks) const;
+        // 把 [begin, end) 的向量插入所有哈希表
+        void insert(uint64_t begin, uint64_t end, const std::vector<uint32_t>& signatures);
+
+        uint64_t dim_;                      // 向量维度
+        uint64_t nTables_;                  // 哈希表数量 L
+        uint64_t nBits_;                    // 每个签名的位数
+        uint64_t nprobe_;                   // 每个表探测的桶数量
+        MetricType metricType_;             // 距离计算方式
+        uint64_t num_;                      // 向量数量
+        const cpu_blas::DistanceKernels* kernels_;      // 距离计算内核
+
+        std::vector<float> planes_;         // nTables * nBits 个超平面的法向量，每个 dim_ 个float
+        std::vector<float> data_;           // num_ * dim_ 个原始向量
+        std::vector<std::unordered_map<uint32_t, Bucket>> tables_;     // 每个表从签名到向量编号的映射
+};
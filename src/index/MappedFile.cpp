@@ -0,0 +1,74 @@
+#include "index/MappedFile.hpp"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& filename, bool populate) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    if (populate) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+    void* addr = ::mmap(nullptr, st.st_size, PROT_READ, flags, fd, 0);
+    // 映射建立后文件描述符就不再需要
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        return nullptr;
+    }
+    return std::shared_ptr<MappedFile>(new MappedFile(addr, st.st_size));
+}
+
+MappedFile::MappedFile(void* addr, uint64_t size) : addr_(addr), size_(size) {}
+
+MappedFile::~MappedFile() {
+    ::munmap(addr_, size_);
+}
+
+const char* MappedFile::data() const {
+    return static_cast<const char*>(addr_);
+}
+
+uint64_t MappedFile::size() const {
+    return size_;
+}
+
+void MappedFile::advise(uint64_t offset, uint64_t length, Advice advice) const {
+    if (offset >= size_ || length == 0) {
+        return;
+    }
+    const uint64_t pageSize = ::sysconf(_SC_PAGESIZE);
+    uint64_t begin = offset / pageSize * pageSize;
+    uint64_t end = std::min(offset + length, size_);
+
+    int flag = MADV_NORMAL;
+    switch (advice) {
+        case Advice::NORMAL:
+            flag = MADV_NORMAL;
+            break;
+        case Advice::SEQUENTIAL:
+            flag = MADV_SEQUENTIAL;
+            break;
+        case Advice::RANDOM:
+            flag = MADV_RANDOM;
+            break;
+        case Advice::WILLNEED:
+            flag = MADV_WILLNEED;
+            break;
+    }
+    // 提示失败不影响正确性，忽略返回值
+    ::madvise(static_cast<char*>(addr_) + begin, end - begin, flag);
+}
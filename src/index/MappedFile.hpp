@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/*
+    只读映射整个文件，析构时解除映射
+    映射是共享的：多个进程映射同一个文件时使用页缓存中的同一份数据，按需缺页读入
+*/
+class MappedFile
+{
+    public:
+        // madvise 的访问模式提示
+        enum class Advice {
+            NORMAL,         // 默认的预读
+            SEQUENTIAL,     // 顺序扫描，加大预读并尽早回收已读过的页
+            RANDOM,         // 随机访问，关闭预读
+            WILLNEED,       // 马上会用到，后台开始读入
+        };
+
+        /*
+            映射 filename，populate 为真时使用 MAP_POPULATE 在返回前读入所有页
+            打开或映射失败时返回空指针
+        */
+        static std::shared_ptr<MappedFile> open(const std::string& filename, bool populate = false);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const;
+        uint64_t size() const;
+
+        // 对 [offset, offset + length) 给出访问模式提示，区间向外扩展到页边界
+        void advise(uint64_t offset, uint64_t length, Advice advice) const;
+
+    private:
+        MappedFile(void* addr, uint64_t size);
+
+        void* addr_;                        // 映射的起始地址
+        uint64_t size_;                     // 文件大小
+};
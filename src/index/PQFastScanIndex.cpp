@@ -0,0 +1,307 @@
+#include "index/PQFastScanIndex.hpp"
+#include "index/FlatIndex.hpp"
+#include "index/Refine.hpp"
+#include "backend/cpu-blas/heap.hpp"
+#include "backend/cpu-blas/kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <omp.h>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint64_t kBlockSize = 32;     // 每组交错存放的向量数量
+constexpr uint64_t kChunkBlocks = 64;   // 每次调用查表内核处理的组数
+
+/*
+    把一个查询的float距离表量化为uint8
+    每段先减去该段的最小值，所有段共用一个缩放系数，使得累加后的整数仍与距离成正比：
+        distance ≈ bias + acc * invScale
+*/
+void quantizeTable(const float* table, uint64_t M, uint8_t* lut, float& bias, float& invScale) {
+    std::vector<float> mins(M);
+    float maxSpan = 0;
+    bias = 0;
+    for (uint64_t m = 0; m < M; ++m) {
+        const float* t = table + m * 16;
+        float lo = *std::min_element(t, t + 16);
+        float hi = *std::max_element(t, t + 16);
+        mins[m] = lo;
+        bias += lo;
+        maxSpan = std::max(maxSpan, hi - lo);
+    }
+    const float scale = maxSpan > 0 ? 255.0f / maxSpan : 1.0f;
+    invScale = 1.0f / scale;
+    for (uint64_t m = 0; m < M; ++m) {
+        for (uint64_t j = 0; j < 16; ++j) {
+            float v = std::nearbyint((table[m * 16 + j] - mins[m]) * scale);
+            lut[m * 16 + j] = (uint8_t)std::min(std::max(v, 0.0f), 255.0f);
+        }
+    }
+}
+
+/*
+    扫描 [bBegin, bEnd) 组编码，把前 nValid 个向量中的结果放入堆中
+*/
+template <class Heap>
+void scanBlocks(
+    const uint8_t* codes,
+    const uint8_t* lut,
+    uint64_t M,
+    float bias,
+    float invScale,
+    uint64_t bBegin,
+    uint64_t bEnd,
+    uint64_t nValid,
+    uint64_t k,
+    Heap& heap
+) {
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+    std::vector<uint16_t> acc(kChunkBlocks * kBlockSize);
+    std::vector<float> dis(kChunkBlocks * kBlockSize);
+    for (uint64_t b0 = bBegin; b0 < bEnd; b0 += kChunkBlocks) {
+        const uint64_t nb = std::min(kChunkBlocks, bEnd - b0);
+        kernels.pq4_accumulate(acc.data(), codes + b0 * M * 16, lut, M, nb);
+        const uint64_t n = std::min(nb * kBlockSize, nValid - b0 * kBlockSize);
+        for (uint64_t j = 0; j < n; ++j) {
+            dis[j] = bias + acc[j] * invScale;
+        }
+        cpu_blas::heapPushLine(heap, k, dis.data(), n, b0 * kBlockSize);
+    }
+}
+
+template <class Heap>
+void searchBlocks(
+    const ProductQuantizer& pq,
+    const float* tables,
+    const uint8_t* codes,
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t k,
+    float emptyDistance,
+    uint64_t* results,
+    float* distances
+) {
+    const uint64_t M = pq.getM();
+    const uint64_t tableSize = M * 16;
+    const uint64_t nBlocks = (nData + kBlockSize - 1) / kBlockSize;
+    const uint64_t nThreads = omp_get_max_threads();
+
+    // 与 PQIndex 相同：查询足够多时按查询并行，否则把数据库切成多段并行扫描后再合并
+    if (nQuery >= nThreads || nData < 10000) {
+#pragma omp parallel for if (nQuery > 1)
+        for (int64_t q = 0; q < (int64_t)nQuery; ++q) {
+            std::vector<uint8_t> lut(tableSize);
+            float bias, invScale;
+            quantizeTable(tables + q * tableSize, M, lut.data(), bias, invScale);
+            Heap heap;
+            scanBlocks(codes, lut.data(), M, bias, invScale, 0, nBlocks, nData, k, heap);
+            cpu_blas::heapToOutput(heap, k, emptyDistance, distances + q * k, results + q * k);
+        }
+        return;
+    }
+
+    uint64_t nSplit = nThreads;
+    std::vector<uint8_t> lut(tableSize);
+    for (uint64_t q = 0; q < nQuery; ++q) {
+        float bias, invScale;
+        quantizeTable(tables + q * tableSize, M, lut.data(), bias, invScale);
+        std::vector<Heap> heaps(nSplit);
+#pragma omp parallel for
+        for (int64_t s = 0; s < (int64_t)nSplit; ++s) {
+            scanBlocks(codes, lut.data(), M, bias, invScale,
+                       s * nBlocks / nSplit, (s + 1) * nBlocks / nSplit, nData, k, heaps[s]);
+        }
+        for (uint64_t s = 1; s < nSplit; ++s) {
+            cpu_blas::heapMerge(heaps[0], heaps[s], k);
+        }
+        cpu_blas::heapToOutput(heaps[0], k, emptyDistance, distances + q * k, results + q * k);
+    }
+}
+
+} // namespace
+
+PQFastScanIndex::PQFastScanIndex(uint64_t dim, uint64_t M, MetricType metricType)
+        : pq_(dim, M, 4), num_(0), metricType_(metricType), refineIndex_(nullptr), kFactor_(1) {
+    if (M > 256) {
+        // 查表累加使用uint16，段数过多会溢出
+        throw std::invalid_argument("PQFastScanIndex: M must not exceed 256");
+    }
+}
+
+void PQFastScanIndex::train(const float* vecs, uint64_t n) {
+    pq_.train(vecs, n);
+}
+
+bool PQFastScanIndex::isTrained() const {
+    return pq_.isTrained();
+}
+
+void PQFastScanIndex::addVector(const float* vecs, uint64_t n) {
+    if (!pq_.isTrained()) {
+        throw std::runtime_error("PQFastScanIndex must be trained before adding vectors");
+    }
+    const uint64_t M = pq_.getM();
+    std::vector<uint8_t> flat(n * M);
+    pq_.encode(vecs, n, flat.data());
+
+    // 最后一组可能没有填满，新向量直接写入对应的半字节
+    const uint64_t nBlocks = (num_ + n + kBlockSize - 1) / kBlockSize;
+    codes_.resize(nBlocks * M * 16, 0);
+    for (uint64_t i = 0; i < n; ++i) {
+        const uint64_t id = num_ + i;
+        uint8_t* block = codes_.data() + id / kBlockSize * M * 16;
+        const uint64_t r = id % kBlockSize;
+        for (uint64_t m = 0; m < M; ++m) {
+            uint8_t& byte = block[m * 16 + r % 16];
+            if (r < 16) {
+                byte = (byte & 0xf0) | flat[i * M + m];
+            } else {
+                byte = (byte & 0x0f) | (flat[i * M + m] << 4);
+            }
+        }
+    }
+    num_ += n;
+}
+
+uint64_t PQFastScanIndex::getNum() const {
+    return num_;
+}
+
+uint64_t PQFastScanIndex::getDim() const {
+    return pq_.getDim();
+}
+
+void PQFastScanIndex::setRefine(FlatIndex* refineIndex, uint64_t kFactor) {
+    refineIndex_ = refineIndex;
+    kFactor_ = std::max<uint64_t>(kFactor, 1);
+}
+
+void PQFastScanIndex::searchCodes(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances
+) {
+    std::vector<float> tables(nQuery * pq_.getM() * pq_.getKsub());
+    pq_.computeDistanceTables(query, nQuery, metricType_, tables.data());
+
+    if (metricType_ == MetricType::METRIC_INNER_PRODUCT) {
+        searchBlocks<cpu_blas::IPHeap>(pq_, tables.data(), codes_.data(), nQuery, num_, k, -HUGE_VALF, results, distances);
+    } else {
+        searchBlocks<cpu_blas::L2Heap>(pq_, tables.data(), codes_.data(), nQuery, num_, k, HUGE_VALF, results, distances);
+    }
+}
+
+void PQFastScanIndex::search(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances
+) {
+    if (nQuery == 0 || k == 0) {
+        return;
+    }
+    if (refineIndex_ == nullptr) {
+        searchCodes(k, nQuery, query, results, distances);
+        return;
+    }
+
+    const uint64_t nCandidate = k * kFactor_;
+    std::vector<uint64_t> candidates(nQuery * nCandidate);
+    std::vector<float> candidateDistances(nQuery * nCandidate);
+    searchCodes(nCandidate, nQuery, query, candidates.data(), candidateDistances.data());
+
+    if (metricType_ == MetricType::METRIC_INNER_PRODUCT) {
+        refineResults<cpu_blas::IPHeap>(*refineIndex_, metricType_, query, nQuery, pq_.getDim(), k,
+                                        nCandidate, candidates.data(), -HUGE_VALF, results, distances);
+    } else {
+        refineResults<cpu_blas::L2Heap>(*refineIndex_, metricType_, query, nQuery, pq_.getDim(), k,
+                                        nCandidate, candidates.data(), HUGE_VALF, results, distances);
+    }
+}
+
+void PQFastScanIndex::reconstruct(
+    uint64_t idx,
+    float* vec
+) {
+    if (idx >= num_) {
+        // 索引超出范围
+        return;
+    }
+    const uint64_t M = pq_.getM();
+    const uint8_t* block = codes_.data() + idx / kBlockSize * M * 16;
+    const uint64_t r = idx % kBlockSize;
+    std::vector<uint8_t> code(M);
+    for (uint64_t m = 0; m < M; ++m) {
+        const uint8_t byte = block[m * 16 + r % 16];
+        code[m] = r < 16 ? (byte & 0x0f) : (byte >> 4);
+    }
+    pq_.decode(code.data(), 1, vec);
+}
+
+const ProductQuantizer& PQFastScanIndex::getQuantizer() const {
+    return pq_;
+}
+
+int PQFastScanIndex::save(const std::string filename) {
+    try {
+        std::filesystem::path dir_path = std::filesystem::path(filename).parent_path();
+        if (!dir_path.empty()) {
+            std::filesystem::create_directories(dir_path);
+        }
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Filesystem error while creating directory: " << e.what() << std::endl;
+        return -1;
+    }
+
+    std::ofstream ofs(filename, std::ios::binary);
+    if (!ofs) {
+        return -1; // 打开文件失败
+    }
+
+    // header
+    /*
+        magicNumber + num + metricType + PQ参数与子中心 + 交错存放的编码
+        精排使用的 FlatIndex 不保存，加载后需要重新调用 setRefine
+    */
+    uint64_t magicNumber = 1149;
+    ofs.write(reinterpret_cast<const char*>(&magicNumber), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&num_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&metricType_), sizeof(MetricType));
+    pq_.write(ofs);
+    ofs.write(reinterpret_cast<const char*>(codes_.data()), codes_.size());
+
+    ofs.close();
+    return 0; // 成功
+}
+
+int PQFastScanIndex::load(const std::string filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) {
+        return -1; // 打开文件失败
+    }
+
+    uint64_t magicNumber;
+    ifs.read(reinterpret_cast<char*>(&magicNumber), sizeof(uint64_t));
+    if (magicNumber != 1149) {
+        return -2; // 魔数不匹配
+    }
+    ifs.read(reinterpret_cast<char*>(&num_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&metricType_), sizeof(MetricType));
+    if (!pq_.read(ifs) || pq_.getNbits() != 4 || pq_.getM() > 256) {
+        return -3; // PQ参数损坏
+    }
+    const uint64_t nBlocks = (num_ + kBlockSize - 1) / kBlockSize;
+    codes_.resize(nBlocks * pq_.getM() * 16);
+    ifs.read(reinterpret_cast<char*>(codes_.data()), codes_.size());
+
+    ifs.close();
+    return 0; // 成功
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "MetricType.hpp"
+#include "ProductQuantizer.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class FlatIndex;
+
+/*
+    4位乘积量化的快速扫描（fast-scan）索引
+    每段只有16个中心，编码按32个向量一组交错存放（见 DistanceKernels::pq4_accumulate），
+    查询时把每段的距离表量化成16个uint8，正好放进一个128位寄存器，用 pshufb / vtbl 在寄存器内查表，
+    不再需要逐个编码访问内存中的float距离表
+    量化后的距离是近似值，可以设置一个 FlatIndex 对候选结果用原始向量重新精排
+*/
+class PQFastScanIndex
+{
+    public:
+        PQFastScanIndex(uint64_t dim, uint64_t M, MetricType metricType = MetricType::METRIC_L2);
+        ~PQFastScanIndex() {};
+
+        // 训练子量化器
+        void train(const float* vecs, uint64_t n);
+        bool isTrained() const;
+
+        // 添加向量，需要先训练
+        void addVector(const float* vecs, uint64_t n);
+        // 获取向量数量
+        uint64_t getNum() const;
+        // 获取向量维度
+        uint64_t getDim() const;
+
+        /*
+            设置精排使用的原始向量，refineIndex 中第i个向量必须与本索引的第i个向量对应
+            快速扫描先取出 k * kFactor 个候选，再用 refineIndex 中的向量计算精确距离取前k个
+            refineIndex 为 nullptr 时不精排，返回量化后的近似距离
+        */
+        void setRefine(FlatIndex* refineIndex, uint64_t kFactor = 4);
+
+        // 查询nQuery个向量并返回前k个匹配的向量
+        void search(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances
+        );
+
+        // 根据索引解码向量
+        void reconstruct(
+            uint64_t idx,
+            float* vec
+        );
+
+        const ProductQuantizer& getQuantizer() const;
+
+        int save(const std::string filename);
+        int load(const std::string filename);
+
+    private:
+        // 查询所有编码，结果为近似距离
+        void searchCodes(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances
+        );
+
+        ProductQuantizer pq_;               // 编解码器，nbits 固定为4
+        uint64_t num_;                      // 向量数量
+        MetricType metricType_;             // 距离计算方式
+        std::vector<uint8_t> codes_;        // 按32个向量一组交错存放的编码，每组 M * 16 字节
+        FlatIndex* refineIndex_;            // 精排使用的原始向量，不归本索引所有
+        uint64_t kFactor_;                  // 精排时候选数量的倍数
+};
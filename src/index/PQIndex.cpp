@@ -0,0 +1,191 @@
+#include "index/PQIndex.hpp"
+#include "backend/cpu-blas/heap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <omp.h>
+#include <stdexcept>
+
+namespace {
+
+/*
+    用距离表扫描 [jBegin, jEnd) 范围内的编码，把结果放入堆中
+*/
+template <class Heap>
+void scanCodes(
+    const ProductQuantizer& pq,
+    const float* table,
+    const uint8_t* codes,
+    uint64_t jBegin,
+    uint64_t jEnd,
+    uint64_t k,
+    Heap& heap
+) {
+    const uint64_t codeSize = pq.getCodeSize();
+    for (uint64_t j = jBegin; j < jEnd; ++j) {
+        cpu_blas::heapPush(heap, k, pq.adc(table, codes + j * codeSize), j);
+    }
+}
+
+template <class Heap>
+void searchCodes(
+    const ProductQuantizer& pq,
+    const float* tables,
+    const uint8_t* codes,
+    uint64_t nQuery,
+    uint64_t nData,
+    uint64_t k,
+    float emptyDistance,
+    uint64_t* results,
+    float* distances
+) {
+    const uint64_t tableSize = pq.getM() * pq.getKsub();
+    const uint64_t nThreads = omp_get_max_threads();
+
+    // 查询足够多时按查询并行，否则把数据库切成多段并行扫描后再合并
+    if (nQuery >= nThreads || nData < 10000) {
+#pragma omp parallel for if (nQuery > 1)
+        for (int64_t q = 0; q < (int64_t)nQuery; ++q) {
+            Heap heap;
+            scanCodes(pq, tables + q * tableSize, codes, 0, nData, k, heap);
+            cpu_blas::heapToOutput(heap, k, emptyDistance, distances + q * k, results + q * k);
+        }
+        return;
+    }
+
+    uint64_t nSplit = nThreads;
+    for (uint64_t q = 0; q < nQuery; ++q) {
+        std::vector<Heap> heaps(nSplit);
+#pragma omp parallel for
+        for (int64_t s = 0; s < (int64_t)nSplit; ++s) {
+            scanCodes(pq, tables + q * tableSize, codes, s * nData / nSplit, (s + 1) * nData / nSplit, k, heaps[s]);
+        }
+        for (uint64_t s = 1; s < nSplit; ++s) {
+            cpu_blas::heapMerge(heaps[0], heaps[s], k);
+        }
+        cpu_blas::heapToOutput(heaps[0], k, emptyDistance, distances + q * k, results + q * k);
+    }
+}
+
+} // namespace
+
+PQIndex::PQIndex(uint64_t dim, uint64_t M, uint64_t nbits, MetricType metricType)
+        : pq_(dim, M, nbits), num_(0), metricType_(metricType) {
+}
+
+void PQIndex::train(const float* vecs, uint64_t n) {
+    pq_.train(vecs, n);
+}
+
+bool PQIndex::isTrained() const {
+    return pq_.isTrained();
+}
+
+void PQIndex::addVector(const float* vecs, uint64_t n) {
+    if (!pq_.isTrained()) {
+        throw std::runtime_error("PQIndex must be trained before adding vectors");
+    }
+    codes_.resize((num_ + n) * pq_.getCodeSize());
+    pq_.encode(vecs, n, codes_.data() + num_ * pq_.getCodeSize());
+    num_ += n;
+}
+
+uint64_t PQIndex::getNum() const {
+    return num_;
+}
+
+uint64_t PQIndex::getDim() const {
+    return pq_.getDim();
+}
+
+void PQIndex::search(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances
+) {
+    if (nQuery == 0 || k == 0) {
+        return;
+    }
+    std::vector<float> tables(nQuery * pq_.getM() * pq_.getKsub());
+    pq_.computeDistanceTables(query, nQuery, metricType_, tables.data());
+
+    if (metricType_ == MetricType::METRIC_INNER_PRODUCT) {
+        searchCodes<cpu_blas::IPHeap>(pq_, tables.data(), codes_.data(), nQuery, num_, k, -HUGE_VALF, results, distances);
+    } else {
+        searchCodes<cpu_blas::L2Heap>(pq_, tables.data(), codes_.data(), nQuery, num_, k, HUGE_VALF, results, distances);
+    }
+}
+
+void PQIndex::reconstruct(
+    uint64_t idx,
+    float* vec
+) {
+    if (idx >= num_) {
+        // 索引超出范围
+        return;
+    }
+    pq_.decode(codes_.data() + idx * pq_.getCodeSize(), 1, vec);
+}
+
+const ProductQuantizer& PQIndex::getQuantizer() const {
+    return pq_;
+}
+
+int PQIndex::save(const std::string filename) {
+    try {
+        std::filesystem::path dir_path = std::filesystem::path(filename).parent_path();
+        if (!dir_path.empty()) {
+            std::filesystem::create_directories(dir_path);
+        }
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Filesystem error while creating directory: " << e.what() << std::endl;
+        return -1;
+    }
+
+    std::ofstream ofs(filename, std::ios::binary);
+    if (!ofs) {
+        return -1; // 打开文件失败
+    }
+
+    // header
+    /*
+        magicNumber + num + metricType + PQ参数与子中心 + 编码
+    */
+    uint64_t magicNumber = 1148;
+    ofs.write(reinterpret_cast<const char*>(&magicNumber), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&num_), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&metricType_), sizeof(MetricType));
+    pq_.write(ofs);
+    ofs.write(reinterpret_cast<const char*>(codes_.data()), num_ * pq_.getCodeSize());
+
+    ofs.close();
+    return 0; // 成功
+}
+
+int PQIndex::load(const std::string filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) {
+        return -1; // 打开文件失败
+    }
+
+    uint64_t magicNumber;
+    ifs.read(reinterpret_cast<char*>(&magicNumber), sizeof(uint64_t));
+    if (magicNumber != 1148) {
+        return -2; // 魔数不匹配
+    }
+    ifs.read(reinterpret_cast<char*>(&num_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&metricType_), sizeof(MetricType));
+    if (!pq_.read(ifs)) {
+        return -3; // PQ参数损坏
+    }
+    codes_.resize(num_ * pq_.getCodeSize());
+    ifs.read(reinterpret_cast<char*>(codes_.data()), num_ * pq_.getCodeSize());
+
+    ifs.close();
+    return 0; // 成功
+}
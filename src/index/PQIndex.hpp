@@ -0,0 +1,57 @@
+#pragma once
+
+#include "MetricType.hpp"
+#include "ProductQuantizer.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+    乘积量化的暴力检索索引
+    每个向量只保存M字节的编码（768维、M=64时为64字节，FlatIndex 为3KB）
+    查询时为每个查询计算距离表，再对所有编码做查表累加（ADC）
+*/
+class PQIndex
+{
+    public:
+        PQIndex(uint64_t dim, uint64_t M, uint64_t nbits = 8, MetricType metricType = MetricType::METRIC_L2);
+        ~PQIndex() {};
+
+        // 训练子量化器
+        void train(const float* vecs, uint64_t n);
+        bool isTrained() const;
+
+        // 添加向量，需要先训练
+        void addVector(const float* vecs, uint64_t n);
+        // 获取向量数量
+        uint64_t getNum() const;
+        // 获取向量维度
+        uint64_t getDim() const;
+
+        // 查询nQuery个向量并返回前k个匹配的向量
+        void search(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances
+        );
+
+        // 根据索引解码向量
+        void reconstruct(
+            uint64_t idx,
+            float* vec
+        );
+
+        const ProductQuantizer& getQuantizer() const;
+
+        int save(const std::string filename);
+        int load(const std::string filename);
+
+    private:
+        ProductQuantizer pq_;               // 编解码器
+        uint64_t num_;                      // 向量数量
+        MetricType metricType_;             // 距离计算方式
+        std::vector<uint8_t> codes_;        // num_ * M 字节的编码
+};
@@ -0,0 +1,155 @@
+#include "index/ProductQuantizer.hpp"
+#include "index/KMeans.hpp"
+#include "backend/cpu-blas/distance.hpp"
+#include "backend/cpu-blas/kernels.hpp"
+
+#include <stdexcept>
+
+ProductQuantizer::ProductQuantizer(uint64_t dim, uint64_t M, uint64_t nbits)
+        : dim_(dim), M_(M), nbits_(nbits), ksub_(1ull << nbits), dsub_(0), trained_(false) {
+    if (M == 0 || dim % M != 0) {
+        throw std::invalid_argument("ProductQuantizer: dim must be a multiple of M");
+    }
+    if (nbits == 0 || nbits > 8) {
+        throw std::invalid_argument("ProductQuantizer: nbits must be in [1, 8]");
+    }
+    dsub_ = dim / M;
+    centroids_.resize(M_ * ksub_ * dsub_);
+}
+
+void ProductQuantizer::train(const float* vecs, uint64_t n) {
+    std::vector<float> sub(n * dsub_);
+    for (uint64_t m = 0; m < M_; ++m) {
+        // 取出第m段的子向量，连续存放后交给 k-means
+        for (uint64_t i = 0; i < n; ++i) {
+            const float* src = vecs + i * dim_ + m * dsub_;
+            std::copy(src, src + dsub_, sub.data() + i * dsub_);
+        }
+        KMeans kmeans(dsub_, ksub_, 25, 1234 + m);
+        kmeans.train(sub.data(), n);
+        const std::vector<float>& c = kmeans.getCentroids();
+        std::copy(c.begin(), c.end(), centroids_.data() + m * ksub_ * dsub_);
+    }
+    trained_ = true;
+}
+
+bool ProductQuantizer::isTrained() const {
+    return trained_;
+}
+
+void ProductQuantizer::encode(const float* vecs, uint64_t n, uint8_t* codes) const {
+    if (n == 0) {
+        return;
+    }
+    std::vector<float> sub(n * dsub_);
+    std::vector<uint64_t> labels(n);
+    std::vector<float> distances(n);
+    for (uint64_t m = 0; m < M_; ++m) {
+        for (uint64_t i = 0; i < n; ++i) {
+            const float* src = vecs + i * dim_ + m * dsub_;
+            std::copy(src, src + dsub_, sub.data() + i * dsub_);
+        }
+        // 最近子中心的查找就是 k = 1 的L2检索
+        cpu_blas::calL2BLAS(
+            sub.data(), centroids_.data() + m * ksub_ * dsub_,
+            n, ksub_, dsub_, 1, distances.data(), labels.data()
+        );
+        for (uint64_t i = 0; i < n; ++i) {
+            codes[i * M_ + m] = (uint8_t)labels[i];
+        }
+    }
+}
+
+void ProductQuantizer::decode(const uint8_t* codes, uint64_t n, float* vecs) const {
+    for (uint64_t i = 0; i < n; ++i) {
+        for (uint64_t m = 0; m < M_; ++m) {
+            const float* c = centroids_.data() + (m * ksub_ + codes[i * M_ + m]) * dsub_;
+            std::copy(c, c + dsub_, vecs + i * dim_ + m * dsub_);
+        }
+    }
+}
+
+void ProductQuantizer::computeDistanceTables(const float* query, uint64_t nQuery, MetricType metricType, float* tables) const {
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+    const uint64_t tableSize = M_ * ksub_;
+#pragma omp parallel for if (nQuery > 16)
+    for (int64_t q = 0; q < (int64_t)nQuery; ++q) {
+        const float* x = query + q * dim_;
+        float* table = tables + q * tableSize;
+        for (uint64_t m = 0; m < M_; ++m) {
+            const float* c = centroids_.data() + m * ksub_ * dsub_;
+            if (metricType == MetricType::METRIC_INNER_PRODUCT) {
+                kernels.inner_products_ny(table + m * ksub_, x + m * dsub_, c, dsub_, ksub_);
+            } else {
+                kernels.L2sqr_ny(table + m * ksub_, x + m * dsub_, c, dsub_, ksub_);
+            }
+        }
+    }
+}
+
+float ProductQuantizer::adc(const float* table, const uint8_t* code) const {
+    // 4路展开，打断累加的依赖链
+    float d0 = 0, d1 = 0, d2 = 0, d3 = 0;
+    uint64_t m = 0;
+    for (; m + 4 <= M_; m += 4) {
+        d0 += table[(m + 0) * ksub_ + code[m + 0]];
+        d1 += table[(m + 1) * ksub_ + code[m + 1]];
+        d2 += table[(m + 2) * ksub_ + code[m + 2]];
+        d3 += table[(m + 3) * ksub_ + code[m + 3]];
+    }
+    for (; m < M_; ++m) {
+        d0 += table[m * ksub_ + code[m]];
+    }
+    return (d0 + d1) + (d2 + d3);
+}
+
+uint64_t ProductQuantizer::getDim() const {
+    return dim_;
+}
+
+uint64_t ProductQuantizer::getM() const {
+    return M_;
+}
+
+uint64_t ProductQuantizer::getNbits() const {
+    return nbits_;
+}
+
+uint64_t ProductQuantizer::getKsub() const {
+    return ksub_;
+}
+
+uint64_t ProductQuantizer::getDsub() const {
+    return dsub_;
+}
+
+uint64_t ProductQuantizer::getCodeSize() const {
+    return M_;
+}
+
+const std::vector<float>& ProductQuantizer::getCentroids() const {
+    return centroids_;
+}
+
+void ProductQuantizer::write(std::ostream& os) const {
+    os.write(reinterpret_cast<const char*>(&dim_), sizeof(uint64_t));
+    os.write(reinterpret_cast<const char*>(&M_), sizeof(uint64_t));
+    os.write(reinterpret_cast<const char*>(&nbits_), sizeof(uint64_t));
+    os.write(reinterpret_cast<const char*>(&trained_), sizeof(bool));
+    os.write(reinterpret_cast<const char*>(centroids_.data()), centroids_.size() * sizeof(float));
+}
+
+bool ProductQuantizer::read(std::istream& is) {
+    is.read(reinterpret_cast<char*>(&dim_), sizeof(uint64_t));
+    is.read(reinterpret_cast<char*>(&M_), sizeof(uint64_t));
+    is.read(reinterpret_cast<char*>(&nbits_), sizeof(uint64_t));
+    is.read(reinterpret_cast<char*>(&trained_), sizeof(bool));
+    if (!is || M_ == 0 || dim_ % M_ != 0 || nbits_ == 0 || nbits_ > 8) {
+        return false;
+    }
+    ksub_ = 1ull << nbits_;
+    dsub_ = dim_ / M_;
+    centroids_.resize(M_ * ksub_ * dsub_);
+    is.read(reinterpret_cast<char*>(centroids_.data()), centroids_.size() * sizeof(float));
+    return (bool)is;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "MetricType.hpp"
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+/*
+    乘积量化（PQ）编解码器
+    向量被切成M段，每段维度为 dsub = dim / M，各自用 k-means 训练 ksub = 2^nbits 个中心
+    每个向量编码为M个子中心的编号，每段占1个字节（nbits <= 8）
+    查询时先计算查询与每段所有中心的距离表，再用编码查表累加（ADC，非对称距离计算）
+*/
+class ProductQuantizer
+{
+    public:
+        ProductQuantizer(uint64_t dim, uint64_t M, uint64_t nbits = 8);
+        ~ProductQuantizer() {};
+
+        // 训练每一段的子量化器，需要至少 ksub 个样本
+        void train(const float* vecs, uint64_t n);
+        bool isTrained() const;
+
+        // 编码n个向量，codes 大小为 n * getCodeSize()
+        void encode(const float* vecs, uint64_t n, uint8_t* codes) const;
+        // 解码n个向量
+        void decode(const uint8_t* codes, uint64_t n, float* vecs) const;
+
+        /*
+            计算nQuery个查询的距离表，tables 大小为 nQuery * M * ksub
+            tables[q][m][j] 为查询q的第m段与第m个子量化器第j个中心的距离（L2为平方距离，IP为内积）
+        */
+        void computeDistanceTables(const float* query, uint64_t nQuery, MetricType metricType, float* tables) const;
+
+        // 用距离表计算一个编码的距离
+        float adc(const float* table, const uint8_t* code) const;
+
+        uint64_t getDim() const;
+        uint64_t getM() const;
+        uint64_t getNbits() const;
+        uint64_t getKsub() const;
+        uint64_t getDsub() const;
+        uint64_t getCodeSize() const;
+        // M * ksub * dsub 个子中心，centroids[m][j] 为第m段的第j个中心
+        const std::vector<float>& getCentroids() const;
+
+        // 序列化，供各个使用PQ的索引在自己的文件中嵌入
+        void write(std::ostream& os) const;
+        bool read(std::istream& is);
+
+    private:
+        uint64_t dim_;                      // 向量维度
+        uint64_t M_;                        // 分段数量
+        uint64_t nbits_;                    // 每段编码的位数
+        uint64_t ksub_;                     // 每段的中心数量
+        uint64_t dsub_;                     // 每段的维度
+        bool trained_;                      // 是否已经训练
+        std::vector<float> centroids_;      // M_ * ksub_ * dsub_
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+    范围查询的结果，按CSR格式存放
+    第i个查询的结果为 labels / distances 的 [lims[i], lims[i+1]) 部分，同一个查询的结果按行号升序
+*/
+struct RangeSearchResult {
+    std::vector<uint64_t> lims;         // nQuery + 1 个偏移
+    std::vector<uint64_t> labels;       // 结果的编号
+    std::vector<float> distances;       // 结果的距离
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "MetricType.hpp"
+#include "index/FlatIndex.hpp"
+#include "backend/cpu-blas/heap.hpp"
+#include "backend/cpu-blas/kernels.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/*
+    近似索引的精排：用 refineIndex 中的原始向量重新计算候选的精确距离，取前k个
+    candidates 为每个查询 nCandidate 个候选编号，遇到 kInvalidIndex 表示该查询的候选已经结束
+*/
+template <class Heap>
+void refineResults(
+    FlatIndex& refineIndex,
+    MetricType metricType,
+    const float* query,
+    uint64_t nQuery,
+    uint64_t dim,
+    uint64_t k,
+    uint64_t nCandidate,
+    const uint64_t* candidates,
+    float emptyDistance,
+    uint64_t* results,
+    float* distances
+) {
+    const uint64_t nRefine = refineIndex.getNum();
+#pragma omp parallel for if (nQuery > 1)
+    for (int64_t q = 0; q < (int64_t)nQuery; ++q) {
+        std::vector<float> vec(dim);
+        const float* x = query + q * dim;
+        Heap heap;
+        for (uint64_t j = 0; j < nCandidate; ++j) {
+            const uint64_t id = candidates[q * nCandidate + j];
+            if (id == cpu_blas::kInvalidIndex) {
+                break;
+            }
+            if (id >= nRefine) {
+                continue;
+            }
+            refineIndex.reconstruct(id, vec.data());
+            float d = metricType == MetricType::METRIC_INNER_PRODUCT
+                ? cpu_blas::fvec_inner_product(x, vec.data(), dim)
+                : cpu_blas::fvec_L2sqr(x, vec.data(), dim);
+            cpu_blas::heapPush(heap, k, d, id);
+        }
+        cpu_blas::heapToOutput(heap, k, emptyDistance, distances + q * k, results + q * k);
+    }
+}
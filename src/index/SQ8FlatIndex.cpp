@@ -0,0 +1,227 @@
+#include "index/SQ8FlatIndex.hpp"
+#include "backend/cpu-blas/distance.hpp"
+#include "backend/cpu-blas/kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+const uint64_t kLegacyMagic = 1147;     // 旧格式的魔数，同时作为 v2 格式中的索引类型
+
+// v2 格式 META 段的内容
+struct SQ8Meta {
+    uint64_t dim;
+    uint64_t num;
+    uint32_t trained;
+    uint32_t metricType;
+};
+
+} // namespace
+
+SQ8FlatIndex::SQ8FlatIndex(uint64_t dim, MetricType metricType)
+        : dim_(dim), num_(0), trained_(false), metricType_(metricType) {
+    vmin_.assign(dim, 0.0f);
+    scale_.assign(dim, 0.0f);
+}
+
+void SQ8FlatIndex::train(const float* vecs, uint64_t n) {
+    if (n == 0) {
+        return;
+    }
+    std::vector<float> vmax(dim_);
+    for (uint64_t j = 0; j < dim_; ++j) {
+        vmin_[j] = vecs[j];
+        vmax[j] = vecs[j];
+    }
+    for (uint64_t i = 1; i < n; ++i) {
+        const float* x = vecs + i * dim_;
+        for (uint64_t j = 0; j < dim_; ++j) {
+            vmin_[j] = std::min(vmin_[j], x[j]);
+            vmax[j] = std::max(vmax[j], x[j]);
+        }
+    }
+    // 取值范围为0的维度步长为0，编码恒为0，解码结果恰好是vmin
+    for (uint64_t j = 0; j < dim_; ++j) {
+        scale_[j] = (vmax[j] - vmin_[j]) / 255.0f;
+    }
+    trained_ = true;
+}
+
+bool SQ8FlatIndex::isTrained() const {
+    return trained_;
+}
+
+void SQ8FlatIndex::addVector(const float* vecs, uint64_t n) {
+    if (!trained_) {
+        throw std::runtime_error("SQ8FlatIndex must be trained before adding vectors");
+    }
+
+    codes_.resize((num_ + n) * dim_);
+    codeNorm_.resize(num_ + n);
+
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+#pragma omp parallel if (n > 10000)
+    {
+        std::vector<float> row(dim_);
+#pragma omp for
+        for (int64_t i = 0; i < (int64_t)n; ++i) {
+            const float* x = vecs + i * dim_;
+            uint8_t* c = codes_.data() + (num_ + i) * dim_;
+            for (uint64_t j = 0; j < dim_; ++j) {
+                // 超出训练范围的分量截断到 [0, 255]
+                float v = scale_[j] > 0 ? (x[j] - vmin_[j]) / scale_[j] : 0.0f;
+                c[j] = (uint8_t)std::min(255.0f, std::max(0.0f, std::nearbyint(v)));
+            }
+            // 范数按解码后的值计算，与检索时看到的数据一致
+            kernels.decode_u8(row.data(), c, vmin_.data(), scale_.data(), dim_, 1);
+            codeNorm_[num_ + i] = kernels.norm_L2sqr(row.data(), dim_);
+        }
+    }
+
+    num_ += n;
+}
+
+uint64_t SQ8FlatIndex::getNum() const {
+    return num_;
+}
+
+uint64_t SQ8FlatIndex::getDim() const {
+    return dim_;
+}
+
+void SQ8FlatIndex::search(
+    uint64_t k,
+    uint64_t nQuery,
+    const float* query,
+    uint64_t* results,
+    float* distances
+) {
+    cpu_blas::querySQ8(
+        nQuery,
+        num_,
+        k,
+        dim_,
+        query,
+        codes_.data(),
+        vmin_.data(),
+        scale_.data(),
+        codeNorm_.data(),
+        distances,
+        results,
+        metricType_
+    );
+}
+
+void SQ8FlatIndex::reconstruct(
+    uint64_t idx,
+    float* vec
+) {
+    if (idx >= num_) {
+        // 索引超出范围
+        return;
+    }
+    cpu_blas::getKernels().decode_u8(vec, codes_.data() + idx * dim_, vmin_.data(), scale_.data(), dim_, 1);
+}
+
+int SQ8FlatIndex::save(const std::string filename) {
+    try {
+        std::filesystem::path dir_path = std::filesystem::path(filename).parent_path();
+        if (!dir_path.empty()) {
+            std::filesystem::create_directories(dir_path);
+        }
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Filesystem error while creating directory: " << e.what() << std::endl;
+        return -1;
+    }
+
+    /*
+        v2 格式，索引类型为 kLegacyMagic：
+        META（dim + num + trained + metricType）| QUANTIZER（vmin + scale）| VECTORS（编码）| NORMS
+    */
+    SQ8Meta meta = {dim_, num_, trained_ ? 1u : 0u, static_cast<uint32_t>(metricType_)};
+    std::vector<float> quantizer(vmin_);
+    quantizer.insert(quantizer.end(), scale_.begin(), scale_.end());
+    IndexFileWriter writer(kLegacyMagic);
+    writer.addSection(SECTION_META, &meta, sizeof(meta));
+    writer.addSection(SECTION_QUANTIZER, quantizer.data(), quantizer.size() * sizeof(float));
+    writer.addSection(SECTION_VECTORS, codes_.data(), num_ * dim_ * sizeof(uint8_t));
+    writer.addSection(SECTION_NORMS, codeNorm_.data(), num_ * sizeof(float));
+    return writer.write(filename);
+}
+
+int SQ8FlatIndex::load(const std::string filename) {
+    IndexFileReader reader;
+    int ret = reader.open(filename, true);
+    if (ret == 0) {
+        return this->readSections(reader);
+    }
+    if (ret != -2) {
+        return ret;
+    }
+
+    // 旧格式
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) {
+        return -1; // 打开文件失败
+    }
+
+    uint64_t magicNumber;
+    ifs.read(reinterpret_cast<char*>(&magicNumber), sizeof(uint64_t));
+    if (magicNumber != kLegacyMagic) {
+        return -2; // 魔数不匹配
+    }
+    ifs.read(reinterpret_cast<char*>(&dim_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&num_), sizeof(uint64_t));
+    ifs.read(reinterpret_cast<char*>(&trained_), sizeof(bool));
+    ifs.read(reinterpret_cast<char*>(&metricType_), sizeof(MetricType));
+
+    vmin_.resize(dim_);
+    scale_.resize(dim_);
+    codes_.resize(num_ * dim_);
+    codeNorm_.resize(num_);
+    ifs.read(reinterpret_cast<char*>(vmin_.data()), dim_ * sizeof(float));
+    ifs.read(reinterpret_cast<char*>(scale_.data()), dim_ * sizeof(float));
+    ifs.read(reinterpret_cast<char*>(codes_.data()), num_ * dim_ * sizeof(uint8_t));
+    ifs.read(reinterpret_cast<char*>(codeNorm_.data()), num_ * sizeof(float));
+
+    ifs.close();
+    return 0; // 成功
+}
+
+int SQ8FlatIndex::readSections(const IndexFileReader& reader) {
+    if (reader.getIndexType() != kLegacyMagic) {
+        return -2; // 不是 SQ8FlatIndex 的文件
+    }
+    SQ8Meta meta;
+    uint64_t metaSize = 0, quantizerSize = 0, codesSize = 0, normSize = 0;
+    const char* metaData = reader.section(SECTION_META, &metaSize);
+    if (!metaData || metaSize < sizeof(meta)) {
+        return -3;
+    }
+    std::memcpy(&meta, metaData, sizeof(meta));
+    const char* quantizer = reader.section(SECTION_QUANTIZER, &quantizerSize);
+    const char* codes = reader.section(SECTION_VECTORS, &codesSize);
+    const char* norms = reader.section(SECTION_NORMS, &normSize);
+    if (!quantizer || quantizerSize != 2 * meta.dim * sizeof(float) || !codes || codesSize != meta.num * meta.dim ||
+        !norms || normSize != meta.num * sizeof(float)) {
+        return -3;
+    }
+
+    dim_ = meta.dim;
+    num_ = meta.num;
+    trained_ = meta.trained != 0;
+    metricType_ = static_cast<MetricType>(meta.metricType);
+    const float* q = reinterpret_cast<const float*>(quantizer);
+    vmin_.assign(q, q + dim_);
+    scale_.assign(q + dim_, q + 2 * dim_);
+    codes_.assign(codes, codes + codesSize);
+    const float* n = reinterpret_cast<const float*>(norms);
+    codeNorm_.assign(n, n + num_);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "MetricType.hpp"
+#include "IndexFile.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+    8位标量量化（SQ8）的暴力检索索引
+    训练时统计每一维的最小值/最大值，每个分量编码为一个uint8，内存和带宽只有 FlatIndex 的1/4
+    查询向量保持float，与编码做非对称距离计算，只在CPU上执行
+*/
+class SQ8FlatIndex
+{
+    public:
+        SQ8FlatIndex(uint64_t dim, MetricType metricType = MetricType::METRIC_INNER_PRODUCT);
+        ~SQ8FlatIndex() {};
+
+        // 根据n个样本向量统计每一维的取值范围
+        void train(const float* vecs, uint64_t n);
+        // 是否已经训练
+        bool isTrained() const;
+
+        // 添加向量，需要先训练
+        void addVector(const float* vecs, uint64_t n);
+        // 获取向量数量
+        uint64_t getNum() const;
+        // 获取向量维度
+        uint64_t getDim() const;
+
+        // 查询nQuery个向量并返回前k个匹配的向量
+        void search(
+            uint64_t k,
+            uint64_t nQuery,
+            const float* query,
+            uint64_t* results,
+            float* distances
+        );
+
+        // 根据索引解码向量
+        void reconstruct(
+            uint64_t idx,
+            float* vec
+        );
+
+        // 按 v2 格式（见 IndexFile.hpp）保存，量化参数单独一段
+        int save(const std::string filename);
+        // 加载 v2 格式或旧格式的文件，v2 格式会先校验所有段；返回-3表示文件损坏
+        int load(const std::string filename);
+
+    private:
+        // 读取 v2 格式的各段
+        int readSections(const IndexFileReader& reader);
+
+        uint64_t dim_;                      // 向量维度
+        uint64_t num_;                      // 向量数量
+        bool trained_;                      // 是否已经训练
+        MetricType metricType_;             // 距离计算方式
+        std::vector<float> vmin_;           // 每一维的最小值
+        std::vector<float> scale_;          // 每一维的量化步长 (max - min) / 255
+        std::vector<uint8_t> codes_;        // 编码，num_ * dim_
+        std::vector<float> codeNorm_;       // 解码后向量的平方范数，num_ 个
+};
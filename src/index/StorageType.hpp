@@ -0,0 +1,8 @@
+#pragma once
+
+/// 数据库向量的存储格式，查询向量和返回的距离始终为 float32
+enum StorageType {
+    STORAGE_FP32 = 0,   ///< float32
+    STORAGE_FP16 = 1,   ///< IEEE 754 半精度，数值范围约为 ±65504
+    STORAGE_BF16 = 2,   ///< bfloat16，指数范围与 float32 相同，尾数只有7位
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+    图索引搜索时记录访问过的节点
+    用递增的 epoch 代替每次清零，每个线程一份（threadVisitedTable），查询时不需要分配 O(n) 的内存
+*/
+struct VisitedTable {
+    std::vector<uint16_t> marks;
+    uint16_t epoch = 0;
+
+    // 开始一次新的搜索，n 为节点数量
+    void reset(size_t n) {
+        if (marks.size() < n) {
+            marks.resize(n, 0);
+        }
+        if (++epoch == 0) {
+            std::fill(marks.begin(), marks.end(), 0);
+            epoch = 1;
+        }
+    }
+
+    // 返回节点之前是否已经访问过，并标记为已访问
+    bool visit(uint32_t id) {
+        if (marks[id] == epoch) {
+            return true;
+        }
+        marks[id] = epoch;
+        return false;
+    }
+};
+
+// 当前线程的访问表，已经为n个节点的新一次搜索重置
+inline VisitedTable& threadVisitedTable(size_t n) {
+    static thread_local VisitedTable table;
+    table.reset(n);
+    return table;
+}
@@ -0,0 +1,201 @@
+#include "index/WriteAheadLog.hpp"
+#include "index/FileSync.hpp"
+#include "backend/cpu-blas/kernels.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint64_t kMagic = 0x474f4c5742445645ull;     // "EVDBWLOG"，按小端序读出
+const uint32_t kVersion = 1;
+
+struct LogHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved0;
+    uint64_t dim;                   // 向量维度，读取时用来确认日志属于同一个索引
+    uint64_t reserved1;
+};
+static_assert(sizeof(LogHeader) == 32, "LogHeader must be 32 bytes");
+
+struct RecordHeader {
+    uint32_t type;
+    uint32_t checksum;              // 记录头（该字段为0）和数据的CRC32C
+    uint64_t sequence;
+    uint64_t count;
+    uint64_t size;                  // 数据的字节数
+};
+static_assert(sizeof(RecordHeader) == 32, "RecordHeader must be 32 bytes");
+
+// 记录的数据补齐到8字节，下一条记录的数据保持8字节对齐
+uint64_t paddedSize(uint64_t size) {
+    return (size + 7) / 8 * 8;
+}
+
+// 写入全部数据，被信号打断或只写了一部分时继续
+bool writeAll(int fd, const char* data, uint64_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+} // namespace
+
+std::unique_ptr<WriteAheadLog> WriteAheadLog::create(const std::string& filename, uint64_t dim) {
+    // 文件头先落盘再改名并同步目录，任何时候日志要么是旧的，要么是完整的新文件头
+    const std::string tmpFilename = filename + ".tmp";
+    int fd = ::open(tmpFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+    LogHeader header = {};
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.dim = dim;
+    bool ok = writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header)) && syncFd(fd);
+    ::close(fd);
+    if (!ok || !renameDurable(tmpFilename, filename)) {
+        return nullptr;
+    }
+    fd = ::open(filename.c_str(), O_WRONLY | O_APPEND);
+    if (fd < 0) {
+        return nullptr;
+    }
+    return std::unique_ptr<WriteAheadLog>(new WriteAheadLog(fd, sizeof(LogHeader)));
+}
+
+std::unique_ptr<WriteAheadLog> WriteAheadLog::openAppend(const std::string& filename, uint64_t end, uint64_t expectedSize) {
+    int fd = ::open(filename.c_str(), O_WRONLY | O_APPEND);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) != expectedSize || end > expectedSize ||
+        (end < expectedSize && ::ftruncate(fd, end) != 0)) {
+        ::close(fd);
+        return nullptr;
+    }
+    return std::unique_ptr<WriteAheadLog>(new WriteAheadLog(fd, end));
+}
+
+int WriteAheadLog::read(
+    const std::string& filename,
+    uint64_t dim,
+    std::shared_ptr<MappedFile>& mapping,
+    std::vector<Record>& records,
+    uint64_t& end
+) {
+    records.clear();
+    mapping = MappedFile::open(filename);
+    if (!mapping) {
+        return -1;
+    }
+    const char* data = mapping->data();
+    const uint64_t fileSize = mapping->size();
+    LogHeader header;
+    if (fileSize < sizeof(header)) {
+        return -2;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != kMagic || header.version != kVersion) {
+        return -2;
+    }
+    if (header.dim != dim) {
+        return -3;
+    }
+
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+    uint64_t offset = sizeof(LogHeader);
+    while (fileSize - offset >= sizeof(RecordHeader)) {
+        RecordHeader rec;
+        std::memcpy(&rec, data + offset, sizeof(rec));
+        if (paddedSize(rec.size) > fileSize - offset - sizeof(RecordHeader)) {
+            break; // 不完整的记录
+        }
+        const uint32_t checksum = rec.checksum;
+        rec.checksum = 0;
+        uint32_t crc = kernels.crc32c(0, &rec, sizeof(rec));
+        crc = kernels.crc32c(crc, data + offset + sizeof(RecordHeader), rec.size);
+        if (crc != checksum) {
+            break;
+        }
+        records.push_back({rec.type, rec.sequence, rec.count, data + offset + sizeof(RecordHeader), rec.size});
+        offset += sizeof(RecordHeader) + paddedSize(rec.size);
+    }
+    end = offset;
+    return 0;
+}
+
+WriteAheadLog::WriteAheadLog(int fd, uint64_t size) : fd_(fd), written_(size) {
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    this->commit();
+    ::close(fd_);
+}
+
+void WriteAheadLog::append(uint32_t type, uint64_t sequence, uint64_t count,
+                           const void* data, uint64_t size, const void* extra, uint64_t extraSize) {
+    RecordHeader rec = {type, 0, sequence, count, size + extraSize};
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+    uint32_t crc = kernels.crc32c(0, &rec, sizeof(rec));
+    crc = kernels.crc32c(crc, data, size);
+    rec.checksum = kernels.crc32c(crc, extra, extraSize);
+
+    static const char zeros[8] = {};
+    const uint64_t padding = paddedSize(rec.size) - rec.size;
+    const uint64_t recordSize = sizeof(rec) + rec.size + padding;
+    if (buffer_.size() + recordSize > groupBytes && !this->flush()) {
+        throw std::runtime_error("Failed to write the write-ahead log");
+    }
+    if (recordSize >= groupBytes) {
+        // 大的记录直接写入，避免复制到缓冲区
+        if (!writeAll(fd_, reinterpret_cast<const char*>(&rec), sizeof(rec)) ||
+            !writeAll(fd_, static_cast<const char*>(data), size) ||
+            !writeAll(fd_, static_cast<const char*>(extra), extraSize) ||
+            !writeAll(fd_, zeros, padding)) {
+            throw std::runtime_error("Failed to write the write-ahead log");
+        }
+        written_ += recordSize;
+        return;
+    }
+    const char* r = reinterpret_cast<const char*>(&rec);
+    buffer_.insert(buffer_.end(), r, r + sizeof(rec));
+    buffer_.insert(buffer_.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+    buffer_.insert(buffer_.end(), static_cast<const char*>(extra), static_cast<const char*>(extra) + extraSize);
+    buffer_.insert(buffer_.end(), zeros, zeros + padding);
+}
+
+bool WriteAheadLog::flush() {
+    if (buffer_.empty()) {
+        return true;
+    }
+    if (!writeAll(fd_, buffer_.data(), buffer_.size())) {
+        return false;
+    }
+    written_ += buffer_.size();
+    buffer_.clear();
+    return true;
+}
+
+int WriteAheadLog::commit() {
+    return this->flush() && syncFd(fd_) ? 0 : -1;
+}
+
+uint64_t WriteAheadLog::size() const {
+    return written_ + buffer_.size();
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+    只追加的预写日志（WAL）
+    | 文件头（32字节） | 记录 | 记录 | ...
+    每条记录是32字节的记录头（类型、校验和、序号、数量、数据长度）加上补齐到8字节的数据，记录的含义由使用者定义
+    校验和是记录头（校验和字段为0）和数据的CRC32C，读取时遇到不完整或校验失败的记录就停止，
+    崩溃时最后一次提交只写了一部分的记录会被丢弃
+
+    组提交：append 只把记录放进缓冲区，缓冲区超过 groupBytes 时写入文件但不落盘，
+    commit 时把剩余的记录写入并 fdatasync，一批修改只需要一次落盘
+    文件以 O_APPEND 打开，同一时间只能有一个写入者
+*/
+class WriteAheadLog
+{
+    public:
+        struct Record {
+            uint32_t type;
+            uint64_t sequence;      // 递增的序号，由使用者分配
+            uint64_t count;         // 记录中的元素数量
+            const char* data;       // 指向映射中的数据
+            uint64_t size;
+        };
+
+        // 新建只有文件头的日志（先写临时文件并落盘，再改名替换已有的日志并同步目录），失败时返回空指针
+        static std::unique_ptr<WriteAheadLog> create(const std::string& filename, uint64_t dim);
+        /*
+            打开已有的日志继续追加，先截断 end 之后不完整的记录
+            文件长度不再是 expectedSize 时（读取之后又被别人写入）返回空指针
+        */
+        static std::unique_ptr<WriteAheadLog> openAppend(const std::string& filename, uint64_t end, uint64_t expectedSize);
+        /*
+            读取日志中所有有效的记录，数据指向 mapping，end 为最后一条有效记录之后的偏移
+            返回0成功，-1文件不存在或打开失败，-2不是日志文件，-3维度不一致
+        */
+        static int read(
+            const std::string& filename,
+            uint64_t dim,
+            std::shared_ptr<MappedFile>& mapping,
+            std::vector<Record>& records,
+            uint64_t& end
+        );
+
+        // 提交剩余的记录并关闭
+        ~WriteAheadLog();
+
+        WriteAheadLog(const WriteAheadLog&) = delete;
+        WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+        /*
+            追加一条记录，数据为 data 和 extra 依次连接，extra 可以为空
+            写入文件失败时抛出 std::runtime_error
+        */
+        void append(uint32_t type, uint64_t sequence, uint64_t count,
+                    const void* data, uint64_t size, const void* extra = nullptr, uint64_t extraSize = 0);
+        // 写入缓冲区中的记录并落盘，返回0成功，-1失败
+        int commit();
+        // 日志的长度，包括还在缓冲区中的记录
+        uint64_t size() const;
+
+        // 缓冲区超过该字节数时写入文件，单条记录超过该值时不经过缓冲区直接写入
+        uint64_t groupBytes = 1 << 20;
+
+    private:
+        WriteAheadLog(int fd, uint64_t size);
+        // 把缓冲区写入文件，不落盘
+        bool flush();
+
+        int fd_;                            // 以 O_APPEND 打开的日志文件
+        uint64_t written_;                  // 已经写入文件的字节数
+        std::vector<char> buffer_;          // 还没有写入文件的记录
+};
@@ -45,6 +45,30 @@ void bind_flat_index(py::module& m) {
         py::arg("mgr") // 新增的 mgr 参数
         )
         
+        .def(py::init([](uint64_t dim,
+                        uint64_t capacity,
+                        StorageType storageType,
+                        MetricType metricType,
+                        py::object mgr_py_obj) {
+            kp::Manager* mgr_ptr = nullptr;
+            return std::make_unique<PyFlatIndex>(dim, capacity, storageType, metricType, mgr_ptr);
+        }), R"pbdoc(
+            Create a FlatIndex with an explicit storage type.
+            
+            Args:
+                dim (int): Vector dimension.
+                capacity (int): Initial capacity.
+                storageType (StorageType): FP32, FP16 or BF16 storage for the database vectors.
+                metricType (MetricType): Distance metric type.
+                mgr (kp.Manager): The Kompute Manager instance for GPU operations.
+        )pbdoc",
+        py::arg("dim"),
+        py::arg("capacity"),
+        py::arg("storageType"),
+        py::arg("metricType"),
+        py::arg("mgr")
+        )
+
         .def(py::init([](uint64_t dim, py::object mgr_py_obj, MetricType metricType) {
             // 检查传入参数是否为None
             kp::Manager* mgr_ptr = nullptr;
@@ -77,6 +101,30 @@ void bind_flat_index(py::module& m) {
              )pbdoc",
              py::arg("vectors"))
         
+        .def("add_with_ids", &PyFlatIndex::add_with_ids,
+             R"pbdoc(
+                 Add vectors with external uint64 ids. After this, search returns ids
+                 instead of row offsets and remove_ids takes ids. Adding an id that
+                 already exists replaces the old vector.
+                 
+                 Args:
+                     vectors: 2D numpy array of shape (n_vectors, dim)
+                     ids: 1D numpy array of n_vectors uint64 ids
+             )pbdoc",
+             py::arg("vectors"), py::arg("ids"))
+
+        .def("has_ids", &PyFlatIndex::has_ids,
+             "Check whether the index uses external ids")
+
+        .def("get_row", &PyFlatIndex::get_row,
+             R"pbdoc(
+                 Look up the row of an id in O(1).
+                 
+                 Returns:
+                     Row offset, or None if the id is not in the index
+             )pbdoc",
+             py::arg("id"))
+
         .def("get_num", &PyFlatIndex::get_num,
              "Get the number of vectors in the index")
         
@@ -88,6 +136,9 @@ void bind_flat_index(py::module& m) {
         
         .def("is_float16", &PyFlatIndex::is_float16,
              "Check if using float16 storage")
+
+        .def("get_storage_type", &PyFlatIndex::get_storage_type,
+             "Get the storage type of the database vectors")
         
         // .def("query", &PyFlatIndex::query,
         //      R"pbdoc(
@@ -134,6 +185,70 @@ void bind_flat_index(py::module& m) {
              )pbdoc",
              py::arg("queries"), py::arg("k")) // 这里不暴露 device 参数，内部处理
 
+        .def("range_search", &PyFlatIndex::range_search,
+             R"pbdoc(
+                 Return every vector within radius of each query: distance < radius
+                 for L2, inner product > radius for METRIC_INNER_PRODUCT.
+                 
+                 Args:
+                     queries: 2D numpy array of query vectors (n_queries, dim)
+                     radius: Distance threshold
+                 
+                 Returns:
+                     Tuple of (lims, labels, distances). Results of query i are
+                     labels[lims[i]:lims[i+1]] and distances[lims[i]:lims[i+1]].
+             )pbdoc",
+             py::arg("queries"), py::arg("radius"))
+
+        .def("search_filtered", &PyFlatIndex::search_filtered,
+             R"pbdoc(
+                 Search only among the selected vectors. Give exactly one selector.
+                 Selectors use the same ids that search returns (external ids if the
+                 index has them, row offsets otherwise).
+                 
+                 Args:
+                     queries: 2D numpy array of query vectors (n_queries, dim)
+                     k: Number of nearest neighbors to return
+                     ids: Array of selected ids
+                     bitset: uint64 array, bit i set selects id i
+                     id_range: (begin, end) tuple selecting begin <= id < end
+                 
+                 Returns:
+                     Tuple of (indices, distances) as numpy arrays, padded with
+                     UINT64_MAX when fewer than k vectors are selected
+             )pbdoc",
+             py::arg("queries"), py::arg("k"), py::arg("ids") = py::none(),
+             py::arg("bitset") = py::none(), py::arg("id_range") = py::none())
+
+        .def("remove_ids", &PyFlatIndex::remove_ids,
+             R"pbdoc(
+                 Mark vectors as removed. They are skipped by query/search right away
+                 and physically dropped by compact().
+                 
+                 Args:
+                     ids: 1D numpy array of external ids, or row offsets if the index
+                          has no external ids
+                 
+                 Returns:
+                     Number of newly removed vectors
+             )pbdoc",
+             py::arg("ids"))
+
+        .def("get_num_removed", &PyFlatIndex::get_num_removed,
+             "Get the number of removed vectors not yet compacted")
+
+        .def("needs_compaction", &PyFlatIndex::needs_compaction,
+             "Check whether the removed fraction exceeds the compaction threshold")
+
+        .def("compact", &PyFlatIndex::compact,
+             R"pbdoc(
+                 Drop removed vectors and renumber the remaining rows in order.
+                 External ids are kept.
+                 
+                 Returns:
+                     1D numpy array mapping old indices to new ones (UINT64_MAX for removed vectors)
+             )pbdoc")
+
         .def("reconstruct", &PyFlatIndex::reconstruct,
              R"pbdoc(
                  Reconstruct a vector by its index.
@@ -168,5 +283,53 @@ void bind_flat_index(py::module& m) {
                  Returns:
                      Status code (0 for success)
              )pbdoc",
-             py::arg("filename"));
+             py::arg("filename"))
+
+        .def("load_mmap", &PyFlatIndex::load_mmap,
+             R"pbdoc(
+                 Map the index file into memory instead of copying it. Vectors are
+                 read on demand from the page cache, which processes mapping the same
+                 file share. Files in the old unaligned format are copied as by load().
+                 
+                 Args:
+                     filename: Path to load the index from
+                     populate: Read all pages before returning (MAP_POPULATE)
+                     verify: Check every section checksum first, which reads the whole file
+                 
+                 Returns:
+                     Status code (0 for success, -3 if the file is corrupted)
+             )pbdoc",
+             py::arg("filename"), py::arg("populate") = false, py::arg("verify") = false)
+
+        .def("is_mapped", &PyFlatIndex::is_mapped,
+             "Check whether the vectors are served from a memory-mapped file")
+
+        .def("enable_wal", &PyFlatIndex::enable_wal,
+             R"pbdoc(
+                 Switch to write-ahead log mode. Later adds, removals and compactions are
+                 appended to filename + ".wal", and save(filename) only commits the log
+                 (one fsync per batch). load() replays the log on top of the snapshot.
+                 The snapshot is rewritten when the log grows past half its size.
+                 
+                 Args:
+                     filename: Snapshot file the log belongs to
+                 
+                 Returns:
+                     Status code (0 for success)
+             )pbdoc",
+             py::arg("filename"))
+
+        .def("disable_wal", &PyFlatIndex::disable_wal,
+             "Commit the log and leave write-ahead log mode")
+
+        .def("is_wal_enabled", &PyFlatIndex::is_wal_enabled,
+             "Check whether changes are written to a write-ahead log")
+
+        .def("checkpoint", &PyFlatIndex::checkpoint,
+             R"pbdoc(
+                 Rewrite the snapshot and truncate the write-ahead log.
+                 
+                 Returns:
+                     Status code (0 for success)
+             )pbdoc");
 }
\ No newline at end of file
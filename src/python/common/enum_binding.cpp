@@ -12,4 +12,11 @@ void bind_common_enums(py::module& m) {
         .value("GPU", DeviceType::GPU_KOMPUTE)
         .value("NPU", DeviceType::NPU_HEXAGON)
         .export_values();
+
+    // 绑定存储格式
+    py::enum_<StorageType>(m, "StorageType")
+        .value("FP32", StorageType::STORAGE_FP32)
+        .value("FP16", StorageType::STORAGE_FP16)
+        .value("BF16", StorageType::STORAGE_BF16)
+        .export_values();
 };
\ No newline at end of file
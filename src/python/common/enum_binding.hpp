@@ -3,6 +3,7 @@
 
 #include "src/index/MetricType.hpp"
 #include "src/index/Device.hpp"
+#include "src/index/StorageType.hpp"
 
 namespace py = pybind11;
 
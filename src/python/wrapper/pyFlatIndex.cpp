@@ -1,12 +1,18 @@
 #include "src/index/FlatIndex.hpp"
 #include "src/python/wrapper/pyFlatIndex.hpp"
 #include "src/python/numpy_helper.hpp"
+#include <pybind11/stl.h>
 
+#include <algorithm>
 #include <stdexcept>
+#include <vector>
 
 PyFlatIndex::PyFlatIndex(uint64_t dim, uint64_t capacity, bool isFloat16, MetricType metricType, kp::Manager* mgr) 
     : index_(std::make_unique<FlatIndex>(dim, capacity, isFloat16, metricType, mgr)) {}
 
+PyFlatIndex::PyFlatIndex(uint64_t dim, uint64_t capacity, StorageType storageType, MetricType metricType, kp::Manager* mgr) 
+    : index_(std::make_unique<FlatIndex>(dim, capacity, storageType, metricType, mgr)) {}
+
 PyFlatIndex::PyFlatIndex(uint64_t dim, kp::Manager* mgr, MetricType metricType) 
     : index_(std::make_unique<FlatIndex>(dim)) {}
 
@@ -30,6 +36,40 @@ void PyFlatIndex::add_vectors(py::array_t<float> vectors) {
     index_->addVector(data, n);
 }
 
+void PyFlatIndex::add_with_ids(py::array_t<float> vectors, py::array_t<uint64_t> ids) {
+    auto buf = vectors.request();
+    auto idsBuf = ids.request();
+
+    if (buf.format != py::format_descriptor<float>::format()) {
+        throw std::runtime_error("Expected float32 array");
+    }
+    if (buf.ndim != 2 || idsBuf.ndim != 1 || idsBuf.shape[0] != buf.shape[0]) {
+        throw std::runtime_error("Expected (n, dim) vectors and n ids");
+    }
+
+    uint64_t n = buf.shape[0];
+    uint64_t dim = buf.shape[1];
+
+    if (dim != index_->getDim()) {
+        throw std::runtime_error("Dimension mismatch: expected " + 
+                                std::to_string(index_->getDim()) + ", got " + std::to_string(dim));
+    }
+
+    index_->addVectorWithIds(static_cast<const float*>(buf.ptr), static_cast<const uint64_t*>(idsBuf.ptr), n);
+}
+
+bool PyFlatIndex::has_ids() const {
+    return index_->hasIds();
+}
+
+py::object PyFlatIndex::get_row(uint64_t id) const {
+    uint64_t row = index_->getRow(id);
+    if (row == UINT64_MAX) {
+        return py::none();
+    }
+    return py::int_(row);
+}
+
 uint64_t PyFlatIndex::get_num() const { 
     return index_->getNum(); 
 }
@@ -46,6 +86,10 @@ bool PyFlatIndex::is_float16() const {
     return index_->isFloat16(); 
 }
 
+StorageType PyFlatIndex::get_storage_type() const { 
+    return index_->getStorageType(); 
+}
+
 // py::tuple PyFlatIndex::query(py::array_t<float> queries, uint64_t k, DeviceType device) {
 //     py::buffer_info buf = queries.request();
     
@@ -135,6 +179,110 @@ py::tuple PyFlatIndex::search(py::array_t<float> queries, uint64_t k) {
     return py::make_tuple(results, distances);
 }
 
+uint64_t PyFlatIndex::remove_ids(py::array_t<uint64_t> ids) {
+    py::buffer_info buf = ids.request();
+    if (buf.ndim != 1) {
+        throw std::runtime_error("Ids must be 1D array");
+    }
+    return index_->removeIds(static_cast<const uint64_t*>(buf.ptr), buf.shape[0]);
+}
+
+uint64_t PyFlatIndex::get_num_removed() const {
+    return index_->getNumRemoved();
+}
+
+bool PyFlatIndex::needs_compaction() const {
+    return index_->needsCompaction();
+}
+
+py::array_t<uint64_t> PyFlatIndex::compact() {
+    std::vector<uint64_t> newIds;
+    index_->compact(&newIds);
+    auto result = py::array_t<uint64_t>(newIds.size());
+    std::copy(newIds.begin(), newIds.end(), static_cast<uint64_t*>(result.request().ptr));
+    return result;
+}
+py::tuple PyFlatIndex::range_search(py::array_t<float> queries, float radius) {
+    py::buffer_info buf = queries.request();
+    if (buf.ndim != 2) {
+        throw std::runtime_error("Query vectors must be 2D array (n_queries, dim)");
+    }
+
+    uint64_t nQuery = buf.shape[0];
+    uint64_t dim = buf.shape[1];
+
+    if (dim != index_->getDim()) {
+        throw std::runtime_error("Query dimension mismatch: expected " + 
+                                std::to_string(index_->getDim()) + ", got " + std::to_string(dim));
+    }
+
+    RangeSearchResult result;
+    index_->rangeSearch(nQuery, static_cast<const float*>(buf.ptr), radius, result);
+
+    // 复制到numpy数组中，result 在返回后释放
+    return py::make_tuple(
+        py::array_t<uint64_t>(result.lims.size(), result.lims.data()),
+        py::array_t<uint64_t>(result.labels.size(), result.labels.data()),
+        py::array_t<float>(result.distances.size(), result.distances.data())
+    );
+}
+
+py::tuple PyFlatIndex::search_filtered(py::array_t<float> queries, uint64_t k, py::object ids, py::object bitset, py::object id_range) {
+    if (ids.is_none() + bitset.is_none() + id_range.is_none() != 2) {
+        throw std::runtime_error("Exactly one of ids, bitset and id_range must be given");
+    }
+
+    py::buffer_info buf = queries.request();
+    if (buf.ndim != 2) {
+        throw std::runtime_error("Query vectors must be 2D array (n_queries, dim)");
+    }
+
+    uint64_t nQuery = buf.shape[0];
+    uint64_t dim = buf.shape[1];
+
+    if (dim != index_->getDim()) {
+        throw std::runtime_error("Query dimension mismatch: expected " + 
+                                std::to_string(index_->getDim()) + ", got " + std::to_string(dim));
+    }
+
+    // 编号列表复制一份排序，位图按 uint64 的字读取
+    std::vector<uint64_t> sortedIds;
+    py::array_t<uint64_t, py::array::c_style | py::array::forcecast> bits;
+    IDSelector selector = IDSelector::range(0, 0);
+    if (!ids.is_none()) {
+        auto idsArray = py::array_t<uint64_t, py::array::c_style | py::array::forcecast>::ensure(ids);
+        if (!idsArray) {
+            throw std::runtime_error("ids must be convertible to a uint64 array");
+        }
+        sortedIds.assign(idsArray.data(), idsArray.data() + idsArray.size());
+        std::sort(sortedIds.begin(), sortedIds.end());
+        selector = IDSelector::sortedList(sortedIds.data(), sortedIds.size());
+    } else if (!bitset.is_none()) {
+        bits = py::array_t<uint64_t, py::array::c_style | py::array::forcecast>::ensure(bitset);
+        if (!bits) {
+            throw std::runtime_error("bitset must be convertible to a uint64 array");
+        }
+        selector = IDSelector::bitset(bits.data(), bits.size() * 64);
+    } else {
+        auto range = id_range.cast<std::pair<uint64_t, uint64_t>>();
+        selector = IDSelector::range(range.first, range.second);
+    }
+
+    auto results = NumpyHelper::create_2d_uint64_array(nQuery, k);
+    auto distances = NumpyHelper::create_2d_float_array(nQuery, k);
+
+    py::buffer_info results_buf = results.request();
+    py::buffer_info distances_buf = distances.request();
+
+    const float* query_data = static_cast<const float*>(buf.ptr);
+    uint64_t* results_data = static_cast<uint64_t*>(results_buf.ptr);
+    float* distances_data = static_cast<float*>(distances_buf.ptr);
+
+    index_->search(k, nQuery, query_data, results_data, distances_data, selector);
+
+    return py::make_tuple(results, distances);
+}
+
 
 py::array_t<float> PyFlatIndex::reconstruct(uint64_t idx) {
     // 创建一个新的numpy数组来存储重建的向量
@@ -152,4 +300,28 @@ int PyFlatIndex::save(const std::string& filename) {
 
 int PyFlatIndex::load(const std::string& filename) {
     return index_->load(filename);
+}
+
+int PyFlatIndex::load_mmap(const std::string& filename, bool populate, bool verify) {
+    return index_->loadMmap(filename, populate, MappedFile::Advice::NORMAL, verify);
+}
+
+bool PyFlatIndex::is_mapped() const {
+    return index_->isMapped();
+}
+
+int PyFlatIndex::enable_wal(const std::string& filename) {
+    return index_->enableWal(filename);
+}
+
+void PyFlatIndex::disable_wal() {
+    index_->disableWal();
+}
+
+bool PyFlatIndex::is_wal_enabled() const {
+    return index_->isWalEnabled();
+}
+
+int PyFlatIndex::checkpoint() {
+    return index_->checkpoint();
 }
\ No newline at end of file
@@ -14,16 +14,23 @@ public:
     // 构造函数
     PyFlatIndex(uint64_t dim, uint64_t capacity, bool isFloat16 = false, 
                 MetricType metricType = MetricType::METRIC_INNER_PRODUCT, kp::Manager* mgr = nullptr);
+    PyFlatIndex(uint64_t dim, uint64_t capacity, StorageType storageType,
+                MetricType metricType = MetricType::METRIC_INNER_PRODUCT, kp::Manager* mgr = nullptr);
     PyFlatIndex(uint64_t dim, kp::Manager* mgr, MetricType metricType);
     
     // 向量操作
     void add_vectors(py::array_t<float> vectors);
+    void add_with_ids(py::array_t<float> vectors, py::array_t<uint64_t> ids);
+    bool has_ids() const;
+    // 不存在时返回 None
+    py::object get_row(uint64_t id) const;
     
     // 基本信息获取
     uint64_t get_num() const;
     uint64_t get_dim() const;
     uint64_t get_capacity() const;
     bool is_float16() const;
+    StorageType get_storage_type() const;
     
     // 查询方法
     py::tuple query(py::array_t<float> queries, uint64_t k, DeviceType device);
@@ -31,6 +38,17 @@ public:
                          DeviceType device);
     // 最终实际不应该暴露device参数，应该在FlatIndex内部进行调度处理
     py::tuple search(py::array_t<float> queries, uint64_t k);
+    // 范围查询，返回CSR格式的 (lims, labels, distances)
+    py::tuple range_search(py::array_t<float> queries, float radius);
+    // 只在 ids（编号列表）、bitset（按编号的位图）或 id_range（[begin, end)）选中的向量中查询，三者只能指定一个
+    py::tuple search_filtered(py::array_t<float> queries, uint64_t k, py::object ids, py::object bitset, py::object id_range);
+
+    // 删除向量：先标记为墓碑，compact 时才真正移除并重新编号
+    uint64_t remove_ids(py::array_t<uint64_t> ids);
+    uint64_t get_num_removed() const;
+    bool needs_compaction() const;
+    // 返回旧编号到新编号的映射，被删除的行为 UINT64_MAX
+    py::array_t<uint64_t> compact();
 
     // 重建向量
     py::array_t<float> reconstruct(uint64_t idx);
@@ -38,4 +56,11 @@ public:
     // 文件操作
     int save(const std::string& filename);
     int load(const std::string& filename);
+    int load_mmap(const std::string& filename, bool populate = false, bool verify = false);
+    bool is_mapped() const;
+    // WAL 模式：修改追加到 filename.wal，save(filename) 只提交日志
+    int enable_wal(const std::string& filename);
+    void disable_wal();
+    bool is_wal_enabled() const;
+    int checkpoint();
 };
\ No newline at end of file
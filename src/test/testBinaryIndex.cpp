@@ -0,0 +1,136 @@
+#include "src/index/BinaryIndex.hpp"
+#include "src/index/FlatIndex.hpp"
+#include "src/backend/cpu-blas/kernels.hpp"
+#include "testData.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+// 当前选中的汉明距离内核必须与标量版本的结果完全一致（nwords 取奇数，覆盖尾部处理）
+bool testHammingKernel() {
+    const uint64_t nwords = 5;
+    const uint64_t ny = 37;
+    std::mt19937_64 rng(1145);
+    std::vector<uint64_t> x(nwords), codes(nwords * ny);
+    for (auto& v : x) {
+        v = rng();
+    }
+    for (auto& v : codes) {
+        v = rng();
+    }
+    std::vector<uint32_t> expected(ny), got(ny);
+    cpu_blas::getKernelsScalar().hamming_ny(expected.data(), x.data(), codes.data(), nwords, ny);
+    cpu_blas::getKernels().hamming_ny(got.data(), x.data(), codes.data(), nwords, ny);
+    for (uint64_t j = 0; j < ny; ++j) {
+        uint32_t d = 0;
+        for (uint64_t i = 0; i < nwords; ++i) {
+            uint64_t v = x[i] ^ codes[j * nwords + i];
+            while (v) {
+                d += v & 1;
+                v >>= 1;
+            }
+        }
+        if (expected[j] != d || got[j] != d) {
+            std::cout << cpu_blas::getKernels().name << " hamming_ny mismatch" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool testBinaryIndex(MetricType metric, bool rotate, const char* name) {
+    const uint64_t dim = 100;           // 不是64的倍数，最后一个字没有用满
+    const uint64_t nData = 20000;
+    const uint64_t nQuery = 50;
+    const uint64_t k = 10;
+
+    std::mt19937 rng(1145);
+    std::vector<float> vecs = makeLowRankData(nData, dim, 16, true, rng);
+    std::vector<float> queries = makeLowRankData(nQuery, dim, 16, true, rng);
+
+    BinaryIndex index(dim, metric, rotate);
+    index.addVector(vecs.data(), 5000);
+    index.addVector(vecs.data() + 5000 * dim, nData - 5000);
+
+    FlatIndex exact(dim, 1000, false, metric, nullptr);
+    exact.addVector(vecs.data(), nData);
+
+    bool isPassed = testHammingKernel();
+
+    for (uint64_t batch : {(uint64_t)1, nQuery}) {
+        std::vector<uint64_t> gt(k * batch);
+        std::vector<float> gtDistances(k * batch);
+        exact.query(k, 0, nData, DeviceType::CPU_BLAS, batch, queries.data(), gt.data(), gtDistances.data());
+
+        // 不精排：返回的是汉明距离，按从小到大排列
+        std::vector<uint64_t> results(k * batch);
+        std::vector<float> distances(k * batch);
+        index.setRefine(nullptr);
+        index.search(k, batch, queries.data(), results.data(), distances.data());
+        for (uint64_t i = 0; i < batch; ++i) {
+            if (distances[i * k] != std::floor(distances[i * k]) || distances[i * k] > dim ||
+                !std::is_sorted(distances.begin() + i * k, distances.begin() + (i + 1) * k)) {
+                std::cout << name << " hamming distances are invalid" << std::endl;
+                isPassed = false;
+                break;
+            }
+        }
+
+        // 精排：距离为精确距离，召回率应足够高
+        index.setRefine(&exact, 20);
+        index.search(k, batch, queries.data(), results.data(), distances.data());
+        uint64_t hit = 0;
+        for (uint64_t i = 0; i < batch; ++i) {
+            if (results[i * k] == gt[i * k]) {
+                ++hit;
+                if (std::abs(distances[i * k] - gtDistances[i * k]) > 1e-4 * (1.0f + std::abs(gtDistances[i * k]))) {
+                    std::cout << name << " refined distance mismatch: expected = " << gtDistances[i * k]
+                              << ", got = " << distances[i * k] << std::endl;
+                    isPassed = false;
+                }
+            }
+        }
+        float recall = (float)hit / batch;
+        std::cout << name << " nQuery = " << batch << ", refined 1-recall@1 = " << recall << std::endl;
+        if (recall < 0.9f) {
+            isPassed = false;
+        }
+    }
+
+    // 保存后重新加载，编码和查询结果不变
+    index.save("data/testBinaryIndex.bin");
+    BinaryIndex loaded(dim);
+    loaded.load("data/testBinaryIndex.bin");
+    std::vector<uint64_t> a(index.getCodeWords()), b(index.getCodeWords());
+    index.getCode(nData - 1, a.data());
+    loaded.getCode(nData - 1, b.data());
+    std::vector<uint64_t> r1(k), r2(k);
+    std::vector<float> d1(k), d2(k);
+    index.setRefine(nullptr);
+    index.search(k, 1, queries.data(), r1.data(), d1.data());
+    loaded.search(k, 1, queries.data(), r2.data(), d2.data());
+    if (loaded.getNum() != nData || a != b || r1 != r2 || d1 != d2) {
+        std::cout << name << " save/load failed" << std::endl;
+        isPassed = false;
+    }
+
+    if (isPassed) {
+        std::cout << name << " BinaryIndex test passed!" << std::endl;
+    } else {
+        std::cout << name << " BinaryIndex test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+int main() {
+    bool isPassed = true;
+    isPassed = testBinaryIndex(MetricType::METRIC_INNER_PRODUCT, false, "IP") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testBinaryIndex(MetricType::METRIC_INNER_PRODUCT, true, "IP rotated") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testBinaryIndex(MetricType::METRIC_L2, true, "L2 rotated") && isPassed;
+    return isPassed ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// 测试共用的数据生成函数
+
+/*
+    生成低内在维度的数据（latent 维隐变量经随机投影后加少量噪声），更接近真实的embedding分布
+    normalize 为 true 时每个向量归一化为单位长度
+*/
+inline std::vector<float> makeLowRankData(uint64_t n, uint64_t dim, uint64_t latent, bool normalize, std::mt19937& rng) {
+    std::mt19937 projRng(2024);     // 数据库和查询使用同一个投影
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<float> proj(latent * dim);
+    for (auto& v : proj) {
+        v = dist(projRng);
+    }
+    std::vector<float> data(n * dim);
+    std::vector<float> z(latent);
+    for (uint64_t i = 0; i < n; ++i) {
+        for (auto& v : z) {
+            v = dist(rng);
+        }
+        float norm = 0;
+        for (uint64_t j = 0; j < dim; ++j) {
+            float v = 0.1f * dist(rng);
+            for (uint64_t l = 0; l < latent; ++l) {
+                v += z[l] * proj[l * dim + j];
+            }
+            data[i * dim + j] = v;
+            norm += v * v;
+        }
+        if (normalize) {
+            norm = std::sqrt(norm);
+            for (uint64_t j = 0; j < dim; ++j) {
+                data[i * dim + j] /= norm;
+            }
+        }
+    }
+    return data;
+}
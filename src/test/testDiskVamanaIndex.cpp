@@ -0,0 +1,87 @@
+#include "src/index/DiskVamanaIndex.hpp"
+#include "src/index/FlatIndex.hpp"
+#include "testData.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+int main() {
+    const uint64_t dim = 64;
+    const uint64_t nData = 10000;
+    const uint64_t nQuery = 50;
+    const uint64_t k = 10;
+
+    std::mt19937 rng(1145);
+    std::vector<float> vecs = makeLowRankData(nData, dim, 8, false, rng);
+    std::vector<float> queries = makeLowRankData(nQuery, dim, 8, false, rng);
+
+    DiskVamanaIndex index(dim, 32, 64, 1.2f, 16);
+    bool isPassed = index.build(vecs.data(), nData, "data/testDiskVamanaIndex.bin") == 0;
+
+    FlatIndex exact(dim, 1000, false, MetricType::METRIC_L2, nullptr);
+    exact.addVector(vecs.data(), nData);
+    std::vector<uint64_t> gt(k * nQuery);
+    std::vector<float> gtDistances(k * nQuery);
+    exact.query(k, 0, nData, DeviceType::CPU_BLAS, nQuery, queries.data(), gt.data(), gtDistances.data());
+
+    index.setSearchListSize(64);
+    index.setBeamWidth(4);
+    std::vector<uint64_t> results(k * nQuery);
+    std::vector<float> distances(k * nQuery);
+    uint64_t readsBefore = index.getDiskReads();
+    index.search(k, nQuery, queries.data(), results.data(), distances.data());
+    double readsPerQuery = (double)(index.getDiskReads() - readsBefore) / nQuery;
+
+    uint64_t hit = 0;
+    for (uint64_t i = 0; i < nQuery; ++i) {
+        for (uint64_t j = 0; j < k; ++j) {
+            if (std::find(results.begin() + i * k, results.begin() + (i + 1) * k, gt[i * k + j]) != results.begin() + (i + 1) * k) {
+                ++hit;
+            }
+        }
+        // 结果按磁盘上的原始向量重新计算了精确距离
+        if (results[i * k] == gt[i * k] &&
+            std::abs(distances[i * k] - gtDistances[i * k]) > 1e-3 * (1.0f + std::abs(gtDistances[i * k]))) {
+            std::cout << "distance mismatch: expected = " << gtDistances[i * k] << ", got = " << distances[i * k] << std::endl;
+            isPassed = false;
+        }
+    }
+    float recall = (float)hit / (nQuery * k);
+    std::cout << "recall@" << k << " = " << recall << ", disk reads per query = " << readsPerQuery << std::endl;
+    if (recall < 0.9f || readsPerQuery > nData / 10) {
+        isPassed = false;
+    }
+
+    // 原始向量从磁盘读回
+    std::vector<float> vec(dim);
+    index.reconstruct(4321, vec.data());
+    if (!std::equal(vec.begin(), vec.end(), vecs.begin() + 4321 * dim)) {
+        std::cout << "reconstruct from disk failed" << std::endl;
+        isPassed = false;
+    }
+
+    // 重新打开索引文件，结果不变
+    DiskVamanaIndex loaded(dim);
+    if (loaded.load("data/testDiskVamanaIndex.bin") != 0) {
+        isPassed = false;
+    }
+    loaded.setSearchListSize(64);
+    loaded.setBeamWidth(4);
+    std::vector<uint64_t> loadedResults(k * nQuery);
+    std::vector<float> loadedDistances(k * nQuery);
+    loaded.search(k, nQuery, queries.data(), loadedResults.data(), loadedDistances.data());
+    if (loaded.getNum() != nData || loadedResults != results) {
+        std::cout << "load failed" << std::endl;
+        isPassed = false;
+    }
+
+    if (isPassed) {
+        std::cout << "DiskVamanaIndex test passed!" << std::endl;
+    } else {
+        std::cout << "DiskVamanaIndex test failed!" << std::endl;
+    }
+    return isPassed ? 0 : 1;
+}
@@ -1,8 +1,16 @@
 #include "src/index/FlatIndex.hpp"
 #include "src/backend/cpu-blas/L2Norm.hpp"
+#include "src/backend/cpu-blas/kernels.hpp"
 
+#include <algorithm>
 #include <vector>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
 
 void testFlatIndexCpuL2() {
     FlatIndex index(2, 1000, false, MetricType::METRIC_L2, nullptr);
@@ -100,7 +108,7 @@ void testFlatIndexCpuIP() {
     }
 }
 
-void FlatIndexCpuRenorm() {
+bool FlatIndexCpuRenorm() {
     // 不用查询，单单测试一下remorm函数是否正常工作
     // 新建向量 1000 个，把半径为10的圆周分成1000份
     int nData = 1000;
@@ -133,15 +141,1235 @@ void FlatIndexCpuRenorm() {
     } else {
         std::cout << "Renormalization test failed!" << std::endl;
     }
+    return isPassed;
+}
+
+bool testFlatIndexStorage16(StorageType storageType, const char* name, float tolerance) {
+    // 16位存储的结果应该与单精度存储基本一致，分别覆盖少量查询（扫描）和批量查询（sgemm_）两条路径
+    const uint64_t dim = 67;        // 不是向量宽度的整数倍，覆盖循环尾部
+    const uint64_t nData = 5000;
+    const uint64_t k = 10;
+
+    std::mt19937 rng(1145);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> vecs(dim * nData);
+    for (auto& v : vecs) {
+        v = dist(rng);
+    }
+
+    bool isPassed = true;
+    for (MetricType metric : {MetricType::METRIC_L2, MetricType::METRIC_INNER_PRODUCT}) {
+        FlatIndex index32(dim, 1000, false, metric, nullptr);
+        FlatIndex index16(dim, 1000, storageType, metric, nullptr);
+        index32.addVector(vecs.data(), nData);
+        index16.addVector(vecs.data(), nData);
+
+        // 重建的向量误差应在存储格式的精度范围内
+        std::vector<float> vec(dim);
+        index16.reconstruct(123, vec.data());
+        for (uint64_t j = 0; j < dim; ++j) {
+            if (std::abs(vec[j] - vecs[123 * dim + j]) > tolerance) {
+                std::cout << name << " reconstruct failed at dim " << j << std::endl;
+                isPassed = false;
+                break;
+            }
+        }
+
+        for (uint64_t nQuery : {1, 3, 64}) {
+            std::vector<float> queries(dim * nQuery);
+            for (auto& v : queries) {
+                v = dist(rng);
+            }
+            std::vector<uint64_t> results32(k * nQuery), results16(k * nQuery);
+            std::vector<float> distances32(k * nQuery), distances16(k * nQuery);
+            index32.query(k, 0, nData, DeviceType::CPU_BLAS, nQuery, queries.data(), results32.data(), distances32.data());
+            index16.query(k, 0, nData, DeviceType::CPU_BLAS, nQuery, queries.data(), results16.data(), distances16.data());
+
+            for (uint64_t i = 0; i < nQuery * k; ++i) {
+                if (std::abs(distances32[i] - distances16[i]) > 10 * tolerance * (1.0f + std::abs(distances32[i]))) {
+                    std::cout << name << " query mismatch: nQuery = " << nQuery << ", i = " << i
+                              << ", fp32 = " << distances32[i] << ", " << name << " = " << distances16[i] << std::endl;
+                    isPassed = false;
+                    break;
+                }
+            }
+        }
+
+        // 保存后重新加载，存储格式和数据应保持不变
+        index16.save("data/testStorage16.bin");
+        FlatIndex loaded(dim, nullptr, metric);
+        loaded.load("data/testStorage16.bin");
+        std::vector<float> loadedVec(dim);
+        loaded.reconstruct(123, loadedVec.data());
+        if (loaded.getStorageType() != storageType || loadedVec != vec) {
+            std::cout << name << " save/load failed" << std::endl;
+            isPassed = false;
+        }
+    }
+
+    if (isPassed) {
+        std::cout << name << " storage test passed!" << std::endl;
+    } else {
+        std::cout << name << " storage test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+// 删除的行不应出现在任何路径的结果中，结果与只包含剩余行的索引一致；压缩、保存和加载后保持不变
+bool testFlatIndexRemove() {
+    const uint64_t nData = 3000;
+    const uint64_t k = 10;
+    bool isPassed = true;
+
+    struct Case {
+        uint64_t dim;
+        StorageType storageType;
+        MetricType metric;
+        bool useSearch;     // search 会在低维时走KD树，其他维度分给各个后端
+    };
+    const Case cases[] = {
+        {67, StorageType::STORAGE_FP32, MetricType::METRIC_L2, false},
+        {67, StorageType::STORAGE_FP32, MetricType::METRIC_INNER_PRODUCT, true},
+        {67, StorageType::STORAGE_FP16, MetricType::METRIC_INNER_PRODUCT, false},
+        {2, StorageType::STORAGE_FP32, MetricType::METRIC_L2, true},
+    };
+
+    for (const Case& c : cases) {
+        const uint64_t dim = c.dim;
+        std::mt19937 rng(1145);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        std::vector<float> vecs(dim * nData);
+        for (auto& v : vecs) {
+            v = dist(rng);
+        }
+
+        FlatIndex index(dim, 1000, c.storageType, c.metric, nullptr);
+        index.addVector(vecs.data(), nData);
+
+        // 删除每3行中的1行，重复删除和越界的行被忽略
+        std::vector<uint64_t> toRemove;
+        for (uint64_t i = 0; i < nData; i += 3) {
+            toRemove.push_back(i);
+        }
+        toRemove.push_back(0);
+        toRemove.push_back(nData + 5);
+        uint64_t nRemoved = index.removeIds(toRemove.data(), toRemove.size());
+
+        // 只包含剩余行的对照索引，liveIds 为对照索引中的行在原索引中的行号
+        FlatIndex live(dim, 1000, c.storageType, c.metric, nullptr);
+        std::vector<uint64_t> liveIds;
+        for (uint64_t i = 0; i < nData; ++i) {
+            if (i % 3 != 0) {
+                live.addVector(vecs.data() + i * dim, 1);
+                liveIds.push_back(i);
+            }
+        }
+        if (nRemoved != (nData + 2) / 3 || index.getNumRemoved() != nRemoved || !index.isRemoved(3) ||
+            index.isRemoved(4) || !index.needsCompaction()) {
+            std::cout << "remove bookkeeping failed" << std::endl;
+            isPassed = false;
+        }
+
+        auto check = [&](FlatIndex& idx, const std::vector<uint64_t>& mapping, const char* stage) {
+            for (uint64_t nQuery : {1, 64}) {
+                std::vector<float> queries(dim * nQuery);
+                for (auto& v : queries) {
+                    v = dist(rng);
+                }
+                std::vector<uint64_t> results(k * nQuery), expected(k * nQuery);
+                std::vector<float> distances(k * nQuery), expectedDistances(k * nQuery);
+                if (c.useSearch) {
+                    idx.search(k, nQuery, queries.data(), results.data(), distances.data());
+                } else {
+                    idx.query(k, 0, idx.getNum(), DeviceType::CPU_BLAS, nQuery, queries.data(), results.data(), distances.data());
+                }
+                live.query(k, 0, live.getNum(), DeviceType::CPU_BLAS, nQuery, queries.data(), expected.data(), expectedDistances.data());
+                for (uint64_t i = 0; i < nQuery * k; ++i) {
+                    bool removed = results[i] >= mapping.size() || mapping[results[i]] == UINT64_MAX;
+                    if (removed || std::abs(distances[i] - expectedDistances[i]) > 1e-3f * (1.0f + std::abs(expectedDistances[i]))) {
+                        std::cout << stage << " dim = " << dim << " mismatch: nQuery = " << nQuery << ", i = " << i
+                                  << ", expected = " << expectedDistances[i] << ", got = " << distances[i] << std::endl;
+                        isPassed = false;
+                        return;
+                    }
+                }
+            }
+        };
+
+        // 墓碑阶段：行号不变，mapping 中删除的行为 UINT64_MAX
+        std::vector<uint64_t> identity(nData);
+        for (uint64_t i = 0; i < nData; ++i) {
+            identity[i] = i % 3 == 0 ? UINT64_MAX : i;
+        }
+        check(index, identity, "tombstone");
+
+        // 保存和加载后墓碑仍然有效
+        index.save("data/testRemove.bin");
+        FlatIndex loaded(dim, nullptr, c.metric);
+        loaded.load("data/testRemove.bin");
+        if (loaded.getNumRemoved() != nRemoved) {
+            std::cout << "tombstones lost after save/load" << std::endl;
+            isPassed = false;
+        }
+        check(loaded, identity, "loaded");
+
+        // 压缩：剩余的行按原来的顺序前移
+        std::vector<uint64_t> newIds;
+        uint64_t remaining = index.compact(&newIds);
+        if (remaining != liveIds.size() || index.getNum() != remaining || index.getNumRemoved() != 0 ||
+            newIds[liveIds[5]] != 5 || newIds[3] != UINT64_MAX) {
+            std::cout << "compact bookkeeping failed" << std::endl;
+            isPassed = false;
+        }
+        std::vector<float> vec(dim), expectedVec(dim);
+        index.reconstruct(5, vec.data());
+        live.reconstruct(5, expectedVec.data());
+        if (vec != expectedVec) {
+            std::cout << "compact moved the wrong rows" << std::endl;
+            isPassed = false;
+        }
+        std::vector<uint64_t> compacted(remaining);
+        for (uint64_t i = 0; i < remaining; ++i) {
+            compacted[i] = i;
+        }
+        check(index, compacted, "compacted");
+
+        // 压缩后追加的向量范数正确
+        index.addVector(vecs.data(), 1);
+        live.addVector(vecs.data(), 1);
+        compacted.push_back(remaining);
+        check(index, compacted, "appended");
+    }
+
+    // 数据量很小时部分后端分到的范围为空，删除后不足k个的位置是空结果，不会把第0行当成距离为0的结果
+    for (uint64_t n = 1; n <= 3; ++n) {
+        const uint64_t dim = 16;
+        std::mt19937 rng(n);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        std::vector<float> vecs(dim * n);
+        for (auto& v : vecs) {
+            v = dist(rng);
+        }
+        FlatIndex small(dim, 1000, StorageType::STORAGE_FP32, MetricType::METRIC_L2, nullptr);
+        small.addVector(vecs.data(), n);
+        uint64_t first = 0;
+        small.removeIds(&first, 1);
+        std::vector<uint64_t> results(2);
+        std::vector<float> distances(2);
+        small.search(2, 1, vecs.data(), results.data(), distances.data());     // 查询就是被删除的第0行
+        for (uint64_t j = 0; j < 2; ++j) {
+            bool ok = j + 1 < n ? results[j] >= 1 && results[j] < n && distances[j] > 0.0f
+                                : results[j] == UINT64_MAX;
+            if (!ok) {
+                std::cout << "small index n = " << n << " returned " << results[j] << "(" << distances[j] << ")" << std::endl;
+                isPassed = false;
+            }
+        }
+    }
+
+    if (isPassed) {
+        std::cout << "Remove test passed!" << std::endl;
+    } else {
+        std::cout << "Remove test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+// 外部编号：search 返回标签，按标签删除和更新，压缩、保存和加载后标签不变
+bool testFlatIndexIds() {
+    const uint64_t nData = 2000;
+    const uint64_t k = 5;
+    bool isPassed = true;
+
+    for (uint64_t dim : {4, 67}) {
+        std::mt19937 rng(1151);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        std::vector<float> vecs(dim * nData);
+        for (auto& v : vecs) {
+            v = dist(rng);
+        }
+        // 标签是稀疏的大整数
+        std::vector<uint64_t> labels(nData);
+        for (uint64_t i = 0; i < nData; ++i) {
+            labels[i] = (i * 2654435761ull) ^ 0xabcdef000000ull;
+        }
+
+        FlatIndex index(dim, 1000, StorageType::STORAGE_FP32, MetricType::METRIC_L2, nullptr);
+        index.addVectorWithIds(vecs.data(), labels.data(), nData / 2);
+        index.addVectorWithIds(vecs.data() + nData / 2 * dim, labels.data() + nData / 2, nData - nData / 2);
+
+        bool threw = false;
+        try {
+            index.addVector(vecs.data(), 1);
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        if (!threw || !index.hasIds() || index.getRow(labels[7]) != 7 || index.getId(7) != labels[7]) {
+            std::cout << "id bookkeeping failed" << std::endl;
+            isPassed = false;
+        }
+
+        // 用数据库中的向量查询，最近的是它自己
+        auto checkSelf = [&](FlatIndex& idx, uint64_t i, uint64_t expected, const char* stage) {
+            uint64_t results[k];
+            float distances[k];
+            idx.search(k, 1, vecs.data() + i * dim, results, distances);
+            if (results[0] != expected || distances[0] > 1e-4f) {
+                std::cout << stage << " dim = " << dim << ": expected label " << expected << ", got " << results[0] << std::endl;
+                isPassed = false;
+            }
+        };
+        checkSelf(index, 10, labels[10], "add");
+
+        // 删除和更新：更新后的标签指向新的行，旧的行不再返回
+        uint64_t toRemove[] = {labels[3], labels[4], 12345};
+        if (index.removeIds(toRemove, 3) != 2 || index.getRow(labels[3]) != UINT64_MAX) {
+            std::cout << "remove by id failed" << std::endl;
+            isPassed = false;
+        }
+        index.addVectorWithIds(vecs.data() + 20 * dim, &labels[30], 1);
+        if (index.getRow(labels[30]) != nData || !index.isRemoved(30)) {
+            std::cout << "update by id failed" << std::endl;
+            isPassed = false;
+        }
+        checkSelf(index, 20, labels[20], "update");
+        {
+            uint64_t results[k];
+            float distances[k];
+            index.search(k, 1, vecs.data() + 20 * dim, results, distances);
+            if (results[1] != labels[30]) {
+                std::cout << "updated vector not found" << std::endl;
+                isPassed = false;
+            }
+            index.search(k, 1, vecs.data() + 3 * dim, results, distances);
+            if (results[0] == labels[3]) {
+                std::cout << "removed label returned" << std::endl;
+                isPassed = false;
+            }
+        }
+
+        // 压缩后标签不变
+        index.compact();
+        if (index.getNum() != nData - 2 || index.getRow(labels[5]) != 3 || index.getId(3) != labels[5]) {
+            std::cout << "compact lost ids" << std::endl;
+            isPassed = false;
+        }
+        checkSelf(index, 1500, labels[1500], "compact");
+
+        // 保存和加载后标签不变
+        index.removeIds(&labels[100], 1);
+        index.save("data/testIds.bin");
+        FlatIndex loaded(dim, nullptr, MetricType::METRIC_L2);
+        if (loaded.load("data/testIds.bin") != 0 || !loaded.hasIds() || loaded.getRow(labels[100]) != UINT64_MAX ||
+            loaded.getRow(labels[30]) != index.getRow(labels[30])) {
+            std::cout << "save/load lost ids" << std::endl;
+            isPassed = false;
+        }
+        checkSelf(loaded, 1999, labels[1999], "load");
+    }
+
+    if (isPassed) {
+        std::cout << "External id test passed!" << std::endl;
+    } else {
+        std::cout << "External id test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+// 过滤查询：三种选择器、两种执行方式（逐个计算 / 交给后端跳过）的结果都与只在选中向量中暴力查询一致
+bool testFlatIndexSelector() {
+    const uint64_t nData = 4000;
+    const uint64_t k = 10;
+    const uint64_t nQuery = 16;
+    bool isPassed = true;
+
+    struct Case {
+        uint64_t dim;
+        StorageType storageType;
+        MetricType metric;
+        bool useIds;
+    };
+    const Case cases[] = {
+        {67, StorageType::STORAGE_FP32, MetricType::METRIC_INNER_PRODUCT, false},
+        {67, StorageType::STORAGE_FP16, MetricType::METRIC_INNER_PRODUCT, true},
+        {4, StorageType::STORAGE_FP32, MetricType::METRIC_L2, false},
+        {4, StorageType::STORAGE_FP32, MetricType::METRIC_L2, true},
+    };
+
+    for (const Case& c : cases) {
+        const uint64_t dim = c.dim;
+        const bool isIP = c.metric == MetricType::METRIC_INNER_PRODUCT;
+        std::mt19937 rng(1152);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        std::vector<float> vecs(dim * nData);
+        for (auto& v : vecs) {
+            v = dist(rng);
+        }
+        std::vector<float> queries(dim * nQuery);
+        for (auto& v : queries) {
+            v = dist(rng);
+        }
+        // 使用外部编号时标签为 3 * 行号 + 1，bitset 和 range 在标签空间中选择
+        std::vector<uint64_t> labels(nData);
+        for (uint64_t i = 0; i < nData; ++i) {
+            labels[i] = c.useIds ? 3 * i + 1 : i;
+        }
+
+        FlatIndex index(dim, 1000, c.storageType, c.metric, nullptr);
+        if (c.useIds) {
+            index.addVectorWithIds(vecs.data(), labels.data(), nData);
+        } else {
+            index.addVector(vecs.data(), nData);
+        }
+        std::vector<uint64_t> removed = {labels[5], labels[7], labels[2000]};
+        index.removeIds(removed.data(), removed.size());
+        // 16位存储时参考值用存储后的向量计算
+        for (uint64_t i = 0; i < nData; ++i) {
+            index.reconstruct(i, vecs.data() + i * dim);
+        }
+
+        // 稀疏的选择走逐个计算，稠密的选择交给后端
+        for (uint64_t stride : {97, 2}) {
+            std::vector<uint64_t> list;
+            std::vector<uint64_t> bits((labels.back() + 64) / 64, 0);
+            for (uint64_t i = 0; i < nData; i += stride) {
+                list.push_back(labels[i]);
+                bits[labels[i] >> 6] |= 1ull << (labels[i] & 63);
+            }
+            list.push_back(labels[5]);      // 已删除的向量不会被选中
+            std::sort(list.begin(), list.end());
+            for (uint64_t i = 0; i < nData; i += 1) {
+                if (i % stride == 5 % stride) {
+                    bits[labels[i] >> 6] |= 1ull << (labels[i] & 63);
+                }
+            }
+            uint64_t rangeEnd = nData / stride;
+            const IDSelector selectors[] = {
+                IDSelector::sortedList(list.data(), list.size()),
+                IDSelector::bitset(bits.data(), labels.back() + 1),
+                IDSelector::range(labels[0], labels[rangeEnd]),
+            };
+            const char* names[] = {"sorted list", "bitset", "range"};
+
+            for (int s = 0; s < 3; ++s) {
+                std::vector<uint64_t> results(nQuery * k);
+                std::vector<float> distances(nQuery * k);
+                index.search(k, nQuery, queries.data(), results.data(), distances.data(), selectors[s]);
+
+                for (uint64_t q = 0; q < nQuery && isPassed; ++q) {
+                    // 暴力查询选中且未删除的向量
+                    std::vector<std::pair<float, uint64_t>> expected;
+                    for (uint64_t i = 0; i < nData; ++i) {
+                        if (!selectors[s].contains(labels[i]) || i == 5 || i == 7 || i == 2000) {
+                            continue;
+                        }
+                        float d = 0.0f;
+                        for (uint64_t j = 0; j < dim; ++j) {
+                            float x = queries[q * dim + j];
+                            float y = vecs[i * dim + j];
+                            d += isIP ? x * y : (x - y) * (x - y);
+                        }
+                        expected.emplace_back(isIP ? -d : d, labels[i]);
+                    }
+                    std::sort(expected.begin(), expected.end());
+                    for (uint64_t j = 0; j < k; ++j) {
+                        uint64_t id = results[q * k + j];
+                        bool valid = j < expected.size();
+                        float want = valid ? (isIP ? -expected[j].first : expected[j].first) : 0.0f;
+                        bool ok = valid ? (id != UINT64_MAX && selectors[s].contains(id) &&
+                                           std::abs(distances[q * k + j] - want) <= 1e-3f * (1.0f + std::abs(want)))
+                                        : id == UINT64_MAX;
+                        if (!ok) {
+                            std::cout << names[s] << " dim = " << dim << " stride = " << stride << " ids = " << c.useIds
+                                      << " mismatch at q = " << q << ", j = " << j << ": expected " << want
+                                      << ", got " << distances[q * k + j] << " (id " << id << ")" << std::endl;
+                            isPassed = false;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // 数据量很小、选择排除第0行时，空的后端范围和不足k个的位置不会变成第0行
+    for (uint64_t n = 2; n <= 3; ++n) {
+        const uint64_t dim = 16;
+        std::mt19937 rng(n);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        std::vector<float> vecs(dim * n);
+        for (auto& v : vecs) {
+            v = dist(rng);
+        }
+        FlatIndex small(dim, 1000, StorageType::STORAGE_FP32, MetricType::METRIC_L2, nullptr);
+        small.addVector(vecs.data(), n);
+        std::vector<uint64_t> results(k);
+        std::vector<float> distances(k);
+        small.search(k, 1, vecs.data(), results.data(), distances.data(), IDSelector::range(1, n));
+        for (uint64_t j = 0; j < k; ++j) {
+            bool ok = j + 1 < n ? results[j] >= 1 && results[j] < n && distances[j] > 0.0f
+                                : results[j] == UINT64_MAX;
+            if (!ok) {
+                std::cout << "small filtered index n = " << n << " returned " << results[j] << "(" << distances[j] << ")" << std::endl;
+                isPassed = false;
+            }
+        }
+    }
+
+    if (isPassed) {
+        std::cout << "Selector test passed!" << std::endl;
+    } else {
+        std::cout << "Selector test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+// 范围查询：结果与暴力计算一致（阈值附近的浮点误差除外），不包含已删除的向量
+bool testFlatIndexRangeSearch() {
+    const uint64_t dim = 67;
+    const uint64_t nData = 5000;
+    bool isPassed = true;
+
+    for (auto storageType : {StorageType::STORAGE_FP32, StorageType::STORAGE_FP16}) {
+        for (auto metric : {MetricType::METRIC_L2, MetricType::METRIC_INNER_PRODUCT}) {
+            const bool isIP = metric == MetricType::METRIC_INNER_PRODUCT;
+            // 均匀分布下 L2 距离集中在 dim * 2/3 附近，IP 集中在0附近，取靠近尾部的阈值
+            const float radius = isIP ? 4.0f : 36.0f;
+            std::mt19937 rng(1153);
+            std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+            std::vector<float> vecs(dim * nData);
+            for (auto& v : vecs) {
+                v = dist(rng);
+            }
+
+            FlatIndex index(dim, 1000, storageType, metric, nullptr);
+            index.addVector(vecs.data(), nData);
+            std::vector<uint64_t> removed;
+            for (uint64_t i = 0; i < nData; i += 10) {
+                removed.push_back(i);
+            }
+            index.removeIds(removed.data(), removed.size());
+            for (uint64_t i = 0; i < nData; ++i) {
+                index.reconstruct(i, vecs.data() + i * dim);
+            }
+
+            // 1个查询走扫描路径，64个查询走 sgemm_ 路径
+            for (uint64_t nQuery : {1, 64}) {
+                std::vector<float> queries(dim * nQuery);
+                for (auto& v : queries) {
+                    v = dist(rng);
+                }
+                RangeSearchResult result;
+                index.rangeSearch(nQuery, queries.data(), radius, result);
+                if (result.lims.size() != nQuery + 1 || result.lims[nQuery] != result.labels.size()) {
+                    std::cout << "range search lims malformed" << std::endl;
+                    isPassed = false;
+                    continue;
+                }
+
+                uint64_t totalHits = 0;
+                for (uint64_t q = 0; q < nQuery && isPassed; ++q) {
+                    std::vector<bool> found(nData, false);
+                    for (uint64_t r = result.lims[q]; r < result.lims[q + 1]; ++r) {
+                        found[result.labels[r]] = true;
+                    }
+                    for (uint64_t i = 0; i < nData; ++i) {
+                        float d = 0.0f;
+                        for (uint64_t j = 0; j < dim; ++j) {
+                            float x = queries[q * dim + j];
+                            float y = vecs[i * dim + j];
+                            d += isIP ? x * y : (x - y) * (x - y);
+                        }
+                        bool expected = i % 10 != 0 && (isIP ? d > radius : d < radius);
+                        bool borderline = std::abs(d - radius) < 1e-3f * (1.0f + radius);
+                        if (found[i] != expected && !borderline) {
+                            std::cout << "range search storage = " << storageType << " ip = " << isIP << " nQuery = " << nQuery
+                                      << " mismatch at q = " << q << ", row = " << i << ", distance = " << d << std::endl;
+                            isPassed = false;
+                            break;
+                        }
+                    }
+                    totalHits += result.lims[q + 1] - result.lims[q];
+                }
+                if (totalHits == 0 || totalHits == nQuery * nData) {
+                    std::cout << "range search radius does not split the data" << std::endl;
+                    isPassed = false;
+                }
+            }
+        }
+    }
+
+    if (isPassed) {
+        std::cout << "Range search test passed!" << std::endl;
+    } else {
+        std::cout << "Range search test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+// mmap 加载：结果与复制加载一致，追加时映射保持不变，压缩时复制到内存；旧格式的文件退回到复制加载
+bool testFlatIndexMmap() {
+    const uint64_t dim = 67;
+    const uint64_t nData = 3000;
+    const uint64_t nQuery = 16;
+    const uint64_t k = 10;
+    bool isPassed = true;
+
+    std::mt19937 rng(1146);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> vecs(dim * nData);
+    for (auto& v : vecs) {
+        v = dist(rng);
+    }
+    std::vector<float> queries(dim * nQuery);
+    for (auto& v : queries) {
+        v = dist(rng);
+    }
+
+    auto sameResults = [&](FlatIndex& a, FlatIndex& b, const char* stage) {
+        std::vector<uint64_t> resultsA(nQuery * k), resultsB(nQuery * k);
+        std::vector<float> distancesA(nQuery * k), distancesB(nQuery * k);
+        a.query(k, 0, a.getNum(), DeviceType::CPU_BLAS, nQuery, queries.data(), resultsA.data(), distancesA.data());
+        b.query(k, 0, b.getNum(), DeviceType::CPU_BLAS, nQuery, queries.data(), resultsB.data(), distancesB.data());
+        if (resultsA != resultsB || distancesA != distancesB) {
+            std::cout << stage << ": mmap results differ" << std::endl;
+            isPassed = false;
+        }
+    };
+
+    for (auto storageType : {StorageType::STORAGE_FP32, StorageType::STORAGE_FP16}) {
+        FlatIndex index(dim, 1000, storageType, MetricType::METRIC_L2, nullptr);
+        index.addVector(vecs.data(), nData);
+        uint64_t toRemove[] = {1, 2, 3};
+        index.removeIds(toRemove, 3);
+        index.save("data/testMmap.bin");
+
+        FlatIndex mapped(dim, nullptr, MetricType::METRIC_L2);
+        if (mapped.loadMmap("data/testMmap.bin", storageType == StorageType::STORAGE_FP16, MappedFile::Advice::SEQUENTIAL) != 0 ||
+            !mapped.isMapped() || mapped.getNum() != nData || mapped.getNumRemoved() != 3) {
+            std::cout << "loadMmap failed" << std::endl;
+            isPassed = false;
+            continue;
+        }
+        sameResults(index, mapped, "mapped");
+        std::vector<float> vec(dim), expected(dim);
+        mapped.reconstruct(77, vec.data());
+        index.reconstruct(77, expected.data());
+        if (vec != expected) {
+            std::cout << "mapped reconstruct differs" << std::endl;
+            isPassed = false;
+        }
+
+        // 映射期间覆盖同一个文件，之后再次映射得到新的内容
+        FlatIndex other(dim, 1000, storageType, MetricType::METRIC_L2, nullptr);
+        other.addVector(vecs.data(), 10);
+        other.save("data/testMmap.bin");
+        sameResults(index, mapped, "overwritten");
+        FlatIndex remapped(dim, nullptr, MetricType::METRIC_L2);
+        remapped.loadMmap("data/testMmap.bin");
+        if (remapped.getNum() != 10) {
+            std::cout << "remapped file has the wrong size" << std::endl;
+            isPassed = false;
+        }
+
+        // 追加只为新的向量分配块，映射保持不变；压缩前才复制到内存
+        mapped.addVector(vecs.data(), 5);
+        index.addVector(vecs.data(), 5);
+        if (!mapped.isMapped() || mapped.getNum() != nData + 5) {
+            std::cout << "addVector copied the mapped data" << std::endl;
+            isPassed = false;
+        }
+        sameResults(index, mapped, "appended");
+        mapped.compact();
+        index.compact();
+        if (mapped.isMapped()) {
+            std::cout << "compact did not unmap" << std::endl;
+            isPassed = false;
+        }
+        sameResults(index, mapped, "unmapped");
+    }
+
+    // 手动写一个旧格式（魔数 1145，不对齐，范数按 num * dim 保存）的文件
+    {
+        FlatIndex index(dim, 1000, StorageType::STORAGE_FP32, MetricType::METRIC_INNER_PRODUCT, nullptr);
+        index.addVector(vecs.data(), nData);
+        std::ofstream ofs("data/testLegacy.bin", std::ios::binary);
+        uint64_t header[3] = {1145, dim, nData};
+        uint8_t storageType = 0;
+        MetricType metric = MetricType::METRIC_INNER_PRODUCT;
+        ofs.write(reinterpret_cast<const char*>(header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(&storageType), 1);
+        ofs.write(reinterpret_cast<const char*>(&metric), sizeof(MetricType));
+        ofs.write(reinterpret_cast<const char*>(vecs.data()), vecs.size() * sizeof(float));
+        std::vector<float> norms(nData * dim, 0.0f);
+        ofs.write(reinterpret_cast<const char*>(norms.data()), norms.size() * sizeof(float));
+        ofs.close();
+
+        FlatIndex legacy(dim, nullptr, MetricType::METRIC_L2);
+        if (legacy.loadMmap("data/testLegacy.bin") != 0 || legacy.isMapped() || legacy.getNum() != nData) {
+            std::cout << "legacy fallback failed" << std::endl;
+            isPassed = false;
+        }
+        sameResults(index, legacy, "legacy");
+    }
+
+    if (isPassed) {
+        std::cout << "Mmap load test passed!" << std::endl;
+    } else {
+        std::cout << "Mmap load test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+bool testFlatIndexFileFormat() {
+    const uint64_t dim = 67;
+    const uint64_t nData = 2000;
+    const uint64_t nQuery = 8;
+    const uint64_t k = 10;
+    bool isPassed = true;
+
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> vecs(dim * nData);
+    for (auto& v : vecs) {
+        v = dist(rng);
+    }
+    std::vector<float> queries(dim * nQuery);
+    for (auto& v : queries) {
+        v = dist(rng);
+    }
+    std::vector<uint64_t> ids(nData);
+    for (uint64_t i = 0; i < nData; ++i) {
+        ids[i] = 1000000 + 7 * i;
+    }
+
+    auto sameResults = [&](FlatIndex& a, FlatIndex& b, const char* stage) {
+        std::vector<uint64_t> resultsA(nQuery * k), resultsB(nQuery * k);
+        std::vector<float> distancesA(nQuery * k), distancesB(nQuery * k);
+        a.search(k, nQuery, queries.data(), resultsA.data(), distancesA.data());
+        b.search(k, nQuery, queries.data(), resultsB.data(), distancesB.data());
+        if (resultsA != resultsB || distancesA != distancesB) {
+            std::cout << stage << ": results differ" << std::endl;
+            isPassed = false;
+        }
+    };
+    auto readFile = [](const std::string& filename) {
+        std::ifstream ifs(filename, std::ios::binary);
+        return std::vector<char>((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    };
+    auto writeFile = [](const std::string& filename, const std::vector<char>& bytes) {
+        std::ofstream ofs(filename, std::ios::binary);
+        ofs.write(bytes.data(), bytes.size());
+    };
+
+    for (auto storageType : {StorageType::STORAGE_FP32, StorageType::STORAGE_BF16}) {
+        FlatIndex index(dim, 1000, storageType, MetricType::METRIC_INNER_PRODUCT, nullptr);
+        index.addVectorWithIds(vecs.data(), ids.data(), nData);
+        uint64_t toRemove[] = {ids[5], ids[6]};
+        index.removeIds(toRemove, 2);
+        index.save("data/testFormat.bin");
+
+        // 文件头和各段的位置
+        IndexFileReader reader;
+        if (reader.open("data/testFormat.bin") != 0 || reader.getVersion() != 2 || reader.getIndexType() != 1145) {
+            std::cout << "v2 header mismatch" << std::endl;
+            isPassed = false;
+            continue;
+        }
+        for (uint32_t id : {SECTION_META, SECTION_VECTORS, SECTION_NORMS, SECTION_TOMBSTONES, SECTION_IDS}) {
+            if (!reader.hasSection(id) || reader.sectionOffset(id) % 4096 != 0) {
+                std::cout << "section " << id << " missing or unaligned" << std::endl;
+                isPassed = false;
+            }
+        }
+
+        FlatIndex loaded(dim, nullptr, MetricType::METRIC_L2);
+        if (loaded.load("data/testFormat.bin") != 0 || loaded.getNum() != nData || loaded.getNumRemoved() != 2 ||
+            !loaded.hasIds() || loaded.getRow(ids[9]) != 9 || loaded.getRow(ids[5]) != UINT64_MAX) {
+            std::cout << "v2 load failed" << std::endl;
+            isPassed = false;
+        }
+        sameResults(index, loaded, "loaded");
+
+        // 不认识的段被忽略
+        {
+            const char payload[] = "written by a newer version";
+            IndexFileWriter writer(reader.getIndexType());
+            for (uint32_t id : reader.getSectionIds()) {
+                uint64_t size = 0;
+                const char* data = reader.section(id, &size);
+                writer.addSection(id, data, size);
+            }
+            writer.addSection(99, payload, sizeof(payload));
+            writer.write("data/testFormatExtra.bin");
+            FlatIndex extra(dim, nullptr, MetricType::METRIC_L2);
+            if (extra.load("data/testFormatExtra.bin") != 0) {
+                std::cout << "unknown section was not ignored" << std::endl;
+                isPassed = false;
+            }
+            sameResults(index, extra, "extra section");
+        }
+
+        // 向量段中改动一个字节：load 和校验的 loadMmap 返回-3，不校验的 loadMmap 仍然可以映射
+        std::vector<char> bytes = readFile("data/testFormat.bin");
+        const uint64_t vecOffset = reader.sectionOffset(SECTION_VECTORS);
+        bytes[vecOffset + 1234] ^= 0x10;
+        writeFile("data/testCorrupt.bin", bytes);
+        FlatIndex corrupt(dim, nullptr, MetricType::METRIC_L2);
+        if (corrupt.load("data/testCorrupt.bin") != -3 ||
+            corrupt.loadMmap("data/testCorrupt.bin", false, MappedFile::Advice::NORMAL, true) != -3 ||
+            corrupt.loadMmap("data/testCorrupt.bin") != 0) {
+            std::cout << "corrupted section not detected" << std::endl;
+            isPassed = false;
+        }
+        bytes[vecOffset + 1234] ^= 0x10;
+
+        // 段表损坏和文件被截断
+        bytes[64 + 8] ^= 0x01;
+        writeFile("data/testCorrupt.bin", bytes);
+        if (corrupt.loadMmap("data/testCorrupt.bin") != -3) {
+            std::cout << "corrupted section table not detected" << std::endl;
+            isPassed = false;
+        }
+        bytes[64 + 8] ^= 0x01;
+        bytes.resize(bytes.size() - 100);
+        writeFile("data/testCorrupt.bin", bytes);
+        if (corrupt.load("data/testCorrupt.bin") != -3) {
+            std::cout << "truncated file not detected" << std::endl;
+            isPassed = false;
+        }
+
+        FlatIndex mapped(dim, nullptr, MetricType::METRIC_L2);
+        if (mapped.loadMmap("data/testFormat.bin", false, MappedFile::Advice::RANDOM, true) != 0 || !mapped.isMapped()) {
+            std::cout << "verified loadMmap failed" << std::endl;
+            isPassed = false;
+        }
+        sameResults(index, mapped, "mapped");
+    }
+
+    if (isPassed) {
+        std::cout << "File format test passed!" << std::endl;
+    } else {
+        std::cout << "File format test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+bool testFlatIndexWal() {
+    const uint64_t dim = 24;
+    const uint64_t nData = 3000;
+    const uint64_t nQuery = 8;
+    const uint64_t k = 10;
+    bool isPassed = true;
+
+    std::mt19937 rng(1023);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> vecs(dim * nData);
+    for (auto& v : vecs) {
+        v = dist(rng);
+    }
+    std::vector<float> queries(dim * nQuery);
+    for (auto& v : queries) {
+        v = dist(rng);
+    }
+    std::vector<uint64_t> ids(nData);
+    for (uint64_t i = 0; i < nData; ++i) {
+        ids[i] = 5000 + 3 * i;
+    }
+
+    auto sameResults = [&](FlatIndex& a, FlatIndex& b, const char* stage) {
+        std::vector<uint64_t> resultsA(nQuery * k), resultsB(nQuery * k);
+        std::vector<float> distancesA(nQuery * k), distancesB(nQuery * k);
+        a.search(k, nQuery, queries.data(), resultsA.data(), distancesA.data());
+        b.search(k, nQuery, queries.data(), resultsB.data(), distancesB.data());
+        if (a.getNum() != b.getNum() || a.getNumRemoved() != b.getNumRemoved() ||
+            resultsA != resultsB || distancesA != distancesB) {
+            std::cout << stage << ": replayed index differs" << std::endl;
+            isPassed = false;
+        }
+    };
+    auto readFile = [](const std::string& filename) {
+        std::ifstream ifs(filename, std::ios::binary);
+        return std::vector<char>((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    };
+    const std::string filename = "data/testWal.bin";
+    const std::string walFilename = filename + ".wal";
+
+    for (auto storageType : {StorageType::STORAGE_FP32, StorageType::STORAGE_FP16}) {
+        FlatIndex index(dim, 1000, storageType, MetricType::METRIC_INNER_PRODUCT, nullptr);
+        index.addVectorWithIds(vecs.data(), ids.data(), 2000);
+        if (index.enableWal(filename) != 0 || !index.isWalEnabled()) {
+            std::cout << "enableWal failed" << std::endl;
+            isPassed = false;
+            continue;
+        }
+        std::vector<char> snapshot = readFile(filename);
+
+        // 新增、按标签删除、更新已有标签、压缩，save 只提交日志
+        index.addVectorWithIds(vecs.data() + 2000 * dim, ids.data() + 2000, 200);
+        std::vector<uint64_t> toRemove(ids.begin() + 100, ids.begin() + 150);
+        index.removeIds(toRemove.data(), toRemove.size());
+        index.addVectorWithIds(vecs.data() + 2200 * dim, ids.data() + 10, 5);
+        index.compact();
+        index.addVectorWithIds(vecs.data() + 2205 * dim, ids.data() + 2205, 100);
+        if (index.save(filename) != 0 || readFile(filename) != snapshot) {
+            std::cout << "save rewrote the snapshot in WAL mode" << std::endl;
+            isPassed = false;
+        }
+
+        FlatIndex replayed(dim, nullptr, MetricType::METRIC_L2);
+        if (replayed.load(filename) != 0) {
+            std::cout << "load with WAL failed" << std::endl;
+            isPassed = false;
+        }
+        sameResults(index, replayed, "load");
+
+        // 崩溃时写了一半的记录被忽略
+        {
+            std::ofstream ofs(walFilename, std::ios::binary | std::ios::app);
+            std::vector<char> torn(100, 0x5a);
+            ofs.write(torn.data(), torn.size());
+        }
+        FlatIndex mapped(dim, nullptr, MetricType::METRIC_L2);
+        if (mapped.loadMmap(filename) != 0) {
+            std::cout << "loadMmap with torn WAL failed" << std::endl;
+            isPassed = false;
+        }
+        sameResults(index, mapped, "torn tail");
+
+        // 刚加载的索引沿用已有的快照和日志，截掉不完整的记录后继续追加
+        if (mapped.enableWal(filename) != 0 || readFile(filename) != snapshot) {
+            std::cout << "enableWal after load rewrote the snapshot" << std::endl;
+            isPassed = false;
+        }
+        uint64_t more[] = {ids[2600], ids[2601]};
+        mapped.addVectorWithIds(vecs.data() + 2600 * dim, more, 2);
+        index.addVectorWithIds(vecs.data() + 2600 * dim, more, 2);
+        mapped.removeIds(ids.data() + 700, 1);
+        index.removeIds(ids.data() + 700, 1);
+        mapped.save(filename);
+        FlatIndex resumed(dim, nullptr, MetricType::METRIC_L2);
+        resumed.load(filename);
+        sameResults(index, resumed, "resumed");
+
+        // 日志超过阈值时 save 重写快照并清空日志
+        mapped.walCheckpointRatio = 0.0f;
+        mapped.removeIds(ids.data() + 701, 1);
+        index.removeIds(ids.data() + 701, 1);
+        if (mapped.save(filename) != 0 || readFile(filename) == snapshot || readFile(walFilename).size() != 32) {
+            std::cout << "checkpoint failed" << std::endl;
+            isPassed = false;
+        }
+        mapped.disableWal();
+        FlatIndex checkpointed(dim, nullptr, MetricType::METRIC_L2);
+        checkpointed.load(filename);
+        sameResults(index, checkpointed, "checkpoint");
+        index.disableWal();
+    }
+
+    // 不使用外部编号：删除和压缩按行号重放
+    {
+        FlatIndex index(dim, 1000, StorageType::STORAGE_FP32, MetricType::METRIC_L2, nullptr);
+        index.enableWal(filename);
+        index.addVector(vecs.data(), 2000);
+        std::vector<uint64_t> rows = {3, 5, 7, 1999};
+        index.removeIds(rows.data(), rows.size());
+        index.compact();
+        index.removeIds(rows.data(), 2);
+        index.addVector(vecs.data() + 2000 * dim, 100);
+        index.save(filename);
+        FlatIndex replayed(dim, nullptr, MetricType::METRIC_L2);
+        replayed.load(filename);
+        sameResults(index, replayed, "rows");
+        index.disableWal();
+    }
+
+    // 不使用 WAL 保存到同一个文件时删除旧的日志，不会重放到无关的快照上
+    {
+        FlatIndex index(dim, 1000, StorageType::STORAGE_FP32, MetricType::METRIC_L2, nullptr);
+        index.walCheckpointRatio = 100.0f;     // 保留日志中的记录，不重写快照
+        index.enableWal(filename);
+        index.addVectorWithIds(vecs.data(), ids.data(), 10);
+        index.save(filename);
+        std::vector<char> log = readFile(walFilename);
+        index.disableWal();
+
+        FlatIndex other(dim, 1000, StorageType::STORAGE_FP32, MetricType::METRIC_L2, nullptr);
+        other.addVector(vecs.data() + 100 * dim, 3);
+        FlatIndex reloaded(dim, nullptr, MetricType::METRIC_L2);
+        if (other.save(filename) != 0 || std::ifstream(walFilename).good() ||
+            reloaded.load(filename) != 0 || reloaded.getNum() != 3) {
+            std::cout << "plain save kept the old WAL" << std::endl;
+            isPassed = false;
+        }
+
+        // 与快照不匹配的日志（向没有外部编号的索引添加带编号的向量）返回错误而不是抛出异常
+        std::ofstream(walFilename, std::ios::binary).write(log.data(), log.size());
+        FlatIndex mismatched(dim, nullptr, MetricType::METRIC_L2);
+        int ret = 0;
+        try {
+            ret = mismatched.load(filename);
+        } catch (const std::exception& e) {
+            std::cout << "mismatched WAL threw: " << e.what() << std::endl;
+        }
+        if (ret != -3) {
+            std::cout << "mismatched WAL was not rejected" << std::endl;
+            isPassed = false;
+        }
+        std::remove(walFilename.c_str());
+    }
+
+    if (isPassed) {
+        std::cout << "WAL test passed!" << std::endl;
+    } else {
+        std::cout << "WAL test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+// 范数每个向量只存一个，分批追加（跨越扩容和并行计算的阈值）后，search 分给各个后端的每一段都要用对应行的范数
+bool testFlatIndexNorms() {
+    const uint64_t dim = 67;
+    const uint64_t batches[] = {1, 999, 2000, 3};
+    const uint64_t k = 10;
+    const uint64_t nQuery = 64;
+    const cpu_blas::DistanceKernels& kernels = cpu_blas::getKernels();
+    bool isPassed = true;
+
+    for (StorageType storageType : {StorageType::STORAGE_FP32, StorageType::STORAGE_FP16}) {
+        std::mt19937 rng(1153);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        FlatIndex index(dim, 16, storageType, MetricType::METRIC_L2, nullptr);
+        for (uint64_t n : batches) {
+            std::vector<float> vecs(dim * n);
+            for (auto& v : vecs) {
+                v = dist(rng);
+            }
+            index.addVector(vecs.data(), n);
+        }
+        const uint64_t nData = index.getNum();
+
+        // 暴力计算的对照结果，数据取重建后的向量，与16位存储时检索读到的值一致
+        std::vector<float> rows(dim * nData);
+        for (uint64_t i = 0; i < nData; ++i) {
+            index.reconstruct(i, rows.data() + i * dim);
+        }
+        std::vector<float> queries(dim * nQuery);
+        for (auto& v : queries) {
+            v = dist(rng);
+        }
+        std::vector<uint64_t> results(k * nQuery);
+        std::vector<float> distances(k * nQuery);
+        index.search(k, nQuery, queries.data(), results.data(), distances.data());
+
+        for (uint64_t q = 0; q < nQuery && isPassed; ++q) {
+            std::vector<float> expected(nData);
+            for (uint64_t i = 0; i < nData; ++i) {
+                expected[i] = kernels.L2sqr(queries.data() + q * dim, rows.data() + i * dim, dim);
+            }
+            std::sort(expected.begin(), expected.end());
+            for (uint64_t j = 0; j < k; ++j) {
+                float got = distances[q * k + j];
+                float exact = kernels.L2sqr(queries.data() + q * dim, rows.data() + results[q * k + j] * dim, dim);
+                if (std::abs(got - expected[j]) > 1e-3f * (1.0f + expected[j]) ||
+                    std::abs(got - exact) > 1e-3f * (1.0f + exact)) {
+                    std::cout << "norm mismatch: query = " << q << ", j = " << j << ", expected = " << expected[j]
+                              << ", got = " << got << std::endl;
+                    isPassed = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (isPassed) {
+        std::cout << "Norms test passed!" << std::endl;
+    } else {
+        std::cout << "Norms test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+// 分块存储：块很小时数据跨越多个块，各条路径的结果与整块存储一致，保存的文件也完全相同
+bool testFlatIndexChunks() {
+    const uint64_t nData = 3000;
+    const uint64_t batches[] = {1, 999, 2000};
+    const uint64_t nQuery = 16;
+    const uint64_t k = 10;
+    bool isPassed = true;
+
+    struct Case {
+        uint64_t dim;
+        StorageType storageType;
+        MetricType metric;
+    };
+    const Case cases[] = {
+        {67, StorageType::STORAGE_FP32, MetricType::METRIC_L2},
+        {67, StorageType::STORAGE_FP16, MetricType::METRIC_INNER_PRODUCT},
+        {2, StorageType::STORAGE_FP32, MetricType::METRIC_L2},     // KD树
+    };
+
+    for (const Case& c : cases) {
+        const uint64_t dim = c.dim;
+        std::mt19937 rng(1155);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        std::vector<float> vecs(dim * nData);
+        for (auto& v : vecs) {
+            v = dist(rng);
+        }
+        std::vector<float> queries(dim * nQuery);
+        for (auto& v : queries) {
+            v = dist(rng);
+        }
+
+        FlatIndex whole(dim, 0, c.storageType, c.metric, nullptr);
+        FlatIndex chunked(dim, 0, c.storageType, c.metric, nullptr);
+        chunked.chunkBytes = 16 * 1024;     // 每块几十到几千行
+        uint64_t added = 0;
+        for (uint64_t n : batches) {
+            whole.addVector(vecs.data() + added * dim, n);
+            chunked.addVector(vecs.data() + added * dim, n);
+            added += n;
+        }
+        uint64_t toRemove[] = {0, 5, 700, 1500, 2999};
+        whole.removeIds(toRemove, 5);
+        chunked.removeIds(toRemove, 5);
+        // 最多只有最后一个块没有用满
+        if (chunked.getCapacity() < nData || chunked.getCapacity() - nData >= 16 * 1024 / sizeof(uint16_t)) {
+            std::cout << "chunk capacity is wrong: " << chunked.getCapacity() << std::endl;
+            isPassed = false;
+        }
+
+        auto sameResults = [&](FlatIndex& a, FlatIndex& b, const char* stage) {
+            std::vector<uint64_t> resultsA(nQuery * k), resultsB(nQuery * k);
+            std::vector<float> distancesA(nQuery * k), distancesB(nQuery * k);
+            auto check = [&](const char* path) {
+                for (uint64_t i = 0; i < nQuery * k; ++i) {
+                    if (resultsA[i] != resultsB[i] || std::abs(distancesA[i] - distancesB[i]) > 1e-4f * (1.0f + std::abs(distancesA[i]))) {
+                        std::cout << stage << " dim = " << dim << " " << path << " mismatch at " << i << ": " << resultsA[i]
+                                  << " / " << distancesA[i] << " vs " << resultsB[i] << " / " << distancesB[i] << std::endl;
+                        isPassed = false;
+                        return;
+                    }
+                }
+            };
+            a.query(k, 0, a.getNum(), DeviceType::CPU_BLAS, nQuery, queries.data(), resultsA.data(), distancesA.data());
+            b.query(k, 0, b.getNum(), DeviceType::CPU_BLAS, nQuery, queries.data(), resultsB.data(), distancesB.data());
+            check("query");
+            // 从块中间开始的区间
+            a.query(k, 123, a.getNum() - 7, DeviceType::CPU_BLAS, nQuery, queries.data(), resultsA.data(), distancesA.data());
+            b.query(k, 123, b.getNum() - 7, DeviceType::CPU_BLAS, nQuery, queries.data(), resultsB.data(), distancesB.data());
+            check("sub-range query");
+            a.search(k, nQuery, queries.data(), resultsA.data(), distancesA.data());
+            b.search(k, nQuery, queries.data(), resultsB.data(), distancesB.data());
+            check("search");
+            IDSelector selector = IDSelector::range(100, 2900);
+            a.search(k, nQuery, queries.data(), resultsA.data(), distancesA.data(), selector);
+            b.search(k, nQuery, queries.data(), resultsB.data(), distancesB.data(), selector);
+            check("filtered search");
+
+            RangeSearchResult rangeA, rangeB;
+            float radius = c.metric == MetricType::METRIC_L2 ? (dim == 2 ? 0.01f : 35.0f) : 2.0f;
+            a.rangeSearch(nQuery, queries.data(), radius, rangeA);
+            b.rangeSearch(nQuery, queries.data(), radius, rangeB);
+            if (rangeA.lims != rangeB.lims || rangeA.labels != rangeB.labels || rangeA.lims.back() == 0) {
+                std::cout << stage << " dim = " << dim << " range search mismatch" << std::endl;
+                isPassed = false;
+            }
+            std::vector<float> vecA(dim), vecB(dim);
+            a.reconstruct(2345, vecA.data());
+            b.reconstruct(2345, vecB.data());
+            if (vecA != vecB) {
+                std::cout << stage << " dim = " << dim << " reconstruct mismatch" << std::endl;
+                isPassed = false;
+            }
+        };
+        sameResults(whole, chunked, "chunked");
+
+        // 按块写入的文件与整块写入的完全相同
+        whole.save("data/testChunksWhole.bin");
+        chunked.save("data/testChunks.bin");
+        std::ifstream fa("data/testChunksWhole.bin", std::ios::binary), fb("data/testChunks.bin", std::ios::binary);
+        std::vector<char> bytesA((std::istreambuf_iterator<char>(fa)), std::istreambuf_iterator<char>());
+        std::vector<char> bytesB((std::istreambuf_iterator<char>(fb)), std::istreambuf_iterator<char>());
+        if (bytesA != bytesB) {
+            std::cout << "chunked save differs" << std::endl;
+            isPassed = false;
+        }
+
+        // 按小块加载、mmap 加载后追加（新的向量放在映射之后的块中）
+        FlatIndex loaded(dim, nullptr, c.metric);
+        loaded.chunkBytes = 16 * 1024;
+        if (loaded.load("data/testChunks.bin") != 0) {
+            std::cout << "chunked load failed" << std::endl;
+            isPassed = false;
+        }
+        sameResults(whole, loaded, "loaded");
+        FlatIndex mapped(dim, nullptr, c.metric);
+        mapped.chunkBytes = 16 * 1024;
+        mapped.loadMmap("data/testChunks.bin");
+        mapped.addVector(vecs.data(), 3);
+        whole.addVector(vecs.data(), 3);
+        if (!mapped.isMapped()) {
+            std::cout << "chunked addVector copied the mapped data" << std::endl;
+            isPassed = false;
+        }
+        sameResults(whole, mapped, "appended");
+
+        // 压缩跨越块边界移动行，之后释放空闲的块
+        std::vector<uint64_t> many;
+        for (uint64_t i = 0; i < nData; i += 2) {
+            many.push_back(i);
+        }
+        whole.removeIds(many.data(), many.size());
+        mapped.removeIds(many.data(), many.size());
+        whole.compact();
+        mapped.compact();
+        if (mapped.getCapacity() >= nData) {
+            std::cout << "compact did not release chunks" << std::endl;
+            isPassed = false;
+        }
+        sameResults(whole, mapped, "compacted");
+    }
+
+    if (isPassed) {
+        std::cout << "Chunked storage test passed!" << std::endl;
+    } else {
+        std::cout << "Chunked storage test failed!" << std::endl;
+    }
+    return isPassed;
 }
 
 int main () {
+    bool isPassed = true;
 
     testFlatIndexCpuL2();
     std::cout << "-------------------------" << std::endl;
     testFlatIndexCpuIP();
     std::cout << "-------------------------" << std::endl;
-    FlatIndexCpuRenorm();
+    isPassed = FlatIndexCpuRenorm() && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testFlatIndexStorage16(StorageType::STORAGE_FP16, "Float16", 1e-3) && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testFlatIndexStorage16(StorageType::STORAGE_BF16, "BFloat16", 8e-3) && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testFlatIndexRemove() && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testFlatIndexIds() && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testFlatIndexSelector() && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testFlatIndexRangeSearch() && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testFlatIndexMmap() && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testFlatIndexFileFormat() && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testFlatIndexWal() && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testFlatIndexNorms() && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testFlatIndexChunks() && isPassed;
 
-    return 0;
+    return isPassed ? 0 : 1;
 }
\ No newline at end of file
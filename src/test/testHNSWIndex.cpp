@@ -0,0 +1,113 @@
+#include "src/index/HNSWIndex.hpp"
+#include "src/index/FlatIndex.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+bool testHNSWIndex(MetricType metric, const char* name) {
+    const uint64_t dim = 32;
+    const uint64_t nData = 20000;
+    const uint64_t nQuery = 100;
+    const uint64_t k = 10;
+
+    std::mt19937 rng(1145);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<float> vecs(nData * dim), queries(nQuery * dim);
+    for (auto& v : vecs) {
+        v = dist(rng);
+    }
+    for (auto& v : queries) {
+        v = dist(rng);
+    }
+
+    HNSWIndex index(dim, 16, 100, metric);
+    auto t0 = std::chrono::high_resolution_clock::now();
+    // 分两次添加，第二次插入时图已经存在
+    index.addVector(vecs.data(), nData / 2);
+    index.addVector(vecs.data() + nData / 2 * dim, nData - nData / 2);
+    auto t1 = std::chrono::high_resolution_clock::now();
+    std::cout << name << " build time: " << std::chrono::duration<double, std::milli>(t1 - t0).count()
+              << " ms, maxLevel = " << index.getMaxLevel() << std::endl;
+
+    FlatIndex exact(dim, 1000, false, metric, nullptr);
+    exact.addVector(vecs.data(), nData);
+    std::vector<uint64_t> gt(k * nQuery);
+    std::vector<float> gtDistances(k * nQuery);
+    exact.query(k, 0, nData, DeviceType::CPU_BLAS, nQuery, queries.data(), gt.data(), gtDistances.data());
+
+    bool isPassed = true;
+
+    index.setEfSearch(64);
+    std::vector<uint64_t> results(k * nQuery);
+    std::vector<float> distances(k * nQuery);
+    // 逐条查询，统计单次查询的延迟
+    t0 = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0; i < nQuery; ++i) {
+        index.search(k, 1, queries.data() + i * dim, results.data() + i * k, distances.data() + i * k);
+    }
+    t1 = std::chrono::high_resolution_clock::now();
+    std::cout << name << " average latency: "
+              << std::chrono::duration<double, std::micro>(t1 - t0).count() / nQuery << " us" << std::endl;
+
+    uint64_t hit = 0;
+    for (uint64_t i = 0; i < nQuery; ++i) {
+        for (uint64_t j = 0; j < k; ++j) {
+            if (std::find(results.begin() + i * k, results.begin() + (i + 1) * k, gt[i * k + j]) != results.begin() + (i + 1) * k) {
+                ++hit;
+            }
+        }
+        // 返回的距离是精确距离
+        if (results[i * k] == gt[i * k] &&
+            std::abs(distances[i * k] - gtDistances[i * k]) > 1e-3 * (1.0f + std::abs(gtDistances[i * k]))) {
+            std::cout << name << " distance mismatch: expected = " << gtDistances[i * k]
+                      << ", got = " << distances[i * k] << std::endl;
+            isPassed = false;
+        }
+    }
+    float recall = (float)hit / (nQuery * k);
+    std::cout << name << " efSearch = 64, recall@" << k << " = " << recall << std::endl;
+    if (recall < 0.9f) {
+        isPassed = false;
+    }
+
+    // 批量查询与逐条查询结果一致
+    std::vector<uint64_t> batchResults(k * nQuery);
+    std::vector<float> batchDistances(k * nQuery);
+    index.search(k, nQuery, queries.data(), batchResults.data(), batchDistances.data());
+    if (batchResults != results) {
+        std::cout << name << " batch search differs from single-query search" << std::endl;
+        isPassed = false;
+    }
+
+    // 保存后重新加载，检索结果不变
+    index.save("data/testHNSWIndex.bin");
+    HNSWIndex loaded(dim);
+    if (loaded.load("data/testHNSWIndex.bin") != 0) {
+        isPassed = false;
+    }
+    index.search(k, nQuery, queries.data(), batchResults.data(), batchDistances.data());
+    loaded.search(k, nQuery, queries.data(), results.data(), distances.data());
+    if (loaded.getNum() != nData || batchResults != results) {
+        std::cout << name << " save/load failed" << std::endl;
+        isPassed = false;
+    }
+
+    if (isPassed) {
+        std::cout << name << " HNSWIndex test passed!" << std::endl;
+    } else {
+        std::cout << name << " HNSWIndex test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+int main() {
+    bool isPassed = true;
+    isPassed = testHNSWIndex(MetricType::METRIC_L2, "L2") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testHNSWIndex(MetricType::METRIC_INNER_PRODUCT, "IP") && isPassed;
+    return isPassed ? 0 : 1;
+}
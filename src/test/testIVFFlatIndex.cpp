@@ -0,0 +1,129 @@
+#include "src/index/IVFFlatIndex.hpp"
+#include "src/index/FlatIndex.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+// 生成带聚类结构的数据：先随机生成若干中心，每个向量为某个中心加噪声
+static std::vector<float> makeClusteredData(uint64_t n, uint64_t dim, std::mt19937& rng) {
+    const uint64_t nCluster = 100;
+    std::mt19937 centerRng(2024);   // 数据库和查询使用同一组中心
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<float> centers(nCluster * dim);
+    for (auto& v : centers) {
+        v = 3.0f * dist(centerRng);
+    }
+    std::uniform_int_distribution<uint64_t> pick(0, nCluster - 1);
+    std::vector<float> data(n * dim);
+    for (uint64_t i = 0; i < n; ++i) {
+        const uint64_t c = pick(rng);
+        for (uint64_t j = 0; j < dim; ++j) {
+            data[i * dim + j] = centers[c * dim + j] + dist(rng);
+        }
+    }
+    return data;
+}
+
+bool testIVFFlatIndex(MetricType metric, const char* name) {
+    const uint64_t dim = 32;
+    const uint64_t nlist = 64;
+    const uint64_t nData = 20000;
+    const uint64_t nQuery = 50;
+    const uint64_t k = 10;
+
+    std::mt19937 rng(1145);
+    std::vector<float> vecs = makeClusteredData(nData, dim, rng);
+    std::vector<float> queries = makeClusteredData(nQuery, dim, rng);
+
+    IVFFlatIndex index(dim, nlist, metric);
+    index.train(vecs.data(), nData);
+    index.addVector(vecs.data(), nData);
+
+    FlatIndex exact(dim, 1000, false, metric, nullptr);
+    exact.addVector(vecs.data(), nData);
+
+    bool isPassed = true;
+
+    uint64_t total = 0;
+    for (uint64_t l = 0; l < nlist; ++l) {
+        total += index.getListSize(l);
+    }
+    if (total != nData) {
+        std::cout << name << " list sizes do not sum to " << nData << std::endl;
+        isPassed = false;
+    }
+
+    for (uint64_t batch : {(uint64_t)1, nQuery}) {
+        std::vector<uint64_t> results(k * batch), gt(k * batch);
+        std::vector<float> distances(k * batch), gtDistances(k * batch);
+        exact.query(k, 0, nData, DeviceType::CPU_BLAS, batch, queries.data(), gt.data(), gtDistances.data());
+
+        // 扫描全部倒排表时结果与暴力检索一致
+        index.setNprobe(nlist);
+        index.search(k, batch, queries.data(), results.data(), distances.data());
+        for (uint64_t i = 0; i < batch * k; ++i) {
+            if (std::abs(distances[i] - gtDistances[i]) > 1e-3 * (1.0f + std::abs(gtDistances[i]))) {
+                std::cout << name << " nprobe = nlist distance mismatch at " << i << ": expected = "
+                          << gtDistances[i] << ", got = " << distances[i] << std::endl;
+                isPassed = false;
+                break;
+            }
+        }
+
+        // 只扫描少量倒排表，召回率仍然较高
+        index.setNprobe(8);
+        index.search(k, batch, queries.data(), results.data(), distances.data());
+        uint64_t hit = 0;
+        for (uint64_t i = 0; i < batch; ++i) {
+            for (uint64_t j = 0; j < k; ++j) {
+                if (std::find(results.begin() + i * k, results.begin() + (i + 1) * k, gt[i * k + j]) != results.begin() + (i + 1) * k) {
+                    ++hit;
+                }
+            }
+        }
+        float recall = (float)hit / (batch * k);
+        std::cout << name << " nQuery = " << batch << ", nprobe = 8, recall@" << k << " = " << recall << std::endl;
+        if (recall < 0.9f) {
+            isPassed = false;
+        }
+    }
+
+    // 保存后重新加载，向量和检索结果不变
+    index.save("data/testIVFFlatIndex.bin");
+    IVFFlatIndex loaded(dim, 1, metric);
+    if (loaded.load("data/testIVFFlatIndex.bin") != 0) {
+        isPassed = false;
+    }
+    std::vector<float> vec(dim);
+    loaded.reconstruct(1234, vec.data());
+    if (loaded.getNum() != nData || !std::equal(vec.begin(), vec.end(), vecs.begin() + 1234 * dim)) {
+        std::cout << name << " save/load failed" << std::endl;
+        isPassed = false;
+    }
+    std::vector<uint64_t> a(k), b(k);
+    std::vector<float> da(k), db(k);
+    index.search(k, 1, queries.data(), a.data(), da.data());
+    loaded.search(k, 1, queries.data(), b.data(), db.data());
+    if (a != b) {
+        std::cout << name << " loaded index returns different results" << std::endl;
+        isPassed = false;
+    }
+
+    if (isPassed) {
+        std::cout << name << " IVFFlatIndex test passed!" << std::endl;
+    } else {
+        std::cout << name << " IVFFlatIndex test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+int main() {
+    bool isPassed = true;
+    isPassed = testIVFFlatIndex(MetricType::METRIC_L2, "L2") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testIVFFlatIndex(MetricType::METRIC_INNER_PRODUCT, "IP") && isPassed;
+    return isPassed ? 0 : 1;
+}
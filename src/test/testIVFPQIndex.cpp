@@ -0,0 +1,105 @@
+#include "src/index/IVFPQIndex.hpp"
+#include "src/index/FlatIndex.hpp"
+#include "testData.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+bool testIVFPQIndex(MetricType metric, const char* name) {
+    const uint64_t dim = 64;
+    const uint64_t nlist = 16;
+    const uint64_t M = 16;
+    const uint64_t nData = 5000;
+    const uint64_t nQuery = 50;
+    const uint64_t k = 10;
+
+    std::mt19937 rng(1145);
+    std::vector<float> vecs = makeLowRankData(nData, dim, 8, false, rng);
+    std::vector<float> queries = makeLowRankData(nQuery, dim, 8, false, rng);
+
+    IVFPQIndex index(dim, nlist, M, 8, metric);
+    index.train(vecs.data(), nData);
+    index.addVector(vecs.data(), nData);
+    index.setNprobe(4);
+
+    FlatIndex exact(dim, 1000, false, metric, nullptr);
+    exact.addVector(vecs.data(), nData);
+
+    bool isPassed = true;
+
+    for (uint64_t batch : {(uint64_t)1, nQuery}) {
+        std::vector<uint64_t> results(k * batch), gt(k * batch);
+        std::vector<float> distances(k * batch), gtDistances(k * batch);
+        index.search(k, batch, queries.data(), results.data(), distances.data());
+        exact.query(k, 0, nData, DeviceType::CPU_BLAS, batch, queries.data(), gt.data(), gtDistances.data());
+
+        uint64_t hit = 0;
+        std::vector<float> vec(dim);
+        for (uint64_t i = 0; i < batch; ++i) {
+            if (std::find(results.begin() + i * k, results.begin() + (i + 1) * k, gt[i * k]) != results.begin() + (i + 1) * k) {
+                ++hit;
+            }
+            // 用预计算表拆开后的距离应等于查询与解码后向量的距离
+            index.reconstruct(results[i * k], vec.data());
+            float expected = 0;
+            for (uint64_t d = 0; d < dim; ++d) {
+                const float q = queries[i * dim + d];
+                expected += metric == MetricType::METRIC_L2 ? (q - vec[d]) * (q - vec[d]) : q * vec[d];
+            }
+            if (std::abs(expected - distances[i * k]) > 1e-3 * (1.0f + std::abs(expected))) {
+                std::cout << name << " IVF-PQ distance mismatch: expected = " << expected
+                          << ", got = " << distances[i * k] << std::endl;
+                isPassed = false;
+            }
+        }
+        float recall = (float)hit / batch;
+        std::cout << name << " nQuery = " << batch << ", nprobe = 4, 1-recall@" << k << " = " << recall << std::endl;
+        if (recall < 0.7f) {
+            isPassed = false;
+        }
+    }
+
+    // 保存后重新加载；加载时关闭预计算表，直接用残差计算的结果应与预计算表一致
+    index.save("data/testIVFPQIndex.bin");
+    IVFPQIndex loaded(dim, 1, M, 8, metric);
+    loaded.precomputedTableMaxBytes = 0;
+    if (loaded.load("data/testIVFPQIndex.bin") != 0) {
+        isPassed = false;
+    }
+    std::vector<float> a(dim), b(dim);
+    index.reconstruct(42, a.data());
+    loaded.reconstruct(42, b.data());
+    if (loaded.getNum() != nData || loaded.getNprobe() != 4 || a != b) {
+        std::cout << name << " save/load failed" << std::endl;
+        isPassed = false;
+    }
+    std::vector<uint64_t> ra(k * nQuery), rb(k * nQuery);
+    std::vector<float> da(k * nQuery), db(k * nQuery);
+    index.search(k, nQuery, queries.data(), ra.data(), da.data());
+    loaded.search(k, nQuery, queries.data(), rb.data(), db.data());
+    for (uint64_t i = 0; i < k * nQuery; ++i) {
+        if (std::abs(da[i] - db[i]) > 1e-3 * (1.0f + std::abs(da[i]))) {
+            std::cout << name << " precomputed table mismatch at " << i << ": " << da[i] << " vs " << db[i] << std::endl;
+            isPassed = false;
+            break;
+        }
+    }
+
+    if (isPassed) {
+        std::cout << name << " IVFPQIndex test passed!" << std::endl;
+    } else {
+        std::cout << name << " IVFPQIndex test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+int main() {
+    bool isPassed = true;
+    isPassed = testIVFPQIndex(MetricType::METRIC_L2, "L2") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testIVFPQIndex(MetricType::METRIC_INNER_PRODUCT, "IP") && isPassed;
+    return isPassed ? 0 : 1;
+}
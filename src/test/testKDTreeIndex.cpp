@@ -0,0 +1,165 @@
+#include "src/index/KDTreeIndex.hpp"
+#include "src/index/FlatIndex.hpp"
+#include "src/backend/cpu-blas/heap.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <chrono>
+
+// 暴力计算前k个结果的距离，作为标准答案
+static std::vector<float> bruteForce(const std::vector<float>& vecs, const std::vector<float>& queries,
+                                     uint64_t dim, uint64_t k, MetricType metric) {
+    const uint64_t nData = vecs.size() / dim;
+    const uint64_t nQuery = queries.size() / dim;
+    std::vector<float> out(nQuery * k);
+    std::vector<uint64_t> ids(nQuery * k);
+    for (uint64_t q = 0; q < nQuery; ++q) {
+        std::vector<float> dis(nData);
+        for (uint64_t i = 0; i < nData; ++i) {
+            float d = 0;
+            for (uint64_t j = 0; j < dim; ++j) {
+                const float x = queries[q * dim + j];
+                const float y = vecs[i * dim + j];
+                d += metric == MetricType::METRIC_L2 ? (x - y) * (x - y) : x * y;
+            }
+            dis[i] = d;
+        }
+        if (metric == MetricType::METRIC_L2) {
+            cpu_blas::L2Heap heap;
+            cpu_blas::heapPushLine(heap, k, dis.data(), nData, 0);
+            cpu_blas::heapToOutput(heap, k, HUGE_VALF, out.data() + q * k, ids.data() + q * k);
+        } else {
+            cpu_blas::IPHeap heap;
+            cpu_blas::heapPushLine(heap, k, dis.data(), nData, 0);
+            cpu_blas::heapToOutput(heap, k, -HUGE_VALF, out.data() + q * k, ids.data() + q * k);
+        }
+    }
+    return out;
+}
+
+// 返回的距离与暴力搜索一致，编号对应的向量确实是该距离
+static bool checkResults(const std::vector<float>& vecs, const std::vector<float>& queries, uint64_t dim, uint64_t k,
+                         MetricType metric, const std::vector<float>& expected,
+                         const std::vector<uint64_t>& results, const std::vector<float>& distances) {
+    for (uint64_t i = 0; i < expected.size(); ++i) {
+        const uint64_t q = i / k;
+        if (results[i] >= vecs.size() / dim || std::abs(distances[i] - expected[i]) > 1e-4f * (1.0f + std::abs(expected[i]))) {
+            return false;
+        }
+        float d = 0;
+        for (uint64_t j = 0; j < dim; ++j) {
+            const float x = queries[q * dim + j];
+            const float y = vecs[results[i] * dim + j];
+            d += metric == MetricType::METRIC_L2 ? (x - y) * (x - y) : x * y;
+        }
+        if (std::abs(d - distances[i]) > 1e-4f * (1.0f + std::abs(d))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool testKDTreeIndex(uint64_t dim, MetricType metric, const char* name) {
+    const uint64_t nData = 30000;
+    const uint64_t nQuery = 200;
+    const uint64_t k = 10;
+
+    std::mt19937 rng(1145);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+    std::vector<float> vecs(nData * dim), queries(nQuery * dim);
+    for (auto& v : vecs) {
+        v = dist(rng);
+    }
+    for (auto& v : queries) {
+        v = dist(rng);
+    }
+    std::vector<float> expected = bruteForce(vecs, queries, dim, k, metric);
+
+    bool isPassed = true;
+    std::vector<uint64_t> results(nQuery * k);
+    std::vector<float> distances(nQuery * k);
+
+    KDTreeIndex tree(dim, metric);
+    tree.build(vecs.data(), nData);
+    auto t0 = std::chrono::steady_clock::now();
+    tree.search(k, nQuery, queries.data(), results.data(), distances.data());
+    auto t1 = std::chrono::steady_clock::now();
+    if (!checkResults(vecs, queries, dim, k, metric, expected, results, distances)) {
+        std::cout << name << " KD tree results mismatch" << std::endl;
+        isPassed = false;
+    }
+
+    // FlatIndex::search 在低维时自动使用KD树；分两次添加，第二次的向量少于1/8，走树 + 暴力扫描合并
+    FlatIndex flat(dim, 1000, false, metric, nullptr);
+    flat.treeMaxDim = 16;
+    flat.addVector(vecs.data(), 28000);
+    std::vector<float> first(vecs.begin(), vecs.begin() + 28000 * dim);
+    std::vector<float> firstExpected = bruteForce(first, queries, dim, k, metric);
+    flat.search(k, nQuery, queries.data(), results.data(), distances.data());
+    if (!checkResults(first, queries, dim, k, metric, firstExpected, results, distances)) {
+        std::cout << name << " FlatIndex tree search mismatch" << std::endl;
+        isPassed = false;
+    }
+    flat.addVector(vecs.data() + 28000 * dim, nData - 28000);
+    auto t2 = std::chrono::steady_clock::now();
+    flat.search(k, nQuery, queries.data(), results.data(), distances.data());
+    auto t3 = std::chrono::steady_clock::now();
+    if (!checkResults(vecs, queries, dim, k, metric, expected, results, distances)) {
+        std::cout << name << " FlatIndex tree + tail search mismatch" << std::endl;
+        isPassed = false;
+    }
+
+    // 对照：关闭KD树，走原来的矩阵乘法路径
+    flat.treeMaxDim = 0;
+    auto t4 = std::chrono::steady_clock::now();
+    flat.query(k, 0, nData, DeviceType::CPU_BLAS, nQuery, queries.data(), results.data(), distances.data());
+    auto t5 = std::chrono::steady_clock::now();
+    std::cout << name << " KD tree: " << std::chrono::duration<double, std::milli>(t1 - t0).count()
+              << " ms, FlatIndex::search: " << std::chrono::duration<double, std::milli>(t3 - t2).count()
+              << " ms, BLAS: " << std::chrono::duration<double, std::milli>(t5 - t4).count()
+              << " ms for " << nQuery << " queries" << std::endl;
+
+    // 保存后重新加载，查询结果不变
+    tree.save("data/testKDTreeIndex.bin");
+    KDTreeIndex loaded(dim);
+    loaded.load("data/testKDTreeIndex.bin");
+    std::vector<uint64_t> loadedResults(nQuery * k);
+    std::vector<float> loadedDistances(nQuery * k);
+    tree.search(k, nQuery, queries.data(), results.data(), distances.data());
+    loaded.search(k, nQuery, queries.data(), loadedResults.data(), loadedDistances.data());
+    std::vector<float> a(dim), b(dim);
+    tree.reconstruct(123, a.data());
+    loaded.reconstruct(123, b.data());
+    if (loaded.getNum() != nData || loadedResults != results || loadedDistances != distances ||
+        a != std::vector<float>(vecs.begin() + 123 * dim, vecs.begin() + 124 * dim) || a != b) {
+        std::cout << name << " save/load failed" << std::endl;
+        isPassed = false;
+    }
+
+    if (isPassed) {
+        std::cout << name << " KDTreeIndex test passed!" << std::endl;
+    } else {
+        std::cout << name << " KDTreeIndex test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+int main() {
+    bool isPassed = true;
+    isPassed = testKDTreeIndex(2, MetricType::METRIC_L2, "dim = 2 L2") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testKDTreeIndex(2, MetricType::METRIC_INNER_PRODUCT, "dim = 2 IP") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testKDTreeIndex(5, MetricType::METRIC_L2, "dim = 5 L2") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testKDTreeIndex(8, MetricType::METRIC_L2, "dim = 8 L2") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testKDTreeIndex(8, MetricType::METRIC_INNER_PRODUCT, "dim = 8 IP") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testKDTreeIndex(16, MetricType::METRIC_L2, "dim = 16 L2") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testKDTreeIndex(16, MetricType::METRIC_INNER_PRODUCT, "dim = 16 IP") && isPassed;
+    return isPassed ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+#include "src/index/LSHIndex.hpp"
+#include "src/index/FlatIndex.hpp"
+#include "src/backend/cpu-blas/heap.hpp"
+#include "testData.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+static float recallAt1(const std::vector<uint64_t>& results, const std::vector<uint64_t>& gt, uint64_t nQuery, uint64_t k) {
+    uint64_t hit = 0;
+    for (uint64_t i = 0; i < nQuery; ++i) {
+        if (results[i * k] == gt[i * k]) {
+            ++hit;
+        }
+    }
+    return (float)hit / nQuery;
+}
+
+bool testLSHIndex(MetricType metric, const char* name) {
+    const uint64_t dim = 64;
+    const uint64_t nData = 20000;
+    const uint64_t nQuery = 100;
+    const uint64_t k = 10;
+
+    std::mt19937 rng(1145);
+    std::vector<float> vecs = makeLowRankData(nData, dim, 16, true, rng);
+    std::vector<float> queries = makeLowRankData(nQuery, dim, 16, true, rng);
+
+    // 模拟持续写入：分成许多小批次添加
+    LSHIndex index(dim, 8, 12, metric);
+    for (uint64_t i = 0; i < nData; i += 100) {
+        index.addVector(vecs.data() + i * dim, 100);
+    }
+
+    FlatIndex exact(dim, 1000, false, metric, nullptr);
+    exact.addVector(vecs.data(), nData);
+    std::vector<uint64_t> gt(k * nQuery);
+    std::vector<float> gtDistances(k * nQuery);
+    exact.query(k, 0, nData, DeviceType::CPU_BLAS, nQuery, queries.data(), gt.data(), gtDistances.data());
+
+    bool isPassed = index.getNum() == nData;
+    std::vector<uint64_t> results(k * nQuery);
+    std::vector<float> distances(k * nQuery);
+    float lastRecall = 0;
+    for (uint64_t nprobe : {(uint64_t)1, (uint64_t)4, (uint64_t)16}) {
+        index.setNprobe(nprobe);
+        index.search(k, nQuery, queries.data(), results.data(), distances.data());
+        float recall = recallAt1(results, gt, nQuery, k);
+        std::cout << name << " nprobe = " << nprobe << ", 1-recall@1 = " << recall << std::endl;
+        // 多探测的桶包含少探测时的所有桶，召回率不会下降
+        if (recall < lastRecall) {
+            isPassed = false;
+        }
+        lastRecall = recall;
+
+        // 返回的距离是精确距离
+        for (uint64_t i = 0; i < nQuery; ++i) {
+            if (results[i * k] == cpu_blas::kInvalidIndex) {
+                continue;
+            }
+            std::vector<float> vec(dim);
+            index.reconstruct(results[i * k], vec.data());
+            float expected = 0;
+            for (uint64_t d = 0; d < dim; ++d) {
+                const float q = queries[i * dim + d];
+                expected += metric == MetricType::METRIC_L2 ? (q - vec[d]) * (q - vec[d]) : q * vec[d];
+            }
+            if (std::abs(expected - distances[i * k]) > 1e-4f) {
+                std::cout << name << " distance mismatch: expected = " << expected << ", got = " << distances[i * k] << std::endl;
+                isPassed = false;
+                break;
+            }
+        }
+    }
+    if (lastRecall < 0.9f) {
+        isPassed = false;
+    }
+
+    // 保存后重新加载，查询结果不变
+    index.save("data/testLSHIndex.bin");
+    LSHIndex loaded(dim);
+    loaded.load("data/testLSHIndex.bin");
+    std::vector<uint64_t> loadedResults(k * nQuery);
+    std::vector<float> loadedDistances(k * nQuery);
+    loaded.search(k, nQuery, queries.data(), loadedResults.data(), loadedDistances.data());
+    if (loaded.getNum() != nData || loaded.getNprobe() != index.getNprobe() ||
+        loadedResults != results || loadedDistances != distances) {
+        std::cout << name << " save/load failed" << std::endl;
+        isPassed = false;
+    }
+
+    if (isPassed) {
+        std::cout << name << " LSHIndex test passed!" << std::endl;
+    } else {
+        std::cout << name << " LSHIndex test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+int main() {
+    bool isPassed = true;
+    isPassed = testLSHIndex(MetricType::METRIC_INNER_PRODUCT, "IP") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testLSHIndex(MetricType::METRIC_L2, "L2") && isPassed;
+    return isPassed ? 0 : 1;
+}
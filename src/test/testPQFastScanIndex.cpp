@@ -0,0 +1,142 @@
+#include "src/index/PQFastScanIndex.hpp"
+#include "src/index/FlatIndex.hpp"
+#include "src/backend/cpu-blas/kernels.hpp"
+#include "testData.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+// 当前选中的查表内核必须与标量版本的结果完全一致（M 取奇数，覆盖AVX2的尾部处理）
+bool testPq4Kernel() {
+    const uint64_t M = 11;
+    const uint64_t nBlocks = 5;
+    std::mt19937 rng(1145);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<uint8_t> codes(nBlocks * M * 16), lut(M * 16);
+    for (auto& c : codes) {
+        c = (uint8_t)byte(rng);
+    }
+    for (auto& t : lut) {
+        t = (uint8_t)byte(rng);
+    }
+    std::vector<uint16_t> expected(nBlocks * 32), got(nBlocks * 32);
+    cpu_blas::getKernelsScalar().pq4_accumulate(expected.data(), codes.data(), lut.data(), M, nBlocks);
+    cpu_blas::getKernels().pq4_accumulate(got.data(), codes.data(), lut.data(), M, nBlocks);
+    if (expected != got) {
+        std::cout << cpu_blas::getKernels().name << " pq4_accumulate mismatch" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool testPQFastScanIndex(MetricType metric, const char* name) {
+    const uint64_t dim = 64;
+    const uint64_t M = 16;
+    const uint64_t nData = 5003;        // 不是32的倍数，最后一组没有填满
+    const uint64_t nQuery = 50;
+    const uint64_t k = 10;
+
+    std::mt19937 rng(1145);
+    std::vector<float> vecs = makeLowRankData(nData, dim, 8, false, rng);
+    std::vector<float> queries = makeLowRankData(nQuery, dim, 8, false, rng);
+
+    PQFastScanIndex index(dim, M, metric);
+    index.train(vecs.data(), nData);
+    // 分两次添加，检查半满的组能被正确续写
+    index.addVector(vecs.data(), 1000);
+    index.addVector(vecs.data() + 1000 * dim, nData - 1000);
+
+    FlatIndex exact(dim, 1000, false, metric, nullptr);
+    exact.addVector(vecs.data(), nData);
+
+    bool isPassed = testPq4Kernel();
+
+    for (uint64_t batch : {(uint64_t)1, nQuery}) {
+        std::vector<uint64_t> gt(k * batch);
+        std::vector<float> gtDistances(k * batch);
+        exact.query(k, 0, nData, DeviceType::CPU_BLAS, batch, queries.data(), gt.data(), gtDistances.data());
+
+        // 不精排：近似距离应接近查询与解码后向量的距离
+        std::vector<uint64_t> results(k * batch);
+        std::vector<float> distances(k * batch);
+        index.setRefine(nullptr);
+        index.search(k, batch, queries.data(), results.data(), distances.data());
+        uint64_t hit = 0;
+        std::vector<float> vec(dim);
+        for (uint64_t i = 0; i < batch; ++i) {
+            if (std::find(results.begin() + i * k, results.begin() + (i + 1) * k, gt[i * k]) != results.begin() + (i + 1) * k) {
+                ++hit;
+            }
+            index.reconstruct(results[i * k], vec.data());
+            float expected = 0;
+            float norm = 0;
+            for (uint64_t d = 0; d < dim; ++d) {
+                const float q = queries[i * dim + d];
+                expected += metric == MetricType::METRIC_L2 ? (q - vec[d]) * (q - vec[d]) : q * vec[d];
+                norm += q * q;
+            }
+            // LUT量化为8位，误差与查询的尺度相关
+            if (std::abs(expected - distances[i * k]) > 0.05f * (norm + std::abs(expected))) {
+                std::cout << name << " fast-scan distance mismatch: expected = " << expected
+                          << ", got = " << distances[i * k] << std::endl;
+                isPassed = false;
+            }
+        }
+        float recall = (float)hit / batch;
+        std::cout << name << " nQuery = " << batch << ", fast-scan 1-recall@" << k << " = " << recall << std::endl;
+        if (recall < 0.5f) {
+            isPassed = false;
+        }
+
+        // 精排：距离为精确距离，召回率应明显提高
+        index.setRefine(&exact, 10);
+        index.search(k, batch, queries.data(), results.data(), distances.data());
+        hit = 0;
+        for (uint64_t i = 0; i < batch; ++i) {
+            if (results[i * k] == gt[i * k]) {
+                ++hit;
+            }
+            if (std::abs(distances[i * k] - gtDistances[i * k]) > 1e-3 * (1.0f + std::abs(gtDistances[i * k])) &&
+                results[i * k] == gt[i * k]) {
+                std::cout << name << " refined distance mismatch: expected = " << gtDistances[i * k]
+                          << ", got = " << distances[i * k] << std::endl;
+                isPassed = false;
+            }
+        }
+        recall = (float)hit / batch;
+        std::cout << name << " nQuery = " << batch << ", refined 1-recall@1 = " << recall << std::endl;
+        if (recall < 0.9f) {
+            isPassed = false;
+        }
+    }
+
+    // 保存后重新加载，编码不变
+    index.save("data/testPQFastScanIndex.bin");
+    PQFastScanIndex loaded(dim, M, metric);
+    loaded.load("data/testPQFastScanIndex.bin");
+    std::vector<float> a(dim), b(dim);
+    index.reconstruct(nData - 1, a.data());
+    loaded.reconstruct(nData - 1, b.data());
+    if (loaded.getNum() != nData || a != b) {
+        std::cout << name << " save/load failed" << std::endl;
+        isPassed = false;
+    }
+
+    if (isPassed) {
+        std::cout << name << " PQFastScanIndex test passed!" << std::endl;
+    } else {
+        std::cout << name << " PQFastScanIndex test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+int main() {
+    bool isPassed = true;
+    isPassed = testPQFastScanIndex(MetricType::METRIC_L2, "L2") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testPQFastScanIndex(MetricType::METRIC_INNER_PRODUCT, "IP") && isPassed;
+    return isPassed ? 0 : 1;
+}
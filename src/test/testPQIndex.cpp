@@ -0,0 +1,90 @@
+#include "src/index/PQIndex.hpp"
+#include "src/index/FlatIndex.hpp"
+#include "testData.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+bool testPQIndex(MetricType metric, const char* name) {
+    const uint64_t dim = 64;
+    const uint64_t M = 16;
+    const uint64_t nData = 5000;
+    const uint64_t nQuery = 50;
+    const uint64_t k = 10;
+
+    std::mt19937 rng(1145);
+    std::vector<float> vecs = makeLowRankData(nData, dim, 8, false, rng);
+    std::vector<float> queries = makeLowRankData(nQuery, dim, 8, false, rng);
+
+    PQIndex index(dim, M, 8, metric);
+    index.train(vecs.data(), nData);
+    index.addVector(vecs.data(), nData);
+
+    FlatIndex exact(dim, 1000, false, metric, nullptr);
+    exact.addVector(vecs.data(), nData);
+
+    bool isPassed = true;
+
+    // 1-recall@k：精确的最近邻出现在PQ返回的前k个结果中的比例
+    for (uint64_t batch : {(uint64_t)1, nQuery}) {
+        std::vector<uint64_t> results(k * batch), gt(k * batch);
+        std::vector<float> distances(k * batch), gtDistances(k * batch);
+        index.search(k, batch, queries.data(), results.data(), distances.data());
+        exact.query(k, 0, nData, DeviceType::CPU_BLAS, batch, queries.data(), gt.data(), gtDistances.data());
+
+        uint64_t hit = 0;
+        std::vector<float> vec(dim);
+        for (uint64_t i = 0; i < batch; ++i) {
+            if (std::find(results.begin() + i * k, results.begin() + (i + 1) * k, gt[i * k]) != results.begin() + (i + 1) * k) {
+                ++hit;
+            }
+            // ADC 的距离应等于查询与解码后向量的距离
+            index.reconstruct(results[i * k], vec.data());
+            float expected = 0;
+            for (uint64_t d = 0; d < dim; ++d) {
+                const float q = queries[i * dim + d];
+                expected += metric == MetricType::METRIC_L2 ? (q - vec[d]) * (q - vec[d]) : q * vec[d];
+            }
+            if (std::abs(expected - distances[i * k]) > 1e-3 * (1.0f + std::abs(expected))) {
+                std::cout << name << " ADC distance mismatch: expected = " << expected
+                          << ", got = " << distances[i * k] << std::endl;
+                isPassed = false;
+            }
+        }
+        float recall = (float)hit / batch;
+        std::cout << name << " nQuery = " << batch << ", 1-recall@" << k << " = " << recall << std::endl;
+        if (recall < 0.7f) {
+            isPassed = false;
+        }
+    }
+
+    // 保存后重新加载，编码不变
+    index.save("data/testPQIndex.bin");
+    PQIndex loaded(dim, M, 8, metric);
+    loaded.load("data/testPQIndex.bin");
+    std::vector<float> a(dim), b(dim);
+    index.reconstruct(42, a.data());
+    loaded.reconstruct(42, b.data());
+    if (loaded.getNum() != nData || a != b) {
+        std::cout << name << " save/load failed" << std::endl;
+        isPassed = false;
+    }
+
+    if (isPassed) {
+        std::cout << name << " PQIndex test passed!" << std::endl;
+    } else {
+        std::cout << name << " PQIndex test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+int main() {
+    bool isPassed = true;
+    isPassed = testPQIndex(MetricType::METRIC_L2, "L2") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testPQIndex(MetricType::METRIC_INNER_PRODUCT, "IP") && isPassed;
+    return isPassed ? 0 : 1;
+}
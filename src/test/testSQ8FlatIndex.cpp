@@ -0,0 +1,96 @@
+#include "src/index/SQ8FlatIndex.hpp"
+#include "src/index/FlatIndex.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+bool testSQ8FlatIndex(MetricType metric, const char* name) {
+    // 与 FlatIndex 的精确结果对比召回率，分别覆盖少量查询（扫描编码）和批量查询（解码后 sgemm_）两条路径
+    const uint64_t dim = 67;
+    const uint64_t nData = 5000;
+    const uint64_t k = 10;
+
+    std::mt19937 rng(1145);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<float> vecs(dim * nData);
+    for (auto& v : vecs) {
+        v = dist(rng);
+    }
+
+    SQ8FlatIndex index(dim, metric);
+    index.train(vecs.data(), nData);
+    index.addVector(vecs.data(), nData);
+
+    FlatIndex exact(dim, 1000, false, metric, nullptr);
+    exact.addVector(vecs.data(), nData);
+
+    bool isPassed = true;
+    for (uint64_t nQuery : {1, 5, 64}) {
+        std::vector<float> queries(dim * nQuery);
+        for (auto& v : queries) {
+            v = dist(rng);
+        }
+        std::vector<uint64_t> results(k * nQuery), gt(k * nQuery);
+        std::vector<float> distances(k * nQuery), gtDistances(k * nQuery);
+        index.search(k, nQuery, queries.data(), results.data(), distances.data());
+        exact.query(k, 0, nData, DeviceType::CPU_BLAS, nQuery, queries.data(), gt.data(), gtDistances.data());
+
+        uint64_t hit = 0;
+        std::vector<float> vec(dim);
+        for (uint64_t i = 0; i < nQuery; ++i) {
+            for (uint64_t j = 0; j < k; ++j) {
+                uint64_t id = results[i * k + j];
+                if (std::find(gt.begin() + i * k, gt.begin() + (i + 1) * k, id) != gt.begin() + (i + 1) * k) {
+                    ++hit;
+                }
+                // 返回的距离应该等于查询与解码后向量的距离
+                index.reconstruct(id, vec.data());
+                float expected = 0;
+                for (uint64_t d = 0; d < dim; ++d) {
+                    const float q = queries[i * dim + d];
+                    expected += metric == MetricType::METRIC_L2 ? (q - vec[d]) * (q - vec[d]) : q * vec[d];
+                }
+                if (std::abs(expected - distances[i * k + j]) > 1e-3 * (1.0f + std::abs(expected))) {
+                    std::cout << name << " distance mismatch: nQuery = " << nQuery << ", expected = " << expected
+                              << ", got = " << distances[i * k + j] << std::endl;
+                    isPassed = false;
+                }
+            }
+        }
+        float recall = (float)hit / (nQuery * k);
+        std::cout << name << " nQuery = " << nQuery << ", recall@" << k << " = " << recall << std::endl;
+        if (recall < 0.8f) {
+            isPassed = false;
+        }
+    }
+
+    // 保存后重新加载，结果不变
+    index.save("data/testSQ8FlatIndex.bin");
+    SQ8FlatIndex loaded(dim, metric);
+    int ret = loaded.load("data/testSQ8FlatIndex.bin");
+    std::vector<float> a(dim), b(dim);
+    index.reconstruct(42, a.data());
+    loaded.reconstruct(42, b.data());
+    if (ret != 0 || loaded.getNum() != nData || a != b) {
+        std::cout << name << " save/load failed" << std::endl;
+        isPassed = false;
+    }
+
+    if (isPassed) {
+        std::cout << name << " SQ8FlatIndex test passed!" << std::endl;
+    } else {
+        std::cout << name << " SQ8FlatIndex test failed!" << std::endl;
+    }
+    return isPassed;
+}
+
+int main() {
+    bool isPassed = true;
+    isPassed = testSQ8FlatIndex(MetricType::METRIC_L2, "L2") && isPassed;
+    std::cout << "-------------------------" << std::endl;
+    isPassed = testSQ8FlatIndex(MetricType::METRIC_INNER_PRODUCT, "IP") && isPassed;
+    return isPassed ? 0 : 1;
+}